@@ -6,10 +6,12 @@
 #define NCORE_BROADCAST_HIGH              0x9FFF
 
 // nCore internal messages [0x0500-0x2000)
+#define NCORE_FLUSH_WINDOW_UPDATES        0x0500
 
 // Timers
 enum {
   NCORE_TIMER_WINDOW_MAINTENANCE = 1,
+  NCORE_TIMER_WINDOW_SWEEP,
 
   NCORE_LEASEABLE_TIMERS_START // Keep at the end
 };
@@ -3,6 +3,9 @@
 #include "Messages.h"
 #include "WindowMonitor.h"
 
+#include "../../Utilities/DeadlineQueue.hpp"
+#include "../../Utilities/IconHash.h"
+
 #include "../nUtilities/lsapi.h"
 #include "../nUtilities/Macros.h"
 
@@ -10,12 +13,20 @@
 #include <assert.h>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 extern HWND gWindow;
 
 // How often icons are allowed to be updated, in milliseconds.
 #define MAX_UPDATE_FREQUENCY 100
 
+// How long to wait for the answers to a batch of WM_GETICON probes before giving up on them, in
+// milliseconds. Hung applications never answer.
+#define ICON_FETCH_TIMEOUT 5000
+
+// How often every window is checked, in milliseconds.
+#define SWEEP_INTERVAL 30000
+
 // The messages that the Window Manager wants from the LS core
 static const UINT sWMMessages[] = {
   LM_WINDOWCREATED, LM_WINDOWDESTROYED, LM_WINDOWREPLACED, LM_WINDOWREPLACING, LM_REDRAW, 0
@@ -29,58 +40,176 @@ struct WindowData {
   WindowData()
     : largeIcon(sDefaultIcon)
     , smallIcon(sDefaultIcon)
+    , iconHash(0)
     , lastUpdateTime(0)
     , updateDuringMaintenance(false)
-  {}
+    , iconGeneration(0)
+    , probesAnswered(0)
+    , fetchInFlight(false)
+    , fetchTime(0)
+    , refetch(false)
+  {
+    ZeroMemory(probes, sizeof(probes));
+    ZeroMemory(&iconStats, sizeof(iconStats));
+  }
   HICON largeIcon;
   HICON smallIcon;
+  UINT64 iconHash;
   ULONGLONG lastUpdateTime;
   bool updateDuringMaintenance;
+
+  // The current batch of WM_GETICON probes. ICON_BIG, ICON_SMALL, and ICON_SMALL2 are all sent
+  // at once, and answers from earlier batches are recognized by their generation.
+  UINT iconGeneration;
+  HICON probes[3];
+  BYTE probesAnswered;
+  bool fetchInFlight;
+  ULONGLONG fetchTime;
+  bool refetch;
+
+  WindowMonitor::IconStats iconStats;
 };
 
 typedef std::unordered_map<HWND, WindowData> WindowMap;
 
 static WindowMap sWindowData;
 
+// Windows which need to be revisited, ordered by when.
+static DeadlineQueue<HWND> sPendingWork;
+
+static WindowMonitor::Stats sStats;
+static WindowMonitor::IconStats sIconStats;
+
+// Windows which have received LM_REDRAW since the last flush.
+static std::unordered_set<HWND> sPendingRedraws;
+
+
+static void ScheduleMaintenance() {
+  ULONGLONG deadline;
+  if (!sPendingWork.NextDeadline(deadline)) {
+    KillTimer(gWindow, NCORE_TIMER_WINDOW_MAINTENANCE);
+    return;
+  }
+  ULONGLONG now = GetTickCount64();
+  UINT delay = deadline > now ? UINT(std::min(deadline - now, ULONGLONG(SWEEP_INTERVAL))) : 0;
+  SetTimer(gWindow, NCORE_TIMER_WINDOW_MAINTENANCE, std::max(delay, UINT(USER_TIMER_MINIMUM)),
+    nullptr);
+}
+
 
-static void CALLBACK GetIconCallback(HWND window, UINT message, ULONG_PTR data, LRESULT result) {
+static void QueueWork(HWND window, ULONGLONG deadline) {
+  sPendingWork.Schedule(window, deadline);
+  ScheduleMaintenance();
+}
+
+
+static void FetchIcons(HWND window, WindowData &data);
+
+
+/// <summary>
+/// Picks the icons once all probes have been answered. Only notifies the modules if the pixels
+/// actually changed.
+/// </summary>
+static void ResolveIcons(HWND window, WindowData &data) {
+  if (data.probesAnswered != 0x7) {
+    return;
+  }
+  data.fetchInFlight = false;
+
+  HICON largeIcon = data.probes[0];
+  if (!largeIcon) {
+    largeIcon = (HICON)GetClassLongPtr(window, GCLP_HICON);
+  }
+  HICON smallIcon = data.probes[1] ? data.probes[1] : data.probes[2];
+  if (!smallIcon) {
+    smallIcon = (HICON)GetClassLongPtr(window, GCLP_HICONSM);
+  }
+
+  data.largeIcon = largeIcon ? largeIcon : sDefaultIcon;
+  data.smallIcon = smallIcon ? smallIcon : sDefaultIcon;
+
+  UINT64 hash = Hashing::HashIcon(data.largeIcon) * 31 + Hashing::HashIcon(data.smallIcon);
+  if (hash == data.iconHash) {
+    ++data.iconStats.dedupeHits;
+    ++sIconStats.dedupeHits;
+  } else {
+    data.iconHash = hash;
+    SendMessage(gWindow, NCORE_WINDOW_ICON_CHANGED, (WPARAM)window, NULL);
+  }
+
+  if (data.refetch) {
+    FetchIcons(window, data);
+  }
+}
+
+
+static void CALLBACK GetIconCallback(HWND window, UINT message, ULONG_PTR param, LRESULT result) {
   assert(message == WM_GETICON);
 
-  switch (data) {
-  case ICON_BIG:
-    if (result != NULL) {
-      sWindowData[window].largeIcon = (HICON)result;
-    } else {
-      HICON icon = (HICON)GetClassLongPtr(window, GCLP_HICON);
-      if (!icon) {
-        icon = sDefaultIcon;
-      }
-      sWindowData[window].largeIcon = icon;
-    }
-    SendMessageCallback(window, WM_GETICON, ICON_SMALL, NULL, GetIconCallback, ICON_SMALL);
-    break;
-
-  case ICON_SMALL:
-    if (result != NULL) {
-      sWindowData[window].smallIcon = (HICON)result;
-      SendMessage(gWindow, NCORE_WINDOW_ICON_CHANGED, (WPARAM)window, NULL);
-    } else {
-      SendMessageCallback(window, WM_GETICON, ICON_SMALL2, NULL, GetIconCallback, ICON_SMALL2);
+  WindowMap::iterator iter = sWindowData.find(window);
+  if (iter == sWindowData.end()) {
+    return;
+  }
+
+  WindowData &data = iter->second;
+  UINT probe = UINT(param & 3);
+  if (!data.fetchInFlight || UINT(param >> 2) != (data.iconGeneration & (UINT_MAX >> 2))) {
+    return;
+  }
+
+  data.probes[probe] = (HICON)result;
+  data.probesAnswered |= 1 << probe;
+  ResolveIcons(window, data);
+}
+
+
+/// <summary>
+/// Sends all WM_GETICON probes for the window at once.
+/// </summary>
+static void FetchIcons(HWND window, WindowData &data) {
+  static const WPARAM probeTypes[] = { ICON_BIG, ICON_SMALL, ICON_SMALL2 };
+
+  ULONGLONG time = GetTickCount64();
+  if (data.fetchInFlight) {
+    if (time - data.fetchTime < ICON_FETCH_TIMEOUT) {
+      data.refetch = true;
+      ++data.iconStats.coalesced;
+      ++sIconStats.coalesced;
+      return;
     }
-    break;
-
-  case ICON_SMALL2:
-    if (result != NULL) {
-      sWindowData[window].smallIcon = (HICON)result;
-    } else {
-      HICON icon = (HICON)GetClassLongPtr(window, GCLP_HICONSM);
-      if (!icon) {
-        icon = sDefaultIcon;
-      }
-      sWindowData[window].smallIcon = icon;
+
+    // The previous batch is lost. Any late answers are ignored, since they carry its generation.
+    ++data.iconStats.timeouts;
+    ++sIconStats.timeouts;
+  }
+
+  if (data.iconStats.fetches++ == 0) {
+    data.iconStats.firstFetchTime = time;
+  }
+  if (sIconStats.fetches++ == 0) {
+    sIconStats.firstFetchTime = time;
+  }
+
+  data.fetchInFlight = true;
+  data.fetchTime = time;
+  data.refetch = false;
+  data.probesAnswered = 0;
+  ++data.iconGeneration;
+
+  UINT failures = 0;
+  for (UINT i = 0; i < _countof(probeTypes); ++i) {
+    data.probes[i] = nullptr;
+    ULONG_PTR param = ULONG_PTR(data.iconGeneration & (UINT_MAX >> 2)) << 2 | i;
+    if (!SendMessageCallback(window, WM_GETICON, probeTypes[i], NULL, GetIconCallback, param)) {
+      data.probesAnswered |= 1 << i;
+      ++failures;
     }
-    SendMessage(gWindow, NCORE_WINDOW_ICON_CHANGED, (WPARAM)window, NULL);
-    break;
+  }
+
+  if (failures == _countof(probeTypes)) {
+    // Most likely destroyed. Check up on it.
+    data.fetchInFlight = false;
+    QueueWork(window, time);
   }
 }
 
@@ -90,18 +219,55 @@ static void UpdateWindowData(HWND window) {
   WindowData &data = sWindowData[window];
   if (time - data.lastUpdateTime < MAX_UPDATE_FREQUENCY) {
     data.updateDuringMaintenance = true;
+    QueueWork(window, data.lastUpdateTime + MAX_UPDATE_FREQUENCY);
     return;
   }
   data.lastUpdateTime = time;
   data.updateDuringMaintenance = false;
-  SendMessageCallback(window, WM_GETICON, ICON_BIG, NULL, GetIconCallback, ICON_BIG);
+  FetchIcons(window, data);
+}
+
+
+/// <summary>
+/// Records an LM_REDRAW. Repeated redraws of the same window before the next flush are handled
+/// once.
+/// </summary>
+static void QueueRedraw(HWND window) {
+  ++sIconStats.redraws;
+  WindowMap::iterator iter = sWindowData.find(window);
+  if (iter != sWindowData.end()) {
+    ++iter->second.iconStats.redraws;
+  }
+
+  if (sPendingRedraws.empty()) {
+    PostMessage(gWindow, NCORE_FLUSH_WINDOW_UPDATES, 0, 0);
+  }
+  if (!sPendingRedraws.insert(window).second) {
+    ++sIconStats.coalesced;
+    if (iter != sWindowData.end()) {
+      ++iter->second.iconStats.coalesced;
+    }
+  }
+}
+
+
+static void FlushRedraws() {
+  std::unordered_set<HWND> redraws;
+  redraws.swap(sPendingRedraws);
+  for (HWND window : redraws) {
+    UpdateWindowData(window);
+  }
 }
 
 
 LRESULT WindowMonitor::HandleMessage(UINT message, WPARAM wParam, LPARAM) {
   switch (message) {
   case LM_REDRAW:
-    UpdateWindowData((HWND)wParam);
+    QueueRedraw((HWND)wParam);
+    return 0;
+
+  case NCORE_FLUSH_WINDOW_UPDATES:
+    FlushRedraws();
     return 0;
 
   case LM_WINDOWCREATED:
@@ -110,6 +276,7 @@ LRESULT WindowMonitor::HandleMessage(UINT message, WPARAM wParam, LPARAM) {
 
   case LM_WINDOWDESTROYED:
     sWindowData.erase((HWND)wParam);
+    sPendingWork.Cancel((HWND)wParam);
     return 0;
 
   case LM_WINDOWREPLACED:
@@ -118,6 +285,7 @@ LRESULT WindowMonitor::HandleMessage(UINT message, WPARAM wParam, LPARAM) {
 
   case LM_WINDOWREPLACING:
     sWindowData.erase((HWND)wParam);
+    sPendingWork.Cancel((HWND)wParam);
     return 0;
 
   default:
@@ -130,7 +298,7 @@ LRESULT WindowMonitor::HandleMessage(UINT message, WPARAM wParam, LPARAM) {
 void WindowMonitor::Start() {
   sDefaultIcon = LoadIcon(nullptr, IDI_APPLICATION);
   SendMessage(GetLitestepWnd(), LM_REGISTERMESSAGE, (WPARAM)gWindow, (LPARAM)sWMMessages);
-  SetTimer(gWindow, NCORE_TIMER_WINDOW_MAINTENANCE, 250, nullptr);
+  SetTimer(gWindow, NCORE_TIMER_WINDOW_SWEEP, SWEEP_INTERVAL, nullptr);
 
   sInitThread = std::thread([] () -> void {
     EnumDesktopWindows(nullptr, (WNDENUMPROC) [] (HWND window, LPARAM) -> BOOL {
@@ -147,6 +315,9 @@ void WindowMonitor::Stop() {
   sInitThread.join();
   SendMessage(GetLitestepWnd(), LM_UNREGISTERMESSAGE, (WPARAM)gWindow, (LPARAM)sWMMessages);
   KillTimer(gWindow, NCORE_TIMER_WINDOW_MAINTENANCE);
+  KillTimer(gWindow, NCORE_TIMER_WINDOW_SWEEP);
+  sPendingWork.Clear();
+  sPendingRedraws.clear();
   sWindowData.clear();
   DestroyIcon(sDefaultIcon);
   sDefaultIcon = nullptr;
@@ -154,19 +325,88 @@ void WindowMonitor::Stop() {
 
 
 void WindowMonitor::RunWindowMaintenance() {
+  ULONGLONG now = GetTickCount64();
+  UINT visited = 0;
+  HWND window;
+  while (sPendingWork.PopDue(now, window)) {
+    ++visited;
+    WindowMap::iterator iter = sWindowData.find(window);
+    if (iter == sWindowData.end()) {
+      continue;
+    }
+
+    if (!IsTaskbarWindow(window)) {
+      sWindowData.erase(iter);
+      ++sStats.removals;
+      continue;
+    }
+
+    if (iter->second.updateDuringMaintenance) {
+      ++sStats.deferredUpdates;
+      UpdateWindowData(window);
+    }
+  }
+
+  ++sStats.passes;
+  sStats.lastVisited = visited;
+  sStats.visited += visited;
+
+  ScheduleMaintenance();
+}
+
+
+void WindowMonitor::SweepWindows() {
+  UINT removals = 0;
+  sStats.lastVisited = UINT(sWindowData.size());
   for (WindowMap::iterator iter = sWindowData.begin(); iter != sWindowData.end();) {
     if (!IsTaskbarWindow(iter->first)) {
+      sPendingWork.Cancel(iter->first);
       iter = sWindowData.erase(iter);
+      ++removals;
       continue;
     }
 
     if (iter->second.updateDuringMaintenance) {
-      iter->second.updateDuringMaintenance = false;
       UpdateWindowData(iter->first);
     }
 
     ++iter;
   }
+
+  ++sStats.sweeps;
+  sStats.visited += sStats.lastVisited;
+  sStats.removals += removals;
+  sStats.lastSweepRemovals = removals;
+  ScheduleMaintenance();
+}
+
+
+const WindowMonitor::Stats &WindowMonitor::GetStats() {
+  return sStats;
+}
+
+
+const WindowMonitor::IconStats &WindowMonitor::GetIconStats() {
+  return sIconStats;
+}
+
+
+bool WindowMonitor::GetIconStats(HWND window, IconStats &stats) {
+  WindowMap::const_iterator iter = sWindowData.find(window);
+  if (iter == sWindowData.end()) {
+    return false;
+  }
+  stats = iter->second.iconStats;
+  return true;
+}
+
+
+double WindowMonitor::GetFetchRate(const IconStats &stats) {
+  if (stats.fetches == 0) {
+    return 0.0;
+  }
+  ULONGLONG elapsed = GetTickCount64() - stats.firstFetchTime;
+  return stats.fetches * 60000.0 / std::max(elapsed, 1000ULL);
 }
 
 
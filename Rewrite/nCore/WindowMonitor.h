@@ -12,7 +12,69 @@ namespace WindowMonitor {
   LRESULT HandleMessage(UINT, WPARAM, LPARAM);
 
   /// <summary>
-  /// Removes non-existing HWNDs, and checks if a window has moved to another monitor.
+  /// Counters describing the work done by window maintenance.
+  /// </summary>
+  struct Stats {
+    ULONGLONG passes;
+    ULONGLONG sweeps;
+    UINT lastVisited;
+    ULONGLONG visited;
+    ULONGLONG deferredUpdates;
+    ULONGLONG removals;
+    UINT lastSweepRemovals;
+  };
+
+  /// <summary>
+  /// Counters for icon fetching, either for a single window or across all windows.
+  /// </summary>
+  struct IconStats {
+    // LM_REDRAW messages received.
+    ULONGLONG redraws;
+
+    // Redraws and fetches folded into one which was already pending.
+    ULONGLONG coalesced;
+
+    // Batches of WM_GETICON probes sent.
+    ULONGLONG fetches;
+
+    // Fetches which returned the same pixels as before.
+    ULONGLONG dedupeHits;
+
+    // Fetches which were given up on, because the window didn't answer in time.
+    ULONGLONG timeouts;
+
+    // Tick count at the first fetch.
+    ULONGLONG firstFetchTime;
+  };
+
+  /// <summary>
+  /// Carries out deferred icon updates which are due, and drops windows which are suspected to
+  /// have been destroyed. Only windows with pending work are visited.
   /// </summary>
   void RunWindowMaintenance();
+
+  /// <summary>
+  /// Checks every known window. Catches anything the shell events missed, so it runs rarely.
+  /// </summary>
+  void SweepWindows();
+
+  /// <summary>
+  /// Returns the maintenance counters.
+  /// </summary>
+  const Stats &GetStats();
+
+  /// <summary>
+  /// Returns the icon counters across all windows.
+  /// </summary>
+  const IconStats &GetIconStats();
+
+  /// <summary>
+  /// Retrieves the icon counters for a single window. Returns false if the window is unknown.
+  /// </summary>
+  bool GetIconStats(HWND window, IconStats &stats);
+
+  /// <summary>
+  /// Returns the number of fetches per minute since the first fetch.
+  /// </summary>
+  double GetFetchRate(const IconStats &stats);
 };
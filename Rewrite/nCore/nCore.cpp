@@ -66,6 +66,10 @@ LRESULT WINAPI MessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM l
     case NCORE_TIMER_WINDOW_MAINTENANCE:
       WindowMonitor::RunWindowMaintenance();
       return 0;
+
+    case NCORE_TIMER_WINDOW_SWEEP:
+      WindowMonitor::SweepWindows();
+      return 0;
     }
     Timers::Handle(wParam, lParam);
     return 0;
@@ -84,6 +88,7 @@ LRESULT WINAPI MessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM l
   case LM_WINDOWDESTROYED:
   case LM_WINDOWREPLACED:
   case LM_WINDOWREPLACING:
+  case NCORE_FLUSH_WINDOW_UPDATES:
     return WindowMonitor::HandleMessage(message, wParam, lParam);
   }
 
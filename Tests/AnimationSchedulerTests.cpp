@@ -0,0 +1,171 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/AnimationSchedulerTests.cpp
+// The nModules Project
+//
+// Tests for the animation scheduler, driven by a fake clock.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nShared/AnimationScheduler.hpp"
+
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// A scheduler whose clock only moves when told to, and which records what it asks of its frame
+  /// source and how it groups updates.
+  /// </summary>
+  struct FakeClockScheduler {
+    FakeClockScheduler()
+      : now(10.0)
+      , running(false)
+      , frameSourceCalls(0)
+      , scheduler(
+          [this] () { return now; },
+          [this] (bool run) { running = run; ++frameSourceCalls; },
+          [this] (void *group, const std::function<void ()> &update) {
+            groups.push_back(group);
+            update();
+          }) {}
+
+    void Start(const void *owner, UINT_PTR key, void *group, float from, float to, float duration,
+        float *target) {
+      scheduler.Start(owner, key, group, &from, &to, 1, duration, Easing::Type::Linear,
+        [target] (const float *values) { *target = values[0]; });
+    }
+
+    double now;
+    bool running;
+    int frameSourceCalls;
+    std::vector<void*> groups;
+    AnimationScheduler scheduler;
+  };
+
+  int sOwnerA, sOwnerB;
+  int sGroupA, sGroupB;
+}
+
+
+// The real easings are tested by looking at them. Linear progress keeps the expected values exact.
+float Easing::Transform(float progress, Easing::Type) {
+  return progress;
+}
+
+
+TEST(AnimationSchedulerRunsToCompletion) {
+  FakeClockScheduler fake;
+  float value = 0.0f;
+
+  fake.Start(&sOwnerA, 1, &sGroupA, 0.0f, 3.0f, 2.0f, &value);
+  CHECK(fake.running && fake.frameSourceCalls == 1);
+  CHECK(fake.scheduler.IsAnimating(&sOwnerA) && !fake.scheduler.IsAnimating(&sOwnerB));
+
+  fake.now += 0.5;
+  fake.scheduler.Tick();
+  CHECK(value == 0.75f);
+
+  // Late frames land exactly on the target, and the frame source is only stopped once.
+  fake.now += 5.0;
+  fake.scheduler.Tick();
+  CHECK(value == 3.0f);
+  CHECK(!fake.running && !fake.scheduler.IsRunning() && fake.frameSourceCalls == 2);
+  CHECK(!fake.scheduler.IsAnimating(&sOwnerA));
+}
+
+
+TEST(AnimationSchedulerZeroDuration) {
+  FakeClockScheduler fake;
+  float value = 0.0f;
+
+  fake.Start(&sOwnerA, 1, &sGroupA, 0.0f, 1.0f, 0.0f, &value);
+  CHECK(value == 1.0f);
+  CHECK(fake.frameSourceCalls == 0 && !fake.scheduler.IsRunning());
+}
+
+
+TEST(AnimationSchedulerReplaceAndStop) {
+  FakeClockScheduler fake;
+  float first = 0.0f, second = 0.0f;
+
+  fake.Start(&sOwnerA, 1, &sGroupA, 0.0f, 10.0f, 1.0f, &first);
+  fake.Start(&sOwnerA, 2, &sGroupA, 0.0f, 10.0f, 1.0f, &second);
+
+  // Starting the same property again replaces the running animation, from its new start.
+  fake.now += 0.5;
+  fake.Start(&sOwnerA, 1, &sGroupA, 5.0f, 0.0f, 1.0f, &first);
+  fake.scheduler.Tick();
+  CHECK(first == 5.0f && second == 5.0f);
+
+  // Stopping one property leaves it where it is, and doesn't touch the others.
+  fake.scheduler.Stop(&sOwnerA, 1);
+  fake.now += 0.25;
+  fake.scheduler.Tick();
+  CHECK(first == 5.0f && second == 7.5f);
+
+  fake.scheduler.Stop(&sOwnerA);
+  CHECK(!fake.scheduler.IsRunning() && !fake.running);
+}
+
+
+TEST(AnimationSchedulerStopFromSetter) {
+  FakeClockScheduler fake;
+  float value = 0.0f, other = 0.0f;
+  int calls = 0;
+
+  // A setter which stops its own animation, like Window::SetOpacity does for a running fade.
+  float from = 0.0f, to = 1.0f;
+  fake.scheduler.Start(&sOwnerA, 1, &sGroupA, &from, &to, 1, 1.0f, Easing::Type::Linear,
+    [&] (const float *values) {
+      value = values[0];
+      ++calls;
+      fake.scheduler.Stop(&sOwnerA, 1);
+    });
+  fake.Start(&sOwnerB, 1, &sGroupA, 0.0f, 1.0f, 1.0f, &other);
+
+  fake.now += 0.5;
+  fake.scheduler.Tick();
+  fake.now += 0.25;
+  fake.scheduler.Tick();
+  CHECK(calls == 1 && value == 0.5f);
+  CHECK(other == 0.75f && fake.scheduler.IsRunning());
+}
+
+
+TEST(AnimationSchedulerGroupsUpdates) {
+  FakeClockScheduler fake;
+  float values[4] = { 0 };
+
+  // Interleaved groups are updated once each per frame.
+  fake.Start(&sOwnerA, 1, &sGroupA, 0.0f, 1.0f, 1.0f, &values[0]);
+  fake.Start(&sOwnerB, 1, &sGroupB, 0.0f, 1.0f, 1.0f, &values[1]);
+  fake.Start(&sOwnerA, 2, &sGroupA, 0.0f, 1.0f, 1.0f, &values[2]);
+  fake.Start(&sOwnerB, 2, &sGroupB, 0.0f, 1.0f, 1.0f, &values[3]);
+
+  fake.now += 0.5;
+  fake.scheduler.Tick();
+  CHECK(fake.groups.size() == 2 && fake.groups[0] != fake.groups[1]);
+  for (float value : values) {
+    CHECK(value == 0.5f);
+  }
+
+  // Stopping a group stops every owner's animations in it.
+  fake.scheduler.StopGroup(&sGroupA);
+  CHECK(!fake.scheduler.IsAnimating(&sOwnerA) && fake.scheduler.IsAnimating(&sOwnerB));
+}
+
+
+TEST(AnimationSchedulerStats) {
+  FakeClockScheduler fake;
+  float value = 0.0f;
+
+  fake.Start(&sOwnerA, 1, &sGroupA, 0.0f, 1.0f, 10.0f, &value);
+  for (int i = 0; i < 60; ++i) {
+    fake.now += 1.0 / 60;
+    fake.scheduler.Tick();
+  }
+  fake.now += 1.0 / 60;
+  fake.scheduler.Tick();
+
+  CHECK(fake.scheduler.GetStats().frames == 61);
+  CHECK(fake.scheduler.GetStats().framesPerSecond > 59.0f && fake.scheduler.GetStats().framesPerSecond < 62.0f);
+}
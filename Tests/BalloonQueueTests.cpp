@@ -0,0 +1,116 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/BalloonQueueTests.cpp
+// The nModules Project
+//
+// Tests for nTray's balloon queue, driven by a fake clock.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nTray/BalloonQueue.hpp"
+
+namespace {
+  // The queue never dereferences icons, so any distinct pointers will do.
+  TrayIcon *const sIconA = (TrayIcon*)0x10;
+  TrayIcon *const sIconB = (TrayIcon*)0x20;
+  TrayIcon *const sIconC = (TrayIcon*)0x30;
+  TrayIcon *const sIconD = (TrayIcon*)0x40;
+
+  /// <summary>
+  /// A queue whose clock only moves when told to.
+  /// </summary>
+  struct FakeClockQueue {
+    FakeClockQueue() : now(1000), queue([this] () { return now; }) {}
+
+    BalloonQueue::Result Push(TrayIcon *icon, DWORD processId, DWORD infoFlags = NIIF_INFO) {
+      return queue.Push(icon, processId, L"Title", L"Info", infoFlags, nullptr);
+    }
+
+    ULONGLONG now;
+    BalloonQueue queue;
+  };
+}
+
+
+TEST(BalloonQueueRateLimit) {
+  FakeClockQueue fake;
+  fake.queue.SetLimits(16, 2, 1000);
+
+  CHECK(fake.Push(sIconA, 1) == BalloonQueue::Result::Queued);
+  CHECK(fake.Push(sIconB, 1) == BalloonQueue::Result::Queued);
+  CHECK(fake.Push(sIconC, 1) == BalloonQueue::Result::Dropped);
+  CHECK(fake.queue.GetStats().rateLimited == 1);
+
+  // Other processes have their own budget.
+  CHECK(fake.Push(sIconC, 2) == BalloonQueue::Result::Queued);
+
+  // The budget refills once the interval has passed since the earlier notifications.
+  fake.now += 999;
+  CHECK(fake.Push(sIconD, 1) == BalloonQueue::Result::Dropped);
+  fake.now += 1;
+  CHECK(fake.Push(sIconD, 1) == BalloonQueue::Result::Queued);
+  CHECK(fake.queue.GetStats().rateLimited == 2);
+  CHECK(fake.queue.GetStats().queued == 4);
+}
+
+
+TEST(BalloonQueueOnlyChargesQueuedBalloons) {
+  FakeClockQueue fake;
+  fake.queue.SetLimits(1, 1, 60000);
+
+  CHECK(fake.Push(sIconA, 1, NIIF_ERROR) == BalloonQueue::Result::Queued);
+
+  // The queue is full of something more important. This must not use up process 2's budget.
+  CHECK(fake.Push(sIconB, 2, NIIF_INFO) == BalloonQueue::Result::Dropped);
+  CHECK(fake.queue.GetStats().rateLimited == 0);
+
+  CHECK(fake.queue.Next(false) && fake.queue.GetActiveIcon() == sIconA);
+  CHECK(fake.Push(sIconB, 2, NIIF_INFO) == BalloonQueue::Result::Queued);
+
+  // A rate limited notification must not evict anything either.
+  fake.queue.ClearActive();
+  CHECK(fake.Push(sIconC, 2, NIIF_ERROR) == BalloonQueue::Result::Dropped);
+  CHECK(fake.queue.GetStats().rateLimited == 1);
+  CHECK(fake.queue.Next(false) && fake.queue.GetActiveIcon() == sIconB);
+}
+
+
+TEST(BalloonQueueCoalescing) {
+  FakeClockQueue fake;
+  fake.queue.SetLimits(16, 1, 60000);
+
+  // Updates from the same icon replace the queued notification, and don't count as new ones.
+  CHECK(fake.Push(sIconA, 1, NIIF_INFO) == BalloonQueue::Result::Queued);
+  CHECK(fake.Push(sIconA, 1, NIIF_INFO) == BalloonQueue::Result::Merged);
+  CHECK(fake.queue.Push(sIconA, 1, L"Newer", L"Info", NIIF_INFO, nullptr) == BalloonQueue::Result::Merged);
+
+  CHECK(fake.queue.Next(false));
+  CHECK(fake.queue.GetActive()->title == L"Newer");
+  CHECK(fake.queue.Empty());
+
+  // Including the one which is being shown.
+  CHECK(fake.Push(sIconA, 1, NIIF_WARNING) == BalloonQueue::Result::MergedIntoActive);
+  CHECK(fake.queue.GetActive()->infoFlags == NIIF_WARNING);
+  CHECK(fake.queue.GetStats().merged == 3);
+  CHECK(fake.queue.GetStats().queued == 1);
+}
+
+
+TEST(BalloonQueueOrdering) {
+  FakeClockQueue fake;
+  fake.queue.SetLimits(2, 0, 0);
+
+  CHECK(fake.Push(sIconA, 1, NIIF_INFO) == BalloonQueue::Result::Queued);
+  CHECK(fake.Push(sIconB, 2, NIIF_INFO) == BalloonQueue::Result::Queued);
+
+  // A more severe notification evicts the newest of the least severe ones.
+  CHECK(fake.Push(sIconC, 3, NIIF_ERROR) == BalloonQueue::Result::Queued);
+  CHECK(fake.queue.GetStats().dropped == 1);
+
+  CHECK(fake.queue.Next(false) && fake.queue.GetActiveIcon() == sIconC);
+  CHECK(fake.queue.Next(false) && fake.queue.GetActiveIcon() == sIconA);
+  CHECK(!fake.queue.Next(false) && fake.queue.GetActiveIcon() == nullptr);
+
+  // Quiet time discards the notifications which ask for it.
+  CHECK(fake.Push(sIconD, 4, NIIF_INFO | NIIF_RESPECT_QUIET_TIME) == BalloonQueue::Result::Queued);
+  CHECK(!fake.queue.Next(true));
+}
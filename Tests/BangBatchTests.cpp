@@ -0,0 +1,173 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/BangBatchTests.cpp
+// The nModules Project
+//
+// Tests for running window bangs as a single update.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+#include "LSAPISeams.hpp"
+#include "WindowSeams.hpp"
+
+#include "../nShared/BangBatch.hpp"
+
+#include <map>
+#include <string>
+
+namespace {
+  HWND const sLabelHandle = reinterpret_cast<HWND>(0x10);
+  HWND const sPopupHandle = reinterpret_cast<HWND>(0x20);
+
+  /// <summary>
+  /// A label with an overlay window, and a popup. "!Show <name>" repaints the named window, and
+  /// "!Show Destroy" destroys the label.
+  /// </summary>
+  struct Windows {
+    Windows() {
+      WindowSeams::Reset();
+      label = WindowSeams::Create(sLabelHandle);
+      overlay = WindowSeams::Create(sLabelHandle);
+      popup = WindowSeams::Create(sPopupHandle);
+      names[L"Label"] = label;
+      names[L"Overlay"] = overlay;
+      names[L"Popup"] = popup;
+
+      find = BangBatch::Batched([this] (LPCTSTR name) -> Window* {
+        auto window = names.find(name);
+        return window != names.end() ? window->second : nullptr;
+      });
+
+      LSAPISeams::gExecute = [this] (LPCWSTR command) {
+        std::wstring name(command);
+        name = name.substr(name.find(L' ') + 1);
+        if (name == L"Destroy") {
+          WindowSeams::Destroy(names[L"Overlay"]);
+          WindowSeams::Destroy(names[L"Label"]);
+          names.erase(L"Label");
+          names.erase(L"Overlay");
+          return;
+        }
+        Window *window = find(name.c_str());
+        if (window != nullptr) {
+          WindowSeams::Repaint(window);
+        }
+      };
+    }
+
+    ~Windows() {
+      LSAPISeams::gExecute = nullptr;
+      WindowSeams::Reset();
+    }
+
+    Window *label, *overlay, *popup;
+    std::map<std::wstring, Window*> names;
+    BangBatch::Finder find;
+  };
+
+  /// <summary>
+  /// The counters added up since the previous call.
+  /// </summary>
+  BangBatch::Stats StatsSince(BangBatch::Stats &last) {
+    BangBatch::Stats now = BangBatch::GetStats();
+    BangBatch::Stats since = { now.batches - last.batches, now.commands - last.commands,
+      now.repaints - last.repaints, now.repaintsAvoided - last.repaintsAvoided };
+    last = now;
+    return since;
+  }
+}
+
+
+TEST(BangBatchNesting) {
+  Windows windows;
+  BangBatch::Stats last = BangBatch::GetStats();
+
+  // Outside of a batch, finding a window doesn't lock it.
+  WindowSeams::Repaint(windows.find(L"Label"));
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 1 && WindowSeams::GetLockCount(sLabelHandle) == 0);
+
+  {
+    BangBatch::Scope outer;
+    WindowSeams::Repaint(windows.find(L"Label"));
+    WindowSeams::Repaint(windows.find(L"Label"));
+    {
+      // An inner scope doesn't commit anything.
+      BangBatch::Scope inner;
+      WindowSeams::Repaint(windows.find(L"Overlay"));
+      WindowSeams::Repaint(windows.find(L"Popup"));
+    }
+    CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 1 && WindowSeams::GetPaintCount(sPopupHandle) == 0);
+
+    // The label and its overlay share one lock.
+    CHECK(WindowSeams::GetLockCount(sLabelHandle) == 1 && WindowSeams::GetLockCount(sPopupHandle) == 1);
+    CHECK(windows.find(L"Missing") == nullptr);
+    WindowSeams::Repaint(windows.find(L"Popup"));
+  }
+
+  // Each top-level window paints once.
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 2 && WindowSeams::GetPaintCount(sPopupHandle) == 1);
+  CHECK(WindowSeams::GetLockCount(sLabelHandle) == 0 && WindowSeams::GetLockCount(sPopupHandle) == 0);
+
+  BangBatch::Stats stats = StatsSince(last);
+  CHECK(stats.batches == 1 && stats.commands == 0);
+  CHECK(stats.repaints == 5 && stats.repaintsAvoided == 3);
+
+  // A batch which doesn't repaint anything has nothing to avoid.
+  {
+    BangBatch::Scope scope;
+    windows.find(L"Label");
+  }
+  stats = StatsSince(last);
+  CHECK(stats.batches == 1 && stats.repaints == 0 && stats.repaintsAvoided == 0);
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 2);
+}
+
+
+TEST(BangBatchCounters) {
+  Windows windows;
+  BangBatch::Stats last = BangBatch::GetStats();
+
+  // Commands are only counted as part of a batch.
+  BangBatch::Execute(L"!Show Label");
+  BangBatch::Stats stats = StatsSince(last);
+  CHECK(stats.batches == 0 && stats.commands == 0 && stats.repaints == 0);
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 1);
+
+  BangBatch::Run(L"[!Show Label] \"!Show Overlay\" [!Show Popup] [!Show Label]");
+  stats = StatsSince(last);
+  CHECK(stats.batches == 1 && stats.commands == 4);
+  CHECK(stats.repaints == 4 && stats.repaintsAvoided == 2);
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 2 && WindowSeams::GetPaintCount(sPopupHandle) == 1);
+
+  // Runs within a scope are part of its batch.
+  {
+    BangBatch::Scope scope;
+    BangBatch::Run(L"[!Show Label] [!Show Popup]");
+    BangBatch::Run(L"[!Show Overlay]");
+    BangBatch::Execute(L"!Show Popup");
+  }
+  stats = StatsSince(last);
+  CHECK(stats.batches == 1 && stats.commands == 4);
+  CHECK(stats.repaints == 4 && stats.repaintsAvoided == 2);
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 3 && WindowSeams::GetPaintCount(sPopupHandle) == 2);
+
+  BangBatch::Run(L"");
+  stats = StatsSince(last);
+  CHECK(stats.batches == 1 && stats.commands == 0);
+}
+
+
+TEST(BangBatchWindowDestroyed) {
+  Windows windows;
+
+  // A bang in the middle of the batch destroys the label, and the ones after it can't find it.
+  BangBatch::Run(L"[!Show Label] [!Show Overlay] [!Show Popup] [!Show Destroy] [!Show Label] [!Show Overlay] "
+    L"[!Show Popup]");
+  CHECK(WindowSeams::GetMisuseCount() == 0);
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 0 && WindowSeams::GetPaintCount(sPopupHandle) == 1);
+  CHECK(WindowSeams::GetLockCount(sPopupHandle) == 0);
+
+  // A new window which gets the old handle isn't affected by the old batch.
+  windows.names[L"Label"] = WindowSeams::Create(sLabelHandle);
+  BangBatch::Run(L"[!Show Label] [!Show Label]");
+  CHECK(WindowSeams::GetMisuseCount() == 0);
+  CHECK(WindowSeams::GetPaintCount(sLabelHandle) == 1 && WindowSeams::GetLockCount(sLabelHandle) == 0);
+}
@@ -0,0 +1,106 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ClockGeometryTests.cpp
+// The nModules Project
+//
+// Tests for the hand geometry and redraw scheduling of nClock.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nClock/ClockGeometry.hpp"
+
+#include <math.h>
+
+namespace {
+  typedef ClockGeometry::Box Box;
+
+  bool Near(float a, float b, float tolerance = 1e-3f) {
+    return fabsf(a - b) <= tolerance;
+  }
+
+  bool Near(const Box &a, const Box &b) {
+    return Near(a.left, b.left) && Near(a.top, b.top) && Near(a.right, b.right) &&
+      Near(a.bottom, b.bottom);
+  }
+}
+
+
+TEST(ClockGeometryRotatedBounds) {
+  // A second hand, pointing up from the center, with a short tail.
+  const Box hand = { -1.0f, -40.0f, 1.0f, 5.0f };
+
+  CHECK(Near(ClockGeometry::RotatedBounds(hand, 0.0f, 50.0f, 50.0f), Box { 49, 10, 51, 55 }));
+
+  // Clockwise, so pointing right.
+  CHECK(Near(ClockGeometry::RotatedBounds(hand, 90.0f, 50.0f, 50.0f), Box { 45, 49, 90, 51 }));
+  CHECK(Near(ClockGeometry::RotatedBounds(hand, 180.0f, 0.0f, 0.0f), Box { -1, -5, 1, 40 }));
+
+  // A square turned by 45 degrees reaches out to its diagonal.
+  const Box square = { -10.0f, -10.0f, 10.0f, 10.0f };
+  float diagonal = 10.0f * sqrtf(2.0f);
+  CHECK(Near(ClockGeometry::RotatedBounds(square, 45.0f, 0.0f, 0.0f),
+    Box { -diagonal, -diagonal, diagonal, diagonal }));
+
+  CHECK(Near(ClockGeometry::Union(Box { 0, 0, 1, 1 }, Box { -1, 0.5f, 0.5f, 2 }), Box { -1, 0, 1, 2 }));
+  CHECK(Near(ClockGeometry::Radius(hand), sqrtf(1.0f + 40.0f * 40.0f)));
+}
+
+
+TEST(ClockGeometryPixelChanges) {
+  const Box a = { 10.2f, 10.0f, 12.2f, 50.0f };
+  const Box b = { 10.55f, 10.0f, 12.55f, 50.0f };
+
+  // A third of a DIP stays within the same pixels at 96 DPI, but not at 192 DPI.
+  CHECK(!ClockGeometry::PixelsDiffer(a, b, 1.0f));
+  CHECK(ClockGeometry::PixelsDiffer(a, b, 2.0f));
+
+  // At 144 DPI the edges stay within pixels 15 and 19, until the right one crosses into 20.
+  CHECK(!ClockGeometry::PixelsDiffer(a, b, 1.5f));
+  CHECK(ClockGeometry::PixelsDiffer(a, Box { 10.2f, 10.0f, 12.7f, 50.0f }, 1.5f));
+  CHECK(!ClockGeometry::PixelsDiffer(a, a, 1.25f));
+
+  // Larger hands, or higher DPIs, move a pixel for less of a change in value.
+  float perPixel = ClockGeometry::ValuePerPixel(60.0f, 50.0f, 1.0f);
+  CHECK(Near(perPixel, 60.0f / (2.0f * 3.14159265f * 50.0f), 1e-5f));
+  CHECK(Near(ClockGeometry::ValuePerPixel(60.0f, 50.0f, 2.0f), perPixel / 2, 1e-5f));
+  CHECK(Near(ClockGeometry::ValuePerPixel(60.0f, 0.0f, 1.0f), 60.0f / (2.0f * 3.14159265f), 1e-5f));
+}
+
+
+TEST(ClockGeometryNextChange) {
+  // A ticking second hand, 300ms into second 12.
+  CHECK(Near(ClockGeometry::MsUntilNextStep(12.3f, 1.0f, 1000.0f, 0.0f), 700.0f, 0.01f));
+
+  // Right on a step, the next one is a whole step away.
+  CHECK(Near(ClockGeometry::MsUntilNextStep(13.0f, 1.0f, 1000.0f, 0.0f), 1000.0f, 0.01f));
+
+  // A timer which fired 10ms early doesn't skip the step it was meant for.
+  CHECK(Near(ClockGeometry::MsUntilNextStep(12.99f, 1.0f, 1000.0f, 984.0f), 10.0f, 0.05f));
+
+  // The minimum delay is measured from the last step, and pushes the change out to later steps.
+  CHECK(Near(ClockGeometry::MsUntilNextStep(12.3f, 1.0f, 1000.0f, 2500.0f), 2700.0f, 0.05f));
+
+  // A smooth hand moves in steps of a fraction of a unit.
+  CHECK(Near(ClockGeometry::MsUntilNextStep(12.3f, 0.25f, 1000.0f, 0.0f), 200.0f, 0.05f));
+}
+
+
+TEST(ClockGeometryAlignment) {
+  // Delays under a second aren't aligned.
+  CHECK(ClockGeometry::AlignDelay(700.0f, 12300.0f, 16.0f) == 700.0f);
+
+  // Longer delays end on a second boundary.
+  CHECK(Near(ClockGeometry::AlignDelay(1500.0f, 12300.0f, 16.0f), 1700.0f));
+
+  // Unless they already end within the tolerance after one.
+  CHECK(Near(ClockGeometry::AlignDelay(1000.0f, 12010.0f, 16.0f), 1000.0f));
+  CHECK(Near(ClockGeometry::AlignDelay(1000.0f, 12020.0f, 16.0f), 1980.0f));
+
+  // Delays of a minute or more end on a minute boundary.
+  CHECK(Near(ClockGeometry::AlignDelay(70000.0f, 30000.0f, 16.0f), 90000.0f));
+  CHECK(Near(ClockGeometry::AlignDelay(90000.0f, 30000.0f, 16.0f), 90000.0f));
+
+  // The delay is capped, whether it was aligned or not.
+  CHECK(Near(ClockGeometry::UpdateDelay(1500.0f, 12300.0f, 16.0f, 60000.0f), 1700.0f));
+  CHECK(Near(ClockGeometry::UpdateDelay(70000.0f, 30000.0f, 16.0f, 60000.0f), 60000.0f));
+  CHECK(Near(ClockGeometry::UpdateDelay(3600000.0f, 0.0f, 16.0f, 60000.0f), 60000.0f));
+}
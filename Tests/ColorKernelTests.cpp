@@ -0,0 +1,285 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ColorKernelTests.cpp
+// The nModules Project
+//
+// Tests and benchmarks for the batch color conversions.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nShared/Color.h"
+
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// A small deterministic generator, so that failures can be reproduced.
+  /// </summary>
+  class Random {
+  public:
+    explicit Random(uint64_t seed) : mState(seed) {}
+
+    uint32_t Next() {
+      mState = mState * 6364136223846793005ull + 1442695040888963407ull;
+      return uint32_t(mState >> 32);
+    }
+
+    uint32_t Next(uint32_t bound) {
+      return Next() % bound;
+    }
+
+  private:
+    uint64_t mState;
+  };
+
+  /// <summary>
+  /// Random colors, led by the ones the conversions treat specially: black, white, greys, and
+  /// colors whose largest channels tie.
+  /// </summary>
+  std::vector<ARGB> MakeColors(size_t count, uint64_t seed) {
+    static const ARGB special[] = {
+      0xFF000000, 0xFFFFFFFF, 0x00000000, 0x80FFFFFF, 0xFF808080, 0xFF7F7F7F, 0xFFFF0000, 0xFF00FF00,
+      0xFF0000FF, 0xFFFFFF00, 0xFF00FFFF, 0xFFFF00FF, 0xFFFF0080, 0xFF01FF00, 0x12345678, 0xFF2080C0
+    };
+
+    Random random(seed);
+    std::vector<ARGB> colors;
+    colors.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      colors.push_back(i < _countof(special) ? special[i] : random.Next());
+    }
+    return colors;
+  }
+
+  /// <summary>
+  /// HSL colors which didn't come from an ARGB, including hues outside [0, 360) and percentages
+  /// outside [0, 100].
+  /// </summary>
+  std::vector<AHSL> MakeAHSL(size_t count, uint64_t seed) {
+    static const AHSL special[] = {
+      { 255, 360, 100, 50 }, { 255, 359, 100, 50 }, { 255, 0, 100, 50 }, { 255, 720, 50, 50 },
+      { 255, -1, 50, 50 }, { 128, 120, 0, 0 }, { 128, 240, 0, 100 }, { 0, 60, 100, 100 },
+      { 255, 300, 150, 50 }, { 255, 180, 100, -10 }, { 255, 59, 100, 50 }, { 255, 60, 100, 50 }
+    };
+
+    Random random(seed);
+    std::vector<AHSL> colors;
+    colors.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      if (i < _countof(special)) {
+        colors.push_back(special[i]);
+      } else {
+        AHSL color = { int(random.Next(256)), int(random.Next(360)), random.Next(10001) / 100.0f,
+          random.Next(10001) / 100.0f };
+        colors.push_back(color);
+      }
+    }
+    return colors;
+  }
+
+  std::vector<AHSV> MakeAHSV(size_t count, uint64_t seed) {
+    std::vector<AHSV> colors;
+    for (const AHSL &hsl : MakeAHSL(count, seed)) {
+      AHSV color = { hsl.alpha, hsl.hue, hsl.saturation, hsl.lightness };
+      colors.push_back(color);
+    }
+    return colors;
+  }
+
+  /// <summary>
+  /// Lengths which leave each tail length after the 8 and 4 color steps, and a few which don't
+  /// fit in one 64 color block.
+  /// </summary>
+  std::vector<size_t> MakeLengths() {
+    std::vector<size_t> lengths;
+    for (size_t body : { 0, 4, 8, 12, 64, 128, 132 }) {
+      for (size_t tail = 0; tail < 4; ++tail) {
+        lengths.push_back(body + tail);
+      }
+    }
+    lengths.push_back(1000);
+    return lengths;
+  }
+
+  template <class T>
+  bool Same(const std::vector<T> &a, const std::vector<T> &b) {
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+  }
+
+  /// <summary>
+  /// Runs a batch function on part of a buffer, and checks that it didn't touch what comes after.
+  /// </summary>
+  template <class T, class Batch>
+  std::vector<T> RunBatch(size_t count, Batch batch) {
+    std::vector<T> out(count + 1);
+    memset(out.data(), 0xCD, out.size() * sizeof(T));
+    batch(out.data());
+
+    T untouched;
+    memset(&untouched, 0xCD, sizeof(T));
+    CHECK(memcmp(&out[count], &untouched, sizeof(T)) == 0);
+    out.pop_back();
+    return out;
+  }
+}
+
+
+TEST(ColorKernelsFromARGB) {
+  for (size_t length : MakeLengths()) {
+    std::vector<ARGB> colors = MakeColors(length, length);
+
+    std::vector<AHSL> expectedHSL;
+    std::vector<AHSV> expectedHSV;
+    std::vector<D2D_COLOR_F> expectedD2D;
+    for (ARGB color : colors) {
+      expectedHSL.push_back(Color::ARGBToAHSL(color));
+      expectedHSV.push_back(Color::ARGBToAHSV(color));
+      expectedD2D.push_back(Color::ARGBToD2D(color));
+    }
+
+    CHECK(Same(expectedHSL, RunBatch<AHSL>(length, [&] (AHSL *out) {
+      Color::ARGBToAHSL(colors.data(), out, length);
+    })));
+    CHECK(Same(expectedHSV, RunBatch<AHSV>(length, [&] (AHSV *out) {
+      Color::ARGBToAHSV(colors.data(), out, length);
+    })));
+    CHECK(Same(expectedD2D, RunBatch<D2D_COLOR_F>(length, [&] (D2D_COLOR_F *out) {
+      Color::ARGBToD2D(colors.data(), out, length);
+    })));
+  }
+}
+
+
+TEST(ColorKernelsToARGB) {
+  for (size_t length : MakeLengths()) {
+    std::vector<AHSL> hsl = MakeAHSL(length, length);
+    std::vector<AHSV> hsv = MakeAHSV(length, length + 1);
+
+    std::vector<ARGB> expectedHSL, expectedHSV;
+    for (size_t i = 0; i < length; ++i) {
+      expectedHSL.push_back(Color::AHSLToARGB(hsl[i]));
+      expectedHSV.push_back(Color::AHSVToARGB(hsv[i]));
+    }
+
+    CHECK(Same(expectedHSL, RunBatch<ARGB>(length, [&] (ARGB *out) {
+      Color::AHSLToARGB(hsl.data(), out, length);
+    })));
+    CHECK(Same(expectedHSV, RunBatch<ARGB>(length, [&] (ARGB *out) {
+      Color::AHSVToARGB(hsv.data(), out, length);
+    })));
+  }
+}
+
+
+TEST(ColorKernelsFunctions) {
+  for (size_t length : MakeLengths()) {
+    std::vector<ARGB> colors1 = MakeColors(length, length), colors2 = MakeColors(length, length + 7);
+
+    std::vector<ARGB> expected;
+    for (size_t i = 0; i < length; ++i) {
+      expected.push_back(Color::Mix(colors1[i], colors2[i], 0.3f));
+    }
+    CHECK(Same(expected, RunBatch<ARGB>(length, [&] (ARGB *out) {
+      Color::Mix(colors1.data(), colors2.data(), 0.3f, out, length);
+    })));
+
+    // Lightening and spinning one color at a time goes through the scalar conversions.
+    std::vector<ARGB> lightened = colors1, spun = colors1;
+    Color::Lighten(lightened.data(), length, -12.0f);
+    Color::Spin(spun.data(), length, 400);
+    for (size_t i = 0; i < length; ++i) {
+      ARGB color = colors1[i];
+      Color::Lighten(&color, 1, -12.0f);
+      CHECK(lightened[i] == color);
+
+      color = colors1[i];
+      Color::Spin(&color, 1, 400);
+      CHECK(spun[i] == color);
+    }
+  }
+}
+
+
+TEST(ColorConversionEdges) {
+  // Black and white have no saturation, and come back unchanged.
+  for (ARGB color : { 0xFF000000u, 0xFFFFFFFFu, 0x80FFFFFFu, 0xFF808080u }) {
+    AHSL hsl = Color::ARGBToAHSL(color);
+    CHECK(hsl.saturation == 0 && hsl.hue == 0);
+    CHECK(Color::AHSLToARGB(hsl) == color);
+
+    AHSV hsv = Color::ARGBToAHSV(color);
+    CHECK(hsv.saturation == 0 && hsv.hue == 0);
+  }
+  CHECK(Color::ARGBToAHSL(0xFFFFFFFF).lightness == COLOR_MAX_LIGHTNESS);
+
+  // So the HSL functions treat them like any other grey.
+  ARGB colors[] = { 0xFF000000, 0xFFFFFFFF };
+  Color::Lighten(colors, 1, 50.0f);
+  Color::Lighten(colors + 1, 1, -50.0f);
+  CHECK(colors[0] == 0xFF808080 && colors[1] == 0xFF808080);
+  CHECK(Color::Mix(0xFF000000, 0xFFFFFFFF, 0.5f) == 0xFF808080);
+
+  // Hues are in [0, 360). The functions which set or turn the hue wrap it.
+  ARGB red = 0xFFFF0000;
+  Color::Spin(&red, 1, 360);
+  CHECK(red == 0xFFFF0000);
+  Color::SetHue(&red, 1, -240);
+  CHECK(red == 0xFF00FF00);
+  CHECK(Color::AHSLToARGB(255, 359, 100, 50) == 0xFFFF0004);
+  CHECK(Color::AHSVToARGB(255, 120, 100, 100) == 0xFF00FF00);
+}
+
+
+BENCHMARK(ColorKernels) {
+  const size_t count = 1 << 16;
+  const int passes = 20;
+  std::vector<ARGB> colors = MakeColors(count, 1), colors2 = MakeColors(count, 2), argb(count);
+  std::vector<AHSL> hsl(count);
+  std::vector<D2D_COLOR_F> d2d(count);
+
+  struct Case {
+    const char *name;
+    std::function<void ()> scalar, batch;
+  };
+  Case cases[] = {
+    {
+      "ARGBToAHSL",
+      [&] { for (size_t i = 0; i < count; ++i) hsl[i] = Color::ARGBToAHSL(colors[i]); },
+      [&] { Color::ARGBToAHSL(colors.data(), hsl.data(), count); }
+    },
+    {
+      "AHSLToARGB",
+      [&] { for (size_t i = 0; i < count; ++i) argb[i] = Color::AHSLToARGB(hsl[i]); },
+      [&] { Color::AHSLToARGB(hsl.data(), argb.data(), count); }
+    },
+    {
+      "ARGBToD2D",
+      [&] { for (size_t i = 0; i < count; ++i) d2d[i] = Color::ARGBToD2D(colors[i]); },
+      [&] { Color::ARGBToD2D(colors.data(), d2d.data(), count); }
+    },
+    {
+      "Mix",
+      [&] { for (size_t i = 0; i < count; ++i) argb[i] = Color::Mix(colors[i], colors2[i], 0.3f); },
+      [&] { Color::Mix(colors.data(), colors2.data(), 0.3f, argb.data(), count); }
+    },
+    {
+      "Lighten",
+      [&] { argb = colors; for (size_t i = 0; i < count; ++i) Color::Lighten(&argb[i], 1, 10.0f); },
+      [&] { argb = colors; Color::Lighten(argb.data(), count, 10.0f); }
+    }
+  };
+
+  Color::ARGBToAHSL(colors.data(), hsl.data(), count);
+  printf(" %u colors\n", unsigned(count));
+  for (const Case &test : cases) {
+    double scalar = Harness::Best(passes, test.scalar);
+    double batch = Harness::Best(passes, test.batch);
+    Harness::Consume(argb[count / 2] + uint64_t(hsl[count / 3].lightness) + uint64_t(d2d[count / 5].r * 255));
+
+    printf(" %s\n", test.name);
+    Harness::Report("Scalar", count / (scalar * 1e3), "Mpixels/s");
+    Harness::Report("Batch", count / (batch * 1e3), "Mpixels/s");
+  }
+}
@@ -0,0 +1,198 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ColorProgramTests.cpp
+// The nModules Project
+//
+// Tests and benchmarks for parsing color strings into compiled color expressions.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nShared/Color.h"
+#include "../nShared/ColorProgram.hpp"
+#include "../nShared/DWMColorRegistry.hpp"
+#include "../nShared/DWMColorVal.hpp"
+#include "../nShared/LiteralColorVal.hpp"
+
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <strsafe.h>
+#include <vector>
+
+namespace {
+  ARGB sDWMColor = 0xFF2080C0;
+
+  /// <summary>
+  /// What Lighten(color, amount) evaluates to.
+  /// </summary>
+  ARGB Lighten(ARGB color, long amount) {
+    AHSL hsl = Color::ARGBToAHSL(color);
+    float lightness = hsl.lightness + amount;
+    hsl.lightness = lightness < 0 ? 0 : lightness > COLOR_MAX_LIGHTNESS ? COLOR_MAX_LIGHTNESS : lightness;
+    return Color::AHSLToARGB(hsl);
+  }
+
+  /// <summary>
+  /// Parses the color string, returning nullptr if it isn't valid.
+  /// </summary>
+  IColorVal *Parse(LPCWSTR string) {
+    IColorVal *color = nullptr;
+    return ParseColor(string, &color) ? color : nullptr;
+  }
+
+  bool ParsesTo(LPCWSTR string, ARGB expected) {
+    std::unique_ptr<IColorVal> color(Parse(string));
+    return color && color->IsConstant() && color->Evaluate() == expected;
+  }
+
+  /// <summary>
+  /// Color strings the way themes use them. Most are literals, the rest follow the DWM color.
+  /// </summary>
+  std::vector<std::wstring> MakeThemeColors(int count) {
+    static LPCWSTR const named[] = { L"Black", L"White", L"SteelBlue", L"Crimson", L"DarkSlateGray" };
+    std::vector<std::wstring> colors;
+    colors.reserve(count);
+    for (int i = 0; i < count; ++i) {
+      WCHAR color[MAX_LINE_LENGTH];
+      int a = i % 256, b = (i * 7) % 256, c = (i * 13) % 256;
+      switch (i % 8) {
+      case 0: StringCchPrintfW(color, _countof(color), L"#%02X%02X%02X", a, b, c); break;
+      case 1: StringCchPrintfW(color, _countof(color), L"#%02X%02X%02X%02X", c, a, b, c); break;
+      case 2: StringCchPrintfW(color, _countof(color), L"RGBA(%d, %d, %d, %d)", a, b, c, 255 - a); break;
+      case 3: StringCchPrintfW(color, _countof(color), L"%s", named[i % _countof(named)]); break;
+      case 4: StringCchPrintfW(color, _countof(color), L"SetAlpha(%s, %d)", named[i % _countof(named)], a); break;
+      case 5: StringCchPrintfW(color, _countof(color), L"Lighten(DWMColor, %d)", i % 40); break;
+      case 6: StringCchPrintfW(color, _countof(color), L"Mix(DWMColor, #%02X%02X%02X, 0.%d)", a, b, c, i % 10); break;
+      case 7:
+        StringCchPrintfW(color, _countof(color), L"Darken(Mix(RGB(%d, %d, %d), Spin(Red, %d), 0.5), %d)",
+          a, b, c, i % 360, i % 30);
+        break;
+      }
+      colors.push_back(color);
+    }
+    return colors;
+  }
+}
+
+
+// ColorProgram asks the registry for the DWM color. The real one asks DWM.
+ARGB DWMColorRegistry::GetColor() {
+  return sDWMColor;
+}
+
+
+TEST(ColorParserLiterals) {
+  CHECK(ParsesTo(L"#F00", 0xFFFF0000));
+  CHECK(ParsesTo(L"#8F00", 0x88FF0000));
+  CHECK(ParsesTo(L"#123456", 0xFF123456));
+  CHECK(ParsesTo(L"#80123456", 0x80123456));
+  CHECK(ParsesTo(L"RGB(1, 2, 3)", 0xFF010203));
+  CHECK(ParsesTo(L"RGBA(1, 2, 3, 4)", 0x04010203));
+  CHECK(ParsesTo(L"Red", 0xFFFF0000));
+  CHECK(ParsesTo(L"SetAlpha(Red, 128)", 0x80FF0000));
+
+  std::unique_ptr<IColorVal> dwm(Parse(L"DWMColor"));
+  CHECK(dynamic_cast<DWMColorVal*>(dwm.get()) != nullptr);
+
+  for (LPCWSTR invalid : { L"", L"#12", L"#12345G", L"RGB(1, 2)", L"Lighten(Red)", L"Lighten(Red, x)",
+      L"Mix(Red, Blue)", L"Mix(Red, Nonexistent, 0.5)", L"Nonexistent" }) {
+    CHECK(Parse(invalid) == nullptr);
+  }
+}
+
+
+TEST(ColorParserFoldsConstants) {
+  // Nothing is left to compute once expressions without the DWM color are compiled.
+  ARGB expected = Lighten(Color::Mix(0xFFFF0000, 0xFF0000FF, 0.5f), 20);
+  std::unique_ptr<IColorVal> folded(Parse(L"Lighten(Mix(#FF0000, #0000FF, 0.5), 20)"));
+  CHECK(dynamic_cast<LiteralColorVal*>(folded.get()) != nullptr);
+  CHECK(folded && folded->Evaluate() == expected && folded->Evaluate(0xFF000000) == expected);
+
+  // Constant arguments of a function which uses the DWM color are folded into one literal.
+  std::unique_ptr<IColorVal> partial(Parse(L"Mix(DWMColor, Lighten(Mix(#FF0000, #0000FF, 0.5), 20), 0.25)"));
+  ColorProgram *program = dynamic_cast<ColorProgram*>(partial.get());
+  CHECK(program != nullptr && !program->IsConstant() && !program->IsDWMColor());
+  for (ARGB dwm : { 0x00000000u, 0xFFFFFFFFu, 0x80102030u }) {
+    CHECK(partial && partial->Evaluate(dwm) == Color::Mix(dwm, expected, 0.25f));
+  }
+}
+
+
+TEST(ColorParserDWMExpressions) {
+  std::unique_ptr<IColorVal> color(Parse(L"Lighten(Mix(DWMColor, Mix(#FF0000, #0000FF, 0.5), 0.25), 20)"));
+  CHECK(color && !color->IsConstant());
+  if (!color) {
+    return;
+  }
+
+  ARGB purple = Color::Mix(0xFFFF0000, 0xFF0000FF, 0.5f);
+  for (ARGB dwm : { 0x00000000u, 0xFFFFFFFFu, 0x80102030u, 0xFF2080C0u }) {
+    CHECK(color->Evaluate(dwm) == Lighten(Color::Mix(dwm, purple, 0.25f), 20));
+  }
+  CHECK(color->Evaluate() == color->Evaluate(sDWMColor));
+
+  std::unique_ptr<IColorVal> copy(color->Copy());
+  CHECK(copy->Evaluate(0x80102030) == color->Evaluate(0x80102030));
+}
+
+
+TEST(ColorParserDeepNesting) {
+  // Mix(#000000, Mix(#000000, ... Mix(#000000, DWMColor, 0.75) ...)). Goes past the local stack.
+  std::wstring string = L"DWMColor";
+  for (int i = 0; i < 40; ++i) {
+    string = L"Mix(#000000, " + string + L", 0.75)";
+  }
+
+  std::unique_ptr<IColorVal> color(Parse(string.c_str()));
+  CHECK(dynamic_cast<ColorProgram*>(color.get()) != nullptr);
+  if (!color) {
+    return;
+  }
+
+  for (ARGB dwm : { 0xFFFFFFFFu, 0x80102030u }) {
+    ARGB expected = dwm;
+    for (int i = 0; i < 40; ++i) {
+      expected = Color::Mix(0xFF000000, expected, 0.75f);
+    }
+    CHECK(color->Evaluate(dwm) == expected);
+  }
+}
+
+
+BENCHMARK(ColorParsing) {
+  std::vector<std::wstring> strings = MakeThemeColors(100000);
+  std::vector<IColorVal*> colors(strings.size(), nullptr);
+
+  // Loading a theme parses every color, and a refresh frees them again.
+  double parsing = Harness::Best(5, [&] {
+    for (size_t i = 0; i < strings.size(); ++i) {
+      delete colors[i];
+      colors[i] = nullptr;
+      ParseColor(strings[i].c_str(), &colors[i]);
+    }
+  });
+
+  // A colorization change evaluates every color for the new DWM color.
+  const int changes = 20;
+  double evaluation = Harness::Best(5, [&] {
+    uint64_t checksum = 0;
+    for (int change = 0; change < changes; ++change) {
+      for (const IColorVal *color : colors) {
+        checksum += color->Evaluate(ARGB(change * 0x01020304));
+      }
+    }
+    Harness::Consume(checksum);
+  });
+
+  size_t literals = 0, programs = 0;
+  for (IColorVal *color : colors) {
+    literals += dynamic_cast<LiteralColorVal*>(color) != nullptr ? 1 : 0;
+    programs += dynamic_cast<ColorProgram*>(color) != nullptr ? 1 : 0;
+    delete color;
+  }
+
+  printf(" %u theme color strings\n", unsigned(strings.size()));
+  Harness::Report("Folded to literals", 100.0 * literals / strings.size(), "%");
+  Harness::Report("Left as programs", 100.0 * programs / strings.size(), "%");
+  Harness::Report("Parsing", parsing * 1e6 / strings.size(), "ns/string");
+  Harness::Report("Evaluation", evaluation * 1e6 / (strings.size() * changes), "ns/color");
+}
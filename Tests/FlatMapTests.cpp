@@ -0,0 +1,526 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/FlatMapTests.cpp
+// The nModules Project
+//
+// Tests and benchmarks for FlatMap and SlotMap.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../Utilities/Common.h"
+#include "../headers/lsapi.h"
+#include "../Utilities/FlatMap.hpp"
+#include "../Utilities/SlotMap.hpp"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+  // HWNDs are pointer-sized values which only differ in a few bits.
+  HWND MakeHandle(uint32_t id) {
+    return (HWND)(uintptr_t(0x10000) + uintptr_t(id) * 4);
+  }
+
+  /// <summary>
+  /// A small deterministic generator, so that failures and timings can be reproduced.
+  /// </summary>
+  class Random {
+  public:
+    explicit Random(uint64_t seed) : mState(seed) {}
+
+    uint32_t Next(uint32_t bound) {
+      mState = mState * 6364136223846793005ull + 1442695040888963407ull;
+      return uint32_t((mState >> 33) % bound);
+    }
+
+  private:
+    uint64_t mState;
+  };
+
+  // Taskbars with this monitor show the windows of every monitor.
+  const UINT sAllMonitors = 0xFFFFFFFF;
+
+  /// <summary>
+  /// Stands in for TaskButton. The replayed messages only change whether it is active.
+  /// </summary>
+  struct Button {
+    explicit Button(HWND window) : window(window), active(false) {}
+
+    void Activate() { active = true; }
+    void Deactivate() { active = false; }
+
+    HWND window;
+    bool active;
+    char padding[240];
+  };
+
+  /// <summary>
+  /// How nTasks used to keep track of its windows and buttons. Each taskbar had a list of buttons
+  /// and a map from HWNDs into it, and each window a list of pointers to its buttons.
+  /// </summary>
+  class NodeShell {
+  private:
+    struct Taskbar {
+      typedef std::list<Button> ButtonList;
+
+      explicit Taskbar(UINT monitor) : monitor(monitor) {}
+
+      Button *AddTask(HWND window, UINT windowMonitor) {
+        if (windowMonitor != monitor && monitor != sAllMonitors) {
+          return nullptr;
+        }
+        buttonList.emplace_back(window);
+        buttonMap[window] = --buttonList.end();
+        return &buttonList.back();
+      }
+
+      void RemoveTask(HWND window) {
+        std::map<HWND, ButtonList::iterator>::iterator iter = buttonMap.find(window);
+        if (iter != buttonMap.end()) {
+          buttonList.erase(iter->second);
+          buttonMap.erase(iter);
+        }
+      }
+
+      UINT monitor;
+      ButtonList buttonList;
+      std::map<HWND, ButtonList::iterator> buttonMap;
+    };
+
+    struct WindowInformation {
+      UINT monitor;
+      std::list<Button*> buttons;
+      char padding[160];
+    };
+
+  public:
+    explicit NodeShell(const std::vector<UINT> &taskbarMonitors) : mActiveWindow(nullptr) {
+      for (UINT monitor : taskbarMonitors) {
+        mTaskbars.emplace_back(monitor);
+      }
+    }
+
+    void AddWindow(HWND window, UINT monitor) {
+      if (mWindowMap.find(window) != mWindowMap.end()) {
+        return;
+      }
+      WindowInformation &info = mWindowMap[window];
+      info.monitor = monitor;
+      for (Taskbar &taskbar : mTaskbars) {
+        Button *button = taskbar.AddTask(window, monitor);
+        if (button != nullptr) {
+          info.buttons.push_back(button);
+        }
+      }
+    }
+
+    void SetActive(HWND window) {
+      std::unordered_map<HWND, WindowInformation>::iterator iter = mWindowMap.find(mActiveWindow);
+      if (iter != mWindowMap.end()) {
+        for (Button *button : iter->second.buttons) {
+          button->Deactivate();
+        }
+      }
+      mActiveWindow = window;
+      iter = mWindowMap.find(mActiveWindow);
+      if (iter != mWindowMap.end()) {
+        for (Button *button : iter->second.buttons) {
+          button->Activate();
+        }
+      }
+    }
+
+    void RemoveWindow(HWND window) {
+      std::unordered_map<HWND, WindowInformation>::iterator iter = mWindowMap.find(window);
+      if (iter != mWindowMap.end()) {
+        for (Taskbar &taskbar : mTaskbars) {
+          taskbar.RemoveTask(window);
+        }
+        mWindowMap.erase(iter);
+      }
+      if (mActiveWindow == window) {
+        mActiveWindow = nullptr;
+      }
+    }
+
+    /// <summary>
+    /// Returns the number of buttons the window has, and how many of them are active.
+    /// </summary>
+    void CountButtons(HWND window, size_t &buttons, size_t &active) const {
+      buttons = active = 0;
+      std::unordered_map<HWND, WindowInformation>::const_iterator iter = mWindowMap.find(window);
+      if (iter != mWindowMap.end()) {
+        for (const Button *button : iter->second.buttons) {
+          ++buttons;
+          active += button->active ? 1 : 0;
+        }
+      }
+    }
+
+    size_t TotalButtons() const {
+      size_t total = 0;
+      for (const Taskbar &taskbar : mTaskbars) {
+        total += taskbar.buttonList.size();
+      }
+      return total;
+    }
+
+  private:
+    HWND mActiveWindow;
+    std::list<Taskbar> mTaskbars;
+    std::unordered_map<HWND, WindowInformation> mWindowMap;
+  };
+
+  /// <summary>
+  /// How nTasks keeps track of its windows and buttons now. Taskbars own their buttons through a
+  /// SlotMap, and each window in the FlatMap keeps a handle to its button on each taskbar.
+  /// </summary>
+  class HandleShell {
+  private:
+    struct Taskbar {
+      typedef SlotMap<Button>::Handle ButtonHandle;
+
+      explicit Taskbar(UINT monitor) : monitor(monitor), removedButtons(0) {}
+
+      Button *AddTask(HWND window, UINT windowMonitor, ButtonHandle &handle) {
+        if (windowMonitor != monitor && monitor != sAllMonitors) {
+          return nullptr;
+        }
+        handle = buttons.Emplace(window);
+        buttonList.push_back(handle);
+        return buttons.Get(handle);
+      }
+
+      Button *GetButton(ButtonHandle handle) const {
+        return buttons.Get(handle);
+      }
+
+      // Like Taskbar::RemoveTask, the stale handle is left in the layout order until the next
+      // relayout compacts it, which is here whenever half of the list is stale.
+      void RemoveTask(ButtonHandle handle) {
+        if (buttons.Erase(handle) && ++removedButtons > buttonList.size() / 2) {
+          buttonList.erase(std::remove_if(buttonList.begin(), buttonList.end(), [this] (ButtonHandle handle) {
+            return buttons.Get(handle) == nullptr;
+          }), buttonList.end());
+          removedButtons = 0;
+        }
+      }
+
+      UINT monitor;
+      SlotMap<Button> buttons;
+      std::vector<ButtonHandle> buttonList;
+      size_t removedButtons;
+    };
+
+    struct ButtonRef {
+      Taskbar *taskbar;
+      Taskbar::ButtonHandle handle;
+    };
+
+    struct WindowInformation {
+      UINT monitor;
+      std::vector<ButtonRef> buttons;
+      char padding[160];
+    };
+
+  public:
+    explicit HandleShell(const std::vector<UINT> &taskbarMonitors) : mActiveWindow(nullptr) {
+      for (UINT monitor : taskbarMonitors) {
+        mTaskbars.emplace_back(monitor);
+      }
+    }
+
+    void AddWindow(HWND window, UINT monitor) {
+      if (mWindowMap.find(window) != mWindowMap.end()) {
+        return;
+      }
+      WindowInformation &info = mWindowMap[window];
+      info.monitor = monitor;
+      for (Taskbar &taskbar : mTaskbars) {
+        ButtonRef ref = { &taskbar, Taskbar::ButtonHandle() };
+        if (taskbar.AddTask(window, monitor, ref.handle) != nullptr) {
+          info.buttons.push_back(ref);
+        }
+      }
+    }
+
+    void SetActive(HWND window) {
+      FlatMap<HWND, WindowInformation>::iterator iter = mWindowMap.find(mActiveWindow);
+      if (iter != mWindowMap.end()) {
+        ForEachButton(iter->second, [] (Button *button) { button->Deactivate(); });
+      }
+      mActiveWindow = window;
+      iter = mWindowMap.find(mActiveWindow);
+      if (iter != mWindowMap.end()) {
+        ForEachButton(iter->second, [] (Button *button) { button->Activate(); });
+      }
+    }
+
+    void RemoveWindow(HWND window) {
+      FlatMap<HWND, WindowInformation>::iterator iter = mWindowMap.find(window);
+      if (iter != mWindowMap.end()) {
+        for (const ButtonRef &ref : iter->second.buttons) {
+          ref.taskbar->RemoveTask(ref.handle);
+        }
+        mWindowMap.erase(iter);
+      }
+      if (mActiveWindow == window) {
+        mActiveWindow = nullptr;
+      }
+    }
+
+    void CountButtons(HWND window, size_t &buttons, size_t &active) const {
+      buttons = active = 0;
+      FlatMap<HWND, WindowInformation>::const_iterator iter = mWindowMap.find(window);
+      if (iter != mWindowMap.end()) {
+        for (const ButtonRef &ref : iter->second.buttons) {
+          const Button *button = ref.taskbar->GetButton(ref.handle);
+          if (button != nullptr) {
+            ++buttons;
+            active += button->active ? 1 : 0;
+          }
+        }
+      }
+    }
+
+    size_t TotalButtons() const {
+      size_t total = 0;
+      for (const Taskbar &taskbar : mTaskbars) {
+        total += taskbar.buttons.Size();
+      }
+      return total;
+    }
+
+  private:
+    template <class Proc>
+    static void ForEachButton(const WindowInformation &info, Proc proc) {
+      for (const ButtonRef &ref : info.buttons) {
+        Button *button = ref.taskbar->GetButton(ref.handle);
+        if (button != nullptr) {
+          proc(button);
+        }
+      }
+    }
+
+  private:
+    HWND mActiveWindow;
+    std::list<Taskbar> mTaskbars;
+    FlatMap<HWND, WindowInformation> mWindowMap;
+  };
+
+  /// <summary>
+  /// A shell hook message, as nTasks receives it.
+  /// </summary>
+  struct Message {
+    UINT message;
+    HWND window;
+    UINT monitor;
+  };
+
+  /// <summary>
+  /// Synthesizes a shell hook stream across two monitors: a few windows come and go, while most
+  /// messages switch between the handful of recently used windows, the way Alt+Tab does.
+  /// </summary>
+  std::vector<Message> MakeReplay(size_t length, uint32_t liveWindows) {
+    std::vector<Message> replay;
+    std::vector<HWND> live;
+    Random random(42);
+    uint32_t nextId = 0;
+
+    replay.reserve(length);
+    while (replay.size() < length) {
+      uint32_t roll = random.Next(100);
+      Message message;
+      if (live.size() < liveWindows / 2 || (roll < 3 && live.size() < liveWindows * 2)) {
+        message.message = LM_WINDOWCREATED;
+        message.window = MakeHandle(nextId++);
+        message.monitor = 1 + random.Next(2);
+        live.push_back(message.window);
+      } else if (roll < 6) {
+        size_t index = random.Next(uint32_t(live.size()));
+        message.message = LM_WINDOWDESTROYED;
+        message.window = live[index];
+        live[index] = live.back();
+        live.pop_back();
+      } else {
+        // Recently created windows stand in for recently used ones.
+        size_t recent = live.size() < 4 ? live.size() : 4;
+        size_t index = random.Next(10) < 8 ? live.size() - 1 - random.Next(uint32_t(recent))
+          : random.Next(uint32_t(live.size()));
+        message.message = LM_WINDOWACTIVATED;
+        message.window = live[index];
+      }
+      replay.push_back(message);
+    }
+    return replay;
+  }
+
+  /// <summary>
+  /// Dispatches the messages to the shell the way WindowManager does.
+  /// </summary>
+  template <class Shell>
+  void Play(Shell &shell, const std::vector<Message> &replay) {
+    for (const Message &message : replay) {
+      switch (message.message) {
+      case LM_WINDOWCREATED:
+        shell.AddWindow(message.window, message.monitor);
+        break;
+
+      case LM_WINDOWACTIVATED:
+        shell.SetActive(message.window);
+        break;
+
+      case LM_WINDOWDESTROYED:
+        shell.RemoveWindow(message.window);
+        break;
+      }
+    }
+  }
+
+  // A taskbar on each of the two monitors, and one showing every window.
+  const std::vector<UINT> sTaskbarMonitors = { 1, 2, sAllMonitors };
+}
+
+
+TEST(FlatMapMatchesUnorderedMap) {
+  FlatMap<HWND, uint32_t> flat;
+  std::unordered_map<HWND, uint32_t> reference;
+  Random random(7);
+
+  for (uint32_t step = 0; step < 200000; ++step) {
+    HWND handle = MakeHandle(random.Next(2000));
+    switch (random.Next(4)) {
+    case 0:
+    case 1:
+      flat[handle] = step;
+      reference[handle] = step;
+      break;
+
+    case 2:
+      CHECK(flat.erase(handle) == reference.erase(handle));
+      break;
+
+    case 3:
+      {
+        FlatMap<HWND, uint32_t>::iterator found = flat.find(handle);
+        std::unordered_map<HWND, uint32_t>::iterator expected = reference.find(handle);
+        CHECK((found == flat.end()) == (expected == reference.end()));
+        if (found != flat.end() && expected != reference.end()) {
+          CHECK(found->second == expected->second);
+        }
+      }
+      break;
+    }
+  }
+
+  CHECK(flat.size() == reference.size());
+  for (const FlatMap<HWND, uint32_t>::value_type &entry : flat) {
+    CHECK(reference.count(entry.first) == 1 && reference[entry.first] == entry.second);
+  }
+
+  flat.clear();
+  CHECK(flat.empty() && flat.find(MakeHandle(1)) == flat.end());
+}
+
+
+TEST(FlatMapEraseWhileIterating) {
+  FlatMap<HWND, uint32_t> map;
+  for (uint32_t i = 0; i < 100; ++i) {
+    map[MakeHandle(i)] = i;
+  }
+
+  // The erase-returns-next idiom must visit every entry once, even though the last entry is moved
+  // into the hole.
+  for (FlatMap<HWND, uint32_t>::iterator iter = map.begin(); iter != map.end();) {
+    if (iter->second % 2 == 0) {
+      iter = map.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  CHECK(map.size() == 50);
+  for (uint32_t i = 0; i < 100; ++i) {
+    CHECK((map.find(MakeHandle(i)) != map.end()) == (i % 2 == 1));
+  }
+}
+
+
+TEST(SlotMapStaleHandles) {
+  SlotMap<uint32_t> slots;
+  SlotMap<uint32_t>::Handle first = slots.Emplace(1u);
+  SlotMap<uint32_t>::Handle second = slots.Emplace(2u);
+  CHECK(*slots.Get(first) == 1 && *slots.Get(second) == 2);
+
+  // A reused slot must not resolve through the old handle.
+  CHECK(slots.Erase(first));
+  SlotMap<uint32_t>::Handle third = slots.Emplace(3u);
+  CHECK(third.index == first.index);
+  CHECK(slots.Get(first) == nullptr);
+  CHECK(*slots.Get(third) == 3);
+  CHECK(!slots.Erase(first));
+
+  slots.Clear();
+  CHECK(slots.Size() == 0 && slots.Get(second) == nullptr && slots.Get(third) == nullptr);
+  CHECK(slots.Get(SlotMap<uint32_t>::Handle()) == nullptr);
+}
+
+
+TEST(WindowMapReplayAgrees) {
+  std::vector<Message> replay = MakeReplay(100000, 200);
+  NodeShell nodes(sTaskbarMonitors);
+  HandleShell handles(sTaskbarMonitors);
+  Play(nodes, replay);
+  Play(handles, replay);
+
+  CHECK(nodes.TotalButtons() == handles.TotalButtons());
+
+  // Every window has a button on its own monitor's taskbar and on the one showing every window.
+  // Only the buttons of the last activated window are active, and destroyed windows have none.
+  HWND active = nullptr;
+  for (const Message &message : replay) {
+    if (message.message == LM_WINDOWACTIVATED) {
+      active = message.window;
+    } else if (message.message == LM_WINDOWDESTROYED && message.window == active) {
+      active = nullptr;
+    }
+  }
+  std::unordered_map<HWND, bool> alive;
+  for (const Message &message : replay) {
+    alive[message.window] = message.message != LM_WINDOWDESTROYED;
+  }
+  for (const std::pair<const HWND, bool> &window : alive) {
+    size_t nodeButtons, nodeActive, handleButtons, handleActive;
+    nodes.CountButtons(window.first, nodeButtons, nodeActive);
+    handles.CountButtons(window.first, handleButtons, handleActive);
+    CHECK(handleButtons == nodeButtons && handleActive == nodeActive);
+    CHECK(handleButtons == (window.second ? 2 : 0));
+    CHECK(handleActive == (window.first == active ? handleButtons : 0));
+  }
+}
+
+
+BENCHMARK(WindowMapReplay) {
+  for (uint32_t windows : { 20u, 200u, 2000u }) {
+    std::vector<Message> replay = MakeReplay(1000000, windows);
+
+    // Each run starts from an empty shell, so the stream creates the same windows every time.
+    double nodes = Harness::Best(5, [&] {
+      NodeShell shell(sTaskbarMonitors);
+      Play(shell, replay);
+      Harness::Consume(shell.TotalButtons());
+    });
+    double handles = Harness::Best(5, [&] {
+      HandleShell shell(sTaskbarMonitors);
+      Play(shell, replay);
+      Harness::Consume(shell.TotalButtons());
+    });
+
+    printf(" ~%u windows, %u taskbars\n", windows, unsigned(sTaskbarMonitors.size()));
+    Harness::Report("unordered_map, list and map", nodes * 1e6 / replay.size(), "ns/message");
+    Harness::Report("FlatMap and SlotMap handles", handles * 1e6 / replay.size(), "ns/message");
+  }
+}
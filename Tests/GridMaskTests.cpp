@@ -0,0 +1,199 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/GridMaskTests.cpp
+// The nModules Project
+//
+// Tests and benchmarks for the start times and masks of nDesk's grid transitions.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nDesk/TransitionEffects/GridMask.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// The start times GridEffect used to calculate for every square, stored column by column.
+  /// </summary>
+  void OriginalStartTimes(GridMask::Order order, int columns, int rows, float fadeTime, float *startTimes) {
+    int count = columns * rows;
+    float span = 1.0f - fadeTime;
+
+    switch (order) {
+    case GridMask::Order::LinearVertical:
+      for (int i = 0; i < count; ++i) {
+        startTimes[i] = i * span / count;
+      }
+      break;
+
+    case GridMask::Order::LinearHorizontal:
+      {
+        int i = 0;
+        for (int y = 0; y < rows; ++y) {
+          for (int x = 0; x < columns; ++x) {
+            startTimes[x*rows + y] = (i++) * span / count;
+          }
+        }
+      }
+      break;
+
+    case GridMask::Order::Triangular:
+      {
+        float alpha = (float)atan2((double)rows, (double)columns);
+        float up = sqrtf(float(columns*columns + rows*rows)) / span;
+        for (int x = 0; x < columns; ++x) {
+          for (int y = 0; y < rows; ++y) {
+            startTimes[x*rows + y] = sqrtf(float(x*x + y*y))*cosf(atan2f((float)y, (float)x) - alpha) / up;
+          }
+        }
+      }
+      break;
+
+    case GridMask::Order::Clockwise:
+      {
+        int index = 0;
+        for (int depth = 0; depth < std::min(columns, rows) / 2; ++depth) {
+          for (int x = depth; x < columns - depth - 1; ++x) {
+            startTimes[x*rows + depth] = index++ * span / count;
+          }
+          for (int y = depth; y < rows - depth - 1; ++y) {
+            startTimes[(columns - depth - 1)*rows + y] = index++ * span / count;
+          }
+          for (int x = columns - depth - 1; x > depth; --x) {
+            startTimes[(x + 1)*rows - depth - 1] = index++ * span / count;
+          }
+          for (int y = rows - depth - 1; y > depth; --y) {
+            startTimes[depth*rows + y] = index++ * span / count;
+          }
+        }
+      }
+      break;
+
+    case GridMask::Order::CounterClockwise:
+      {
+        int index = 0;
+        for (int depth = 0; depth < std::min(columns, rows) / 2; ++depth) {
+          for (int y = depth; y < rows - depth - 1; ++y) {
+            startTimes[depth*rows + y] = index++ * span / count;
+          }
+          for (int x = depth; x < columns - depth - 1; ++x) {
+            startTimes[(x + 1)*rows - depth - 1] = index++ * span / count;
+          }
+          for (int y = rows - depth - 1; y > depth; --y) {
+            startTimes[(columns - depth - 1)*rows + y] = index++ * span / count;
+          }
+          for (int x = columns - depth - 1; x > depth; --x) {
+            startTimes[x*rows + depth] = index++ * span / count;
+          }
+        }
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  const GridMask::Order sOrders[] = {
+    GridMask::Order::LinearVertical,
+    GridMask::Order::LinearHorizontal,
+    GridMask::Order::Triangular,
+    GridMask::Order::Clockwise,
+    GridMask::Order::CounterClockwise
+  };
+}
+
+
+TEST(GridMaskMatchesOriginalStartTimes) {
+  const float fadeTime = 0.2f;
+
+  for (int columns = 1; columns <= 13; ++columns) {
+    for (int rows = 1; rows <= 13; ++rows) {
+      for (GridMask::Order order : sOrders) {
+        int count = columns * rows;
+        std::vector<float> original(count, NAN), startTimes(count, NAN);
+        OriginalStartTimes(order, columns, rows, fadeTime, original.data());
+        GridMask::StartTimes(order, columns, rows, fadeTime, startTimes.data());
+
+        for (int x = 0; x < columns; ++x) {
+          for (int y = 0; y < rows; ++y) {
+            // The original spirals never got to the middle row or column of odd grids.
+            float expected = original[x*rows + y], actual = startTimes[y*columns + x];
+            CHECK(!isnan(actual));
+            CHECK(isnan(expected) || fabsf(expected - actual) < 1e-5f);
+            CHECK(actual >= 0.0f && actual <= 1.0f - fadeTime + 1e-6f);
+          }
+        }
+
+        // Every square of a spiral gets a start time of its own.
+        if (order == GridMask::Order::Clockwise || order == GridMask::Order::CounterClockwise) {
+          std::sort(startTimes.begin(), startTimes.end());
+          CHECK(std::adjacent_find(startTimes.begin(), startTimes.end()) == startTimes.end());
+        }
+      }
+    }
+  }
+}
+
+
+TEST(GridMaskRender) {
+  const int count = 1000;
+  const float fadeTime = 0.2f;
+  std::vector<float> startTimes(count);
+  for (int i = 0; i < count; ++i) {
+    startTimes[i] = i * (1.0f - fadeTime) / count;
+  }
+
+  std::vector<uint8_t> mask(count);
+  for (int step = 0; step <= 100; ++step) {
+    float progress = step / 100.0f;
+    GridMask::Render(startTimes.data(), count, progress, fadeTime, mask.data());
+    for (int i = 0; i < count; ++i) {
+      // The opacity GridEffect used to give each square.
+      float expected = std::min(1.0f, std::max(progress - startTimes[i], 0.0f) / fadeTime) * 255.0f;
+      CHECK(fabsf(expected - mask[i]) <= 0.51f);
+    }
+  }
+}
+
+
+BENCHMARK(GridMaskFrames) {
+  const float fadeTime = 0.2f;
+  const struct {
+    const char *name;
+    int width, height;
+  } screens[] = { { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+
+  for (const auto &screen : screens) {
+    for (int squareSize : { 20, 100 }) {
+      int columns = (screen.width + squareSize - 1) / squareSize;
+      int rows = (screen.height + squareSize - 1) / squareSize;
+      int count = columns * rows;
+      std::vector<float> startTimes(count);
+      std::vector<uint8_t> mask(count);
+
+      // The triangular table is the one which used to need trigonometry for every square.
+      double original = Harness::Best(5, [&] {
+        OriginalStartTimes(GridMask::Order::Triangular, columns, rows, fadeTime, startTimes.data());
+      });
+      double table = Harness::Best(5, [&] {
+        GridMask::StartTimes(GridMask::Order::Triangular, columns, rows, fadeTime, startTimes.data());
+      });
+      double frames = Harness::Best(5, [&] {
+        uint64_t checksum = 0;
+        for (int frame = 0; frame < 100; ++frame) {
+          GridMask::Render(startTimes.data(), count, frame / 100.0f, fadeTime, mask.data());
+          checksum += mask[frame % count];
+        }
+        Harness::Consume(checksum);
+      });
+
+      printf(" %s, %dpx squares, %d squares\n", screen.name, squareSize, count);
+      Harness::Report("Triangular start times, trigonometry", original * 1000.0, "us");
+      Harness::Report("Triangular start times, GridMask", table * 1000.0, "us");
+      Harness::Report("Mask", frames * 1000.0 / 100, "us/frame");
+    }
+  }
+}
@@ -0,0 +1,94 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Harness.cpp
+// The nModules Project
+//
+// Runs the registered tests, or benchmarks.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+  struct Case {
+    const char *name;
+    Harness::CaseProc proc;
+    bool benchmark;
+  };
+
+  // Function local, so that registrations from any translation unit can run first.
+  std::vector<Case> &Cases() {
+    static std::vector<Case> cases;
+    return cases;
+  }
+
+  const char *sCurrent = nullptr;
+  unsigned sFailures = 0;
+  volatile uint64_t sSink = 0;
+}
+
+
+Harness::Registration::Registration(const char *name, CaseProc proc, bool benchmark) {
+  Case entry = { name, proc, benchmark };
+  Cases().push_back(entry);
+}
+
+
+void Harness::Fail(const char *file, int line, const char *expression) {
+  printf("%s(%d): %s: CHECK(%s) failed\n", file, line, sCurrent, expression);
+  ++sFailures;
+}
+
+
+double Harness::Now() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+void Harness::Report(const char *measurement, double value, const char *unit) {
+  printf("  %-40s %12.3f %s\n", measurement, value, unit);
+}
+
+
+void Harness::Consume(uint64_t value) {
+  sSink = sSink + value;
+}
+
+
+/// <summary>
+/// Usage: Tests [--benchmark] [filter]
+/// Runs every test, or with --benchmark every benchmark, whose name contains filter.
+/// </summary>
+int main(int argc, char **argv) {
+  bool benchmarks = false;
+  const char *filter = "";
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--benchmark") == 0) {
+      benchmarks = true;
+    } else {
+      filter = argv[i];
+    }
+  }
+
+  unsigned run = 0, failed = 0;
+  for (const Case &entry : Cases()) {
+    if (entry.benchmark != benchmarks || strstr(entry.name, filter) == nullptr) {
+      continue;
+    }
+
+    printf("%s\n", entry.name);
+    sCurrent = entry.name;
+    unsigned failures = sFailures;
+    entry.proc();
+    ++run;
+    if (sFailures != failures) {
+      ++failed;
+    }
+  }
+
+  printf("%u run, %u failed\n", run, failed);
+  return failed == 0 ? 0 : 1;
+}
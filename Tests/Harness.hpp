@@ -0,0 +1,70 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Harness.hpp
+// The nModules Project
+//
+// A minimal test and benchmark runner for the parts of the tree which don't need LiteStep.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+namespace Harness {
+  typedef void (*CaseProc)();
+
+  /// <summary>
+  /// Adds a test or benchmark to the list run by main. Created by the TEST and BENCHMARK macros.
+  /// </summary>
+  struct Registration {
+    Registration(const char *name, CaseProc proc, bool benchmark);
+  };
+
+  /// <summary>
+  /// Records a failed check in the currently running test.
+  /// </summary>
+  void Fail(const char *file, int line, const char *expression);
+
+  /// <summary>
+  /// Returns a monotonic time in milliseconds, for timing benchmarks.
+  /// </summary>
+  double Now();
+
+  /// <summary>
+  /// Prints a measurement made by the currently running benchmark.
+  /// </summary>
+  void Report(const char *measurement, double value, const char *unit);
+
+  /// <summary>
+  /// Keeps the compiler from optimizing away the computation which produced value.
+  /// </summary>
+  void Consume(uint64_t value);
+
+  /// <summary>
+  /// Runs proc the specified number of times, returning the shortest time one run took in
+  /// milliseconds. The best run is the one least disturbed by the rest of the system.
+  /// </summary>
+  template <class Proc>
+  double Best(int runs, Proc proc) {
+    double best = 1e300;
+    for (int run = 0; run < runs; ++run) {
+      double start = Now();
+      proc();
+      double elapsed = Now() - start;
+      best = elapsed < best ? elapsed : best;
+    }
+    return best;
+  }
+}
+
+#define HARNESS_CASE(name, benchmark) \
+  static void name(); \
+  static Harness::Registration name##Registration(#name, name, benchmark); \
+  static void name()
+
+/// Defines a test. Tests are run by default, and fail if any CHECK fails.
+#define TEST(name) HARNESS_CASE(name, false)
+
+/// Defines a benchmark. Benchmarks are only run when --benchmark is passed.
+#define BENCHMARK(name) HARNESS_CASE(name, true)
+
+#define CHECK(expression) \
+  ((expression) ? (void)0 : Harness::Fail(__FILE__, __LINE__, #expression))
@@ -0,0 +1,53 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/HitTestIndexTests.cpp
+// The nModules Project
+//
+// Tests for HitTestIndex.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../Utilities/HitTestIndex.hpp"
+
+namespace {
+  /// <summary>
+  /// A taskbar of buttons which touch each other, scanned or gridded depending on count.
+  /// </summary>
+  void CheckAbuttingButtons(int count) {
+    HitTestIndex<int> index;
+    for (int i = 0; i < count; ++i) {
+      index.Add(i, i * 100.0f, 0.0f, (i + 1) * 100.0f, 30.0f);
+    }
+    index.Build();
+
+    // Shared edges belong to the button on the right, whichever button was hit last.
+    int item = -1;
+    for (int i = 1; i < count; ++i) {
+      CHECK(index.Find(i * 100.0f - 50.0f, 10.0f, item) && item == i - 1);
+      CHECK(index.Find(i * 100.0f, 10.0f, item) && item == i);
+      CHECK(index.Find(i * 100.0f - 0.5f, 10.0f, item) && item == i - 1);
+    }
+    CHECK(!index.Find(count * 100.0f, 10.0f, item));
+    CHECK(!index.Find(50.0f, 30.0f, item));
+  }
+}
+
+
+TEST(HitTestIndexAbuttingRectangles) {
+  CheckAbuttingButtons(4);
+  CheckAbuttingButtons(40);
+}
+
+
+TEST(HitTestIndexOverlapsFirstWins) {
+  HitTestIndex<int> index;
+  index.Add(1, 0.0f, 0.0f, 100.0f, 100.0f);
+  index.Add(2, 50.0f, 50.0f, 150.0f, 150.0f);
+  index.Build();
+
+  // Hitting the second rectangle where it's alone must not make it win where it's overlapped.
+  int item = 0;
+  CHECK(index.Find(120.0f, 120.0f, item) && item == 2);
+  CHECK(index.Find(75.0f, 75.0f, item) && item == 1);
+  CHECK(index.Find(120.0f, 120.0f, item) && item == 2);
+  CHECK(index.Find(99.0f, 99.0f, item) && item == 1);
+}
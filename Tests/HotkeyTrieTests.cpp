@@ -0,0 +1,142 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/HotkeyTrieTests.cpp
+// The nModules Project
+//
+// Tests for nKey's hotkey sequences.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nKey/HotkeyTrie.hpp"
+
+namespace {
+  // The RegisterHotKey modifiers.
+  const uint32_t sAlt = 0x1;
+  const uint32_t sControl = 0x2;
+  const uint32_t sWin = 0x8;
+
+  /// <summary>
+  /// The hotkeys
+  ///   Ctrl+K            -> 0
+  ///   Ctrl+K, Ctrl+C    -> 1
+  ///   Ctrl+K, U         -> 2
+  ///   Ctrl+K, U, D      -> 3
+  ///   Ctrl+C            -> 4
+  ///   Win+E             -> 5
+  ///   Alt+X, Y          -> 6
+  /// </summary>
+  struct Hotkeys {
+    HotkeyTrie trie;
+    uint32_t k, kc, ku, kud, c, e, x, xy;
+
+    Hotkeys() {
+      k = Add(HotkeyTrie::sRoot, sControl, 'K', 0);
+      kc = Add(k, sControl, 'C', 1);
+      ku = Add(k, 0, 'U', 2);
+      kud = Add(ku, 0, 'D', 3);
+      c = Add(HotkeyTrie::sRoot, sControl, 'C', 4);
+      e = Add(HotkeyTrie::sRoot, sWin, 'E', 5);
+      x = Add(HotkeyTrie::sRoot, sAlt, 'X', HotkeyTrie::sNone);
+      xy = Add(x, 0, 'Y', 6);
+    }
+
+    uint32_t Add(uint32_t parent, uint32_t mods, uint32_t key, uint32_t action) {
+      bool added;
+      uint32_t node = trie.AddChild(parent, mods, key, 0, added);
+      if (action != HotkeyTrie::sNone) {
+        trie.SetAction(node, action);
+      }
+      return node;
+    }
+  };
+}
+
+
+TEST(HotkeyTrieBuild) {
+  Hotkeys hotkeys;
+  HotkeyTrie &trie = hotkeys.trie;
+  CHECK(trie.GetNodeCount() == 9);
+  CHECK(trie.FindChild(HotkeyTrie::sRoot, sControl, 'K') == hotkeys.k);
+  CHECK(trie.FindChild(hotkeys.k, sControl, 'C') == hotkeys.kc);
+  CHECK(trie.FindChild(hotkeys.k, 0, 'C') == HotkeyTrie::sNone);
+  CHECK(trie.GetNode(hotkeys.kud).parent == hotkeys.ku);
+
+  // Adding a press which is already there finds the node.
+  bool added;
+  CHECK(trie.AddChild(hotkeys.k, 0, 'U', 0, added) == hotkeys.ku && !added);
+  uint32_t extra = trie.AddChild(hotkeys.k, 0, 'V', 0, added);
+  CHECK(added && trie.GetNodeCount() == 10);
+  trie.RemoveLast();
+  CHECK(trie.GetNodeCount() == 9 && trie.FindChild(hotkeys.k, 0, 'V') == HotkeyTrie::sNone);
+  CHECK(extra == 9);
+
+  trie.Clear();
+  CHECK(trie.GetNodeCount() == 1 && trie.GetNode(HotkeyTrie::sRoot).children.empty());
+}
+
+
+TEST(HotkeyTrieSequenceAdvances) {
+  Hotkeys hotkeys;
+  HotkeyTrie &trie = hotkeys.trie;
+
+  // Plain hotkeys run straight away.
+  CHECK(trie.Press(hotkeys.e) == hotkeys.e && trie.GetPending() == HotkeyTrie::sNone);
+
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone && trie.GetPending() == hotkeys.k);
+  CHECK(trie.Press(hotkeys.kc) == hotkeys.kc && trie.GetPending() == HotkeyTrie::sNone);
+
+  // Three presses deep.
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone);
+  CHECK(trie.Press(hotkeys.ku) == HotkeyTrie::sNone && trie.GetPending() == hotkeys.ku);
+  CHECK(trie.Press(hotkeys.kud) == hotkeys.kud && trie.GetPending() == HotkeyTrie::sNone);
+
+  // Ctrl+C can only be registered once, so during the sequence it arrives as the plain hotkey.
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone);
+  CHECK(trie.Press(hotkeys.c) == hotkeys.kc);
+  CHECK(trie.Press(hotkeys.c) == hotkeys.c);
+}
+
+
+TEST(HotkeyTrieUnrelatedPressResets) {
+  Hotkeys hotkeys;
+  HotkeyTrie &trie = hotkeys.trie;
+
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone);
+  CHECK(trie.Press(hotkeys.e) == hotkeys.e && trie.GetPending() == HotkeyTrie::sNone);
+
+  // The sequence is gone, so Ctrl+C is just Ctrl+C again.
+  CHECK(trie.Press(hotkeys.c) == hotkeys.c);
+
+  // An unrelated press which starts a sequence of its own starts that one instead.
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone);
+  CHECK(trie.Press(hotkeys.x) == HotkeyTrie::sNone && trie.GetPending() == hotkeys.x);
+  CHECK(trie.Press(hotkeys.xy) == hotkeys.xy);
+
+  // Pressing the start of a sequence again starts it over.
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone);
+  CHECK(trie.Press(hotkeys.ku) == HotkeyTrie::sNone);
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone && trie.GetPending() == hotkeys.k);
+  CHECK(trie.Press(hotkeys.ku) == HotkeyTrie::sNone && trie.GetPending() == hotkeys.ku);
+}
+
+
+TEST(HotkeyTrieTimeout) {
+  Hotkeys hotkeys;
+  HotkeyTrie &trie = hotkeys.trie;
+
+  // A prefix which is a hotkey of its own runs when the time runs out.
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone);
+  CHECK(trie.Timeout() == hotkeys.k && trie.GetNode(hotkeys.k).action == 0);
+  CHECK(trie.GetPending() == HotkeyTrie::sNone);
+
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone && trie.Press(hotkeys.ku) == HotkeyTrie::sNone);
+  CHECK(trie.Timeout() == hotkeys.ku);
+
+  // One which isn't does nothing.
+  CHECK(trie.Press(hotkeys.x) == HotkeyTrie::sNone);
+  CHECK(trie.Timeout() == HotkeyTrie::sNone && trie.GetPending() == HotkeyTrie::sNone);
+
+  // Nor does a timeout without a sequence, or one after the sequence has finished.
+  CHECK(trie.Timeout() == HotkeyTrie::sNone);
+  CHECK(trie.Press(hotkeys.k) == HotkeyTrie::sNone && trie.Press(hotkeys.kc) == hotkeys.kc);
+  CHECK(trie.Timeout() == HotkeyTrie::sNone);
+}
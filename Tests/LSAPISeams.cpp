@@ -0,0 +1,87 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/LSAPISeams.cpp
+// The nModules Project
+//
+// Stands in for the lsapi.dll exports which code under test refers to. Kept apart from lsapi.h,
+// which declares them as imports.
+//-------------------------------------------------------------------------------------------------
+#include "LSAPISeams.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+// The size callers of GetToken make their buffers, MAX_LINE_LENGTH.
+static const size_t sMaxToken = 4096;
+
+std::function<void (LPCWSTR command)> LSAPISeams::gExecute;
+
+
+EXTERN_C BOOL __cdecl LSSetVariableW(LPCWSTR, LPCWSTR) {
+  return TRUE;
+}
+
+
+EXTERN_C HINSTANCE __cdecl LSExecuteW(HWND, LPCWSTR command, INT) {
+  if (LSAPISeams::gExecute) {
+    LSAPISeams::gExecute(command);
+  }
+  return nullptr;
+}
+
+
+/// <summary>
+/// Reads the first token of string. Tokens are split by whitespace, and may be quoted, or, if
+/// brackets is set, bracketed.
+/// </summary>
+EXTERN_C BOOL __cdecl GetTokenW(LPCWSTR string, LPWSTR buffer, LPCWSTR *next, BOOL brackets) {
+  while (*string == L' ' || *string == L'\t') {
+    ++string;
+  }
+  if (*string == L'\0') {
+    if (next != nullptr) {
+      *next = string;
+    }
+    return FALSE;
+  }
+
+  LPCWSTR start = string, end;
+  if (*string == L'"' || *string == L'\'') {
+    WCHAR quote = *string;
+    start = ++string;
+    while (*string != L'\0' && *string != quote) {
+      ++string;
+    }
+    end = string;
+  } else if (brackets != FALSE && *string == L'[') {
+    start = ++string;
+    for (int depth = 1; *string != L'\0'; ++string) {
+      if (*string == L'[') {
+        ++depth;
+      } else if (*string == L']' && --depth == 0) {
+        break;
+      }
+    }
+    end = string;
+  } else {
+    while (*string != L'\0' && *string != L' ' && *string != L'\t') {
+      ++string;
+    }
+    end = string;
+  }
+  if (*string != L'\0' && *string != L' ' && *string != L'\t') {
+    ++string;
+  }
+  while (*string == L' ' || *string == L'\t') {
+    ++string;
+  }
+
+  if (buffer != nullptr) {
+    size_t length = std::min(size_t(end - start), sMaxToken - 1);
+    memcpy(buffer, start, length * sizeof(WCHAR));
+    buffer[length] = L'\0';
+  }
+  if (next != nullptr) {
+    *next = string;
+  }
+  return TRUE;
+}
@@ -0,0 +1,16 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/LSAPISeams.hpp
+// The nModules Project
+//
+// Lets tests see what code under test asks of lsapi.dll.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/Common.h"
+
+#include <functional>
+
+namespace LSAPISeams {
+  // Called with each command passed to LSExecute, in place of running it.
+  extern std::function<void (LPCWSTR command)> gExecute;
+}
@@ -0,0 +1,231 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/LineTokenizerTests.cpp
+// The nModules Project
+//
+// Tests and benchmarks for LineTokenizer and KeyBuilder.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../Utilities/LineTokenizer.hpp"
+
+#include <string>
+#include <strsafe.h>
+#include <vector>
+#include <wchar.h>
+
+namespace {
+  bool IsSpace(WCHAR chr) {
+    return chr == L' ' || chr == L'\t' || chr == L'\r' || chr == L'\n';
+  }
+
+  /// <summary>
+  /// A model of LiteStep's GetToken, which copies each token into a buffer.
+  /// </summary>
+  bool ReferenceGetToken(LPCWSTR line, LPWSTR token, LPCWSTR *next, bool useBrackets) {
+    token[0] = L'\0';
+    *next = nullptr;
+    if (line == nullptr) {
+      return false;
+    }
+    while (IsSpace(*line)) {
+      ++line;
+    }
+    if (*line == L'\0') {
+      return false;
+    }
+
+    LPCWSTR current = line, start = nullptr;
+    WCHAR quote = L'\0';
+    int bracketLevel = 0;
+    for (; *current != L'\0'; ++current) {
+      if (quote == L'\0' && IsSpace(*current)) {
+        break;
+      }
+      if (useBrackets && (*current == L'[' || *current == L']') && (quote == L'\0' || quote == L'[')) {
+        if (*current == L'[') {
+          quote = L'[';
+          if (++bracketLevel == 1 && start == nullptr) {
+            continue;
+          }
+        } else if (--bracketLevel <= 0) {
+          break;
+        }
+      } else if ((*current == L'"' || *current == L'\'') && quote != L'[') {
+        if (quote == L'\0') {
+          quote = *current;
+          if (start == nullptr) {
+            continue;
+          }
+        } else if (*current == quote) {
+          break;
+        }
+      }
+      if (start == nullptr) {
+        start = current;
+      }
+    }
+
+    size_t length = start != nullptr ? current - start : 0;
+    wmemcpy(token, start != nullptr ? start : current, length);
+    token[length] = L'\0';
+
+    if (*current != L'\0') {
+      ++current;
+    }
+    while (IsSpace(*current)) {
+      ++current;
+    }
+    if (*current != L'\0') {
+      *next = current;
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// A small deterministic generator, so that failures can be reproduced.
+  /// </summary>
+  class Random {
+  public:
+    explicit Random(uint64_t seed) : mState(seed) {}
+
+    uint32_t Next(uint32_t bound) {
+      mState = mState * 6364136223846793005ull + 1442695040888963407ull;
+      return uint32_t((mState >> 33) % bound);
+    }
+
+  private:
+    uint64_t mState;
+  };
+}
+
+
+TEST(LineTokenizerMatchesGetToken) {
+  // Short lines out of the characters which matter to the tokenizer, and a few which don't.
+  static const WCHAR alphabet[] = L"ab \t\"'[]!$x";
+  Random random(1);
+  WCHAR expected[64];
+
+  for (int iteration = 0; iteration < 200000; ++iteration) {
+    std::wstring line;
+    for (uint32_t length = random.Next(24); length > 0; --length) {
+      line += alphabet[random.Next(_countof(alphabet) - 1)];
+    }
+
+    for (bool useBrackets : { false, true }) {
+      LineTokenizer spans(line.c_str(), useBrackets);
+      std::wstring writable(line);
+      LineTokenizer terminated(&writable[0], useBrackets);
+      LPCWSTR position = line.c_str();
+
+      for (;;) {
+        LPCWSTR next;
+        bool found = ReferenceGetToken(position, expected, &next, useBrackets);
+        StringSpan span;
+        LPCWSTR token = nullptr;
+        CHECK(spans.Next(span) == found);
+        CHECK(terminated.NextTerminated(token) == found);
+        if (!found) {
+          break;
+        }
+
+        CHECK(span.begin >= line.c_str() && span.begin + span.length <= line.c_str() + line.size());
+        CHECK(span.ToString() == expected);
+        CHECK(token != nullptr && wcscmp(token, expected) == 0);
+        CHECK((next == nullptr) == (spans.Rest() == nullptr));
+        if (next == nullptr) {
+          CHECK(!spans.Next(span));
+          break;
+        }
+        CHECK(wcscmp(next, spans.Rest()) == 0);
+        position = next;
+      }
+    }
+  }
+}
+
+
+TEST(StringSpanComparisons) {
+  LineTokenizer tokenizer(L"  nLabel  \"Hello World\"  ");
+  StringSpan span;
+  CHECK(tokenizer.Next(span) && span.Equals(L"NLABEL") && !span.Equals(L"nLabe") && span.StartsWith(L"nLab"));
+  CHECK(tokenizer.Next(span) && span.Equals(L"hello world") && !span.StartsWith(L"Hello World!"));
+  CHECK(!tokenizer.Next(span) && tokenizer.Rest() == nullptr);
+
+  WCHAR buffer[6];
+  CHECK(!span.CopyTo(buffer, _countof(buffer)) && wcscmp(buffer, L"Hello") == 0);
+  CHECK(!span.CopyTo(buffer, 0));
+
+  KeyBuilder<8> key(L"nTask", L"Button");
+  CHECK(wcscmp(key, L"nTaskBu") == 0);
+}
+
+
+BENCHMARK(LineTokenizing) {
+  static LPCWSTR const templates[] = {
+    L"*Popup \"Programs\" !PopupPrograms",
+    L"*HotKey Win+Ctrl E \"!execute [!nLabelShow A][!nLabelHide B]\"",
+    L"nTaskbarButtonFont \"Segoe UI\" 12 bold",
+    L"*nDeskOn LeftClickUp ctrl 0 0 100 100 !Popup",
+    L"nIconTileIconSize 48 .icon=C:\\x.ico 'quoted value' [bracket [nested] x]"
+  };
+  std::vector<LPCWSTR> lines;
+  for (int i = 0; i < 200000; ++i) {
+    lines.push_back(templates[i % _countof(templates)]);
+  }
+
+  // Copying every token into a MAX_LINE_LENGTH buffer, the way GetToken is used.
+  double copying = Harness::Best(5, [&] {
+    uint64_t checksum = 0;
+    for (LPCWSTR line : lines) {
+      WCHAR token[4096];
+      for (LPCWSTR position = line; position != nullptr && ReferenceGetToken(position, token, &position, false);) {
+        checksum += wcslen(token);
+      }
+    }
+    Harness::Consume(checksum);
+  });
+
+  double spans = Harness::Best(5, [&] {
+    uint64_t checksum = 0;
+    for (LPCWSTR line : lines) {
+      LineTokenizer tokenizer(line);
+      StringSpan span;
+      while (tokenizer.Next(span)) {
+        checksum += span.length;
+      }
+    }
+    Harness::Consume(checksum);
+  });
+
+  Harness::Report("Copying tokens", copying * 1e6 / lines.size(), "ns/line");
+  Harness::Report("LineTokenizer spans", spans * 1e6 / lines.size(), "ns/line");
+}
+
+
+BENCHMARK(KeyBuilding) {
+  static LPCWSTR const prefixes[] = { L"nTaskbarButton", L"nLabelClockText", L"nIconTile" };
+  static LPCWSTR const keys[] = { L"X", L"Width", L"FontSize", L"Group" };
+  const int iterations = 3000000;
+
+  double formatting = Harness::Best(5, [&] {
+    uint64_t checksum = 0;
+    for (int i = 0; i < iterations; ++i) {
+      WCHAR key[64];
+      StringCchPrintfW(key, _countof(key), L"%s%s", prefixes[i % 3], keys[i % 4]);
+      checksum += key[3];
+    }
+    Harness::Consume(checksum);
+  });
+
+  double building = Harness::Best(5, [&] {
+    uint64_t checksum = 0;
+    for (int i = 0; i < iterations; ++i) {
+      KeyBuilder<64> key(prefixes[i % 3], keys[i % 4]);
+      checksum += ((LPCWSTR)key)[3];
+    }
+    Harness::Consume(checksum);
+  });
+
+  Harness::Report("StringCchPrintf", formatting * 1e6 / iterations, "ns/key");
+  Harness::Report("KeyBuilder", building * 1e6 / iterations, "ns/key");
+}
@@ -0,0 +1,150 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/MessageDispatchBenchmarks.cpp
+// The nModules Project
+//
+// Compares the ways Window can find the handler of a registered user message. The IDs are handed
+// out by a UIDGenerator from Window::WM_FIRSTREGISTERED up, so they are dense. Timers work the same
+// way, from Window::VT_FIRSTREGISTERED.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nShared/MessageHandler.hpp"
+#include "../nShared/Window.hpp"
+#include "../Utilities/UIDGenerator.hpp"
+
+#include <map>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// The call through the vtable is part of every dispatch.
+  /// </summary>
+  class Handler : public MessageHandler {
+  public:
+    explicit Handler(UINT weight) : mWeight(weight) {
+      mInitialized = true;
+    }
+
+    LRESULT WINAPI HandleMessage(HWND, UINT message, WPARAM, LPARAM, LPVOID) override {
+      return LRESULT(message) * mWeight;
+    }
+
+  private:
+    UINT mWeight;
+  };
+
+  /// <summary>
+  /// How Window used to find handlers.
+  /// </summary>
+  struct MapTable {
+    MapTable() : ids(Window::WM_FIRSTREGISTERED) {}
+
+    UINT Register(MessageHandler *handler) {
+      UINT message = ids.GetNewID();
+      handlers[message] = handler;
+      return message;
+    }
+
+    void Release(UINT message) {
+      if (handlers.erase(message) != 0) {
+        ids.ReleaseID(message);
+      }
+    }
+
+    LRESULT Dispatch(UINT message) {
+      std::map<UINT, MessageHandler*>::const_iterator iter = handlers.find(message);
+      return iter != handlers.end() ? iter->second->HandleMessage(nullptr, message, 0, 0, nullptr) : 0;
+    }
+
+    UIDGenerator<UINT> ids;
+    std::map<UINT, MessageHandler*> handlers;
+  };
+
+  /// <summary>
+  /// How Window::RegisterUserMessage, ReleaseUserMessage, and HandleMessage find handlers now.
+  /// </summary>
+  struct FlatTable {
+    FlatTable() : ids(Window::WM_FIRSTREGISTERED) {}
+
+    UINT Register(MessageHandler *handler) {
+      UINT message = ids.GetNewID();
+      if (message - Window::WM_FIRSTREGISTERED >= handlers.size()) {
+        handlers.resize(message - Window::WM_FIRSTREGISTERED + 1, nullptr);
+      }
+      handlers[message - Window::WM_FIRSTREGISTERED] = handler;
+      return message;
+    }
+
+    void Release(UINT message) {
+      if (message >= Window::WM_FIRSTREGISTERED && message - Window::WM_FIRSTREGISTERED < handlers.size() &&
+          handlers[message - Window::WM_FIRSTREGISTERED] != nullptr) {
+        handlers[message - Window::WM_FIRSTREGISTERED] = nullptr;
+        ids.ReleaseID(message);
+      }
+    }
+
+    LRESULT Dispatch(UINT message) {
+      if (message >= Window::WM_FIRSTREGISTERED && message - Window::WM_FIRSTREGISTERED < handlers.size()) {
+        MessageHandler *handler = handlers[message - Window::WM_FIRSTREGISTERED];
+        if (handler != nullptr) {
+          return handler->HandleMessage(nullptr, message, 0, 0, nullptr);
+        }
+      }
+      return 0;
+    }
+
+    UIDGenerator<UINT> ids;
+    std::vector<MessageHandler*> handlers;
+  };
+
+  /// <summary>
+  /// Dispatches the stream of messages ten times over.
+  /// </summary>
+  template <class Table>
+  void Play(Table &table, const std::vector<UINT> &messages) {
+    uint64_t checksum = 0;
+    for (int pass = 0; pass < 10; ++pass) {
+      for (UINT message : messages) {
+        checksum += uint64_t(table.Dispatch(message));
+      }
+    }
+    Harness::Consume(checksum);
+  }
+}
+
+
+BENCHMARK(MessageDispatch) {
+  // 16 handlers, left over after a module with a few messages released some of them, so the table
+  // has holes.
+  std::vector<Handler> handlers;
+  for (UINT i = 0; i < 20; ++i) {
+    handlers.push_back(Handler(i));
+  }
+  MapTable map;
+  FlatTable flat;
+  std::vector<UINT> registered;
+  for (Handler &handler : handlers) {
+    UINT message = flat.Register(&handler);
+    map.Register(&handler);
+    registered.push_back(message);
+  }
+  for (size_t i = 0; i < registered.size(); i += 5) {
+    map.Release(registered[i]);
+    flat.Release(registered[i]);
+  }
+
+  // Most messages have a handler. Some are released IDs, or messages nobody registered.
+  std::vector<UINT> messages;
+  uint64_t state = 1;
+  for (int i = 0; i < 100000; ++i) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    messages.push_back(Window::WM_FIRSTREGISTERED + UINT((state >> 33) % 24));
+  }
+
+  double mapTime = Harness::Best(5, [&] { Play(map, messages); });
+  double flatTime = Harness::Best(5, [&] { Play(flat, messages); });
+
+  double dispatches = messages.size() * 10.0;
+  Harness::Report("std::map", mapTime * 1e6 / dispatches, "ns/dispatch");
+  Harness::Report("Flat table", flatTime * 1e6 / dispatches, "ns/dispatch");
+}
@@ -0,0 +1,229 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/MonitorIndexTests.cpp
+// The nModules Project
+//
+// Tests for the monitor lookups behind MonitorInfo.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../Utilities/MonitorIndex.hpp"
+
+#include <vector>
+
+namespace {
+  typedef MonitorIndex::Rect Rect;
+
+  /// <summary>
+  /// A small deterministic generator, so that failures can be reproduced.
+  /// </summary>
+  class Random {
+  public:
+    explicit Random(uint64_t seed) : mState(seed) {}
+
+    uint32_t Next(uint32_t bound) {
+      mState = mState * 6364136223846793005ull + 1442695040888963407ull;
+      return uint32_t((mState >> 33) % bound);
+    }
+
+    int32_t Range(int32_t low, int32_t high) {
+      return low + int32_t(Next(uint32_t(high - low)));
+    }
+
+  private:
+    uint64_t mState;
+  };
+
+  Rect MakeRect(int32_t left, int32_t top, int32_t width, int32_t height) {
+    Rect rect = { left, top, left + width, top + height };
+    return rect;
+  }
+
+  int64_t Intersection(const Rect &a, const Rect &b) {
+    int64_t width = int64_t(std::min(a.right, b.right)) - std::max(a.left, b.left);
+    int64_t height = int64_t(std::min(a.bottom, b.bottom)) - std::max(a.top, b.top);
+    return width > 0 && height > 0 ? width * height : 0;
+  }
+
+  uint32_t ScanPoint(const std::vector<Rect> &monitors, int32_t x, int32_t y) {
+    for (uint32_t i = 0; i < uint32_t(monitors.size()); ++i) {
+      const Rect &monitor = monitors[i];
+      if (x >= monitor.left && x < monitor.right && y >= monitor.top && y < monitor.bottom) {
+        return i;
+      }
+    }
+    return MonitorIndex::sNone;
+  }
+
+  uint32_t ScanRect(const std::vector<Rect> &monitors, const Rect &rect) {
+    uint32_t best = MonitorIndex::sNone;
+    int64_t bestArea = 0;
+    for (uint32_t i = 0; i < uint32_t(monitors.size()); ++i) {
+      int64_t area = Intersection(rect, monitors[i]);
+      if (area > bestArea) {
+        bestArea = area;
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  /// <summary>
+  /// Monitors in rows and columns which share their edges, starting left of and above the origin.
+  /// </summary>
+  std::vector<Rect> MakeGrid(int columns, int rows, int32_t width, int32_t height) {
+    std::vector<Rect> monitors;
+    for (int row = 0; row < rows; ++row) {
+      for (int column = 0; column < columns; ++column) {
+        monitors.push_back(MakeRect((column - 1) * width, (row - 1) * height, width, height));
+      }
+    }
+    return monitors;
+  }
+
+  /// <summary>
+  /// Monitors of different sizes at random spots which don't overlap, so that there are gaps
+  /// between some of them and shared edges between others.
+  /// </summary>
+  std::vector<Rect> MakeScattered(uint32_t count, Random &random) {
+    static const int32_t widths[] = { 640, 800, 1024, 1280, 1920, 2560 };
+    static const int32_t heights[] = { 480, 600, 768, 1024, 1080, 1440 };
+    const uint32_t sizeCount = uint32_t(sizeof(widths) / sizeof(widths[0]));
+
+    std::vector<Rect> monitors;
+    while (monitors.size() < count) {
+      // Positions on a coarse grid make touching edges likely.
+      Rect rect = MakeRect(random.Range(-8, 8) * 320, random.Range(-8, 8) * 240,
+        widths[random.Next(sizeCount)], heights[random.Next(sizeCount)]);
+      bool overlaps = false;
+      for (const Rect &monitor : monitors) {
+        overlaps = overlaps || Intersection(rect, monitor) > 0;
+      }
+      if (!overlaps) {
+        monitors.push_back(rect);
+      }
+    }
+    return monitors;
+  }
+
+  /// <summary>
+  /// Checks every lookup which touches a monitor edge or corner, and random ones, against a scan
+  /// of all monitors.
+  /// </summary>
+  bool MatchesScan(const std::vector<Rect> &monitors, Random &random) {
+    MonitorIndex index;
+    index.Build(monitors.data(), uint32_t(monitors.size()));
+
+    std::vector<int32_t> xs, ys;
+    for (const Rect &monitor : monitors) {
+      for (int32_t offset : { -1, 0, 1 }) {
+        xs.push_back(monitor.left + offset);
+        xs.push_back(monitor.right + offset);
+        ys.push_back(monitor.top + offset);
+        ys.push_back(monitor.bottom + offset);
+      }
+    }
+
+    for (int32_t x : xs) {
+      for (int32_t y : ys) {
+        if (index.FromPoint(x, y) != ScanPoint(monitors, x, y)) {
+          return false;
+        }
+      }
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+      int32_t x = random.Range(-4000, 6000), y = random.Range(-3000, 5000);
+      if (index.FromPoint(x, y) != ScanPoint(monitors, x, y)) {
+        return false;
+      }
+
+      // Windows the size of a window, and some which are much larger or empty.
+      Rect rect = MakeRect(x, y, random.Range(0, i % 10 == 0 ? 8000 : 1200), random.Range(0, 900));
+      if (index.FromRect(rect) != ScanRect(monitors, rect)) {
+        return false;
+      }
+
+      // Rectangles which start on an edge.
+      rect = MakeRect(xs[random.Next(uint32_t(xs.size()))], ys[random.Next(uint32_t(ys.size()))],
+        random.Range(1, 2000), random.Range(1, 1500));
+      if (index.FromRect(rect) != ScanRect(monitors, rect)) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+
+TEST(MonitorIndexGrids) {
+  Random random(1);
+  for (int count = 1; count <= 16; ++count) {
+    for (int columns = 1; columns <= count; ++columns) {
+      if (count % columns == 0) {
+        CHECK(MatchesScan(MakeGrid(columns, count / columns, 1920, 1080), random));
+      }
+    }
+  }
+}
+
+
+TEST(MonitorIndexScattered) {
+  Random random(2);
+  for (uint32_t count = 1; count <= 16; ++count) {
+    for (int layout = 0; layout < 8; ++layout) {
+      CHECK(MatchesScan(MakeScattered(count, random), random));
+    }
+  }
+}
+
+
+TEST(MonitorIndexOverlapping) {
+  Random random(3);
+
+  // A cloned display, and one which is cloned onto a smaller monitor.
+  std::vector<Rect> cloned = MakeGrid(2, 1, 1920, 1080);
+  cloned.push_back(cloned[0]);
+  CHECK(MatchesScan(cloned, random));
+  cloned.push_back(MakeRect(cloned[1].left, cloned[1].top, 1280, 720));
+  CHECK(MatchesScan(cloned, random));
+
+  // Monitors which overlap in part, at random.
+  for (uint32_t count = 2; count <= 16; ++count) {
+    std::vector<Rect> monitors;
+    for (uint32_t i = 0; i < count; ++i) {
+      monitors.push_back(MakeRect(random.Range(-2000, 2000), random.Range(-1500, 1500),
+        random.Range(640, 2560), random.Range(480, 1440)));
+    }
+    CHECK(MatchesScan(monitors, random));
+  }
+}
+
+
+TEST(MonitorIndexSharedEdges) {
+  // Right and bottom edges belong to the next monitor over.
+  std::vector<Rect> monitors = MakeGrid(2, 2, 100, 100);
+  MonitorIndex index;
+  index.Build(monitors.data(), uint32_t(monitors.size()));
+  CHECK(index.FromPoint(-100, -100) == 0);
+  CHECK(index.FromPoint(0, -100) == 1);
+  CHECK(index.FromPoint(-1, -1) == 0);
+  CHECK(index.FromPoint(0, 0) == 3);
+  CHECK(index.FromPoint(-100, 0) == 2);
+  CHECK(index.FromPoint(100, 0) == MonitorIndex::sNone);
+  CHECK(index.FromPoint(0, 100) == MonitorIndex::sNone);
+  CHECK(index.FromPoint(-101, 0) == MonitorIndex::sNone);
+
+  // A rectangle split evenly between monitors goes to the first of them.
+  CHECK(index.FromRect(MakeRect(-10, -10, 20, 20)) == 0);
+  CHECK(index.FromRect(MakeRect(-10, 10, 20, 20)) == 2);
+  CHECK(index.FromRect(MakeRect(-10, -10, 21, 20)) == 1);
+
+  // Touching a monitor isn't being on it.
+  CHECK(index.FromRect(MakeRect(100, -100, 50, 50)) == MonitorIndex::sNone);
+  CHECK(index.FromRect(MakeRect(-50, 100, 50, 50)) == MonitorIndex::sNone);
+
+  // No monitors at all.
+  index.Build(nullptr, 0);
+  CHECK(index.FromPoint(0, 0) == MonitorIndex::sNone);
+  CHECK(index.FromRect(MakeRect(0, 0, 10, 10)) == MonitorIndex::sNone);
+}
@@ -0,0 +1,103 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/PerfectHashTests.cpp
+// The nModules Project
+//
+// Tests for the map nKey looks virtual key names up in.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../Utilities/PerfectHash.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+  typedef std::vector<std::pair<std::wstring, int>> Entries;
+
+  /// <summary>
+  /// Names like the ones in a VK table, "VK_BROWSER_BACK0" and so on.
+  /// </summary>
+  Entries MakeEntries(int count) {
+    static const wchar_t *const prefixes[] = { L"VK_", L"VK_BROWSER_", L"VK_MEDIA_", L"VK_OEM_", L"VK_NUMPAD" };
+    static const wchar_t *const suffixes[] = { L"BACK", L"NEXT", L"STOP", L"PLAY", L"CLEAR" };
+
+    Entries entries;
+    for (int i = 0; i < count; ++i) {
+      std::wstring key = std::wstring(prefixes[i % 5]) + suffixes[(i / 5) % 5] + std::to_wstring(i / 25);
+      entries.push_back(std::make_pair(key, i));
+    }
+    return entries;
+  }
+}
+
+
+TEST(PerfectHashFindsAllKeys) {
+  for (int count : { 1, 2, 7, 8, 9, 100, 1000, 20000 }) {
+    Entries entries = MakeEntries(count);
+    PerfectHash<int> map;
+    map.Build(entries);
+    CHECK(map.Size() == size_t(count));
+
+    bool allFound = true;
+    for (auto &entry : entries) {
+      int value = -1;
+      allFound = allFound && map.Find(entry.first.c_str(), value) && value == entry.second;
+    }
+    CHECK(allFound);
+  }
+}
+
+
+TEST(PerfectHashRejectsMisses) {
+  Entries entries = MakeEntries(1000);
+  PerfectHash<int> map;
+  map.Build(entries);
+
+  // Keys which are close to ones in the map. Lookups are case sensitive.
+  bool anyFound = false;
+  for (auto &entry : entries) {
+    int value;
+    std::wstring key = entry.first;
+    anyFound = anyFound || map.Find((key + L"x").c_str(), value);
+    anyFound = anyFound || map.Find(key.substr(1).c_str(), value);
+    key[0] = L'v';
+    anyFound = anyFound || map.Find(key.c_str(), value);
+  }
+  CHECK(!anyFound);
+
+  int value = 7;
+  CHECK(!map.Find(L"", value) && value == 7);
+  CHECK(!map.Find(L"VK_BACK1000", value));
+
+  // Empty maps find nothing.
+  PerfectHash<int> empty;
+  CHECK(!empty.Find(L"VK_BACK0", value) && empty.Size() == 0);
+  empty.Build(Entries());
+  CHECK(!empty.Find(L"", value) && empty.Size() == 0);
+  map.Clear();
+  CHECK(!map.Find(entries[0].first.c_str(), value) && map.Size() == 0);
+}
+
+
+TEST(PerfectHashLastDuplicateWins) {
+  // Names from vk104.txt come after the built-in ones, and replace them.
+  Entries entries = MakeEntries(100);
+  entries.push_back(std::make_pair(entries[3].first, 1003));
+  entries.push_back(std::make_pair(entries[50].first, 1050));
+  entries.push_back(std::make_pair(entries[3].first, 2003));
+
+  PerfectHash<int> map;
+  map.Build(entries);
+  CHECK(map.Size() == 100);
+
+  int value;
+  CHECK(map.Find(entries[3].first.c_str(), value) && value == 2003);
+  CHECK(map.Find(entries[50].first.c_str(), value) && value == 1050);
+  CHECK(map.Find(entries[4].first.c_str(), value) && value == 4);
+
+  // Rebuilding replaces what was there.
+  map.Build(Entries(1, std::make_pair(std::wstring(L"Only"), 1)));
+  CHECK(map.Size() == 1 && !map.Find(entries[3].first.c_str(), value));
+  CHECK(map.Find(L"Only", value) && value == 1);
+}
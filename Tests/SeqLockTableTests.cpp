@@ -0,0 +1,195 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/SeqLockTableTests.cpp
+// The nModules Project
+//
+// Tests for the table behind nCore's window state.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../Utilities/SeqLockTable.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// A record whose halves have to agree, so that torn copies can be spotted.
+  /// </summary>
+  struct Record {
+    uint32_t value;
+    uint32_t check;
+  };
+
+  Record MakeRecord(uint32_t value) {
+    Record record = { value, ~value };
+    return record;
+  }
+
+  typedef SeqLockTable<uint32_t, Record, 4, 8> Table;
+
+  /// <summary>
+  /// Returns the keys of the table, in storage order.
+  /// </summary>
+  std::vector<uint32_t> ReadKeys(const Table &table) {
+    std::vector<Table::Entry> entries;
+    table.ReadAll(entries);
+    std::vector<uint32_t> keys;
+    for (const Table::Entry &entry : entries) {
+      keys.push_back(entry.key);
+    }
+    return keys;
+  }
+}
+
+
+TEST(SeqLockTableLogWrapAround) {
+  Table table;
+
+  // 20 changes go through a log of 8 more than twice.
+  for (uint32_t key = 0; key < 10; ++key) {
+    table.Set(key, MakeRecord(key), 0);
+  }
+  for (uint32_t key = 0; key < 10; ++key) {
+    table.Set(key, MakeRecord(key + 100), 1u << key);
+  }
+  CHECK(table.GetVersion() == 20);
+
+  // Replacing a record without saying what changed isn't a change.
+  table.Set(3, MakeRecord(3), 0);
+  CHECK(table.GetVersion() == 20);
+
+  uint64_t version = 12;
+  std::vector<Table::Change> changes;
+  CHECK(table.ReadChanges(version, changes));
+  CHECK(version == 20 && changes.size() == 8);
+  for (size_t i = 0; i < changes.size(); ++i) {
+    const Table::Change &change = changes[i];
+    CHECK(change.version == 13 + i);
+    CHECK(change.key == 2 + i && change.type == Table::ChangeType::Modified && change.fields == 1u << (2 + i));
+  }
+
+  // Up to date, nothing to read.
+  CHECK(table.ReadChanges(version, changes) && version == 20 && changes.empty());
+
+  // The log keeps going around after a removal.
+  CHECK(table.Remove(4));
+  CHECK(table.ReadChanges(version, changes) && version == 21 && changes.size() == 1);
+  CHECK(changes[0].key == 4 && changes[0].type == Table::ChangeType::Removed);
+}
+
+
+TEST(SeqLockTableReadChangesFallback) {
+  Table table;
+  for (uint32_t key = 0; key < 9; ++key) {
+    table.Set(key, MakeRecord(key), 0);
+  }
+
+  // 9 changes since version 0, but the log only holds 8.
+  uint64_t version = 0;
+  std::vector<Table::Change> changes;
+  CHECK(!table.ReadChanges(version, changes));
+  CHECK(changes.empty() && version == 9);
+
+  // Exactly as many changes as the log holds still works.
+  version = 1;
+  CHECK(table.ReadChanges(version, changes) && changes.size() == 8 && changes.front().key == 1);
+
+  // A reader which fell behind reads the whole table instead, then carries on from its version.
+  std::vector<Table::Entry> entries;
+  version = table.ReadAll(entries);
+  CHECK(version == 9 && entries.size() == 9);
+  table.Set(100, MakeRecord(100), 0);
+  CHECK(table.ReadChanges(version, changes) && changes.size() == 1 && changes[0].key == 100);
+}
+
+
+TEST(SeqLockTableSwapRemove) {
+  Table table;
+  for (uint32_t key = 10; key < 15; ++key) {
+    table.Set(key, MakeRecord(key), 0);
+  }
+  CHECK(ReadKeys(table) == std::vector<uint32_t>({ 10, 11, 12, 13, 14 }));
+
+  // The last entry fills the hole, and can still be found and modified.
+  CHECK(table.Remove(11));
+  CHECK(ReadKeys(table) == std::vector<uint32_t>({ 10, 14, 12, 13 }));
+  CHECK(table.Get(14) != nullptr && table.Get(14)->value == 14);
+  table.Set(14, MakeRecord(114), 1);
+  Record record;
+  CHECK(table.Find(14, record) && record.value == 114);
+  CHECK(ReadKeys(table) == std::vector<uint32_t>({ 10, 14, 12, 13 }));
+
+  // Removing the last entry leaves the others where they are.
+  CHECK(table.Remove(13));
+  CHECK(ReadKeys(table) == std::vector<uint32_t>({ 10, 14, 12 }));
+
+  CHECK(!table.Remove(11));
+  CHECK(!table.Find(11, record) && table.Get(11) == nullptr);
+  CHECK(table.GetVersion() == 8);
+}
+
+
+TEST(SeqLockTableGrows) {
+  // Nothing is dropped past the initial capacity.
+  Table table;
+  for (uint32_t key = 0; key < 1000; ++key) {
+    table.Set(key, MakeRecord(key), 0);
+  }
+  CHECK(table.GetCapacity() >= 1000);
+
+  std::vector<Table::Entry> entries;
+  table.ReadAll(entries);
+  CHECK(entries.size() == 1000);
+  for (uint32_t key = 0; key < 1000; ++key) {
+    Record record;
+    CHECK(table.Find(key, record) && record.value == key);
+  }
+
+  std::vector<uint32_t> keys = table.GetKeys();
+  std::sort(keys.begin(), keys.end());
+  CHECK(keys.size() == 1000 && keys.front() == 0 && keys.back() == 999);
+}
+
+
+TEST(SeqLockTableConcurrentReaders) {
+  // One thread writes, growing and shrinking the table, while others copy it.
+  Table table;
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> torn(0);
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 2; ++i) {
+    readers.emplace_back([&table, &done, &torn] () {
+      std::vector<Table::Entry> entries;
+      while (!done.load()) {
+        table.ReadAll(entries);
+        for (const Table::Entry &entry : entries) {
+          if (entry.record.check != ~entry.record.value) {
+            ++torn;
+          }
+        }
+        Record record;
+        if (table.Find(7, record) && record.check != ~record.value) {
+          ++torn;
+        }
+      }
+    });
+  }
+
+  for (uint32_t round = 0; round < 200; ++round) {
+    for (uint32_t key = 0; key < 300; ++key) {
+      table.Set(key, MakeRecord(key * round), 1);
+    }
+    for (uint32_t key = 0; key < 300; key += 2) {
+      table.Remove(key);
+    }
+  }
+
+  done.store(true);
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  CHECK(torn.load() == 0);
+}
@@ -0,0 +1,135 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/SettingsBenchmarks.cpp
+// The nModules Project
+//
+// Measures building the Settings group chains of a large theme, as modules do while starting up.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nShared/ErrorHandler.h"
+#include "../nShared/Settings.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <wctype.h>
+
+namespace {
+  // The RC files, by lower case key.
+  std::unordered_map<std::wstring, std::wstring> sRCValues;
+
+  // The number of times the RC files were read.
+  uint64_t sRCReads = 0;
+
+  void SetRCValue(const std::wstring &key, const std::wstring &value) {
+    std::wstring lower(key);
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
+    sRCValues[lower] = value;
+  }
+
+  /// <summary>
+  /// A theme with a few shared groups, and many windows which use them. Every taskbar, label and
+  /// popup has its own prefix, and belongs to a chain of two or three groups.
+  /// </summary>
+  void LoadTheme(int windows) {
+    sRCValues.clear();
+    SetRCValue(L"ThemeGroup", L"Base");
+    SetRCValue(L"ThemeButtonGroup", L"Theme");
+    for (int i = 0; i < windows; ++i) {
+      wchar_t prefix[32];
+      swprintf_s(prefix, L"Window%d", i);
+      SetRCValue(std::wstring(prefix) + L"Group", i % 3 == 0 ? L"ThemeButton" : L"Theme");
+    }
+  }
+
+  /// <summary>
+  /// Creates the settings a window with a few children and states would, returning how many were
+  /// created.
+  /// </summary>
+  int CreateWindowSettings(int window) {
+    static LPCTSTR const children[] = { L"Button", L"Icon", L"Text", L"Overlay" };
+    static LPCTSTR const states[] = { L"", L"Hover", L"Pressed", L"Active", L"Flashing" };
+
+    wchar_t prefix[32];
+    swprintf_s(prefix, L"Window%d", window);
+    Settings settings(prefix);
+    int created = 1;
+    for (LPCTSTR child : children) {
+      LPSettings childSettings = settings.CreateChild(child);
+      for (LPCTSTR state : states) {
+        delete childSettings->CreateChild(state);
+        ++created;
+      }
+      delete childSettings;
+      ++created;
+    }
+    return created;
+  }
+}
+
+
+// The parts of the LiteStep API which Settings uses, reading from sRCValues.
+bool LiteStep::GetPrefixedRCString(LPCTSTR prefix, LPCTSTR keyName, LPTSTR buffer,
+    LPCTSTR defaultValue, size_t cchBuffer) {
+  ++sRCReads;
+  std::wstring key = std::wstring(prefix) + keyName;
+  std::transform(key.begin(), key.end(), key.begin(), ::towlower);
+  auto iter = sRCValues.find(key);
+  LPCTSTR value = iter != sRCValues.end() ? iter->second.c_str() : defaultValue;
+  wcsncpy_s(buffer, cchBuffer, value != nullptr ? value : L"", _TRUNCATE);
+  return iter != sRCValues.end();
+}
+
+bool LiteStep::GetPrefixedRCLine(LPCTSTR prefix, LPCTSTR keyName, LPTSTR buffer,
+    LPCTSTR defaultValue, size_t cchBuffer) {
+  return GetPrefixedRCString(prefix, keyName, buffer, defaultValue, cchBuffer);
+}
+
+bool LiteStep::GetPrefixedRCBool(LPCTSTR, LPCTSTR, bool defaultValue) { return defaultValue; }
+double LiteStep::GetPrefixedRCDouble(LPCTSTR, LPCTSTR, double defaultValue) { return defaultValue; }
+float LiteStep::GetPrefixedRCFloat(LPCTSTR, LPCTSTR, float defaultValue) { return defaultValue; }
+int LiteStep::GetPrefixedRCInt(LPCTSTR, LPCTSTR, int defaultValue) { return defaultValue; }
+__int64 LiteStep::GetPrefixedRCInt64(LPCTSTR, LPCTSTR, __int64 defaultValue) { return defaultValue; }
+UINT LiteStep::GetPrefixedRCMonitor(LPCTSTR, LPCTSTR, UINT defaultValue) { return defaultValue; }
+Distance LiteStep::GetPrefixedRCDistance(LPCTSTR, LPCTSTR, Distance defaultValue) { return defaultValue; }
+IColorVal *LiteStep::ParseColor(LPCTSTR, const IColorVal *defaultValue) {
+  return defaultValue != nullptr ? defaultValue->Copy() : nullptr;
+}
+void LiteStep::IterateOverLines(LPCTSTR, std::function<void (LPCTSTR)>) {}
+void LiteStep::IterateOverTokens(LPCTSTR, std::function<void (LPCTSTR)>) {}
+void ErrorHandler::Error(Level, LPCTSTR, ...) {}
+
+
+BENCHMARK(SettingsGroupChains) {
+  for (int windows : { 100, 1000 }) {
+    LoadTheme(windows);
+
+    // Cold is every window starting from an empty cache, which is what the first load of a
+    // theme, or a refresh, costs. Warm is every window after the first finding its chains.
+    double best[2];
+    uint64_t reads[2] = { 0, 0 };
+    int created = 0;
+    for (int warm = 0; warm < 2; ++warm) {
+      best[warm] = Harness::Best(5, [&] {
+        Settings::ClearCache();
+        uint64_t readsBefore = sRCReads;
+        created = 0;
+        for (int i = 0; i < windows; ++i) {
+          if (!warm) {
+            Settings::ClearCache();
+          }
+          created += CreateWindowSettings(i);
+        }
+        reads[warm] = sRCReads - readsBefore;
+      });
+    }
+
+    printf(" %d windows, %d settings\n", windows, created);
+    Harness::Report("Cold cache", best[0] * 1000.0 / created, "us/settings");
+    Harness::Report("Cold cache RC reads", double(reads[0]) / created, "reads/settings");
+    Harness::Report("Warm cache", best[1] * 1000.0 / created, "us/settings");
+    Harness::Report("Warm cache RC reads", double(reads[1]) / created, "reads/settings");
+  }
+}
@@ -0,0 +1,168 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ShelfPackerTests.cpp
+// The nModules Project
+//
+// Tests and benchmarks for the packer behind IconAtlas.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../Utilities/ShelfPacker.hpp"
+
+#include <stdio.h>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// A small deterministic generator, so that failures can be reproduced.
+  /// </summary>
+  class Random {
+  public:
+    explicit Random(uint64_t seed) : mState(seed) {}
+
+    uint32_t Next(uint32_t bound) {
+      mState = mState * 6364136223846793005ull + 1442695040888963407ull;
+      return uint32_t((mState >> 33) % bound);
+    }
+
+  private:
+    uint64_t mState;
+  };
+
+  /// <summary>
+  /// Returns true if the rectangles are inside the area, and no two of them overlap.
+  /// </summary>
+  bool IsValidPacking(const ShelfPacker &packer, const std::vector<ShelfPacker::Rect> &rects) {
+    std::vector<uint8_t> covered(size_t(packer.GetWidth()) * packer.GetHeight(), 0);
+    for (const ShelfPacker::Rect &rect : rects) {
+      if (rect.x + rect.width > packer.GetWidth() || rect.y + rect.height > packer.GetHeight()) {
+        return false;
+      }
+      for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+        for (uint32_t x = rect.x; x < rect.x + rect.width; ++x) {
+          if (covered[size_t(y) * packer.GetWidth() + x]++ != 0) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  uint64_t Area(const std::vector<ShelfPacker::Rect> &rects) {
+    uint64_t area = 0;
+    for (const ShelfPacker::Rect &rect : rects) {
+      area += uint64_t(rect.width) * rect.height;
+    }
+    return area;
+  }
+
+  /// <summary>
+  /// Allocates icons of the specified sizes, in turn, until the packer is full.
+  /// </summary>
+  std::vector<ShelfPacker::Rect> Fill(ShelfPacker &packer, const std::vector<uint32_t> &sizes) {
+    std::vector<ShelfPacker::Rect> rects;
+    std::vector<bool> full(sizes.size(), false);
+    for (size_t i = 0, failures = 0; failures < sizes.size(); i = (i + 1) % sizes.size()) {
+      uint32_t size = sizes[i];
+      ShelfPacker::Rect rect;
+      if (full[i]) {
+        continue;
+      } else if (packer.Allocate(size, size, rect)) {
+        rects.push_back(rect);
+      } else {
+        full[i] = true;
+        ++failures;
+      }
+    }
+    return rects;
+  }
+}
+
+
+TEST(ShelfPackerRandomRounds) {
+  Random random(1);
+  static const uint32_t sizes[] = { 16, 20, 24, 32, 40, 48, 64, 96, 128, 256 };
+  const uint32_t sizeCount = uint32_t(sizeof(sizes) / sizeof(sizes[0]));
+
+  for (uint32_t size : { 256u, 512u, 1024u }) {
+    ShelfPacker packer(size, size);
+    std::vector<ShelfPacker::Rect> rects;
+
+    for (int round = 0; round < 200; ++round) {
+      // Allocate a few, then free some of what's there, in random order.
+      for (uint32_t count = random.Next(40); count > 0; --count) {
+        uint32_t width = sizes[random.Next(sizeCount)], height = width;
+        if (random.Next(4) == 0) {
+          height = sizes[random.Next(sizeCount)];
+        }
+        ShelfPacker::Rect rect;
+        if (packer.Allocate(width, height, rect)) {
+          CHECK(rect.width == width && rect.height == height);
+          rects.push_back(rect);
+        }
+      }
+      for (uint32_t count = random.Next(30); count > 0 && !rects.empty(); --count) {
+        size_t index = random.Next(uint32_t(rects.size()));
+        packer.Free(rects[index]);
+        rects[index] = rects.back();
+        rects.pop_back();
+      }
+
+      CHECK(packer.GetUsedArea() == Area(rects));
+      CHECK(IsValidPacking(packer, rects));
+    }
+
+    // Freeing everything gives back the whole area.
+    for (const ShelfPacker::Rect &rect : rects) {
+      packer.Free(rect);
+    }
+    CHECK(packer.GetUsedArea() == 0);
+    ShelfPacker::Rect whole;
+    CHECK(packer.Allocate(size, size, whole) && whole.x == 0 && whole.y == 0);
+  }
+}
+
+
+TEST(ShelfPackerEdges) {
+  ShelfPacker packer(64, 64);
+  ShelfPacker::Rect rect;
+  CHECK(!packer.Allocate(0, 16, rect));
+  CHECK(!packer.Allocate(16, 0, rect));
+  CHECK(!packer.Allocate(65, 16, rect));
+  CHECK(!packer.Allocate(16, 65, rect));
+
+  // Holes are filled before the shelf is extended.
+  ShelfPacker::Rect a, b, c;
+  CHECK(packer.Allocate(16, 16, a) && packer.Allocate(16, 16, b) && packer.Allocate(16, 16, c));
+  packer.Free(a);
+  CHECK(packer.Allocate(16, 16, rect) && rect.x == a.x && rect.y == a.y);
+
+  // Reset frees everything and changes the size.
+  packer.Reset(32, 32);
+  CHECK(packer.GetUsedArea() == 0 && packer.GetWidth() == 32 && packer.GetHeight() == 32);
+  CHECK(packer.Allocate(32, 32, rect) && !packer.Allocate(1, 1, rect));
+}
+
+
+BENCHMARK(ShelfPackerFill) {
+  struct Case {
+    const char *name;
+    std::vector<uint32_t> sizes;
+  };
+  const Case cases[] = { { "32px icons", { 32 } }, { "16/32/48px icons", { 16, 32, 48 } } };
+
+  for (const Case &test : cases) {
+    size_t allocations = 0;
+    uint64_t used = 0;
+    ShelfPacker packer(1024, 1024);
+    double best = Harness::Best(20, [&] {
+      packer.Reset(1024, 1024);
+      allocations = Fill(packer, test.sizes).size();
+      used = packer.GetUsedArea();
+    });
+
+    printf(" 1024px atlas, %s\n", test.name);
+    Harness::Report("Occupancy", 100.0 * used / (1024.0 * 1024.0), "%");
+    Harness::Report("Allocation", best * 1e6 / allocations, "ns/icon");
+  }
+}
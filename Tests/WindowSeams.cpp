@@ -0,0 +1,165 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/WindowSeams.cpp
+// The nModules Project
+//
+// Stands in for the Window members which code under test refers to. The windows are never real;
+// each Window pointer handed out points to a record of what the window would be doing.
+//-------------------------------------------------------------------------------------------------
+#include "WindowSeams.hpp"
+
+#include "../nShared/Window.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace {
+  struct StandIn {
+    HWND handle;
+    bool destroyed;
+  };
+
+  struct TopLevel {
+    StandIn *window;
+    std::vector<Window::UpdateLock*> locks;
+    bool needsUpdate;
+    UINT paints;
+  };
+
+  std::vector<std::unique_ptr<StandIn>> sStandIns;
+  std::map<HWND, TopLevel> sTopLevels;
+  ULONGLONG sDeferredRepaints = 0;
+  UINT sMisuses = 0;
+
+  StandIn *Use(Window *window) {
+    StandIn *standIn = reinterpret_cast<StandIn*>(window);
+    if (standIn->destroyed) {
+      ++sMisuses;
+    }
+    return standIn;
+  }
+
+  TopLevel *FindTopLevel(HWND handle) {
+    auto topLevel = sTopLevels.find(handle);
+    return handle != nullptr && topLevel != sTopLevels.end() && topLevel->second.window != nullptr
+      ? &topLevel->second : nullptr;
+  }
+}
+
+
+Window *WindowSeams::Create(HWND handle) {
+  StandIn *standIn = new StandIn;
+  standIn->handle = handle;
+  standIn->destroyed = false;
+  sStandIns.emplace_back(standIn);
+
+  if (FindTopLevel(handle) == nullptr) {
+    TopLevel &topLevel = sTopLevels[handle];
+    topLevel.window = standIn;
+    topLevel.needsUpdate = false;
+  }
+  return reinterpret_cast<Window*>(standIn);
+}
+
+
+void WindowSeams::Destroy(Window *window) {
+  StandIn *standIn = Use(window);
+  TopLevel *topLevel = FindTopLevel(standIn->handle);
+  if (topLevel != nullptr && topLevel->window == standIn) {
+    topLevel->needsUpdate = false;
+    std::vector<Window::UpdateLock*> locks = topLevel->locks;
+    for (Window::UpdateLock *lock : locks) {
+      lock->Unlock();
+    }
+    topLevel->window = nullptr;
+
+    for (auto &child : sStandIns) {
+      if (child->handle == standIn->handle) {
+        child->handle = nullptr;
+      }
+    }
+  }
+  standIn->destroyed = true;
+}
+
+
+void WindowSeams::Repaint(Window *window) {
+  TopLevel *topLevel = FindTopLevel(Use(window)->handle);
+  if (topLevel == nullptr) {
+    return;
+  }
+  if (topLevel->locks.empty()) {
+    ++topLevel->paints;
+  } else {
+    topLevel->needsUpdate = true;
+    ++sDeferredRepaints;
+  }
+}
+
+
+UINT WindowSeams::GetPaintCount(HWND handle) {
+  auto topLevel = sTopLevels.find(handle);
+  return topLevel != sTopLevels.end() ? topLevel->second.paints : 0;
+}
+
+
+size_t WindowSeams::GetLockCount(HWND handle) {
+  TopLevel *topLevel = FindTopLevel(handle);
+  return topLevel != nullptr ? topLevel->locks.size() : 0;
+}
+
+
+UINT WindowSeams::GetMisuseCount() {
+  return sMisuses;
+}
+
+
+void WindowSeams::Reset() {
+  sStandIns.clear();
+  sTopLevels.clear();
+  sMisuses = 0;
+}
+
+
+Window::UpdateLock::UpdateLock(Window *window)
+  : mWindow(window)
+  , mLocked(true)
+{
+  // Locks go on the top-level window.
+  TopLevel *topLevel = FindTopLevel(Use(window)->handle);
+  if (topLevel != nullptr) {
+    topLevel->locks.push_back(this);
+    mWindow = reinterpret_cast<Window*>(topLevel->window);
+  }
+}
+
+
+Window::UpdateLock::~UpdateLock() {
+  Unlock();
+}
+
+
+void Window::UpdateLock::Unlock() {
+  if (mLocked) {
+    mLocked = false;
+    TopLevel *topLevel = FindTopLevel(Use(mWindow)->handle);
+    if (topLevel != nullptr) {
+      topLevel->locks.erase(std::find(topLevel->locks.begin(), topLevel->locks.end(), this));
+      if (topLevel->locks.empty() && topLevel->needsUpdate) {
+        topLevel->needsUpdate = false;
+        ++topLevel->paints;
+      }
+    }
+  }
+}
+
+
+ULONGLONG Window::GetDeferredRepaintCount() {
+  return sDeferredRepaints;
+}
+
+
+HWND Window::GetWindowHandle() {
+  return Use(this)->handle;
+}
@@ -0,0 +1,50 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/WindowSeams.hpp
+// The nModules Project
+//
+// Stand-ins for windows, for code under test which only locks windows and asks for their handles.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/Common.h"
+
+class Window;
+
+namespace WindowSeams {
+  /// <summary>
+  /// Creates a stand-in for a window which paints to the top-level window with the specified
+  /// handle. The first one created for a handle is that top-level window.
+  /// </summary>
+  Window *Create(HWND handle);
+
+  /// <summary>
+  /// Destroys a stand-in, the way Window's destructor does. A top-level window clears the locks on
+  /// it without repainting, and leaves its children without a handle.
+  /// </summary>
+  void Destroy(Window *window);
+
+  /// <summary>
+  /// Repaints the window, or defers the repaint while its top-level window is locked.
+  /// </summary>
+  void Repaint(Window *window);
+
+  /// <summary>
+  /// Returns the number of times the top-level window with the specified handle has painted.
+  /// </summary>
+  UINT GetPaintCount(HWND handle);
+
+  /// <summary>
+  /// Returns the number of locks held on the top-level window with the specified handle.
+  /// </summary>
+  size_t GetLockCount(HWND handle);
+
+  /// <summary>
+  /// Returns the number of times a destroyed window was used.
+  /// </summary>
+  UINT GetMisuseCount();
+
+  /// <summary>
+  /// Frees every stand-in, and starts the counts over.
+  /// </summary>
+  void Reset();
+}
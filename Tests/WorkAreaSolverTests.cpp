@@ -0,0 +1,150 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/WorkAreaSolverTests.cpp
+// The nModules Project
+//
+// Tests for the workareas nDesk works out from its margins and the bars docked to each monitor.
+//-------------------------------------------------------------------------------------------------
+#include "Harness.hpp"
+
+#include "../nDesk/WorkAreaSolver.hpp"
+
+#include <vector>
+
+namespace {
+  typedef WorkAreaSolver::Rect Rect;
+  typedef WorkAreaSolver::Margins Margins;
+
+  bool Equals(const Rect &a, const Rect &b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+  }
+
+  bool Equals(const Margins &a, const Margins &b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+  }
+
+  /// <summary>
+  /// Solves the workareas of the monitors.
+  /// </summary>
+  std::vector<Rect> Solve(const std::vector<Rect> &monitors, const std::vector<Margins> &margins,
+      const std::vector<Rect> &bars) {
+    std::vector<Rect> workAreas(monitors.size());
+    WorkAreaSolver::Solve(monitors.data(), margins.data(), monitors.size(), bars.data(),
+      bars.size(), workAreas.data());
+    return workAreas;
+  }
+
+  const Margins sNoMargins = { 0, 0, 0, 0 };
+}
+
+
+TEST(WorkAreaSolverMixedMonitors) {
+  // A 4K monitor with a 1080p one to its right, lined up at the top.
+  std::vector<Rect> monitors = { { 0, 0, 3840, 2160 }, { 3840, 0, 5760, 1080 } };
+  std::vector<Margins> margins = { { 0, 0, 0, 40 }, { 0, 30, 0, 0 } };
+
+  // A taskbar along the bottom of the 4K monitor, and a narrow bar on the right of the 1080p one.
+  std::vector<Rect> bars = { { 0, 2080, 3840, 2160 }, { 5720, 0, 5760, 1080 } };
+  std::vector<Rect> workAreas = Solve(monitors, margins, bars);
+
+  // The bar beats the smaller margin on the same edge, and margins on other edges still apply.
+  CHECK(Equals(workAreas[0], Rect { 0, 0, 3840, 2080 }));
+  CHECK(Equals(workAreas[1], Rect { 3840, 30, 5720, 1080 }));
+
+  // A margin larger than the bar on its edge wins.
+  margins[0].bottom = 120;
+  workAreas = Solve(monitors, margins, bars);
+  CHECK(Equals(workAreas[0], Rect { 0, 0, 3840, 2040 }));
+}
+
+
+TEST(WorkAreaSolverNegativeOrigin) {
+  // A 1080p monitor above and to the left of the primary one.
+  std::vector<Rect> monitors = { { -1920, -300, 0, 780 }, { 0, 0, 2560, 1440 } };
+  std::vector<Margins> margins = { sNoMargins, sNoMargins };
+  std::vector<Rect> bars = { { -1920, -300, 0, -260 }, { -1920, 0, -1880, 780 } };
+  std::vector<Rect> workAreas = Solve(monitors, margins, bars);
+
+  CHECK(Equals(workAreas[0], Rect { -1880, -260, 0, 780 }));
+  CHECK(Equals(workAreas[1], monitors[1]));
+
+  CHECK(Equals(WorkAreaSolver::Reservation(monitors[0], bars[0]), Margins { 0, 40, 0, 0 }));
+  CHECK(Equals(WorkAreaSolver::Reservation(monitors[0], bars[1]), Margins { 40, 0, 0, 0 }));
+}
+
+
+TEST(WorkAreaSolverSpanningBar) {
+  // A bar stretched along the bottom of two monitors takes up the bottom of both.
+  std::vector<Rect> monitors = { { 0, 0, 1920, 1080 }, { 1920, 0, 3840, 1080 } };
+  std::vector<Margins> margins = { sNoMargins, sNoMargins };
+  std::vector<Rect> bars = { { 0, 1040, 3840, 1080 } };
+  std::vector<Rect> workAreas = Solve(monitors, margins, bars);
+  CHECK(Equals(workAreas[0], Rect { 0, 0, 1920, 1040 }));
+  CHECK(Equals(workAreas[1], Rect { 1920, 0, 3840, 1040 }));
+
+  // When the bottoms don't line up, only the monitor the bar is docked to loses its edge.
+  monitors = { { 0, 0, 3840, 2160 }, { 3840, 0, 5760, 1080 } };
+  bars = { { 0, 2120, 5760, 2160 } };
+  workAreas = Solve(monitors, margins, bars);
+  CHECK(Equals(workAreas[0], Rect { 0, 0, 3840, 2120 }));
+  CHECK(Equals(workAreas[1], monitors[1]));
+
+  // Only the part on the monitor counts, so a bar hanging off an edge reserves what is left.
+  monitors = { { 0, 0, 1920, 1080 } };
+  margins = { sNoMargins };
+  bars = { { 0, -20, 1920, 30 } };
+  workAreas = Solve(monitors, margins, bars);
+  CHECK(Equals(workAreas[0], Rect { 0, 30, 1920, 1080 }));
+}
+
+
+TEST(WorkAreaSolverFloatingBar) {
+  Rect monitor = { 0, 0, 1920, 1080 };
+
+  // A bar in the middle of the monitor, or off it, takes up nothing.
+  CHECK(Equals(WorkAreaSolver::Reservation(monitor, Rect { 500, 500, 1500, 540 }), sNoMargins));
+  CHECK(Equals(WorkAreaSolver::Reservation(monitor, Rect { 2000, 0, 2100, 1080 }), sNoMargins));
+  CHECK(Equals(WorkAreaSolver::Reservation(monitor, Rect { 0, 1080, 1920, 1120 }), sNoMargins));
+
+  // A bar no further from an edge than it is thick is docked to it, and reserves up to its far side.
+  CHECK(Equals(WorkAreaSolver::Reservation(monitor, Rect { 0, 40, 1920, 80 }), Margins { 0, 80, 0, 0 }));
+  CHECK(Equals(WorkAreaSolver::Reservation(monitor, Rect { 0, 39, 1920, 80 }), Margins { 0, 80, 0, 0 }));
+  CHECK(Equals(WorkAreaSolver::Reservation(monitor, Rect { 0, 41, 1920, 80 }), sNoMargins));
+  CHECK(Equals(WorkAreaSolver::Reservation(monitor, Rect { 1860, 0, 1890, 1080 }), Margins { 0, 0, 60, 0 }));
+
+  // Edges which would leave nothing along an axis are ignored along that axis.
+  std::vector<Rect> workAreas = Solve({ monitor }, { Margins { 1000, 0, 1000, 0 } },
+    { Rect { 0, 1000, 1920, 1080 } });
+  CHECK(Equals(workAreas[0], Rect { 0, 0, 1920, 1000 }));
+}
+
+
+TEST(WorkAreaSolverSixteenMonitors) {
+  // A 4x4 wall of 1080p monitors. Each row has a bar spanning its bottom, and the left column has
+  // a bar running down its whole height.
+  std::vector<Rect> monitors;
+  std::vector<Margins> margins;
+  std::vector<Rect> bars;
+  for (int32_t row = 0; row < 4; ++row) {
+    for (int32_t column = 0; column < 4; ++column) {
+      int32_t left = (column - 1) * 1920, top = (row - 1) * 1080;
+      monitors.push_back(Rect { left, top, left + 1920, top + 1080 });
+      margins.push_back(Margins { 0, column == 3 ? 10 : 0, 0, 0 });
+    }
+    bars.push_back(Rect { -1920, row * 1080 - 40, 3 * 1920, row * 1080 });
+  }
+  bars.push_back(Rect { -1920, -1080, -1860, 3 * 1080 });
+
+  std::vector<Rect> workAreas = Solve(monitors, margins, bars);
+  for (int32_t row = 0; row < 4; ++row) {
+    for (int32_t column = 0; column < 4; ++column) {
+      const Rect &monitor = monitors[row * 4 + column];
+      Rect expected = {
+        monitor.left + (column == 0 ? 60 : 0),
+        monitor.top + (column == 3 ? 10 : 0),
+        monitor.right,
+        monitor.bottom - 40
+      };
+      CHECK(Equals(workAreas[row * 4 + column], expected));
+    }
+  }
+}
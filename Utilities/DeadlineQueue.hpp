@@ -0,0 +1,120 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/DeadlineQueue.hpp
+// The nModules Project
+//
+// A min-heap of keys ordered by the time at which they need attention.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+#include <queue>
+#include <stddef.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Keeps track of which keys need to be revisited, and when. Each key is present at most once,
+/// with the earliest deadline it has been scheduled for. Rescheduled and cancelled keys are left
+/// in the heap and skipped when they surface.
+/// </summary>
+template <class Key, class Time = unsigned long long, class Hash = std::hash<Key>>
+class DeadlineQueue {
+private:
+  typedef std::pair<Time, Key> Entry;
+
+public:
+  /// <summary>
+  /// Schedules key to be revisited at deadline. If the key is already scheduled for an earlier
+  /// time, that time is kept.
+  /// </summary>
+  void Schedule(Key key, Time deadline) {
+    auto iter = mDeadlines.find(key);
+    if (iter != mDeadlines.end()) {
+      if (iter->second <= deadline) {
+        return;
+      }
+      iter->second = deadline;
+    } else {
+      mDeadlines.emplace(key, deadline);
+    }
+    mHeap.emplace(deadline, key);
+  }
+
+  /// <summary>
+  /// Stops tracking the specified key.
+  /// </summary>
+  void Cancel(Key key) {
+    mDeadlines.erase(key);
+    if (mDeadlines.empty()) {
+      Clear();
+    }
+  }
+
+  /// <summary>
+  /// Removes all keys.
+  /// </summary>
+  void Clear() {
+    mDeadlines.clear();
+    mHeap = decltype(mHeap)();
+  }
+
+  /// <summary>
+  /// Returns true if no keys are scheduled.
+  /// </summary>
+  bool Empty() const {
+    return mDeadlines.empty();
+  }
+
+  /// <summary>
+  /// Returns the number of scheduled keys.
+  /// </summary>
+  size_t Size() const {
+    return mDeadlines.size();
+  }
+
+  /// <summary>
+  /// Retrieves the earliest deadline. Returns false if no keys are scheduled.
+  /// </summary>
+  bool NextDeadline(Time &deadline) {
+    DropStale();
+    if (mHeap.empty()) {
+      return false;
+    }
+    deadline = mHeap.top().first;
+    return true;
+  }
+
+  /// <summary>
+  /// Removes and retrieves one key whose deadline is at or before now. Returns false if there are
+  /// no such keys.
+  /// </summary>
+  bool PopDue(Time now, Key &key) {
+    DropStale();
+    if (mHeap.empty() || mHeap.top().first > now) {
+      return false;
+    }
+    key = mHeap.top().second;
+    mHeap.pop();
+    mDeadlines.erase(key);
+    return true;
+  }
+
+private:
+  /// <summary>
+  /// Pops heap entries which no longer match the current deadline of their key.
+  /// </summary>
+  void DropStale() {
+    while (!mHeap.empty()) {
+      auto iter = mDeadlines.find(mHeap.top().second);
+      if (iter != mDeadlines.end() && iter->second == mHeap.top().first) {
+        return;
+      }
+      mHeap.pop();
+    }
+  }
+
+private:
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> mHeap;
+  std::unordered_map<Key, Time, Hash> mDeadlines;
+};
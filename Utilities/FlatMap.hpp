@@ -0,0 +1,261 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/FlatMap.hpp
+// The nModules Project
+//
+// A hash map which keeps its entries in one contiguous array.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// An open-addressing hash map. The entries are stored densely, with the hole left by an erased
+/// entry filled by moving the last one into it, so iteration is a linear walk over an array.
+/// Lookups probe a separate table of 8-byte buckets, and only touch the entry array on a likely
+/// match.
+///
+/// The interface mirrors the subset of std::unordered_map which is commonly used. Unlike
+/// std::unordered_map, inserting or erasing invalidates all iterators and references.
+/// </summary>
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+class FlatMap {
+public:
+  typedef std::pair<Key, Value> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+private:
+  /// <summary>
+  /// A slot in the probe table.
+  /// </summary>
+  struct Bucket {
+    // Index of the entry in mEntries, or sEmpty.
+    uint32_t entry;
+
+    // The upper 32 bits of the mixed hash of the entry's key.
+    uint32_t tag;
+  };
+
+  static const uint32_t sEmpty = 0xFFFFFFFF;
+  static const size_t sMinBuckets = 8;
+
+public:
+  FlatMap() : mShift(64) {}
+
+public:
+  iterator begin() {
+    return mEntries.begin();
+  }
+
+  iterator end() {
+    return mEntries.end();
+  }
+
+  const_iterator begin() const {
+    return mEntries.begin();
+  }
+
+  const_iterator end() const {
+    return mEntries.end();
+  }
+
+  size_t size() const {
+    return mEntries.size();
+  }
+
+  bool empty() const {
+    return mEntries.empty();
+  }
+
+  /// <summary>
+  /// Returns the entry with the specified key, or end().
+  /// </summary>
+  iterator find(const Key &key) {
+    size_t bucket = 0;
+    return FindBucket(key, Tag(key), bucket) ? mEntries.begin() + mBuckets[bucket].entry : mEntries.end();
+  }
+
+  /// <summary>
+  /// Returns the entry with the specified key, or end().
+  /// </summary>
+  const_iterator find(const Key &key) const {
+    size_t bucket = 0;
+    return FindBucket(key, Tag(key), bucket) ? mEntries.begin() + mBuckets[bucket].entry : mEntries.end();
+  }
+
+  /// <summary>
+  /// Returns the value for the specified key, inserting a default constructed one if the key is
+  /// not in the map.
+  /// </summary>
+  Value &operator[](const Key &key) {
+    uint32_t tag = Tag(key);
+    size_t bucket = 0;
+    if (FindBucket(key, tag, bucket)) {
+      return mEntries[mBuckets[bucket].entry].second;
+    }
+
+    // Keep the load factor at or below 1/2, so that probe sequences stay short.
+    if ((mEntries.size() + 1) * 2 > mBuckets.size()) {
+      Rehash(mBuckets.empty() ? sMinBuckets : mBuckets.size() * 2);
+      FindBucket(key, tag, bucket);
+    }
+
+    mBuckets[bucket].entry = uint32_t(mEntries.size());
+    mBuckets[bucket].tag = tag;
+    mEntries.emplace_back(key, Value());
+    return mEntries.back().second;
+  }
+
+  /// <summary>
+  /// Removes the specified entry. The last entry is moved into its place.
+  /// </summary>
+  /// <returns>An iterator to the entry which now occupies the position of the removed one.</returns>
+  iterator erase(const_iterator pos) {
+    size_t index = pos - mEntries.cbegin();
+    size_t bucket = 0;
+    FindBucket(pos->first, Tag(pos->first), bucket);
+    RemoveBucket(bucket);
+
+    size_t last = mEntries.size() - 1;
+    if (index != last) {
+      FindBucket(mEntries[last].first, Tag(mEntries[last].first), bucket);
+      mBuckets[bucket].entry = uint32_t(index);
+      mEntries[index] = std::move(mEntries[last]);
+    }
+    mEntries.pop_back();
+
+    return mEntries.begin() + index;
+  }
+
+  /// <summary>
+  /// Removes the entry with the specified key, if there is one.
+  /// </summary>
+  /// <returns>The number of entries removed.</returns>
+  size_t erase(const Key &key) {
+    const_iterator iter = find(key);
+    if (iter == end()) {
+      return 0;
+    }
+    erase(iter);
+    return 1;
+  }
+
+  /// <summary>
+  /// Removes all entries. The probe table keeps its size.
+  /// </summary>
+  void clear() {
+    mEntries.clear();
+    for (Bucket &bucket : mBuckets) {
+      bucket.entry = sEmpty;
+    }
+  }
+
+  /// <summary>
+  /// Makes room for at least count entries.
+  /// </summary>
+  void reserve(size_t count) {
+    mEntries.reserve(count);
+    size_t buckets = sMinBuckets;
+    while (buckets < count * 2) {
+      buckets *= 2;
+    }
+    if (buckets > mBuckets.size()) {
+      Rehash(buckets);
+    }
+  }
+
+private:
+  /// <summary>
+  /// Computes the tag for the specified key. The hash is mixed with a multiplicative step, since
+  /// many keys (handles, pointers) only differ in a few bits.
+  /// </summary>
+  uint32_t Tag(const Key &key) const {
+    return uint32_t((uint64_t(mHash(key)) * 0x9E3779B97F4A7C15ull) >> 32);
+  }
+
+  /// <summary>
+  /// Returns the bucket at which the probe sequence for the specified tag starts.
+  /// </summary>
+  size_t Home(uint32_t tag) const {
+    return size_t((uint64_t(tag) << 32) >> mShift);
+  }
+
+  /// <summary>
+  /// Looks for the bucket holding the specified key.
+  /// </summary>
+  /// <param name="bucket">The bucket holding the key or, if not found, the empty bucket where it
+  /// would be inserted.</param>
+  /// <returns>True if the key was found.</returns>
+  bool FindBucket(const Key &key, uint32_t tag, size_t &bucket) const {
+    if (mBuckets.empty()) {
+      return false;
+    }
+
+    size_t mask = mBuckets.size() - 1;
+    for (size_t i = Home(tag);; i = (i + 1) & mask) {
+      const Bucket &candidate = mBuckets[i];
+      if (candidate.entry == sEmpty
+          || (candidate.tag == tag && mEqual(mEntries[candidate.entry].first, key))) {
+        bucket = i;
+        return candidate.entry != sEmpty;
+      }
+    }
+  }
+
+  /// <summary>
+  /// Empties the specified bucket, shifting later buckets of the same probe run back so that no
+  /// tombstones are needed.
+  /// </summary>
+  void RemoveBucket(size_t hole) {
+    size_t mask = mBuckets.size() - 1;
+    for (size_t i = (hole + 1) & mask; mBuckets[i].entry != sEmpty; i = (i + 1) & mask) {
+      size_t home = Home(mBuckets[i].tag);
+      if (((i - home) & mask) >= ((i - hole) & mask)) {
+        mBuckets[hole] = mBuckets[i];
+        hole = i;
+      }
+    }
+    mBuckets[hole].entry = sEmpty;
+  }
+
+  /// <summary>
+  /// Rebuilds the probe table with the specified number of buckets, which must be a power of 2.
+  /// </summary>
+  void Rehash(size_t buckets) {
+    Bucket empty = { sEmpty, 0 };
+    mBuckets.assign(buckets, empty);
+
+    mShift = 64;
+    for (size_t i = buckets; i > 1; i >>= 1) {
+      --mShift;
+    }
+
+    size_t mask = buckets - 1;
+    for (size_t entry = 0; entry < mEntries.size(); ++entry) {
+      uint32_t tag = Tag(mEntries[entry].first);
+      size_t i = Home(tag);
+      while (mBuckets[i].entry != sEmpty) {
+        i = (i + 1) & mask;
+      }
+      mBuckets[i].entry = uint32_t(entry);
+      mBuckets[i].tag = tag;
+    }
+  }
+
+private:
+  // The entries, in no particular order.
+  std::vector<value_type> mEntries;
+
+  // The probe table. Its size is always 0 or a power of 2.
+  std::vector<Bucket> mBuckets;
+
+  // 64 - log2(mBuckets.size()).
+  unsigned mShift;
+
+  Hash mHash;
+  KeyEqual mEqual;
+};
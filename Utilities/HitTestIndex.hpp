@@ -0,0 +1,216 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/HitTestIndex.hpp
+// The nModules Project
+//
+// Finds which of a set of rectangles contains a point.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// Maps points to the first of a list of rectangles which contains them. Rectangles are half-open,
+/// like RECTs, so rectangles which share an edge don't overlap, and a point on that edge belongs
+/// to the one on the right, or below. Once built, the rectangles are bucketed into a uniform grid
+/// over their bounds -- a single row of cells when they all share the same vertical extent, as in
+/// a taskbar -- so a lookup only has to look at the few rectangles in one cell. Small lists are
+/// just scanned.
+///
+/// The last rectangle which was hit is tried first, which makes runs of lookups inside the same
+/// rectangle, like a mouse moving over a button, nearly free.
+/// </summary>
+template <class T>
+class HitTestIndex {
+private:
+  struct Entry {
+    float left, top, right, bottom;
+    T item;
+
+    // True if an earlier entry overlaps this one, so a hit on it can't be trusted on its own.
+    bool shadowed;
+  };
+
+  static const uint32_t sNone = 0xFFFFFFFF;
+
+  // Lists shorter than this are scanned linearly.
+  static const size_t sMinGridEntries = 8;
+
+  // The maximum number of cells along either axis.
+  static const uint32_t sMaxCells = 64;
+
+public:
+  HitTestIndex() : mColumns(0), mRows(0), mLastHit(sNone) {}
+
+public:
+  /// <summary>
+  /// Removes all rectangles.
+  /// </summary>
+  void Clear() {
+    mEntries.clear();
+    mCellStart.clear();
+    mCellEntries.clear();
+    mColumns = mRows = 0;
+    mLastHit = sNone;
+  }
+
+  /// <summary>
+  /// Adds a rectangle. Where rectangles overlap, the one added first wins. Build must be called
+  /// after the last one is added.
+  /// </summary>
+  void Add(const T &item, float left, float top, float right, float bottom) {
+    Entry entry = { left, top, right, bottom, item, false };
+    mEntries.push_back(entry);
+  }
+
+  /// <summary>
+  /// Builds the lookup grid.
+  /// </summary>
+  void Build() {
+    mCellStart.clear();
+    mCellEntries.clear();
+    mColumns = mRows = 0;
+    mLastHit = sNone;
+
+    if (mEntries.size() < sMinGridEntries) {
+      for (size_t i = 0; i < mEntries.size(); ++i) {
+        mEntries[i].shadowed = false;
+        for (size_t j = 0; j < i && !mEntries[i].shadowed; ++j) {
+          mEntries[i].shadowed = Overlaps(mEntries[i], mEntries[j]);
+        }
+      }
+      return;
+    }
+
+    bool singleRow = true;
+    mLeft = mTop = INFINITY;
+    float right = -INFINITY, bottom = -INFINITY;
+    for (const Entry &entry : mEntries) {
+      mLeft = std::min(mLeft, entry.left);
+      mTop = std::min(mTop, entry.top);
+      right = std::max(right, entry.right);
+      bottom = std::max(bottom, entry.bottom);
+      singleRow &= entry.top == mEntries[0].top && entry.bottom == mEntries[0].bottom;
+    }
+
+    float width = std::max(right - mLeft, 1.0f), height = std::max(bottom - mTop, 1.0f);
+    uint32_t count = uint32_t(mEntries.size());
+    if (singleRow) {
+      mColumns = std::min(count, sMaxCells);
+      mRows = 1;
+    } else {
+      mColumns = uint32_t(std::sqrt(count * width / height) + 0.5f);
+      mColumns = std::max(1u, std::min(mColumns, sMaxCells));
+      mRows = std::max(1u, std::min((count + mColumns - 1) / mColumns, sMaxCells));
+    }
+    mCellWidth = width / mColumns;
+    mCellHeight = height / mRows;
+
+    // Count the entries in each cell, then lay the cells out back to back. Entries go into their
+    // cells in order, so the first match in a cell is the first match overall.
+    mCellStart.assign(mColumns * mRows + 1, 0);
+    for (const Entry &entry : mEntries) {
+      ForEachCell(entry, [this] (uint32_t cell) { ++mCellStart[cell + 1]; });
+    }
+    for (size_t cell = 1; cell < mCellStart.size(); ++cell) {
+      mCellStart[cell] += mCellStart[cell - 1];
+    }
+    mCellEntries.resize(mCellStart.back());
+    std::vector<uint32_t> fill(mCellStart.begin(), mCellStart.end() - 1);
+    for (uint32_t i = 0; i < count; ++i) {
+      Entry &entry = mEntries[i];
+      entry.shadowed = false;
+      ForEachCell(entry, [this, &fill, &entry, i] (uint32_t cell) {
+        for (uint32_t j = mCellStart[cell]; j < fill[cell] && !entry.shadowed; ++j) {
+          entry.shadowed = Overlaps(entry, mEntries[mCellEntries[j]]);
+        }
+        mCellEntries[fill[cell]++] = i;
+      });
+    }
+  }
+
+  /// <summary>
+  /// Finds the first rectangle which contains the specified point.
+  /// </summary>
+  /// <returns>False if no rectangle contains the point.</returns>
+  bool Find(float x, float y, T &item) {
+    if (mLastHit != sNone && !mEntries[mLastHit].shadowed && Contains(mEntries[mLastHit], x, y)) {
+      item = mEntries[mLastHit].item;
+      return true;
+    }
+
+    uint32_t hit = sNone;
+    if (mColumns == 0) {
+      for (uint32_t i = 0; i < uint32_t(mEntries.size()); ++i) {
+        if (Contains(mEntries[i], x, y)) {
+          hit = i;
+          break;
+        }
+      }
+    } else if (x >= mLeft && y >= mTop) {
+      uint32_t column = Cell(x - mLeft, mCellWidth, mColumns);
+      uint32_t row = Cell(y - mTop, mCellHeight, mRows);
+      uint32_t cell = row * mColumns + column;
+      for (uint32_t j = mCellStart[cell]; j < mCellStart[cell + 1]; ++j) {
+        if (Contains(mEntries[mCellEntries[j]], x, y)) {
+          hit = mCellEntries[j];
+          break;
+        }
+      }
+    }
+
+    if (hit == sNone) {
+      return false;
+    }
+    mLastHit = hit;
+    item = mEntries[hit].item;
+    return true;
+  }
+
+private:
+  static bool Contains(const Entry &entry, float x, float y) {
+    return x >= entry.left && x < entry.right && y >= entry.top && y < entry.bottom;
+  }
+
+  static bool Overlaps(const Entry &a, const Entry &b) {
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+  }
+
+  static uint32_t Cell(float offset, float cellSize, uint32_t cells) {
+    return std::min(uint32_t(offset / cellSize), cells - 1);
+  }
+
+  /// <summary>
+  /// Calls func with every cell the entry covers.
+  /// </summary>
+  template <class Func>
+  void ForEachCell(const Entry &entry, Func func) {
+    uint32_t left = Cell(entry.left - mLeft, mCellWidth, mColumns);
+    uint32_t right = Cell(entry.right - mLeft, mCellWidth, mColumns);
+    uint32_t top = Cell(entry.top - mTop, mCellHeight, mRows);
+    uint32_t bottom = Cell(entry.bottom - mTop, mCellHeight, mRows);
+    for (uint32_t row = top; row <= bottom; ++row) {
+      for (uint32_t column = left; column <= right; ++column) {
+        func(row * mColumns + column);
+      }
+    }
+  }
+
+private:
+  std::vector<Entry> mEntries;
+
+  // The grid. Cell c holds the entries mCellEntries[mCellStart[c]] to mCellEntries[mCellStart[c+1]].
+  float mLeft, mTop, mCellWidth, mCellHeight;
+  uint32_t mColumns, mRows;
+  std::vector<uint32_t> mCellStart;
+  std::vector<uint32_t> mCellEntries;
+
+  // The entry found by the last successful lookup.
+  uint32_t mLastHit;
+};
+
+// std::min takes its arguments by reference, so the constants need a definition.
+template <class T> const uint32_t HitTestIndex<T>::sNone;
+template <class T> const uint32_t HitTestIndex<T>::sMaxCells;
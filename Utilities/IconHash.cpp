@@ -0,0 +1,62 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/IconHash.cpp
+// The nModules Project
+//
+// Content hashing of icons.
+//-------------------------------------------------------------------------------------------------
+#include "Common.h"
+#include "Hashing.h"
+#include "IconHash.h"
+
+#include <vector>
+
+
+/// <summary>
+/// Computes the CRC32 of the dimensions and bits of a bitmap.
+/// </summary>
+static uint32_t HashBitmap(HBITMAP bitmap) {
+  BITMAP info;
+  if (bitmap == nullptr || GetObject(bitmap, sizeof(info), &info) == 0) {
+    return 0;
+  }
+
+  struct {
+    LONG width;
+    LONG height;
+    WORD bitsPerPixel;
+  } header = { info.bmWidth, info.bmHeight, info.bmBitsPixel };
+  uint32_t hash = Hashing::Crc32(&header, sizeof(header));
+
+  LONG size = info.bmWidthBytes * info.bmHeight;
+  if (size > 0) {
+    std::vector<BYTE> bits(size);
+    LONG read = GetBitmapBits(bitmap, size, bits.data());
+    hash = Hashing::Crc32(bits.data(), read, hash);
+  }
+
+  return hash;
+}
+
+
+/// <summary>
+/// Computes a hash of the pixels of an icon.
+/// </summary>
+/// <param name="icon">The icon to hash.</param>
+uint64_t Hashing::HashIcon(HICON icon) {
+  ICONINFO iconInfo;
+  if (icon == nullptr || !GetIconInfo(icon, &iconInfo)) {
+    return 0;
+  }
+
+  uint64_t hash = uint64_t(HashBitmap(iconInfo.hbmColor)) << 32 | HashBitmap(iconInfo.hbmMask);
+
+  if (iconInfo.hbmColor != nullptr) {
+    DeleteObject(iconInfo.hbmColor);
+  }
+  if (iconInfo.hbmMask != nullptr) {
+    DeleteObject(iconInfo.hbmMask);
+  }
+
+  // Reserve 0 for "no icon".
+  return hash != 0 ? hash : 1;
+}
@@ -0,0 +1,21 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/IconHash.h
+// The nModules Project
+//
+// Content hashing of icons.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+// Declared the way Windows.h declares it with STRICT, so that this header can be included by code
+// which gets Windows.h through something other than Common.h.
+struct HICON__;
+
+namespace Hashing {
+  /// <summary>
+  /// Computes a hash of the pixels of an icon, so that identical icons can be recognized even when
+  /// they have different handles. Returns 0 for a null icon.
+  /// </summary>
+  uint64_t HashIcon(struct HICON__ *icon);
+}
@@ -0,0 +1,182 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/LineTokenizer.cpp
+// The nModules Project
+//
+// Splits configuration lines into tokens without copying them.
+//-------------------------------------------------------------------------------------------------
+#include "LineTokenizer.hpp"
+
+#include <wctype.h>
+
+
+/// <summary>
+/// True for the characters GetToken treats as whitespace.
+/// </summary>
+static bool IsSpace(WCHAR chr) {
+  return chr == L' ' || chr == L'\t' || chr == L'\r' || chr == L'\n';
+}
+
+
+/// <summary>
+/// Returns the first character at or after str which is not whitespace.
+/// </summary>
+static LPCWSTR SkipSpace(LPCWSTR str) {
+  while (IsSpace(*str)) {
+    ++str;
+  }
+  return str;
+}
+
+
+/// <summary>
+/// True if the span has no characters.
+/// </summary>
+bool StringSpan::Empty() const {
+  return length == 0;
+}
+
+
+/// <summary>
+/// True if the span is the same as str, ignoring case.
+/// </summary>
+bool StringSpan::Equals(LPCWSTR str) const {
+  return StartsWith(str) && str[length] == L'\0';
+}
+
+
+/// <summary>
+/// True if the span begins with prefix, ignoring case.
+/// </summary>
+bool StringSpan::StartsWith(LPCWSTR prefix) const {
+  for (size_t i = 0; prefix[i] != L'\0'; ++i) {
+    if (i == length || towlower(begin[i]) != towlower(prefix[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/// <summary>
+/// Copies the span into a null terminated buffer, truncating it if it doesn't fit.
+/// </summary>
+bool StringSpan::CopyTo(LPWSTR buffer, size_t cchBuffer) const {
+  if (cchBuffer == 0) {
+    return false;
+  }
+  size_t count = length < cchBuffer ? length : cchBuffer - 1;
+  wmemcpy(buffer, begin, count);
+  buffer[count] = L'\0';
+  return count == length;
+}
+
+
+/// <summary>
+/// Copies the span into a string.
+/// </summary>
+std::wstring StringSpan::ToString() const {
+  return std::wstring(begin, length);
+}
+
+
+/// <summary>
+/// Constructor
+/// </summary>
+LineTokenizer::LineTokenizer(LPCWSTR line, bool useBrackets)
+  : mLine(line)
+  , mWritableLine(nullptr)
+  , mPosition(line != nullptr ? SkipSpace(line) : nullptr)
+  , mUseBrackets(useBrackets)
+{
+}
+
+
+/// <summary>
+/// Constructor. Tokens can be null terminated in place.
+/// </summary>
+LineTokenizer::LineTokenizer(LPWSTR line, bool useBrackets)
+  : LineTokenizer((LPCWSTR)line, useBrackets)
+{
+  mWritableLine = line;
+}
+
+
+/// <summary>
+/// Reads the next token.
+/// </summary>
+bool LineTokenizer::Next(StringSpan &token) {
+  if (mPosition == nullptr || *mPosition == L'\0') {
+    mPosition = nullptr;
+    return false;
+  }
+
+  LPCWSTR current = mPosition, start = nullptr;
+  WCHAR quote = L'\0';
+  int bracketLevel = 0;
+
+  for (; *current != L'\0'; ++current) {
+    if (quote == L'\0' && IsSpace(*current)) {
+      break;
+    }
+
+    if (mUseBrackets && (*current == L'[' || *current == L']') && (quote == L'\0' || quote == L'[')) {
+      if (*current == L'[') {
+        quote = L'[';
+        if (++bracketLevel == 1 && start == nullptr) {
+          continue;
+        }
+      } else if (--bracketLevel <= 0) {
+        break;
+      }
+    } else if ((*current == L'"' || *current == L'\'') && quote != L'[') {
+      if (quote == L'\0') {
+        quote = *current;
+        if (start == nullptr) {
+          continue;
+        }
+      } else if (*current == quote) {
+        break;
+      }
+    }
+
+    if (start == nullptr) {
+      start = current;
+    }
+  }
+
+  // A token which is nothing but a pair of quotes or brackets is empty.
+  token = start != nullptr ? StringSpan(start, current - start) : StringSpan(current, 0);
+
+  // Step over whatever ended the token, and on to the next one.
+  if (*current != L'\0') {
+    ++current;
+  }
+  mPosition = SkipSpace(current);
+
+  return true;
+}
+
+
+/// <summary>
+/// Reads the next token, and null terminates it in place.
+/// </summary>
+bool LineTokenizer::NextTerminated(LPCWSTR &token) {
+  StringSpan span;
+  if (mWritableLine == nullptr || !Next(span)) {
+    return false;
+  }
+
+  // The character after the token has been stepped over, so it can be overwritten.
+  LPWSTR end = mWritableLine + (span.begin - mLine) + span.length;
+  *end = L'\0';
+  token = span.begin;
+  return true;
+}
+
+
+/// <summary>
+/// Returns the rest of the line, starting at the next token, or nullptr if there is nothing left.
+/// </summary>
+LPCWSTR LineTokenizer::Rest() const {
+  return mPosition != nullptr && *mPosition != L'\0' ? mPosition : nullptr;
+}
@@ -0,0 +1,132 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/LineTokenizer.hpp
+// The nModules Project
+//
+// Splits configuration lines into tokens without copying them.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "Common.h"
+
+#include <string>
+
+/// <summary>
+/// A run of characters in a string, which is not null terminated.
+/// </summary>
+struct StringSpan {
+  StringSpan() : begin(L""), length(0) {}
+  StringSpan(LPCWSTR begin, size_t length) : begin(begin), length(length) {}
+
+  /// <summary>
+  /// True if the span has no characters.
+  /// </summary>
+  bool Empty() const;
+
+  /// <summary>
+  /// True if the span is the same as str, ignoring case.
+  /// </summary>
+  bool Equals(LPCWSTR str) const;
+
+  /// <summary>
+  /// True if the span begins with prefix, ignoring case.
+  /// </summary>
+  bool StartsWith(LPCWSTR prefix) const;
+
+  /// <summary>
+  /// Copies the span into a null terminated buffer, truncating it if it doesn't fit.
+  /// </summary>
+  /// <returns>False if the span was truncated.</returns>
+  bool CopyTo(LPWSTR buffer, size_t cchBuffer) const;
+
+  /// <summary>
+  /// Copies the span into a string.
+  /// </summary>
+  std::wstring ToString() const;
+
+  LPCWSTR begin;
+  size_t length;
+};
+
+
+/// <summary>
+/// Reads tokens from a line the way LiteStep's GetToken does, but hands them out as spans into
+/// the line rather than copying each one into a buffer.
+///
+/// Tokens are separated by whitespace. A quote (" or ') which is not already inside a quote
+/// starts a quoted run which can contain whitespace, and which ends the token at the matching
+/// quote. The quotes around a token which starts with one are not part of it. When brackets are
+/// enabled, [ and ] work the same way, except that they nest, and quotes inside them don't count.
+/// </summary>
+class LineTokenizer {
+public:
+  explicit LineTokenizer(LPCWSTR line, bool useBrackets = false);
+  explicit LineTokenizer(LPWSTR line, bool useBrackets = false);
+
+public:
+  /// <summary>
+  /// Reads the next token. A pair of quotes or brackets with nothing between them is an empty token.
+  /// </summary>
+  /// <returns>False if there are no more tokens.</returns>
+  bool Next(StringSpan &token);
+
+  /// <summary>
+  /// Reads the next token, and null terminates it in place. Only works if the tokenizer was given
+  /// a line it can write to, and overwrites the character which ended the token.
+  /// </summary>
+  /// <returns>False if there are no more tokens.</returns>
+  bool NextTerminated(LPCWSTR &token);
+
+  /// <summary>
+  /// Returns the rest of the line, starting at the next token, or nullptr if there is nothing left.
+  /// This is what GetToken returns through its next token pointer.
+  /// </summary>
+  LPCWSTR Rest() const;
+
+private:
+  LPCWSTR mLine;
+
+  // The same line, if it can be written to.
+  LPWSTR mWritableLine;
+
+  // The start of the next token.
+  LPCWSTR mPosition;
+  bool mUseBrackets;
+};
+
+
+/// <summary>
+/// Builds an RC key out of a few parts, without going through a formatting function. Keys which
+/// don't fit are truncated, like they are by StringCchPrintf.
+/// </summary>
+template <size_t size>
+class KeyBuilder {
+public:
+  KeyBuilder() : mLength(0) {
+    mKey[0] = L'\0';
+  }
+
+  KeyBuilder(LPCWSTR prefix, LPCWSTR key) : mLength(0) {
+    mKey[0] = L'\0';
+    Append(prefix).Append(key);
+  }
+
+public:
+  /// <summary>
+  /// Adds str to the end of the key.
+  /// </summary>
+  KeyBuilder &Append(LPCWSTR str) {
+    for (; *str != L'\0' && mLength < size - 1; ++str) {
+      mKey[mLength++] = *str;
+    }
+    mKey[mLength] = L'\0';
+    return *this;
+  }
+
+  operator LPCWSTR() const {
+    return mKey;
+  }
+
+private:
+  WCHAR mKey[size];
+  size_t mLength;
+};
@@ -0,0 +1,160 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/MonitorIndex.hpp
+// The nModules Project
+//
+// Finds the monitor which contains a point, or most of a rectangle.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// Splits the virtual desktop into vertical slabs at every left and right monitor edge. Each slab
+/// lists the monitors which span it, sorted by their top edge, so that a point is found with one
+/// binary search over the edges and one over the slab. Rectangles are found by checking only the
+/// monitors in the slabs they overlap.
+///
+/// Rectangles include their left and top edges, but not their right and bottom edges. Where
+/// monitors overlap, like when a display is cloned, points are found by scanning instead, and the
+/// first monitor wins.
+/// </summary>
+class MonitorIndex {
+public:
+  struct Rect {
+    int32_t left, top, right, bottom;
+  };
+
+  static const uint32_t sNone = 0xFFFFFFFF;
+
+public:
+  MonitorIndex() : mOverlapping(false) {}
+
+public:
+  /// <summary>
+  /// Builds the index.
+  /// </summary>
+  void Build(const Rect *monitors, uint32_t count) {
+    mMonitors.assign(monitors, monitors + count);
+    mEdges.clear();
+    mSlabStart.clear();
+    mSlabMonitors.clear();
+
+    mOverlapping = false;
+    for (uint32_t i = 0; i < count && !mOverlapping; ++i) {
+      for (uint32_t j = 0; j < i && !mOverlapping; ++j) {
+        mOverlapping = Intersection(mMonitors[i], mMonitors[j]) > 0;
+      }
+    }
+
+    for (const Rect &monitor : mMonitors) {
+      mEdges.push_back(monitor.left);
+      mEdges.push_back(monitor.right);
+    }
+    std::sort(mEdges.begin(), mEdges.end());
+    mEdges.erase(std::unique(mEdges.begin(), mEdges.end()), mEdges.end());
+
+    for (size_t slab = 0; slab + 1 < mEdges.size(); ++slab) {
+      mSlabStart.push_back(uint32_t(mSlabMonitors.size()));
+      for (uint32_t i = 0; i < count; ++i) {
+        if (mMonitors[i].left <= mEdges[slab] && mMonitors[i].right >= mEdges[slab + 1]) {
+          mSlabMonitors.push_back(i);
+        }
+      }
+      std::sort(mSlabMonitors.begin() + mSlabStart.back(), mSlabMonitors.end(),
+        [this] (uint32_t a, uint32_t b) { return mMonitors[a].top < mMonitors[b].top; });
+    }
+    mSlabStart.push_back(uint32_t(mSlabMonitors.size()));
+  }
+
+  /// <summary>
+  /// Returns the monitor which contains the point, or sNone.
+  /// </summary>
+  uint32_t FromPoint(int32_t x, int32_t y) const {
+    if (mOverlapping) {
+      for (uint32_t i = 0; i < uint32_t(mMonitors.size()); ++i) {
+        if (x >= mMonitors[i].left && x < mMonitors[i].right && y >= mMonitors[i].top && y < mMonitors[i].bottom) {
+          return i;
+        }
+      }
+      return sNone;
+    }
+
+    // The slab is the one which starts at the last edge at or before x.
+    auto edge = std::upper_bound(mEdges.begin(), mEdges.end(), x);
+    if (edge == mEdges.begin() || edge == mEdges.end()) {
+      return sNone;
+    }
+    size_t slab = edge - mEdges.begin() - 1;
+
+    // Within the slab, the monitor is the last one which starts at or above y.
+    auto first = mSlabMonitors.begin() + mSlabStart[slab], last = mSlabMonitors.begin() + mSlabStart[slab + 1];
+    auto monitor = std::upper_bound(first, last, y,
+      [this] (int32_t y, uint32_t monitor) { return y < mMonitors[monitor].top; });
+    if (monitor == first || y >= mMonitors[*(monitor - 1)].bottom) {
+      return sNone;
+    }
+    return *(monitor - 1);
+  }
+
+  /// <summary>
+  /// Returns the monitor which contains the largest part of the rectangle, or sNone if it isn't on
+  /// any monitor. Ties go to the first monitor.
+  /// </summary>
+  uint32_t FromRect(const Rect &rect) const {
+    uint32_t best = sNone;
+    int64_t bestArea = 0;
+    auto consider = [&] (uint32_t monitor) {
+      int64_t area = Intersection(rect, mMonitors[monitor]);
+      if (area > bestArea || (area == bestArea && area > 0 && monitor < best)) {
+        bestArea = area;
+        best = monitor;
+      }
+    };
+
+    if (mOverlapping) {
+      for (uint32_t i = 0; i < uint32_t(mMonitors.size()); ++i) {
+        consider(i);
+      }
+      return best;
+    }
+
+    // Every slab which starts before the right edge of the rectangle, and ends after its left.
+    size_t slab = std::upper_bound(mEdges.begin(), mEdges.end(), rect.left) - mEdges.begin();
+    slab = slab == 0 ? 0 : slab - 1;
+    for (; slab + 1 < mEdges.size() && mEdges[slab] < rect.right; ++slab) {
+      auto first = mSlabMonitors.begin() + mSlabStart[slab], last = mSlabMonitors.begin() + mSlabStart[slab + 1];
+      auto monitor = std::upper_bound(first, last, rect.top,
+        [this] (int32_t y, uint32_t monitor) { return y < mMonitors[monitor].top; });
+      if (monitor != first) {
+        --monitor;
+      }
+      for (; monitor != last && mMonitors[*monitor].top < rect.bottom; ++monitor) {
+        consider(*monitor);
+      }
+    }
+
+    return best;
+  }
+
+private:
+  static int64_t Intersection(const Rect &a, const Rect &b) {
+    int64_t width = int64_t(std::min(a.right, b.right)) - std::max(a.left, b.left);
+    int64_t height = int64_t(std::min(a.bottom, b.bottom)) - std::max(a.top, b.top);
+    return width > 0 && height > 0 ? width * height : 0;
+  }
+
+private:
+  std::vector<Rect> mMonitors;
+
+  // Every distinct left and right monitor edge, in order. Slab s lies between edges s and s + 1.
+  std::vector<int32_t> mEdges;
+
+  // The monitors spanning slab s are mSlabMonitors[mSlabStart[s]] to mSlabMonitors[mSlabStart[s+1]].
+  std::vector<uint32_t> mSlabStart;
+  std::vector<uint32_t> mSlabMonitors;
+
+  // True if any monitors overlap.
+  bool mOverlapping;
+};
@@ -0,0 +1,187 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/PerfectHash.hpp
+// The nModules Project
+//
+// Maps a fixed set of strings to values without collisions.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// A read-only map from strings to values, built once from a known set of keys. Every key gets a
+/// slot of its own, so a lookup hashes the string once, reads one displacement and compares
+/// against at most one key.
+///
+/// Keys are first split into small buckets. Then, largest bucket first, each bucket gets the
+/// smallest displacement which moves all of its keys into free slots. Keys are case sensitive.
+/// </summary>
+template <class T>
+class PerfectHash {
+private:
+  struct Slot {
+    std::wstring key;
+    T value;
+    bool used;
+  };
+
+  static const uint32_t sMaxDisplacement = 1 << 16;
+
+public:
+  PerfectHash() : mBucketMask(0), mSlotMask(0) {}
+
+public:
+  /// <summary>
+  /// Removes all keys.
+  /// </summary>
+  void Clear() {
+    mDisplacements.clear();
+    mSlots.clear();
+    mBucketMask = mSlotMask = 0;
+  }
+
+  /// <summary>
+  /// Builds the map. When a key appears more than once, the last value wins.
+  /// </summary>
+  void Build(const std::vector<std::pair<std::wstring, T>> &entries) {
+    // Drop duplicates, keeping the last value.
+    std::vector<std::pair<std::wstring, T>> unique;
+    std::unordered_map<std::wstring, size_t> positions;
+    unique.reserve(entries.size());
+    for (auto &entry : entries) {
+      auto position = positions.find(entry.first);
+      if (position == positions.end()) {
+        positions[entry.first] = unique.size();
+        unique.push_back(entry);
+      } else {
+        unique[position->second].second = entry.second;
+      }
+    }
+
+    // Load the slots to at most half, so that displacements are quick to find.
+    uint32_t slots = 1;
+    while (slots < unique.size() * 2) {
+      slots *= 2;
+    }
+    while (!TryBuild(unique, slots)) {
+      slots *= 2;
+    }
+  }
+
+  /// <summary>
+  /// Finds the value of a key.
+  /// </summary>
+  /// <returns>False if the key isn't in the map.</returns>
+  bool Find(const wchar_t *key, T &value) const {
+    if (mSlots.empty()) {
+      return false;
+    }
+    uint64_t hash = Hash(key);
+    const Slot &slot = mSlots[SlotOf(hash, mDisplacements[hash & mBucketMask])];
+    if (!slot.used || slot.key != key) {
+      return false;
+    }
+    value = slot.value;
+    return true;
+  }
+
+  /// <summary>
+  /// Returns the number of keys in the map.
+  /// </summary>
+  size_t Size() const {
+    size_t size = 0;
+    for (const Slot &slot : mSlots) {
+      size += slot.used ? 1 : 0;
+    }
+    return size;
+  }
+
+private:
+  static uint64_t Hash(const wchar_t *key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *key != L'\0'; ++key) {
+      hash = (hash ^ uint64_t(*key)) * 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  uint32_t SlotOf(uint64_t hash, uint32_t displacement) const {
+    uint64_t mixed = hash ^ (displacement * 0x9E3779B97F4A7C15ULL);
+    mixed = (mixed ^ (mixed >> 31)) * 0xBF58476D1CE4E5B9ULL;
+    mixed ^= mixed >> 29;
+    return uint32_t(mixed & mSlotMask);
+  }
+
+  /// <summary>
+  /// Tries to place every entry in the specified number of slots.
+  /// </summary>
+  bool TryBuild(const std::vector<std::pair<std::wstring, T>> &entries, uint32_t slots) {
+    uint32_t buckets = std::max(1u, slots / 8);
+    mBucketMask = buckets - 1;
+    mSlotMask = slots - 1;
+    mDisplacements.assign(buckets, 0);
+    mSlots.assign(slots, Slot());
+
+    std::vector<uint64_t> hashes(entries.size());
+    std::vector<std::vector<uint32_t>> members(buckets);
+    for (uint32_t i = 0; i < uint32_t(entries.size()); ++i) {
+      hashes[i] = Hash(entries[i].first.c_str());
+      members[hashes[i] & mBucketMask].push_back(i);
+    }
+
+    std::vector<uint32_t> order(buckets);
+    for (uint32_t i = 0; i < buckets; ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&members] (uint32_t a, uint32_t b) {
+      return members[a].size() > members[b].size();
+    });
+
+    std::vector<uint32_t> placed;
+    for (uint32_t bucket : order) {
+      if (members[bucket].empty()) {
+        break;
+      }
+
+      uint32_t displacement = 0;
+      for (; displacement < sMaxDisplacement; ++displacement) {
+        placed.clear();
+        for (uint32_t member : members[bucket]) {
+          uint32_t slot = SlotOf(hashes[member], displacement);
+          if (mSlots[slot].used || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+            break;
+          }
+          placed.push_back(slot);
+        }
+        if (placed.size() == members[bucket].size()) {
+          break;
+        }
+      }
+      if (displacement == sMaxDisplacement) {
+        return false;
+      }
+
+      mDisplacements[bucket] = displacement;
+      for (size_t i = 0; i < placed.size(); ++i) {
+        Slot &slot = mSlots[placed[i]];
+        slot.key = entries[members[bucket][i]].first;
+        slot.value = entries[members[bucket][i]].second;
+        slot.used = true;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  // The displacement of each bucket.
+  std::vector<uint32_t> mDisplacements;
+  std::vector<Slot> mSlots;
+  uint32_t mBucketMask;
+  uint32_t mSlotMask;
+};
@@ -0,0 +1,135 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/RollingHistogram.hpp
+// The nModules Project
+//
+// A histogram of the most recent durations.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/// <summary>
+/// Counts the last sWindow durations, in microseconds, in power of two buckets. Bucket b holds the
+/// durations in [2^b, 2^(b+1)), except that bucket 0 also holds 0, and the last bucket holds
+/// everything too long for the others. Adding a duration once the window is full drops the
+/// oldest one, so the histogram always describes recent behavior.
+/// </summary>
+class RollingHistogram {
+public:
+  static const uint32_t sWindow = 256;
+  static const uint32_t sBuckets = 24;
+
+public:
+  RollingHistogram() {
+    Clear();
+  }
+
+public:
+  /// <summary>
+  /// Adds a duration, in microseconds.
+  /// </summary>
+  void Add(uint32_t duration) {
+    uint32_t &slot = mSamples[mTotal % sWindow];
+    if (mTotal >= sWindow) {
+      --mCounts[BucketOf(slot)];
+      mSum -= slot;
+    }
+    slot = duration;
+    ++mCounts[BucketOf(duration)];
+    mSum += duration;
+    ++mTotal;
+  }
+
+  /// <summary>
+  /// Forgets every duration.
+  /// </summary>
+  void Clear() {
+    memset(mCounts, 0, sizeof(mCounts));
+    memset(mSamples, 0, sizeof(mSamples));
+    mTotal = 0;
+    mSum = 0;
+  }
+
+  /// <summary>
+  /// Returns the number of durations in the window.
+  /// </summary>
+  uint32_t GetCount() const {
+    return mTotal < sWindow ? uint32_t(mTotal) : sWindow;
+  }
+
+  /// <summary>
+  /// Returns the number of durations ever added.
+  /// </summary>
+  uint64_t GetTotal() const {
+    return mTotal;
+  }
+
+  /// <summary>
+  /// Returns the number of durations in the window which fall in the specified bucket.
+  /// </summary>
+  uint32_t GetBucket(uint32_t bucket) const {
+    return mCounts[bucket];
+  }
+
+  /// <summary>
+  /// Returns the mean of the durations in the window.
+  /// </summary>
+  double GetMean() const {
+    uint32_t count = GetCount();
+    return count == 0 ? 0.0 : double(mSum) / count;
+  }
+
+  /// <summary>
+  /// Returns the longest duration in the window.
+  /// </summary>
+  uint32_t GetMax() const {
+    uint32_t max = 0;
+    for (uint32_t i = 0; i < GetCount(); ++i) {
+      if (mSamples[i] > max) {
+        max = mSamples[i];
+      }
+    }
+    return max;
+  }
+
+  /// <summary>
+  /// Returns an upper bound on the specified percentile of the durations in the window, the upper
+  /// edge of the bucket it falls in.
+  /// </summary>
+  uint32_t GetPercentile(double percentile) const {
+    uint32_t count = GetCount();
+    if (count == 0) {
+      return 0;
+    }
+
+    uint32_t rank = uint32_t(percentile / 100.0 * (count - 1)) + 1;
+    uint32_t seen = 0;
+    for (uint32_t bucket = 0; bucket < sBuckets - 1; ++bucket) {
+      seen += mCounts[bucket];
+      if (seen >= rank) {
+        return (2u << bucket) - 1;
+      }
+    }
+    return GetMax();
+  }
+
+private:
+  static uint32_t BucketOf(uint32_t duration) {
+    uint32_t bucket = 0;
+    while (duration > 1 && bucket < sBuckets - 1) {
+      duration >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+
+private:
+  uint32_t mCounts[sBuckets];
+
+  // The durations in the window. The next one goes in at mTotal % sWindow.
+  uint32_t mSamples[sWindow];
+
+  uint64_t mTotal;
+  uint64_t mSum;
+};
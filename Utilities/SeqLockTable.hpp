@@ -0,0 +1,314 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/SeqLockTable.hpp
+// The nModules Project
+//
+// A table with one writer and any number of lock-free readers.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// A table of records, keyed by Key, which one thread writes to and any thread may read from
+/// without taking a lock. Writes are guarded by a sequence counter, which is odd while a write is
+/// in progress. Readers copy what they need and start over if the counter moved while they did.
+///
+/// Every write bumps the version of the table, and is recorded in a log of the last LogSize
+/// changes. Readers which remember the version they last saw can catch up by reading only the
+/// changes since then, and fall back to reading the whole table when the log has moved past it.
+///
+/// The table starts out with room for InitialCapacity records, and doubles when it fills up. Full
+/// storage is copied rather than freed, and stays allocated until the table is destroyed, so a
+/// reader racing a writer only ever copies garbage, which it then throws away. Keys and records
+/// must be trivially copyable.
+/// </summary>
+template <class Key, class Record, uint32_t InitialCapacity, uint32_t LogSize>
+class SeqLockTable {
+  static_assert(std::is_trivially_copyable<Key>::value, "Keys must be trivially copyable");
+  static_assert(std::is_trivially_copyable<Record>::value, "Records must be trivially copyable");
+
+public:
+  enum class ChangeType : uint8_t {
+    Added,
+    Modified,
+    Removed
+  };
+
+  struct Entry {
+    Key key;
+    Record record;
+  };
+
+  struct Change {
+    // The version of the table once this change was made.
+    uint64_t version;
+
+    Key key;
+    ChangeType type;
+
+    // For modifications, the fields of the record which changed, as reported by the writer.
+    uint32_t fields;
+  };
+
+public:
+  SeqLockTable() : mSequence(0), mVersion(0), mCount(0) {
+    mBlocks.emplace_back(new Block(InitialCapacity));
+    mBlock.store(mBlocks.back().get(), std::memory_order_relaxed);
+  }
+
+private:
+  SeqLockTable(const SeqLockTable &);
+  SeqLockTable &operator=(const SeqLockTable &);
+
+  //
+  // Writer
+  //
+public:
+  /// <summary>
+  /// Returns the record stored for key, or nullptr. Only the writer may call this, the record
+  /// must not be modified through the pointer, and the pointer is only valid until the next write.
+  /// </summary>
+  const Record *Get(const Key &key) const {
+    auto iter = mIndex.find(key);
+    return iter == mIndex.end() ? nullptr : &Entries()[iter->second].record;
+  }
+
+  /// <summary>
+  /// Adds a record, or replaces an existing one. Replacing a record with fields set to 0 doesn't
+  /// count as a change.
+  /// </summary>
+  void Set(const Key &key, const Record &record, uint32_t fields) {
+    auto iter = mIndex.find(key);
+    if (iter == mIndex.end()) {
+      if (mCount == mBlocks.back()->capacity) {
+        Grow();
+      }
+      BeginWrite();
+      Entries()[mCount].key = key;
+      Entries()[mCount].record = record;
+      mIndex[key] = mCount;
+      ++mCount;
+      Log(key, ChangeType::Added, 0);
+      EndWrite();
+    } else if (fields != 0) {
+      BeginWrite();
+      Entries()[iter->second].record = record;
+      Log(key, ChangeType::Modified, fields);
+      EndWrite();
+    }
+  }
+
+  /// <summary>
+  /// Removes the record stored for key.
+  /// </summary>
+  /// <returns>False if there was no such record.</returns>
+  bool Remove(const Key &key) {
+    auto iter = mIndex.find(key);
+    if (iter == mIndex.end()) {
+      return false;
+    }
+
+    // Fill the hole with the last entry, so that the entries stay packed.
+    uint32_t index = iter->second;
+    mIndex.erase(iter);
+    BeginWrite();
+    Entry *entries = Entries();
+    if (index != mCount - 1) {
+      entries[index] = entries[mCount - 1];
+      mIndex[entries[index].key] = index;
+    }
+    --mCount;
+    Log(key, ChangeType::Removed, 0);
+    EndWrite();
+    return true;
+  }
+
+  /// <summary>
+  /// Returns every key in the table. Only the writer may call this.
+  /// </summary>
+  std::vector<Key> GetKeys() const {
+    std::vector<Key> keys;
+    keys.reserve(mCount);
+    for (uint32_t i = 0; i < mCount; ++i) {
+      keys.push_back(Entries()[i].key);
+    }
+    return keys;
+  }
+
+  /// <summary>
+  /// Returns the number of records the table has room for before it has to grow again.
+  /// </summary>
+  uint32_t GetCapacity() const {
+    return mBlocks.back()->capacity;
+  }
+
+  //
+  // Readers
+  //
+public:
+  /// <summary>
+  /// Returns the number of changes made to the table so far.
+  /// </summary>
+  uint64_t GetVersion() const {
+    uint64_t version;
+    Read([this, &version] () {
+      version = mVersion;
+    });
+    return version;
+  }
+
+  /// <summary>
+  /// Copies every entry in the table.
+  /// </summary>
+  /// <returns>The version of the table which was copied.</returns>
+  uint64_t ReadAll(std::vector<Entry> &entries) const {
+    uint64_t version;
+    Read([this, &entries, &version] () {
+      version = mVersion;
+      // The count may not match the block, keep the copy within bounds until the read is validated.
+      const Block *block = mBlock.load(std::memory_order_acquire);
+      entries.assign(block->entries.get(), block->entries.get() + (std::min)(mCount, block->capacity));
+    });
+    return version;
+  }
+
+  /// <summary>
+  /// Copies the record stored for key.
+  /// </summary>
+  /// <returns>False if there is no such record.</returns>
+  bool Find(const Key &key, Record &record) const {
+    bool found;
+    Read([this, &key, &record, &found] () {
+      found = false;
+      const Block *block = mBlock.load(std::memory_order_acquire);
+      uint32_t count = (std::min)(mCount, block->capacity);
+      for (uint32_t i = 0; i < count; ++i) {
+        if (block->entries[i].key == key) {
+          record = block->entries[i].record;
+          found = true;
+          break;
+        }
+      }
+    });
+    return found;
+  }
+
+  /// <summary>
+  /// Copies the changes made since the specified version, oldest first.
+  /// </summary>
+  /// <param name="version">
+  /// The version the caller last saw. Set to the version of the table the changes lead up to.
+  /// </param>
+  /// <returns>
+  /// False if some of the changes have already dropped out of the log, in which case the caller
+  /// has to read the whole table instead.
+  /// </returns>
+  bool ReadChanges(uint64_t &version, std::vector<Change> &changes) const {
+    uint64_t since = version;
+    bool complete;
+    Read([this, since, &version, &changes, &complete] () {
+      changes.clear();
+      version = mVersion;
+      complete = version - since <= LogSize;
+      if (complete) {
+        for (uint64_t v = since + 1; v <= version; ++v) {
+          changes.push_back(mLog[(v - 1) % LogSize]);
+        }
+      }
+    });
+    return complete;
+  }
+
+private:
+  /// <summary>
+  /// Storage for capacity entries.
+  /// </summary>
+  struct Block {
+    explicit Block(uint32_t capacity) : capacity(capacity), entries(new Entry[capacity]) {}
+
+    uint32_t capacity;
+    std::unique_ptr<Entry[]> entries;
+  };
+
+private:
+  /// <summary>
+  /// Returns the entries the writer works on.
+  /// </summary>
+  Entry *Entries() const {
+    return mBlocks.back()->entries.get();
+  }
+
+  /// <summary>
+  /// Moves the entries to a block twice the size. The old block is kept, since readers may still
+  /// be copying from it.
+  /// </summary>
+  void Grow() {
+    const Block &old = *mBlocks.back();
+    mBlocks.emplace_back(new Block(old.capacity * 2));
+    std::copy(old.entries.get(), old.entries.get() + mCount, mBlocks.back()->entries.get());
+
+    BeginWrite();
+    mBlock.store(mBlocks.back().get(), std::memory_order_release);
+    EndWrite();
+  }
+
+  void BeginWrite() {
+    mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void EndWrite() {
+    mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  void Log(const Key &key, ChangeType type, uint32_t fields) {
+    Change &change = mLog[mVersion % LogSize];
+    change.version = ++mVersion;
+    change.key = key;
+    change.type = type;
+    change.fields = fields;
+  }
+
+  /// <summary>
+  /// Runs copy until it completes without a write happening at the same time.
+  /// </summary>
+  template <class Copy>
+  void Read(Copy copy) const {
+    for (;;) {
+      uint32_t before = mSequence.load(std::memory_order_acquire);
+      if ((before & 1) != 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      copy();
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (mSequence.load(std::memory_order_relaxed) == before) {
+        return;
+      }
+    }
+  }
+
+private:
+  std::atomic<uint32_t> mSequence;
+  uint64_t mVersion;
+
+  // The block readers copy from. The first mCount entries are in use.
+  std::atomic<Block*> mBlock;
+  uint32_t mCount;
+
+  // Every block the table has used, the current one last. Only the writer touches this.
+  std::vector<std::unique_ptr<Block>> mBlocks;
+
+  // The last LogSize changes. Version v is stored at (v - 1) % LogSize.
+  Change mLog[LogSize];
+
+  // Maps keys to their index in the entries. Only the writer touches this.
+  std::unordered_map<Key, uint32_t> mIndex;
+};
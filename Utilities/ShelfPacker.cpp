@@ -0,0 +1,164 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/ShelfPacker.cpp
+// The nModules Project
+//
+// Packs rectangles into a fixed size area.
+//-------------------------------------------------------------------------------------------------
+#include "ShelfPacker.hpp"
+
+#include <algorithm>
+
+
+/// <summary>
+/// Constructor
+/// </summary>
+ShelfPacker::ShelfPacker(uint32_t width, uint32_t height) {
+  Reset(width, height);
+}
+
+
+/// <summary>
+/// Frees every rectangle, and changes the size of the area.
+/// </summary>
+void ShelfPacker::Reset(uint32_t width, uint32_t height) {
+  mWidth = width;
+  mHeight = height;
+  mShelves.clear();
+  mTop = 0;
+  mUsedArea = 0;
+}
+
+
+/// <summary>
+/// Finds room for a rectangle of the specified size.
+/// </summary>
+bool ShelfPacker::Allocate(uint32_t width, uint32_t height, Rect &rect) {
+  if (width == 0 || height == 0 || width > mWidth || height > mHeight) {
+    return false;
+  }
+
+  // The shortest shelf which is tall enough, without being much too tall.
+  Shelf *best = nullptr;
+  for (Shelf &shelf : mShelves) {
+    if (shelf.height >= height && shelf.height*3 <= height*4 &&
+        (best == nullptr || shelf.height < best->height) && Fits(shelf, width)) {
+      best = &shelf;
+    }
+  }
+
+  // Otherwise, open a new shelf.
+  if (best == nullptr && mHeight - mTop >= height) {
+    Shelf shelf = { mTop, height, 0, {} };
+    mShelves.push_back(shelf);
+    mTop += height;
+    best = &mShelves.back();
+  }
+
+  // As a last resort, settle for a shelf which is much too tall.
+  if (best == nullptr) {
+    for (Shelf &shelf : mShelves) {
+      if (shelf.height >= height && Fits(shelf, width)) {
+        best = &shelf;
+        break;
+      }
+    }
+  }
+
+  if (best == nullptr) {
+    return false;
+  }
+
+  // Fill holes before extending the shelf.
+  auto hole = std::find_if(best->holes.begin(), best->holes.end(),
+    [width] (const std::pair<uint32_t, uint32_t> &hole) { return hole.second >= width; });
+  if (hole != best->holes.end()) {
+    rect.x = hole->first;
+    hole->first += width;
+    hole->second -= width;
+    if (hole->second == 0) {
+      best->holes.erase(hole);
+    }
+  } else {
+    rect.x = best->end;
+    best->end += width;
+  }
+  rect.y = best->y;
+  rect.width = width;
+  rect.height = height;
+
+  mUsedArea += uint64_t(width) * height;
+  return true;
+}
+
+
+/// <summary>
+/// Gives back a rectangle returned by Allocate.
+/// </summary>
+void ShelfPacker::Free(const Rect &rect) {
+  auto shelf = std::lower_bound(mShelves.begin(), mShelves.end(), rect.y,
+    [] (const Shelf &shelf, uint32_t y) { return shelf.y < y; });
+  if (shelf == mShelves.end() || shelf->y != rect.y) {
+    return;
+  }
+  mUsedArea -= uint64_t(rect.width) * rect.height;
+
+  auto &holes = shelf->holes;
+  if (rect.x + rect.width == shelf->end) {
+    shelf->end = rect.x;
+    if (!holes.empty() && holes.back().first + holes.back().second == shelf->end) {
+      shelf->end = holes.back().first;
+      holes.pop_back();
+    }
+  } else {
+    auto next = std::lower_bound(holes.begin(), holes.end(), std::make_pair(rect.x, uint32_t(0)));
+    next = holes.insert(next, std::make_pair(rect.x, rect.width));
+    if (next + 1 != holes.end() && next->first + next->second == (next + 1)->first) {
+      next->second += (next + 1)->second;
+      holes.erase(next + 1);
+    }
+    if (next != holes.begin() && (next - 1)->first + (next - 1)->second == next->first) {
+      (next - 1)->second += next->second;
+      holes.erase(next);
+    }
+  }
+
+  // Close empty shelves at the bottom, so that their rows can be used by any height.
+  while (!mShelves.empty() && mShelves.back().end == 0) {
+    mTop = mShelves.back().y;
+    mShelves.pop_back();
+  }
+}
+
+
+uint32_t ShelfPacker::GetWidth() const {
+  return mWidth;
+}
+
+
+uint32_t ShelfPacker::GetHeight() const {
+  return mHeight;
+}
+
+
+/// <summary>
+/// Returns the total area of all allocated rectangles.
+/// </summary>
+uint64_t ShelfPacker::GetUsedArea() const {
+  return mUsedArea;
+}
+
+
+/// <summary>
+/// Returns true if there is room for a rectangle of the specified width on the shelf.
+/// </summary>
+bool ShelfPacker::Fits(const Shelf &shelf, uint32_t width) const {
+  if (mWidth - shelf.end >= width) {
+    return true;
+  }
+  for (auto &hole : shelf.holes) {
+    if (hole.second >= width) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,83 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/ShelfPacker.hpp
+// The nModules Project
+//
+// Packs rectangles into a fixed size area.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Packs rectangles into a fixed size area, in horizontal shelves. Each rectangle goes on the
+/// shortest shelf it fits on without wasting more than a quarter of the shelf's height, and a new
+/// shelf is opened below the last one when there is none. This is a good fit for icons, which
+/// mostly come in a handful of sizes.
+///
+/// Freed space is reused by later rectangles on the same shelf, and trailing shelves which become
+/// empty are closed.
+/// </summary>
+class ShelfPacker {
+public:
+  struct Rect {
+    uint32_t x, y, width, height;
+  };
+
+public:
+  ShelfPacker(uint32_t width, uint32_t height);
+
+public:
+  /// <summary>
+  /// Finds room for a rectangle of the specified size.
+  /// </summary>
+  /// <returns>False if there is no room left.</returns>
+  bool Allocate(uint32_t width, uint32_t height, Rect &rect);
+
+  /// <summary>
+  /// Gives back a rectangle returned by Allocate.
+  /// </summary>
+  void Free(const Rect &rect);
+
+  /// <summary>
+  /// Frees every rectangle, and changes the size of the area.
+  /// </summary>
+  void Reset(uint32_t width, uint32_t height);
+
+  uint32_t GetWidth() const;
+  uint32_t GetHeight() const;
+
+  /// <summary>
+  /// Returns the total area of all allocated rectangles.
+  /// </summary>
+  uint64_t GetUsedArea() const;
+
+private:
+  struct Shelf {
+    uint32_t y, height;
+
+    // Everything to the right of this is free.
+    uint32_t end;
+
+    // Freed spans to the left of end, as (x, width), sorted by x.
+    std::vector<std::pair<uint32_t, uint32_t>> holes;
+  };
+
+private:
+  /// <summary>
+  /// Returns true if there is room for a rectangle of the specified width on the shelf.
+  /// </summary>
+  bool Fits(const Shelf &shelf, uint32_t width) const;
+
+private:
+  uint32_t mWidth, mHeight;
+
+  // Sorted by y.
+  std::vector<Shelf> mShelves;
+
+  // The y of the first row below the last shelf.
+  uint32_t mTop;
+
+  uint64_t mUsedArea;
+};
@@ -0,0 +1,147 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/SlotMap.hpp
+// The nModules Project
+//
+// Owns a set of objects and hands out generation-checked handles to them.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Owns a set of objects, which are referred to through handles. A handle is an index into a
+/// slot array plus the generation of the slot at the time the object was created. Removing an
+/// object bumps the generation of its slot, so any handle which is still around simply stops
+/// resolving instead of dangling, even once the slot has been reused.
+///
+/// Objects are never moved, pointers to them remain valid until they are erased.
+/// </summary>
+template <class T>
+class SlotMap {
+public:
+  /// <summary>
+  /// Refers to an object in a SlotMap. A default constructed handle never resolves.
+  /// </summary>
+  struct Handle {
+    Handle() : index(0), generation(0) {}
+    Handle(uint32_t index, uint32_t generation) : index(index), generation(generation) {}
+
+    uint32_t index;
+    uint32_t generation;
+  };
+
+private:
+  struct Slot {
+    Slot() : generation(1) {}
+    Slot(Slot &&other) : item(std::move(other.item)), generation(other.generation) {}
+
+    std::unique_ptr<T> item;
+    uint32_t generation;
+  };
+
+public:
+  SlotMap() : mSize(0) {}
+
+private:
+  SlotMap(const SlotMap &);
+  SlotMap &operator=(const SlotMap &);
+
+public:
+  /// <summary>
+  /// Constructs a new object from the specified arguments.
+  /// </summary>
+  template <class... Args>
+  Handle Emplace(Args&&... args) {
+    uint32_t index;
+    if (mFree.empty()) {
+      index = uint32_t(mSlots.size());
+      mSlots.emplace_back();
+    } else {
+      index = mFree.back();
+      mFree.pop_back();
+    }
+
+    Slot &slot = mSlots[index];
+    slot.item.reset(new T(std::forward<Args>(args)...));
+    ++mSize;
+    return Handle(index, slot.generation);
+  }
+
+  /// <summary>
+  /// Returns the object the handle refers to, or nullptr if it has been erased.
+  /// </summary>
+  T *Get(Handle handle) const {
+    if (handle.index >= mSlots.size()) {
+      return nullptr;
+    }
+    const Slot &slot = mSlots[handle.index];
+    return slot.generation == handle.generation ? slot.item.get() : nullptr;
+  }
+
+  /// <summary>
+  /// Destroys the object the handle refers to.
+  /// </summary>
+  /// <returns>False if the handle did not resolve.</returns>
+  bool Erase(Handle handle) {
+    if (Get(handle) == nullptr) {
+      return false;
+    }
+
+    // Invalidate the slot before destroying the object, in case the destructor ends up looking
+    // the handle up again.
+    Slot &slot = mSlots[handle.index];
+    std::unique_ptr<T> item(std::move(slot.item));
+    NextGeneration(slot);
+    mFree.push_back(handle.index);
+    --mSize;
+    item.reset();
+    return true;
+  }
+
+  /// <summary>
+  /// Destroys all objects.
+  /// </summary>
+  void Clear() {
+    mFree.clear();
+    for (uint32_t i = uint32_t(mSlots.size()); i-- > 0;) {
+      Slot &slot = mSlots[i];
+      if (slot.item) {
+        std::unique_ptr<T> item(std::move(slot.item));
+        NextGeneration(slot);
+        item.reset();
+      }
+      mFree.push_back(i);
+    }
+    mSize = 0;
+  }
+
+  /// <summary>
+  /// Returns the number of live objects.
+  /// </summary>
+  size_t Size() const {
+    return mSize;
+  }
+
+private:
+  /// <summary>
+  /// Moves a slot on to its next generation. Generation 0 is reserved for default constructed
+  /// handles.
+  /// </summary>
+  static void NextGeneration(Slot &slot) {
+    if (++slot.generation == 0) {
+      slot.generation = 1;
+    }
+  }
+
+private:
+  std::vector<Slot> mSlots;
+
+  // Indices of empty slots. Clear pushes them in reverse, so that low indices are reused first.
+  std::vector<uint32_t> mFree;
+
+  // Number of live objects.
+  size_t mSize;
+};
@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/TraceBuffer.hpp
+// The nModules Project
+//
+// A ring of timed spans, recorded by a single thread.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// A span of time spent in one place in the code.
+/// </summary>
+struct TraceEvent {
+  // The id of the place the span was recorded at.
+  uint32_t site;
+
+  // The performance counter at the start and the end of the span.
+  int64_t start;
+  int64_t end;
+
+  // Passed through to the trace. Window::Paint records the window.
+  uint64_t arg;
+};
+
+/// <summary>
+/// Keeps the last Capacity spans recorded by one thread. Recording is a copy and a store, with no
+/// locks and no allocations. Once the ring is full, the oldest spans are overwritten.
+///
+/// Reading while the owning thread is recording may return a span which is being overwritten, so
+/// captures should be stopped before they are read.
+/// </summary>
+class TraceBuffer {
+public:
+  explicit TraceBuffer(uint32_t thread, uint32_t capacity)
+    : mThread(thread)
+    , mEvents(capacity)
+    , mCount(0)
+  {
+  }
+
+private:
+  TraceBuffer(const TraceBuffer &);
+  TraceBuffer &operator=(const TraceBuffer &);
+
+public:
+  /// <summary>
+  /// Records a span. Must only be called by the owning thread.
+  /// </summary>
+  void Record(uint32_t site, int64_t start, int64_t end, uint64_t arg) {
+    uint64_t count = mCount.load(std::memory_order_relaxed);
+    TraceEvent &event = mEvents[size_t(count % mEvents.size())];
+    event.site = site;
+    event.start = start;
+    event.end = end;
+    event.arg = arg;
+    mCount.store(count + 1, std::memory_order_release);
+  }
+
+  /// <summary>
+  /// Drops every recorded span.
+  /// </summary>
+  void Reset() {
+    mCount.store(0, std::memory_order_release);
+  }
+
+  /// <summary>
+  /// Drops every recorded span, and hands the buffer over to another thread. The previous owner
+  /// must have exited.
+  /// </summary>
+  void Reassign(uint32_t thread) {
+    mThread = thread;
+    Reset();
+  }
+
+  /// <summary>
+  /// Appends the spans still in the ring to events, oldest first.
+  /// </summary>
+  /// <returns>The number of spans which were overwritten before they could be read.</returns>
+  uint64_t Read(std::vector<TraceEvent> &events) const {
+    uint64_t count = mCount.load(std::memory_order_acquire);
+    uint64_t first = count > mEvents.size() ? count - mEvents.size() : 0;
+    for (uint64_t i = first; i < count; ++i) {
+      events.push_back(mEvents[size_t(i % mEvents.size())]);
+    }
+    return first;
+  }
+
+  /// <summary>
+  /// Returns the id of the owning thread.
+  /// </summary>
+  uint32_t GetThread() const {
+    return mThread;
+  }
+
+  /// <summary>
+  /// Returns the number of spans the ring holds.
+  /// </summary>
+  uint32_t GetCapacity() const {
+    return uint32_t(mEvents.size());
+  }
+
+private:
+  uint32_t mThread;
+  std::vector<TraceEvent> mEvents;
+
+  // The number of spans recorded since the last reset.
+  std::atomic<uint64_t> mCount;
+};
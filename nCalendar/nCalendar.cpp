@@ -73,6 +73,8 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
   }
   LoadSettings();
 
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 
@@ -6,16 +6,31 @@
 //-------------------------------------------------------------------------------------------------
 #include "Clock.hpp"
 
+#include <algorithm>
+#include <math.h>
+
+using std::max;
+using std::min;
+
 static const WindowSettings sClockWindowDefaults([] (WindowSettings &defaults) {
   defaults.evaluateText = true;
   defaults.registerWithCore = true;
 });
 
+// How early, in milliseconds, a timer may fire relative to a second or minute boundary and still
+// be considered to be on it.
+static const float sTimerSlack = 16.0f;
+
+// Upper bound on how long we sleep, so that we recover quickly if the system time changes.
+static const float sMaxUpdateDelay = 60000.0f;
+
 
 /// <summary>
 /// Constructor
 /// </summary>
 Clock::Clock(LPCTSTR clockName) : Drawable(clockName) {
+  mUpdateTimer = 0;
+  mMinUpdateDelay = (float)max(0, mSettings->GetInt(L"UpdateRate", 1000));
   mUse24HourDial = mSettings->GetBool(L"24HourDial", false);
 
   WindowSettings windowSettings;
@@ -24,16 +39,15 @@ Clock::Clock(LPCTSTR clockName) : Drawable(clockName) {
 
   mWindow->Initialize(windowSettings, &mStateRender);
 
-  mSecondHand.Initialize(mSettings, L"SecondHand", 60.0f);
-  mMinuteHand.Initialize(mSettings, L"MinuteHand", 60.0f);
-  mHourHand.Initialize(mSettings, L"HourHand", mUse24HourDial ? 24.0f : 12.0f);
+  mSecondHand.Initialize(mSettings, L"SecondHand", 60.0f, 1000.0f);
+  mMinuteHand.Initialize(mSettings, L"MinuteHand", 60.0f, 60000.0f);
+  mHourHand.Initialize(mSettings, L"HourHand", mUse24HourDial ? 24.0f : 12.0f, 3600000.0f);
 
   mWindow->AddPrePainter(&mHourHand);
   mWindow->AddPrePainter(&mMinuteHand);
   mWindow->AddPrePainter(&mSecondHand);
 
   UpdateHands();
-  mUpdateTimer = mWindow->SetCallbackTimer(mSettings->GetInt(L"UpdateRate", 1000), this);
 
   mWindow->Show();
 }
@@ -50,7 +64,8 @@ Clock::~Clock() {
 
 
 /// <summary>
-/// Updates the rotation of the clock hands
+/// Updates the rotation of the clock hands, repaints the area covered by the hands which moved,
+/// and schedules the next update.
 /// </summary>
 void Clock::UpdateHands() {
   SYSTEMTIME time;
@@ -60,9 +75,40 @@ void Clock::UpdateHands() {
   float minute = time.wMinute + second / 60.0f;
   float hour = time.wHour + minute / 60.0f;
 
-  mSecondHand.SetValue(second);
-  mMinuteHand.SetValue(minute);
-  mHourHand.SetValue(hour);
+  Window::UpdateLock lock(mWindow);
+  D2D1_RECT_F damage;
+  if (mSecondHand.SetValue(second, damage)) {
+    mWindow->Repaint(&damage);
+  }
+  if (mMinuteHand.SetValue(minute, damage)) {
+    mWindow->Repaint(&damage);
+  }
+  if (mHourHand.SetValue(hour, damage)) {
+    mWindow->Repaint(&damage);
+  }
+
+  ScheduleUpdate(time);
+}
+
+
+/// <summary>
+/// Replaces the update timer with one which fires when the first hand will next move at least one
+/// device pixel. UpdateRate acts as a lower bound on the delay between two moves of a hand.
+/// </summary>
+void Clock::ScheduleUpdate(const SYSTEMTIME &time) {
+  if (mUpdateTimer != 0) {
+    mWindow->ClearCallbackTimer(mUpdateTimer);
+    mUpdateTimer = 0;
+  }
+
+  float msIntoMinute = time.wSecond * 1000.0f + time.wMilliseconds;
+
+  float minDelay = max(0.0f, mMinUpdateDelay - sTimerSlack);
+  float delay = min(mSecondHand.GetNextChange(minDelay),
+    min(mMinuteHand.GetNextChange(minDelay), mHourHand.GetNextChange(minDelay)));
+  delay = ClockGeometry::UpdateDelay(delay, msIntoMinute, sTimerSlack, sMaxUpdateDelay);
+
+  mUpdateTimer = mWindow->SetCallbackTimer(UINT(ceilf(delay)) + 1, this);
 }
 
 
@@ -74,7 +120,6 @@ LRESULT WINAPI Clock::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM
   case WM_TIMER:
     if (wParam == mUpdateTimer) {
       UpdateHands();
-      mWindow->Repaint();
     }
     return 0;
 
@@ -83,7 +128,7 @@ LRESULT WINAPI Clock::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM
     return 0;
 
   case Window::WM_NEWTOPPARENT:
-    mUpdateTimer = mWindow->SetCallbackTimer(mSettings->GetInt(L"UpdateRate", 1000), this);
+    UpdateHands();
     return 0;
   }
 
@@ -25,6 +25,11 @@ public:
 public:
   void UpdateHands();
 
+private:
+  // Sets up the timer for the next time any hand will visibly move, given the time the hands were
+  // last updated for.
+  void ScheduleUpdate(const SYSTEMTIME &time);
+
   // MessageHandler
 public:
   LRESULT WINAPI HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM lParam, LPVOID) override;
@@ -33,6 +38,7 @@ private:
   StateRender<States> mStateRender;
 
   UINT_PTR mUpdateTimer;
+  float mMinUpdateDelay;
   bool mUse24HourDial;
 
   ClockHand mSecondHand;
@@ -0,0 +1,108 @@
+//-------------------------------------------------------------------------------------------------
+// /nClock/ClockGeometry.cpp
+// The nModules Project
+//
+// Hand geometry and redraw scheduling math for clocks.
+//-------------------------------------------------------------------------------------------------
+#include "ClockGeometry.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+using std::max;
+using std::min;
+
+static const float sPi = 3.14159265358979f;
+
+
+ClockGeometry::Box ClockGeometry::RotatedBounds(const Box &handRect, float degrees,
+    float centerX, float centerY) {
+  float radians = degrees * sPi / 180.0f;
+  float c = cosf(radians);
+  float s = sinf(radians);
+
+  const float xs[] = { handRect.left, handRect.right };
+  const float ys[] = { handRect.top, handRect.bottom };
+
+  Box bounds = { centerX, centerY, centerX, centerY };
+  bool first = true;
+  for (float x : xs) {
+    for (float y : ys) {
+      float rx = centerX + x * c - y * s;
+      float ry = centerY + x * s + y * c;
+      if (first) {
+        bounds.left = bounds.right = rx;
+        bounds.top = bounds.bottom = ry;
+        first = false;
+      } else {
+        bounds.left = min(bounds.left, rx);
+        bounds.right = max(bounds.right, rx);
+        bounds.top = min(bounds.top, ry);
+        bounds.bottom = max(bounds.bottom, ry);
+      }
+    }
+  }
+
+  return bounds;
+}
+
+
+ClockGeometry::Box ClockGeometry::Union(const Box &a, const Box &b) {
+  Box ret = {
+    min(a.left, b.left), min(a.top, b.top), max(a.right, b.right), max(a.bottom, b.bottom)
+  };
+  return ret;
+}
+
+
+bool ClockGeometry::PixelsDiffer(const Box &a, const Box &b, float pixelsPerDip) {
+  return floorf(a.left * pixelsPerDip) != floorf(b.left * pixelsPerDip)
+    || floorf(a.top * pixelsPerDip) != floorf(b.top * pixelsPerDip)
+    || ceilf(a.right * pixelsPerDip) != ceilf(b.right * pixelsPerDip)
+    || ceilf(a.bottom * pixelsPerDip) != ceilf(b.bottom * pixelsPerDip);
+}
+
+
+float ClockGeometry::Radius(const Box &handRect) {
+  float x = max(fabsf(handRect.left), fabsf(handRect.right));
+  float y = max(fabsf(handRect.top), fabsf(handRect.bottom));
+  return sqrtf(x * x + y * y);
+}
+
+
+float ClockGeometry::ValuePerPixel(float maxValue, float radius, float pixelsPerDip) {
+  radius *= pixelsPerDip;
+  if (radius < 1.0f) {
+    radius = 1.0f;
+  }
+  return maxValue / (2.0f * sPi * radius);
+}
+
+
+float ClockGeometry::MsUntilNextStep(float value, float step, float msPerUnit, float minDelay) {
+  float passed = floorf(value / step) * step;
+  float target = passed + max(0.0f, minDelay) / msPerUnit;
+  float next = ceilf(target / step) * step;
+  if (next <= value) {
+    next += step;
+  }
+  return (next - value) * msPerUnit;
+}
+
+
+float ClockGeometry::AlignDelay(float delay, float msIntoMinute, float tolerance) {
+  float granularity = delay >= 60000.0f ? 60000.0f : delay >= 1000.0f ? 1000.0f : 0.0f;
+  if (granularity == 0.0f) {
+    return delay;
+  }
+
+  float end = msIntoMinute + delay;
+  float aligned = ceilf((end - tolerance) / granularity) * granularity;
+  return max(delay, aligned - msIntoMinute);
+}
+
+
+float ClockGeometry::UpdateDelay(float nextChange, float msIntoMinute, float tolerance,
+    float maxDelay) {
+  return min(AlignDelay(nextChange, msIntoMinute, tolerance), maxDelay);
+}
@@ -0,0 +1,67 @@
+//-------------------------------------------------------------------------------------------------
+// /nClock/ClockGeometry.hpp
+// The nModules Project
+//
+// Hand geometry and redraw scheduling math for clocks. Deliberately free of any Windows or D2D
+// dependencies, so that it can be tested on its own.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+namespace ClockGeometry {
+  /// <summary>
+  /// An axis-aligned box.
+  /// </summary>
+  struct Box {
+    float left, top, right, bottom;
+  };
+
+  /// <summary>
+  /// Returns the axis-aligned bounding box of the hand rectangle, after it has been rotated by the
+  /// specified number of degrees around the origin and then translated to (centerX, centerY).
+  /// </summary>
+  Box RotatedBounds(const Box &handRect, float degrees, float centerX, float centerY);
+
+  /// <summary>
+  /// Returns the smallest box containing both boxes.
+  /// </summary>
+  Box Union(const Box &a, const Box &b);
+
+  /// <summary>
+  /// Returns true if the two boxes, given in DIPs, cover different device pixels.
+  /// </summary>
+  bool PixelsDiffer(const Box &a, const Box &b, float pixelsPerDip);
+
+  /// <summary>
+  /// Returns the distance from the center of rotation to the point of the hand furthest away from
+  /// it.
+  /// </summary>
+  float Radius(const Box &handRect);
+
+  /// <summary>
+  /// Returns how much the value of a hand has to change for its outermost point, radius DIPs from
+  /// the center, to move one device pixel.
+  /// </summary>
+  float ValuePerPixel(float maxValue, float radius, float pixelsPerDip);
+
+  /// <summary>
+  /// Returns the number of milliseconds until value, which increases by 1 every msPerUnit
+  /// milliseconds, reaches the next multiple of step that lies at least minDelay milliseconds
+  /// after the last multiple of step that value passed. Measuring from that multiple, rather than
+  /// from value, keeps a timer which fires slightly early from skipping a step.
+  /// </summary>
+  float MsUntilNextStep(float value, float step, float msPerUnit, float minDelay);
+
+  /// <summary>
+  /// Rounds a delay up so that it expires on a second, or for long delays a minute, boundary.
+  /// msIntoMinute is the current offset into the current minute. Delays that already end within
+  /// tolerance milliseconds of a boundary are left alone.
+  /// </summary>
+  float AlignDelay(float delay, float msIntoMinute, float tolerance);
+
+  /// <summary>
+  /// Returns how long to wait before the next redraw, given the delay until the next hand moves.
+  /// The delay is aligned by AlignDelay, and never longer than maxDelay, so that a change of the
+  /// system time is picked up quickly.
+  /// </summary>
+  float UpdateDelay(float nextChange, float msIntoMinute, float tolerance, float maxDelay);
+}
@@ -16,6 +16,10 @@ static const BrushSettings sBrushDefaults([] (BrushSettings &defaults) {
 /// </summary>
 ClockHand::ClockHand() {
   mCenterPoint = D2D1::SizeF(0, 0);
+  mRotation = 0.0f;
+  mValue = 0.0f;
+  mPixelsPerDip = 1.0f;
+  mBounds = ClockGeometry::Box();
 }
 
 
@@ -52,6 +56,13 @@ void ClockHand::DiscardDeviceResources() {
 /// (Re)Creates all D2D resources.
 /// </summary>
 HRESULT ClockHand::ReCreateDeviceResources(ID2D1RenderTarget *renderTarget) {
+  float dpiX, dpiY;
+  renderTarget->GetDpi(&dpiX, &dpiY);
+  if (dpiX / 96.0f != mPixelsPerDip) {
+    mPixelsPerDip = dpiX / 96.0f;
+    UpdateValuePerPixel();
+  }
+
   HRESULT hr = mBrush.ReCreate(renderTarget);
   if (SUCCEEDED(hr)) {
     mBrush.UpdatePosition(mHandRect, &mBrushWindowData);
@@ -68,27 +79,20 @@ void ClockHand::UpdatePosition(D2D1_RECT_F parentPosition) {
   mCenterPoint = D2D1::SizeF(
       (parentPosition.left + parentPosition.right) / 2.0f,
       (parentPosition.top + parentPosition.bottom) / 2.0f);
-}
-
-
-/// <summary>
-/// IPaintable::UpdateDWMColor
-/// Called when the DWM color has changed. Returns true if this Paintable is currently using the
-/// DWM color.
-/// </summary>
-bool ClockHand::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) {
-  return mBrush.UpdateDWMColor(newColor, renderTarget);
+  mBounds = GetBounds();
 }
 
 
 /// <summary>
 /// Initializes this clock hand.
 /// </summary>
-void ClockHand::Initialize(Settings *clockSettings, LPCTSTR prefix, float maxValue) {
+void ClockHand::Initialize(Settings *clockSettings, LPCTSTR prefix, float maxValue,
+    float msPerUnit) {
   Settings *settings = clockSettings->CreateChild(prefix);
 
   mSmoothMovement = settings->GetBool(L"SmoothMovement", false);
   mMaxValue = maxValue;
+  mMsPerUnit = msPerUnit;
 
   mBrushSettings.Load(settings, &sBrushDefaults);
   mBrush.Load(&mBrushSettings);
@@ -102,21 +106,67 @@ void ClockHand::Initialize(Settings *clockSettings, LPCTSTR prefix, float maxVal
   mHandRect.bottom = mHandRect.top + thickness;
   mHandRect.right = mHandRect.left + length;
 
+  UpdateValuePerPixel();
+
   delete settings;
 }
 
 
+/// <summary>
+/// Recomputes how much the value has to change for the tip of the hand to move one pixel.
+/// </summary>
+void ClockHand::UpdateValuePerPixel() {
+  ClockGeometry::Box handBox = { mHandRect.left, mHandRect.top, mHandRect.right, mHandRect.bottom };
+  mValuePerPixel = ClockGeometry::ValuePerPixel(mMaxValue, ClockGeometry::Radius(handBox),
+    mPixelsPerDip);
+}
+
+
 /// <summary>
 /// Sets the rotation of the clock hand.
 /// </summary>
-void ClockHand::SetValue(float value) {
+/// <param name="value">The new value of the hand.</param>
+/// <param name="damage">Set to the area covered by the hand before and after the move.</param>
+/// <returns>True if the hand moved by at least one device pixel.</returns>
+bool ClockHand::SetValue(float value, D2D1_RECT_F &damage) {
   if (value > mMaxValue) {
     value -= mMaxValue;
   }
+  mValue = value;
 
   if (!mSmoothMovement) {
     value = floorf(value);
   }
 
   mRotation = value * 360.0f / mMaxValue - 90.0f;
+
+  ClockGeometry::Box oldBounds = mBounds;
+  mBounds = GetBounds();
+  if (!ClockGeometry::PixelsDiffer(oldBounds, mBounds, mPixelsPerDip)) {
+    return false;
+  }
+
+  ClockGeometry::Box dirty = ClockGeometry::Union(oldBounds, mBounds);
+  damage = D2D1::RectF(dirty.left, dirty.top, dirty.right, dirty.bottom);
+  return true;
+}
+
+
+/// <summary>
+/// Determines when this hand will next move by at least one device pixel.
+/// </summary>
+/// <param name="minDelay">The minimum number of milliseconds between two moves.</param>
+/// <returns>The number of milliseconds until the hand should be redrawn.</returns>
+float ClockHand::GetNextChange(float minDelay) const {
+  return ClockGeometry::MsUntilNextStep(mValue, mSmoothMovement ? mValuePerPixel : 1.0f,
+    mMsPerUnit, minDelay);
+}
+
+
+/// <summary>
+/// Returns the area currently covered by the hand, in window coordinates.
+/// </summary>
+ClockGeometry::Box ClockHand::GetBounds() const {
+  ClockGeometry::Box handBox = { mHandRect.left, mHandRect.top, mHandRect.right, mHandRect.bottom };
+  return ClockGeometry::RotatedBounds(handBox, mRotation, mCenterPoint.width, mCenterPoint.height);
 }
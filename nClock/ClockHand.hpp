@@ -6,6 +6,8 @@
 //-------------------------------------------------------------------------------------------------
 #pragma once
 
+#include "ClockGeometry.hpp"
+
 #include "../nShared/Brush.hpp"
 #include "../nShared/IPainter.hpp"
 
@@ -21,11 +23,21 @@ public:
   void DiscardDeviceResources() override;
   HRESULT ReCreateDeviceResources(ID2D1RenderTarget *renderTarget) override;
   void UpdatePosition(D2D1_RECT_F parentPosition) override;
-  bool UpdateDWMColor(ARGB newColor, ID2D1RenderTarget* renderTarget) override;
 
 public:
-  void Initialize(Settings *clockSettings, LPCTSTR prefix, float maxValue);
-  void SetValue(float value);
+  void Initialize(Settings *clockSettings, LPCTSTR prefix, float maxValue, float msPerUnit);
+
+  // Sets the value of the hand. Returns true if the hand moved by at least one device pixel, in
+  // which case damage is set to the area which needs to be repainted.
+  bool SetValue(float value, D2D1_RECT_F &damage);
+
+  // Returns the number of milliseconds until the hand next moves visibly, at least minDelay after
+  // it last did.
+  float GetNextChange(float minDelay) const;
+
+private:
+  ClockGeometry::Box GetBounds() const;
+  void UpdateValuePerPixel();
 
     // User settings
 private:
@@ -35,10 +47,21 @@ private:
 private:
   float mMaxValue;
 
+  // How many milliseconds it takes for the value of this hand to increase by 1.
+  float mMsPerUnit;
+
+  // How much the value has to change for the tip of the hand to move one pixel.
+  float mValuePerPixel;
+
+  // The number of device pixels per DIP of the render target we paint to.
+  float mPixelsPerDip;
+
     // Computed member variables
 private:
   D2D1_SIZE_F mCenterPoint;
   float mRotation;
+  float mValue;
+  ClockGeometry::Box mBounds;
 
   Brush mBrush;
   BrushSettings mBrushSettings;
@@ -41,6 +41,8 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
   }
   LoadSettings();
 
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 
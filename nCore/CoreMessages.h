@@ -9,7 +9,9 @@
 // Internal nCore messages
 #define NCORE_FILE_SYSTEM_LOAD_COMPLETE             0x0500
 #define NCORE_FILE_SYSTEM_ITEM_LOAD_COMPLETE        0x0501
+#define NCORE_SHELL_STATE_FLUSH                     0x0502
 
 // nCore -> Modules
 #define NCORE_DISPLAYCHANGE                         0x9000
 #define NCORE_SETTINGCHANGE                         0x9001
+#define NCORE_WINDOWSTATECHANGE                     0x9002
@@ -11,6 +11,8 @@
 #include "CoreMessages.h"
 #include "FileSystemLoader.h"
 
+#include "../nCoreCom/Tracing.h"
+
 #include "../Utilities/Macros.h"
 
 #include <CommonControls.h>
@@ -137,6 +139,60 @@ static HRESULT LoadIconUsingExtractIcon(LoadThumbnailResponse &response, int ico
 }
 
 
+/// <summary>
+/// Hashes the size and pixels of a bitmap into the specified hash.
+/// </summary>
+static UINT64 HashBitmap(HBITMAP bitmap, UINT64 hash) {
+  BITMAP bmp;
+  if (bitmap == nullptr || GetObjectW(bitmap, sizeof(BITMAP), &bmp) == 0) {
+    return hash;
+  }
+
+  BITMAPINFO info;
+  ZeroMemory(&info, sizeof(info));
+  info.bmiHeader.biSize = sizeof(info.bmiHeader);
+  info.bmiHeader.biWidth = bmp.bmWidth;
+  info.bmiHeader.biHeight = -abs(bmp.bmHeight);
+  info.bmiHeader.biPlanes = 1;
+  info.bmiHeader.biBitCount = 32;
+  info.bmiHeader.biCompression = BI_RGB;
+
+  std::vector<UINT32> pixels(size_t(bmp.bmWidth) * abs(bmp.bmHeight));
+  HDC dc = CreateCompatibleDC(nullptr);
+  GetDIBits(dc, bitmap, 0, UINT(abs(bmp.bmHeight)), pixels.data(), &info, DIB_RGB_COLORS);
+  DeleteDC(dc);
+
+  hash = (hash ^ UINT64(bmp.bmWidth)) * 1099511628211ULL;
+  hash = (hash ^ UINT64(bmp.bmHeight)) * 1099511628211ULL;
+  for (UINT32 pixel : pixels) {
+    hash = (hash ^ pixel) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+/// <summary>
+/// Hashes the pixels of a thumbnail.
+/// </summary>
+static UINT64 HashThumbnail(const LoadThumbnailResponse &response) {
+  UINT64 hash = 14695981039346656037ULL;
+  if (response.type == LoadThumbnailResponse::Type::HBITMAP) {
+    hash = HashBitmap(response.thumbnail.bitmap, hash);
+  } else {
+    ICONINFO iconInfo;
+    if (GetIconInfo(response.thumbnail.icon, &iconInfo) != FALSE) {
+      hash = HashBitmap(iconInfo.hbmColor, hash);
+      hash = HashBitmap(iconInfo.hbmMask, hash);
+      if (iconInfo.hbmColor != nullptr) {
+        DeleteObject(iconInfo.hbmColor);
+      }
+      DeleteObject(iconInfo.hbmMask);
+    }
+  }
+  return hash;
+}
+
+
 static void LoadThumbnail(LoadThumbnailResponse &response, int iconSize, IShellFolder2 *folder, LPCITEMIDLIST *item) {
   response.size.height = (FLOAT)iconSize;
   response.size.width = (FLOAT)iconSize;
@@ -151,10 +207,12 @@ static void LoadThumbnail(LoadThumbnailResponse &response, int iconSize, IShellF
     response.thumbnail.icon = LoadIcon(nullptr, IDI_ERROR);
     response.type = LoadThumbnailResponse::Type::HICON;
   }
+  response.hash = HashThumbnail(response);
 }
 
 
 static void LoadFolderItemThread(LoadItemRequest request, UINT64 requestId, volatile bool *abort, HWND hwnd) {
+  TRACE_SPAN_ARG("FileSystemLoader::LoadFolderItem", requestId);
   CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
 
   LoadItemResponse item;
@@ -180,6 +238,7 @@ static void LoadFolderItemThread(LoadItemRequest request, UINT64 requestId, vola
 
 
 static void LoadFolderThread(LoadFolderRequest request, UINT64 requestId, volatile bool *abort, HWND hwnd) {
+  TRACE_SPAN_ARG("FileSystemLoader::LoadFolder", requestId);
   LoadFolderResponse response;
 
   CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
@@ -43,6 +43,8 @@ struct LoadThumbnailResponse {
     HICON,
     HBITMAP
   } type;
+  // A hash of the thumbnail's pixels, which tells a re-extracted thumbnail apart from the old one.
+  UINT64 hash;
 };
 
 struct LoadItemResponse {
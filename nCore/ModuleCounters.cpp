@@ -0,0 +1,65 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ModuleCounters.cpp
+// The nModules Project
+//
+// Counters which modules report to nCore on request.
+//-------------------------------------------------------------------------------------------------
+#include "ModuleCounters.h"
+
+#include "../Utilities/Common.h"
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// The registered groups, in the order they were registered.
+static std::vector<std::pair<std::wstring, COUNTERPROC>> sGroups;
+
+
+/// <summary>
+/// Registers a group of counters. The procedure is called whenever somebody reads the counters,
+/// until the group is unregistered.
+/// </summary>
+EXPORT_CDECL(void) RegisterCounters(LPCWSTR group, COUNTERPROC proc) {
+  for (auto &entry : sGroups) {
+    if (_wcsicmp(entry.first.c_str(), group) == 0) {
+      entry.second = proc;
+      return;
+    }
+  }
+  sGroups.push_back(std::make_pair(std::wstring(group), proc));
+}
+
+
+/// <summary>
+/// Unregisters a group of counters. Must be called before the module which registered it unloads.
+/// </summary>
+EXPORT_CDECL(void) UnRegisterCounters(LPCWSTR group) {
+  for (auto iter = sGroups.begin(); iter != sGroups.end(); ++iter) {
+    if (_wcsicmp(iter->first.c_str(), group) == 0) {
+      sGroups.erase(iter);
+      return;
+    }
+  }
+}
+
+
+/// <summary>
+/// Calls the specified function with the current value of every registered counter.
+/// </summary>
+void EnumCounters(const std::function<void (LPCWSTR group, LPCWSTR name, double value)> &function) {
+  struct Sink {
+    const std::function<void (LPCWSTR, LPCWSTR, double)> *function;
+    LPCWSTR group;
+  };
+
+  for (auto &entry : sGroups) {
+    Sink sink = { &function, entry.first.c_str() };
+    entry.second([] (LPVOID sink, LPCWSTR name, double value) {
+      Sink *target = (Sink*)sink;
+      (*target->function)(target->group, name, value);
+    }, &sink);
+  }
+}
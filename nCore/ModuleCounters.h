@@ -0,0 +1,19 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ModuleCounters.h
+// The nModules Project
+//
+// Counters which modules report to nCore on request.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <Windows.h>
+
+/// <summary>
+/// Receives one counter. Passed to a COUNTERPROC along with the sink it should be called with.
+/// </summary>
+typedef void (*COUNTERSINK)(LPVOID sink, LPCWSTR name, double value);
+
+/// <summary>
+/// Reports a group of counters, by calling report once for each of them.
+/// </summary>
+typedef void (*COUNTERPROC)(COUNTERSINK report, LPVOID sink);
@@ -8,8 +8,15 @@
 #include "../nShared/LiteStep.h"
 #include "../External/v8/include/v8.h"
 #include "ScriptingNCore.h"
+#include "../nShared/BangBatch.hpp"
 #include "../nShared/Window.hpp"
 #include "ScriptingHelpers.h"
+#include "StartupTimings.h"
+#include "TraceCapture.h"
+
+#include <functional>
+#include <string>
+#include <vector>
 
 
 using namespace v8;
@@ -17,6 +24,100 @@ using namespace v8;
 
 // 
 EXPORT_CDECL(Window*) FindRegisteredWindow(LPCTSTR prefix);
+const std::vector<std::pair<std::wstring, ModuleStartupTiming>> &GetModuleStartupTimings();
+void EnumCounters(const std::function<void (LPCWSTR group, LPCWSTR name, double value)> &function);
+
+extern Persistent<Context> gContext;
+
+// Looks up windows by name, taking part in any open batch.
+static BangBatch::Finder sFindWindow = BangBatch::Batched(FindRegisteredWindow);
+
+
+/// <summary>
+/// Runs a function, or an array of bang commands, as a single update. Every window touched
+/// through nCore.Window or the window bangs repaints once, when the batch is done.
+/// </summary>
+static void Batch(const FunctionCallbackInfo<Value> & args) {
+  if (args.Length() != 1) {
+    return;
+  }
+
+  Isolate *isolate = Isolate::GetCurrent();
+  HandleScope handleScope(isolate);
+  BangBatch::Scope scope;
+
+  if (args[0]->IsFunction()) {
+    args[0].As<Function>()->Call(Local<Context>::New(isolate, gContext)->Global(), 0, nullptr);
+  } else if (args[0]->IsArray()) {
+    Handle<Array> commands = args[0].As<Array>();
+    for (uint32_t i = 0; i < commands->Length(); ++i) {
+      String::Value command(commands->Get(i));
+      BangBatch::Execute(CAST(*command));
+    }
+  }
+}
+
+
+/// <summary>
+/// Returns the counters for all batches which have been run.
+/// </summary>
+static void GetBatchStats(const FunctionCallbackInfo<Value> & args) {
+  HandleScope handleScope(Isolate::GetCurrent());
+
+  const BangBatch::Stats &stats = BangBatch::GetStats();
+  Handle<Object> ret = Object::New();
+  ret->Set(String::New(CAST(L"batches")), Number::New(double(stats.batches)));
+  ret->Set(String::New(CAST(L"commands")), Number::New(double(stats.commands)));
+  ret->Set(String::New(CAST(L"repaints")), Number::New(double(stats.repaints)));
+  ret->Set(String::New(CAST(L"repaintsAvoided")), Number::New(double(stats.repaintsAvoided)));
+
+  args.GetReturnValue().Set(ret);
+}
+
+
+/// <summary>
+/// Returns how long each module took to start up, and to refresh, keyed by module name.
+/// </summary>
+static void GetStartupTimings(const FunctionCallbackInfo<Value> & args) {
+  HandleScope handleScope(Isolate::GetCurrent());
+
+  Handle<Object> ret = Object::New();
+  for (auto &entry : GetModuleStartupTimings()) {
+    const ModuleStartupTiming &timing = entry.second;
+    Handle<Object> module = Object::New();
+    module->Set(String::New(CAST(L"initialize")), Number::New(timing.initialize));
+    module->Set(String::New(CAST(L"connect")), Number::New(timing.connect));
+    module->Set(String::New(CAST(L"load")), Number::New(timing.load));
+    module->Set(String::New(CAST(L"refresh")), Number::New(timing.refresh));
+    module->Set(String::New(CAST(L"imageWait")), Number::New(timing.imageWait));
+    module->Set(String::New(CAST(L"imagesDecodedAhead")), Number::New(timing.imagesDecodedAhead));
+    module->Set(String::New(CAST(L"imagesDecodedInline")), Number::New(timing.imagesDecodedInline));
+    ret->Set(String::New(CAST(entry.first.c_str())), module);
+  }
+
+  args.GetReturnValue().Set(ret);
+}
+
+
+/// <summary>
+/// Returns the current value of every counter the modules report, keyed by group and name.
+/// </summary>
+static void GetCounters(const FunctionCallbackInfo<Value> & args) {
+  HandleScope handleScope(Isolate::GetCurrent());
+
+  Handle<Object> ret = Object::New();
+  EnumCounters([&ret] (LPCWSTR group, LPCWSTR name, double value) {
+    Handle<String> groupName = String::New(CAST(group));
+    Handle<Value> counters = ret->Get(groupName);
+    if (!counters->IsObject()) {
+      counters = Object::New();
+      ret->Set(groupName, counters);
+    }
+    counters.As<Object>()->Set(String::New(CAST(name)), Number::New(value));
+  });
+
+  args.GetReturnValue().Set(ret);
+}
 
 
 static void MoveWindow(const FunctionCallbackInfo<Value> & args) {
@@ -29,7 +130,7 @@ static void MoveWindow(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window * window = FindRegisteredWindow(CAST(*windowName));
+  Window * window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -76,7 +177,7 @@ static void SizeWindow(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window * window = FindRegisteredWindow(CAST(*windowName));
+  Window * window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -124,7 +225,7 @@ static void PositionWindow(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window * window = FindRegisteredWindow(CAST(*windowName));
+  Window * window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -173,7 +274,7 @@ static void HideWindow(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window * window = FindRegisteredWindow(CAST(*windowName));
+  Window * window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -193,7 +294,7 @@ static void ShowWindow(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window * window = FindRegisteredWindow(CAST(*windowName));
+  Window * window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -216,7 +317,7 @@ static void GetWindowX(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window * window = FindRegisteredWindow(CAST(*windowName));
+  Window * window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -236,7 +337,7 @@ static void GetWindowY(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window * window = FindRegisteredWindow(CAST(*windowName));
+  Window * window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -256,7 +357,7 @@ static void GetWindowHeight(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window *window = FindRegisteredWindow(CAST(*windowName));
+  Window *window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -276,7 +377,7 @@ static void GetWindowWidth(const FunctionCallbackInfo<Value> & args) {
     return;
   }
   String::Value windowName(args[0]);
-  Window *window = FindRegisteredWindow(CAST(*windowName));
+  Window *window = sFindWindow(CAST(*windowName));
 
   if (window == nullptr) {
     return;
@@ -286,6 +387,112 @@ static void GetWindowWidth(const FunctionCallbackInfo<Value> & args) {
 }
 
 
+/// <summary>
+/// Returns how long the most recent frames of a window took to paint, in microseconds.
+/// </summary>
+static void GetWindowFrameTimes(const FunctionCallbackInfo<Value> & args) {
+  if (args.Length() != 1 || !args[0]->IsString()) {
+    return;
+  }
+
+  HandleScope handleScope(Isolate::GetCurrent());
+
+  String::Value windowName(args[0]);
+  Window *window = sFindWindow(CAST(*windowName));
+
+  if (window == nullptr) {
+    return;
+  }
+
+  const RollingHistogram &frameTimes = window->GetFrameTimes();
+  Handle<Object> ret = Object::New();
+  ret->Set(String::New(CAST(L"frames")), Number::New(frameTimes.GetCount()));
+  ret->Set(String::New(CAST(L"mean")), Number::New(frameTimes.GetMean()));
+  ret->Set(String::New(CAST(L"p50")), Number::New(frameTimes.GetPercentile(50)));
+  ret->Set(String::New(CAST(L"p95")), Number::New(frameTimes.GetPercentile(95)));
+  ret->Set(String::New(CAST(L"p99")), Number::New(frameTimes.GetPercentile(99)));
+  ret->Set(String::New(CAST(L"max")), Number::New(frameTimes.GetMax()));
+
+  args.GetReturnValue().Set(ret);
+}
+
+
+/// <summary>
+/// Returns how many messages a window has handled, and how many it handles per second.
+/// </summary>
+static void GetWindowMessageRate(const FunctionCallbackInfo<Value> & args) {
+  if (args.Length() != 1 || !args[0]->IsString()) {
+    return;
+  }
+
+  HandleScope handleScope(Isolate::GetCurrent());
+
+  String::Value windowName(args[0]);
+  Window *window = sFindWindow(CAST(*windowName));
+
+  if (window == nullptr) {
+    return;
+  }
+
+  Handle<Object> ret = Object::New();
+  ret->Set(String::New(CAST(L"messages")), Number::New(double(window->GetMessageCount())));
+  ret->Set(String::New(CAST(L"perSecond")), Number::New(window->GetMessageRate()));
+
+  args.GetReturnValue().Set(ret);
+}
+
+
+static void StartTrace(const FunctionCallbackInfo<Value> &) {
+  TraceCapture::Start();
+}
+
+
+static void StopTrace(const FunctionCallbackInfo<Value> &) {
+  TraceCapture::Stop();
+}
+
+
+static void IsTraceCapturing(const FunctionCallbackInfo<Value> & args) {
+  args.GetReturnValue().Set(TraceCapture::IsCapturing());
+}
+
+
+/// <summary>
+/// Writes the capture to the specified file, or to %TEMP%\nCoreTrace.json. Returns true if it
+/// was written.
+/// </summary>
+static void DumpTrace(const FunctionCallbackInfo<Value> & args) {
+  HRESULT hr;
+  if (args.Length() == 1 && args[0]->IsString()) {
+    String::Value path(args[0]);
+    hr = TraceCapture::Dump(CAST(*path));
+  } else {
+    hr = TraceCapture::Dump(nullptr);
+  }
+  args.GetReturnValue().Set(SUCCEEDED(hr));
+}
+
+
+/// <summary>
+/// Returns the cost of a single span, in nanoseconds, with and without a capture running.
+/// Returns nothing while a capture is running.
+/// </summary>
+static void MeasureTraceOverhead(const FunctionCallbackInfo<Value> & args) {
+  HandleScope handleScope(Isolate::GetCurrent());
+
+  TraceCapture::Overhead overhead;
+  if (!TraceCapture::MeasureOverhead(overhead)) {
+    return;
+  }
+
+  Handle<Object> ret = Object::New();
+  ret->Set(String::New(CAST(L"idle")), Number::New(overhead.idle));
+  ret->Set(String::New(CAST(L"capturing")), Number::New(overhead.capturing));
+
+  args.GetReturnValue().Set(ret);
+}
+
+
 /// <summary>
 /// Creates the LiteStep object.
 /// </summary>
@@ -293,6 +500,10 @@ Handle<ObjectTemplate> Scripting::NCore::Initialize(Isolate *isolate) {
   HandleScope handleScope(isolate);
 
   Handle<ObjectTemplate> nCore = ObjectTemplate::New();
+  nCore->Set(String::New(CAST(L"Batch")), FunctionTemplate::New(Batch), PropertyAttribute::ReadOnly);
+  nCore->Set(String::New(CAST(L"GetBatchStats")), FunctionTemplate::New(GetBatchStats), PropertyAttribute::ReadOnly);
+  nCore->Set(String::New(CAST(L"GetStartupTimings")), FunctionTemplate::New(GetStartupTimings), PropertyAttribute::ReadOnly);
+  nCore->Set(String::New(CAST(L"GetCounters")), FunctionTemplate::New(GetCounters), PropertyAttribute::ReadOnly);
 
   Handle<ObjectTemplate> window = ObjectTemplate::New();
   nCore->Set(String::New(CAST(L"Window")), window, PropertyAttribute::ReadOnly);
@@ -305,6 +516,16 @@ Handle<ObjectTemplate> Scripting::NCore::Initialize(Isolate *isolate) {
   window->Set(String::New(CAST(L"GetY")), FunctionTemplate::New(GetWindowY), PropertyAttribute::ReadOnly);
   window->Set(String::New(CAST(L"GetHeight")), FunctionTemplate::New(GetWindowHeight), PropertyAttribute::ReadOnly);
   window->Set(String::New(CAST(L"GetWidth")), FunctionTemplate::New(GetWindowWidth), PropertyAttribute::ReadOnly);
+  window->Set(String::New(CAST(L"GetFrameTimes")), FunctionTemplate::New(GetWindowFrameTimes), PropertyAttribute::ReadOnly);
+  window->Set(String::New(CAST(L"GetMessageRate")), FunctionTemplate::New(GetWindowMessageRate), PropertyAttribute::ReadOnly);
+
+  Handle<ObjectTemplate> trace = ObjectTemplate::New();
+  nCore->Set(String::New(CAST(L"Trace")), trace, PropertyAttribute::ReadOnly);
+  trace->Set(String::New(CAST(L"Start")), FunctionTemplate::New(StartTrace), PropertyAttribute::ReadOnly);
+  trace->Set(String::New(CAST(L"Stop")), FunctionTemplate::New(StopTrace), PropertyAttribute::ReadOnly);
+  trace->Set(String::New(CAST(L"IsCapturing")), FunctionTemplate::New(IsTraceCapturing), PropertyAttribute::ReadOnly);
+  trace->Set(String::New(CAST(L"Dump")), FunctionTemplate::New(DumpTrace), PropertyAttribute::ReadOnly);
+  trace->Set(String::New(CAST(L"MeasureOverhead")), FunctionTemplate::New(MeasureTraceOverhead), PropertyAttribute::ReadOnly);
 
   return handleScope.Close(nCore);
 }
@@ -0,0 +1,331 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ShellState.cpp
+// The nModules Project
+//
+// The state of the taskbar windows, shared by all modules.
+//-------------------------------------------------------------------------------------------------
+#include "CoreMessages.h"
+#include "ShellState.h"
+
+#include "../nShared/LiteStep.h"
+#include "../nShared/MonitorInfo.hpp"
+
+#include "../Utilities/Common.h"
+
+#include <mutex>
+#include <string>
+#include <strsafe.h>
+#include <unordered_map>
+#include <vector>
+
+extern MonitorInfo gMonitorInfo;
+extern void SendCoreMessage(UINT message, WPARAM, LPARAM);
+
+// The shell hook messages which affect the windows.
+static const UINT sShellMessages[] = { LM_WINDOWCREATED, LM_WINDOWACTIVATED, LM_WINDOWDESTROYED,
+  LM_REDRAW, LM_WINDOWREPLACED, LM_WINDOWREPLACING, LM_MONITORCHANGED, 0 };
+
+// Why a window has to be looked at again.
+static const UINT sRefresh = 0x1;
+static const UINT sActivated = 0x2;
+static const UINT sFlashed = 0x4;
+static const UINT sRemoved = 0x8;
+
+static WindowStateTable sWindows;
+
+// nCore's message window.
+static HWND sMessageWindow = nullptr;
+
+// The window which was activated last, if it is still active.
+static HWND sActiveWindow = nullptr;
+
+// The activation counter of the most recently activated window.
+static UINT64 sActivation = 0;
+
+// Windows which have been touched by a shell event since the last flush.
+static std::unordered_map<HWND, UINT> sPending;
+
+// The whole titles of the windows whose titles don't fit in their records.
+static std::unordered_map<HWND, std::wstring> sLongTitles;
+static std::mutex sLongTitlesLock;
+
+
+/// <summary>
+/// Determines if a window should be shown on the taskbar.
+/// </summary>
+static bool IsTaskbarWindow(HWND window) {
+  if (!IsWindow(window) || !IsWindowVisible(window)) {
+    return false;
+  }
+
+  LONG_PTR exStyle = GetWindowLongPtrW(window, GWL_EXSTYLE);
+
+  // Windows with the WS_EX_APPWINDOW style should always be shown. Otherwise windows with
+  // parents, windows with owners, and tool windows shouldn't be.
+  if ((exStyle & WS_EX_APPWINDOW) == WS_EX_APPWINDOW) {
+    return true;
+  }
+  return GetParent(window) == nullptr && GetWindow(window, GW_OWNER) == nullptr &&
+    (exStyle & WS_EX_TOOLWINDOW) != WS_EX_TOOLWINDOW;
+}
+
+
+/// <summary>
+/// Returns the whole title of a window, as stored. Only the writer may call this.
+/// </summary>
+static LPCWSTR GetStoredTitle(HWND window, const WindowState &state) {
+  if ((state.flags & WindowState::LongTitle) != 0) {
+    auto iter = sLongTitles.find(window);
+    if (iter != sLongTitles.end()) {
+      return iter->second.c_str();
+    }
+  }
+  return state.title;
+}
+
+
+/// <summary>
+/// Stores the title of a window, keeping it aside if it doesn't fit in the record.
+/// </summary>
+static void SetStoredTitle(HWND window, WindowState &state, LPCWSTR title) {
+  StringCchCopyW(state.title, _countof(state.title), title);
+  bool longTitle = wcslen(title) >= _countof(state.title);
+
+  std::lock_guard<std::mutex> lock(sLongTitlesLock);
+  if (longTitle) {
+    state.flags |= WindowState::LongTitle;
+    sLongTitles[window] = title;
+  } else {
+    sLongTitles.erase(window);
+  }
+}
+
+
+/// <summary>
+/// Removes a window from the table.
+/// </summary>
+static void RemoveWindowState(HWND window) {
+  if (sWindows.Remove(window)) {
+    std::lock_guard<std::mutex> lock(sLongTitlesLock);
+    sLongTitles.erase(window);
+  }
+}
+
+
+/// <summary>
+/// Brings the stored state of a window up to date.
+/// </summary>
+static void UpdateWindowState(HWND window, UINT reasons) {
+  if ((reasons & sRemoved) != 0 || !IsTaskbarWindow(window)) {
+    RemoveWindowState(window);
+    return;
+  }
+
+  WindowState state;
+  const WindowState *old = sWindows.Get(window);
+  if (old != nullptr) {
+    state = *old;
+  } else {
+    ZeroMemory(&state, sizeof(state));
+  }
+
+  WCHAR title[MAX_LINE_LENGTH];
+  GetWindowTextW(window, title, _countof(title));
+  bool titleChanged = old == nullptr || wcscmp(GetStoredTitle(window, *old), title) != 0;
+
+  state.monitor = gMonitorInfo.MonitorFromHWND(window);
+
+  state.flags = IsIconic(window) ? WindowState::Minimized : 0;
+  if (window == sActiveWindow) {
+    state.flags |= WindowState::Active;
+  } else if ((reasons & sFlashed) != 0 || old != nullptr &&
+      (old->flags & WindowState::Flashing) != 0) {
+    state.flags |= WindowState::Flashing;
+  }
+
+  if ((reasons & sActivated) != 0) {
+    state.activation = ++sActivation;
+  }
+
+  if (titleChanged) {
+    SetStoredTitle(window, state, title);
+  } else if (old != nullptr) {
+    state.flags |= old->flags & WindowState::LongTitle;
+  }
+
+  UINT fields = 0;
+  if (old != nullptr) {
+    if (titleChanged) {
+      fields |= WindowState::TitleChanged;
+    }
+    if (old->monitor != state.monitor) {
+      fields |= WindowState::MonitorChanged;
+    }
+    if (old->flags != state.flags) {
+      fields |= WindowState::FlagsChanged;
+    }
+    if (old->activation != state.activation) {
+      fields |= WindowState::ActivationChanged;
+    }
+  }
+
+  sWindows.Set(window, state, fields);
+}
+
+
+/// <summary>
+/// Marks a window as needing to be looked at during the next flush.
+/// </summary>
+static void QueueWindow(HWND window, UINT reasons) {
+  if (window == nullptr) {
+    return;
+  }
+  if (sPending.empty()) {
+    PostMessage(sMessageWindow, NCORE_SHELL_STATE_FLUSH, 0, 0);
+  }
+  sPending[window] |= reasons;
+}
+
+
+/// <summary>
+/// Brings every window touched since the last flush up to date, then lets the modules know.
+/// </summary>
+static void FlushWindowState() {
+  if (sPending.empty()) {
+    return;
+  }
+
+  std::unordered_map<HWND, UINT> pending;
+  pending.swap(sPending);
+
+  UINT64 version = sWindows.GetVersion();
+  for (auto &window : pending) {
+    UpdateWindowState(window.first, window.second);
+  }
+  if (sWindows.GetVersion() != version) {
+    SendCoreMessage(NCORE_WINDOWSTATECHANGE, 0, 0);
+  }
+}
+
+
+/// <summary>
+/// Fills the table with the windows which already exist, and starts listening for shell events.
+/// </summary>
+void StartShellState(HWND messageWindow) {
+  sMessageWindow = messageWindow;
+
+  std::vector<HWND> windows;
+  EnumWindows((WNDENUMPROC)[] (HWND window, LPARAM windows) -> BOOL {
+    if (IsTaskbarWindow(window)) {
+      ((std::vector<HWND>*)windows)->push_back(window);
+    }
+    return TRUE;
+  }, (LPARAM)&windows);
+
+  // EnumWindows goes from the top of the Z order, activate the bottom window first.
+  sActiveWindow = GetForegroundWindow();
+  for (auto window = windows.rbegin(); window != windows.rend(); ++window) {
+    UpdateWindowState(*window, sActivated);
+  }
+
+  SendMessage(LiteStep::GetLitestepWnd(), LM_REGISTERMESSAGE, (WPARAM)messageWindow,
+    (LPARAM)sShellMessages);
+}
+
+
+/// <summary>
+/// Stops listening for shell events, and empties the table.
+/// </summary>
+void StopShellState() {
+  SendMessage(LiteStep::GetLitestepWnd(), LM_UNREGISTERMESSAGE, (WPARAM)sMessageWindow,
+    (LPARAM)sShellMessages);
+  sPending.clear();
+  for (HWND window : sWindows.GetKeys()) {
+    RemoveWindowState(window);
+  }
+  sActiveWindow = nullptr;
+  sMessageWindow = nullptr;
+}
+
+
+/// <summary>
+/// Rechecks which monitor each window is on, after the display layout changed.
+/// </summary>
+void ShellStateDisplayChanged() {
+  for (HWND window : sWindows.GetKeys()) {
+    QueueWindow(window, sRefresh);
+  }
+}
+
+
+/// <summary>
+/// Handles the shell hook messages registered for by StartShellState.
+/// </summary>
+LRESULT HandleShellStateMessage(UINT message, WPARAM wParam, LPARAM lParam) {
+  switch (message) {
+  case LM_WINDOWCREATED:
+  case LM_MONITORCHANGED:
+    QueueWindow((HWND)wParam, sRefresh);
+    break;
+
+  case LM_WINDOWDESTROYED:
+  case LM_WINDOWREPLACING:
+    QueueWindow((HWND)wParam, sRemoved);
+    break;
+
+  case LM_WINDOWREPLACED:
+    QueueWindow((HWND)lParam, sRefresh);
+    break;
+
+  case LM_WINDOWACTIVATED:
+    // Windows are frequently deactivated because they are being minimized.
+    QueueWindow(sActiveWindow, sRefresh);
+    sActiveWindow = (HWND)wParam;
+    QueueWindow(sActiveWindow, sActivated);
+    break;
+
+  case LM_REDRAW:
+    QueueWindow((HWND)wParam, lParam == HSHELL_HIGHBIT ? sRefresh | sFlashed : sRefresh);
+    break;
+
+  case NCORE_SHELL_STATE_FLUSH:
+    FlushWindowState();
+    break;
+  }
+  return 0;
+}
+
+
+/// <summary>
+/// Returns the state of the taskbar windows.
+/// </summary>
+EXPORT_CDECL(const WindowStateTable&) FetchWindowState() {
+  return sWindows;
+}
+
+
+/// <summary>
+/// Copies the whole title of a taskbar window, however long it is.
+/// </summary>
+/// <returns>False if the window isn't in the table.</returns>
+EXPORT_CDECL(bool) FetchWindowTitle(HWND window, LPWSTR title, UINT cchTitle) {
+  WindowState state;
+  if (!sWindows.Find(window, state)) {
+    return false;
+  }
+
+  if ((state.flags & WindowState::LongTitle) != 0) {
+    std::lock_guard<std::mutex> lock(sLongTitlesLock);
+    auto iter = sLongTitles.find(window);
+    if (iter != sLongTitles.end()) {
+      StringCchCopyW(title, cchTitle, iter->second.c_str());
+      return true;
+    }
+
+    // The title was shortened after the record was copied, and a change notification is on its
+    // way. The start of the old one will do until then.
+  }
+
+  StringCchCopyW(title, cchTitle, state.title);
+  return true;
+}
@@ -0,0 +1,46 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ShellState.h
+// The nModules Project
+//
+// The state of the taskbar windows, shared by all modules.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../nShared/LiteStep.h"
+
+#include "../Utilities/Common.h"
+#include "../Utilities/SeqLockTable.hpp"
+
+/// <summary>
+/// A top-level window which belongs on the taskbar, as nCore last saw it.
+/// </summary>
+struct WindowState {
+  // Bits of flags.
+  static const UINT Active = 0x1;
+  static const UINT Minimized = 0x2;
+  static const UINT Flashing = 0x4;
+
+  // The title didn't fit. FetchWindowTitle has the whole of it.
+  static const UINT LongTitle = 0x8;
+
+  // Bits of the fields of a change.
+  static const UINT TitleChanged = 0x1;
+  static const UINT MonitorChanged = 0x2;
+  static const UINT FlagsChanged = 0x4;
+  static const UINT ActivationChanged = 0x8;
+
+  // The monitor the window is on.
+  UINT monitor;
+
+  UINT flags;
+
+  // Goes up every time a window is activated. Windows which were open before nCore was loaded
+  // start out in Z order. Sorting by this, highest first, gives the alt-tab order.
+  UINT64 activation;
+
+  // The start of the title. Long enough for nearly every window, while keeping the records small
+  // enough that copying the whole table is cheap.
+  WCHAR title[256];
+};
+
+typedef SeqLockTable<HWND, WindowState, 64, 512> WindowStateTable;
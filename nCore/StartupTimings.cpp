@@ -0,0 +1,39 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/StartupTimings.cpp
+// The nModules Project
+//
+// How long each module took to start up.
+//-------------------------------------------------------------------------------------------------
+#include "StartupTimings.h"
+
+#include "../Utilities/Common.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// The last timing reported by each module, in the order the modules first reported.
+static std::vector<std::pair<std::wstring, ModuleStartupTiming>> sTimings;
+
+
+/// <summary>
+/// Records the startup timing of a module, replacing any earlier report from it.
+/// </summary>
+EXPORT_CDECL(void) ReportModuleStartup(LPCWSTR module, const ModuleStartupTiming &timing) {
+  for (auto &entry : sTimings) {
+    if (_wcsicmp(entry.first.c_str(), module) == 0) {
+      entry.second = timing;
+      return;
+    }
+  }
+  sTimings.push_back(std::make_pair(std::wstring(module), timing));
+}
+
+
+/// <summary>
+/// Returns the last timing reported by each module.
+/// </summary>
+const std::vector<std::pair<std::wstring, ModuleStartupTiming>> &GetModuleStartupTimings() {
+  return sTimings;
+}
@@ -0,0 +1,34 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/StartupTimings.h
+// The nModules Project
+//
+// How long each module took to start up.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <Windows.h>
+
+/// <summary>
+/// The time a module spent in each stage of starting up, reported to nCore once the module has
+/// finished loading, and again every time it is refreshed. All times are in milliseconds.
+/// </summary>
+struct ModuleStartupTiming {
+  // Registering window classes and creating the message window.
+  float initialize;
+
+  // Connecting to nCore.
+  float connect;
+
+  // Reading settings and creating windows, up until initModule returned.
+  float load;
+
+  // The last refresh, or 0 if the module hasn't been refreshed.
+  float refresh;
+
+  // Of the load, or the last refresh, the time spent waiting for images to finish decoding.
+  float imageWait;
+
+  // Images decoded on the thread pool, and on the module's thread.
+  UINT imagesDecodedAhead;
+  UINT imagesDecodedInline;
+};
@@ -0,0 +1,413 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/TraceCapture.cpp
+// The nModules Project
+//
+// Collects the spans recorded by all modules, and writes them out as a Chrome trace.
+//-------------------------------------------------------------------------------------------------
+#include "TraceCapture.h"
+
+#include "../nCoreCom/Tracing.h"
+
+#include "../nShared/ErrorHandler.h"
+#include "../nShared/LiteStep.h"
+#include "../nShared/Window.hpp"
+
+#include "../Utilities/RollingHistogram.hpp"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdarg.h>
+#include <string>
+#include <strsafe.h>
+#include <unordered_map>
+#include <vector>
+
+extern void EnumRegisteredWindows(const std::function<void (LPCWSTR, Window*)> &function);
+extern void EnumCounters(const std::function<void (LPCWSTR, LPCWSTR, double)> &function);
+
+// The number of spans the LiteStep thread keeps, where nearly all painting and messages are
+// handled, and the number every other thread keeps. FileSystemLoader starts a thread per item, so
+// the other threads get small buffers, which are reused once their threads exit.
+static const UINT sMainBufferCapacity = 8192;
+static const UINT sWorkerBufferCapacity = 256;
+
+// The most buffers of exited worker threads which are kept around for reuse.
+static const size_t sMaxSpareBuffers = 16;
+
+// The number of spans timed by MeasureOverhead, each way.
+static const int sOverheadIterations = 100000;
+
+// Non-zero while capturing. Every module's spans read this.
+static volatile LONG sCapturing = 0;
+
+// Guards sBuffers and sSites.
+static std::mutex sLock;
+
+// The buffer of every thread which has recorded a span.
+static std::vector<std::unique_ptr<TraceBuffer>> sBuffers;
+
+// Worker buffers whose threads have exited, and whose spans have been dumped or discarded.
+static std::vector<std::unique_ptr<TraceBuffer>> sSpareBuffers;
+
+// The LiteStep thread.
+static DWORD sMainThread = 0;
+
+// The names of the sites. Site ids are indices into this, plus 1.
+static std::vector<std::string> sSites;
+
+// The calling thread's buffer.
+static __declspec(thread) TraceBuffer *tBuffer = nullptr;
+
+// The performance counter when the last capture started, and stopped.
+static __int64 sCaptureStart = 0;
+static __int64 sCaptureStop = 0;
+
+// The last measured overhead.
+static TraceCapture::Overhead sOverhead = { 0.0, 0.0 };
+static bool sOverheadMeasured = false;
+
+
+/// <summary>
+/// Returns the flag the spans check before recording anything.
+/// </summary>
+EXPORT_CDECL(const volatile LONG*) GetTraceCaptureFlag() {
+  return &sCapturing;
+}
+
+
+/// <summary>
+/// Returns the calling thread's trace buffer, reusing a spare one or creating it if needed.
+/// </summary>
+EXPORT_CDECL(TraceBuffer*) GetTraceBuffer() {
+  if (tBuffer == nullptr) {
+    DWORD thread = GetCurrentThreadId();
+    std::lock_guard<std::mutex> lock(sLock);
+    if (thread != sMainThread && !sSpareBuffers.empty()) {
+      sBuffers.push_back(std::move(sSpareBuffers.back()));
+      sSpareBuffers.pop_back();
+      sBuffers.back()->Reassign(thread);
+    } else {
+      sBuffers.emplace_back(new TraceBuffer(thread,
+        thread == sMainThread ? sMainBufferCapacity : sWorkerBufferCapacity));
+    }
+    tBuffer = sBuffers.back().get();
+  }
+  return tBuffer;
+}
+
+
+/// <summary>
+/// Returns the id of the site with the specified name, adding it if needed.
+/// </summary>
+EXPORT_CDECL(UINT) RegisterTraceSite(LPCSTR name) {
+  std::lock_guard<std::mutex> lock(sLock);
+  for (size_t i = 0; i < sSites.size(); ++i) {
+    if (sSites[i] == name) {
+      return UINT(i + 1);
+    }
+  }
+  sSites.push_back(name);
+  return UINT(sSites.size());
+}
+
+
+/// <summary>
+/// Returns true if the specified thread has exited.
+/// </summary>
+static bool HasExited(DWORD threadId) {
+  HANDLE thread = OpenThread(SYNCHRONIZE, FALSE, threadId);
+  if (thread == nullptr) {
+    return true;
+  }
+  bool exited = WaitForSingleObject(thread, 0) == WAIT_OBJECT_0;
+  CloseHandle(thread);
+  return exited;
+}
+
+
+/// <summary>
+/// Takes the buffers of threads which have exited out of sBuffers, keeping a few of the small ones
+/// for reuse. Their spans are lost, so this must only be done once they have been dumped, or when
+/// they are about to be reset anyway. sLock must be held.
+/// </summary>
+static void ReleaseExitedBuffers() {
+  for (auto buffer = sBuffers.begin(); buffer != sBuffers.end();) {
+    if (HasExited((*buffer)->GetThread())) {
+      if ((*buffer)->GetCapacity() == sWorkerBufferCapacity &&
+          sSpareBuffers.size() < sMaxSpareBuffers) {
+        sSpareBuffers.push_back(std::move(*buffer));
+      }
+      buffer = sBuffers.erase(buffer);
+    } else {
+      ++buffer;
+    }
+  }
+}
+
+
+/// <summary>
+/// Appends formatted text to a string.
+/// </summary>
+static void Append(std::string &out, LPCSTR format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  StringCchVPrintfA(buffer, _countof(buffer), format, args);
+  va_end(args);
+  out += buffer;
+}
+
+
+/// <summary>
+/// Appends a string to a JSON document, as a quoted UTF-8 string.
+/// </summary>
+static void AppendString(std::string &out, LPCWSTR string) {
+  char utf8[MAX_PATH * 3];
+  if (WideCharToMultiByte(CP_UTF8, 0, string, -1, utf8, _countof(utf8), nullptr, nullptr) == 0) {
+    utf8[0] = '\0';
+  }
+  out += '"';
+  for (const char *c = utf8; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+      out += *c;
+    } else if (UCHAR(*c) >= 0x20) {
+      out += *c;
+    }
+  }
+  out += '"';
+}
+
+
+/// <summary>
+/// Appends a window's frame times to a JSON document.
+/// </summary>
+static void AppendFrameTimes(std::string &out, const RollingHistogram &frameTimes) {
+  Append(out, "{\"frames\":%u,\"total\":%llu,\"mean\":%.1f,\"p50\":%u,\"p95\":%u,\"p99\":%u,"
+    "\"max\":%u,\"buckets\":[", frameTimes.GetCount(), frameTimes.GetTotal(),
+    frameTimes.GetMean(), frameTimes.GetPercentile(50), frameTimes.GetPercentile(95),
+    frameTimes.GetPercentile(99), frameTimes.GetMax());
+  for (UINT bucket = 0; bucket < RollingHistogram::sBuckets; ++bucket) {
+    Append(out, bucket == 0 ? "%u" : ",%u", frameTimes.GetBucket(bucket));
+  }
+  out += "]}";
+}
+
+
+void TraceCapture::Initialize() {
+  sMainThread = GetCurrentThreadId();
+
+  LiteStep::AddBangCommand(L"!nCoreStartTrace", [] (HWND, LPCTSTR) {
+    Start();
+  });
+  LiteStep::AddBangCommand(L"!nCoreStopTrace", [] (HWND, LPCTSTR) {
+    Stop();
+  });
+  LiteStep::AddBangCommand(L"!nCoreDumpTrace", [] (HWND, LPCTSTR args) {
+    WCHAR path[MAX_PATH];
+    LPCWSTR target = nullptr;
+    if (LiteStep::GetToken(args, path, nullptr, FALSE) != FALSE && *path != L'\0') {
+      target = path;
+    }
+    HRESULT hr = Dump(target);
+    if (FAILED(hr)) {
+      ErrorHandler::ErrorHR(ErrorHandler::Level::Warning, hr, L"Failed to write the trace.");
+    }
+  });
+}
+
+
+void TraceCapture::Shutdown() {
+  LiteStep::RemoveBangCommand(L"!nCoreStartTrace");
+  LiteStep::RemoveBangCommand(L"!nCoreStopTrace");
+  LiteStep::RemoveBangCommand(L"!nCoreDumpTrace");
+  Stop();
+}
+
+
+void TraceCapture::Start() {
+  Stop();
+
+  std::lock_guard<std::mutex> lock(sLock);
+
+  // Threads which have exited can't record anything more. Their buffers are released here, or by
+  // Dump, rather than when they exit, so that their spans make it into the dump.
+  ReleaseExitedBuffers();
+  for (auto &buffer : sBuffers) {
+    buffer->Reset();
+  }
+
+  QueryPerformanceCounter((LARGE_INTEGER*)&sCaptureStart);
+  sCaptureStop = 0;
+  InterlockedExchange(&sCapturing, 1);
+}
+
+
+void TraceCapture::Stop() {
+  if (InterlockedExchange(&sCapturing, 0) != 0) {
+    QueryPerformanceCounter((LARGE_INTEGER*)&sCaptureStop);
+  }
+}
+
+
+bool TraceCapture::IsCapturing() {
+  return sCapturing != 0;
+}
+
+
+HRESULT TraceCapture::Dump(LPCWSTR path) {
+  Stop();
+  if (!sOverheadMeasured) {
+    Overhead overhead;
+    MeasureOverhead(overhead);
+  }
+
+  WCHAR defaultPath[MAX_PATH];
+  if (path == nullptr) {
+    GetTempPathW(_countof(defaultPath), defaultPath);
+    StringCchCatW(defaultPath, _countof(defaultPath), L"nCoreTrace.json");
+    path = defaultPath;
+  }
+
+  // Window::Paint records the window it painted, name them where we can.
+  std::unordered_map<UINT64, std::wstring> windowNames;
+  EnumRegisteredWindows([&windowNames] (LPCWSTR prefix, Window *window) {
+    windowNames[UINT64(UINT_PTR(window))] = prefix;
+  });
+
+  __int64 frequency;
+  QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+  double toMicroseconds = 1e6 / double(frequency);
+  DWORD processId = GetCurrentProcessId();
+
+  std::string out;
+  Append(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  Append(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,"
+    "\"args\":{\"name\":\"LiteStep\"}}", processId);
+
+  uint64_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(sLock);
+    std::vector<TraceEvent> events;
+    for (auto &buffer : sBuffers) {
+      events.clear();
+      dropped += buffer->Read(events);
+      for (const TraceEvent &event : events) {
+        // Spans which ended after the capture stopped were recorded while measuring the overhead.
+        if (event.site == 0 || event.site > sSites.size() || event.end > sCaptureStop) {
+          continue;
+        }
+        Append(out, ",\n{\"name\":\"%s\",\"cat\":\"nModules\",\"ph\":\"X\",\"ts\":%.3f,"
+          "\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{", sSites[event.site - 1].c_str(),
+          (event.start - sCaptureStart) * toMicroseconds, (event.end - event.start) * toMicroseconds,
+          processId, buffer->GetThread());
+        auto name = windowNames.find(event.arg);
+        if (name != windowNames.end()) {
+          out += "\"window\":";
+          AppendString(out, name->second.c_str());
+        } else if (event.arg != 0) {
+          Append(out, "\"arg\":%llu", event.arg);
+        }
+        out += "}}";
+      }
+    }
+
+    // The spans of threads which have exited are in the dump now.
+    ReleaseExitedBuffers();
+  }
+  out += "],\n";
+
+  // Chrome ignores keys it doesn't know, everything else goes in here.
+  Append(out, "\"nModules\":{\"duration\":%.3f,\"dropped\":%llu,"
+    "\"spanOverhead\":{\"idle\":%.2f,\"capturing\":%.2f},\"frameTimes\":{",
+    (sCaptureStop - sCaptureStart) * toMicroseconds, dropped, sOverhead.idle, sOverhead.capturing);
+  bool first = true;
+  for (auto &name : windowNames) {
+    const RollingHistogram &frameTimes = ((Window*)UINT_PTR(name.first))->GetFrameTimes();
+    if (frameTimes.GetCount() == 0) {
+      continue;
+    }
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    out += '\n';
+    AppendString(out, name.second.c_str());
+    out += ':';
+    AppendFrameTimes(out, frameTimes);
+  }
+
+  // The counters of every module, as of the dump.
+  out += "},\"counters\":{";
+  std::wstring lastGroup;
+  EnumCounters([&out, &lastGroup] (LPCWSTR group, LPCWSTR name, double value) {
+    if (lastGroup != group) {
+      if (!lastGroup.empty()) {
+        out += "},";
+      }
+      out += '\n';
+      AppendString(out, group);
+      out += ":{";
+      lastGroup = group;
+    } else {
+      out += ',';
+    }
+    AppendString(out, name);
+    Append(out, ":%.17g", value);
+  });
+  if (!lastGroup.empty()) {
+    out += '}';
+  }
+  out += "}}}\n";
+
+  HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+    nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+  DWORD written;
+  HRESULT hr = S_OK;
+  if (!WriteFile(file, out.data(), DWORD(out.size()), &written, nullptr)) {
+    hr = HRESULT_FROM_WIN32(GetLastError());
+  }
+  CloseHandle(file);
+
+  return hr;
+}
+
+
+bool TraceCapture::MeasureOverhead(Overhead &overhead) {
+  if (IsCapturing()) {
+    return false;
+  }
+
+  static nCore::Tracing::Site site = { "TraceCapture::MeasureOverhead", 0 };
+  __int64 frequency, start, idle, capturing;
+  QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+
+  QueryPerformanceCounter((LARGE_INTEGER*)&start);
+  for (int i = 0; i < sOverheadIterations; ++i) {
+    nCore::Tracing::Span span(site, UINT64(i));
+  }
+  QueryPerformanceCounter((LARGE_INTEGER*)&idle);
+
+  // Record into a scratch buffer, so that the benchmark doesn't push anything out of the capture.
+  TraceBuffer scratch(GetCurrentThreadId(), 1024);
+  TraceBuffer *buffer = nCore::Tracing::SwapThreadBuffer(&scratch);
+  InterlockedExchange(&sCapturing, 1);
+  for (int i = 0; i < sOverheadIterations; ++i) {
+    nCore::Tracing::Span span(site, UINT64(i));
+  }
+  InterlockedExchange(&sCapturing, 0);
+  QueryPerformanceCounter((LARGE_INTEGER*)&capturing);
+  nCore::Tracing::SwapThreadBuffer(buffer);
+
+  double toNanoseconds = 1e9 / double(frequency) / sOverheadIterations;
+  overhead.idle = (idle - start) * toNanoseconds;
+  overhead.capturing = (capturing - idle) * toNanoseconds;
+
+  sOverhead = overhead;
+  sOverheadMeasured = true;
+  return true;
+}
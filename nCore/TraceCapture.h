@@ -0,0 +1,61 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/TraceCapture.h
+// The nModules Project
+//
+// Collects the spans recorded by all modules, and writes them out as a Chrome trace.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/Common.h"
+
+namespace TraceCapture {
+  /// <summary>
+  /// The cost of a single span, in nanoseconds.
+  /// </summary>
+  struct Overhead {
+    // While no capture is running.
+    double idle;
+
+    // While capturing.
+    double capturing;
+  };
+
+  /// <summary>
+  /// Adds the trace bangs.
+  /// </summary>
+  void Initialize();
+
+  /// <summary>
+  /// Stops any capture, and removes the trace bangs.
+  /// </summary>
+  void Shutdown();
+
+  /// <summary>
+  /// Drops everything recorded so far, and starts recording spans on every thread.
+  /// </summary>
+  void Start();
+
+  /// <summary>
+  /// Stops recording spans. What has been recorded is kept until the next Start.
+  /// </summary>
+  void Stop();
+
+  /// <summary>
+  /// Returns true while a capture is running.
+  /// </summary>
+  bool IsCapturing();
+
+  /// <summary>
+  /// Stops the capture, and writes it to the specified file in the Chrome trace event format,
+  /// along with the frame times of every registered window and the counters of every module. A
+  /// null path writes to %TEMP%\nCoreTrace.json. The spans of threads which have exited are
+  /// released once they are written, so later dumps of the same capture leave them out.
+  /// </summary>
+  HRESULT Dump(LPCWSTR path);
+
+  /// <summary>
+  /// Times a large number of spans, with and without a capture running.
+  /// </summary>
+  /// <returns>False if a capture is running, in which case nothing is measured.</returns>
+  bool MeasureOverhead(Overhead &overhead);
+}
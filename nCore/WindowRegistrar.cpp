@@ -50,3 +50,13 @@ EXPORT_CDECL(void) AddWindowRegistrationListener(LPCWSTR prefix, Window * listen
 EXPORT_CDECL(void) RemoveWindowRegistrationListener(LPCWSTR prefix, Window * listener) {
   sRegistrationListeners[prefix].remove(listener);
 }
+
+
+/// <summary>
+/// Calls the specified function for every registered window.
+/// </summary>
+void EnumRegisteredWindows(const std::function<void (LPCWSTR, Window*)> &function) {
+  for (auto &registered : sRegisteredWindows) {
+    function(registered.first.c_str(), registered.second);
+  }
+}
@@ -8,6 +8,7 @@
 #include "ParsedText.hpp"
 #include "Scripting.h"
 #include "TextFunctions.h"
+#include "TraceCapture.h"
 #include "Version.h"
 
 #include "../nCoreCom/Core.h"
@@ -43,6 +44,10 @@ EXPORT_CDECL(Window*) FindRegisteredWindow(LPCWSTR prefix);
 extern void LoadCompleted(UINT64 id, LPVOID result);
 extern void LoadItemCompleted(UINT64 id, LPVOID result);
 extern void SendCoreMessage(UINT message, WPARAM, LPARAM);
+extern void StartShellState(HWND messageWindow);
+extern void StopShellState();
+extern void ShellStateDisplayChanged();
+extern LRESULT HandleShellStateMessage(UINT message, WPARAM, LPARAM);
 
 
 /// <summary>
@@ -91,6 +96,7 @@ static LRESULT WINAPI MainProc(HWND window, UINT message, WPARAM wParam, LPARAM
   case WM_SETTINGCHANGE:
     if (wParam == SPI_SETWORKAREA) {
       gMonitorInfo.Update();
+      ShellStateDisplayChanged();
       SendCoreMessage(NCORE_DISPLAYCHANGE, wParam, lParam);
     }
     SendCoreMessage(NCORE_SETTINGCHANGE, wParam, lParam);
@@ -98,6 +104,7 @@ static LRESULT WINAPI MainProc(HWND window, UINT message, WPARAM wParam, LPARAM
 
   case WM_DISPLAYCHANGE:
     gMonitorInfo.Update();
+    ShellStateDisplayChanged();
     SendCoreMessage(NCORE_DISPLAYCHANGE, wParam, lParam);
     return 0;
 
@@ -116,6 +123,16 @@ static LRESULT WINAPI MainProc(HWND window, UINT message, WPARAM wParam, LPARAM
   case NCORE_FILE_SYSTEM_ITEM_LOAD_COMPLETE:
     LoadItemCompleted(UINT64(wParam), LPVOID(lParam));
     return 0;
+
+  case LM_WINDOWCREATED:
+  case LM_WINDOWACTIVATED:
+  case LM_WINDOWDESTROYED:
+  case LM_REDRAW:
+  case LM_WINDOWREPLACED:
+  case LM_WINDOWREPLACING:
+  case LM_MONITORCHANGED:
+  case NCORE_SHELL_STATE_FLUSH:
+    return HandleShellStateMessage(message, wParam, lParam);
   }
   return DefWindowProcW(window, message, wParam, lParam);
 }
@@ -177,10 +194,12 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR path) {
   }
 
   TextFunctions::_Register();
+  StartShellState(ghWndMsgHandler);
   timeTimer = SetTimer(ghWndMsgHandler, 1, 1000, nullptr);
 
   // We need to be connected to the core for some of the functions in nShared to work... xD
   nCore::Connect(MakeVersion(MODULE_VERSION));
+  TraceCapture::Initialize();
 
   // Register window bangs
   WindowBangs::Register(L"n", FindRegisteredWindow);
@@ -205,8 +224,11 @@ EXPORT_CDECL(void) quitModule(HINSTANCE instance) {
   StateBangs::UnRegister(L"n");
   BrushBangs::UnRegister(L"n");
 
+  TraceCapture::Shutdown();
+
   // Deinitalize
   if (ghWndMsgHandler) {
+    StopShellState();
     KillTimer(ghWndMsgHandler, timeTimer);
     SendMessageW(LiteStep::GetLitestepWnd(), LM_UNREGISTERMESSAGE, (WPARAM)ghWndMsgHandler, (LPARAM)gLSMessages);
     DestroyWindow(ghWndMsgHandler);
@@ -62,6 +62,7 @@ HRESULT nCore::Connect(VERSION minVersion) {
   HRESULT hr = S_OK;
 
   RETURNONFAIL(hr, System::_Init(hCoreInstance));
+  RETURNONFAIL(hr, Tracing::_Init(hCoreInstance));
 
   sInitialized = true;
 
@@ -73,6 +74,7 @@ HRESULT nCore::Connect(VERSION minVersion) {
 /// Disconnects from the core.
 /// </summary>
 void nCore::Disconnect() {
+  Tracing::_DeInit();
   System::_DeInit();
   FUNC_VAR_NAME(GetCoreVersion) = nullptr;
   sInitialized = false;
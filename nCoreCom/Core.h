@@ -10,6 +10,9 @@
 #include "../nCore/CoreMessages.h"
 #include "../nCore/FileSystemLoader.h"
 #include "../nCore/IParsedText.hpp"
+#include "../nCore/ModuleCounters.h"
+#include "../nCore/ShellState.h"
+#include "../nCore/StartupTimings.h"
 
 #include "../nShared/MonitorInfo.hpp"
 
@@ -25,6 +28,10 @@ namespace nCore {
   VERSION GetCoreVersion();
   MonitorInfo &FetchMonitorInfo();
 
+  // Shell State
+  const WindowStateTable &FetchWindowState();
+  bool FetchWindowTitle(HWND window, LPWSTR title, UINT cchTitle);
+
   void RegisterForCoreMessages(HWND hwnd, const UINT messages[]);
   void UnregisterForCoreMessages(HWND hwnd, const UINT messages[]);
 
@@ -45,5 +52,12 @@ namespace nCore {
     Window *FindRegisteredWindow(LPCWSTR);
     void AddWindowRegistrationListener(LPCWSTR, Window*);
     void RemoveWindowRegistrationListener(LPCWSTR, Window*);
+
+    // Startup Timings
+    void ReportModuleStartup(LPCWSTR module, const ModuleStartupTiming&);
+
+    // Module Counters
+    void RegisterCounters(LPCWSTR group, COUNTERPROC);
+    void UnRegisterCounters(LPCWSTR group);
   }
 }
@@ -23,4 +23,9 @@ namespace nCore {
     HRESULT _Init(HMODULE);
     void _DeInit();
   }
+
+  namespace Tracing {
+    HRESULT _Init(HMODULE);
+    void _DeInit();
+  }
 }
@@ -12,6 +12,8 @@
 // Pointers to functions in the core. Initalized by _Init, reset by _DeInit.
 namespace nCore {
   DECL_FUNC_VAR(FetchMonitorInfo);
+  DECL_FUNC_VAR(FetchWindowState);
+  DECL_FUNC_VAR(FetchWindowTitle);
   DECL_FUNC_VAR(LoadFolder);
   DECL_FUNC_VAR(LoadFolderItem);
 
@@ -26,6 +28,11 @@ namespace nCore {
     DECL_FUNC_VAR(FindRegisteredWindow);
     DECL_FUNC_VAR(AddWindowRegistrationListener);
     DECL_FUNC_VAR(RemoveWindowRegistrationListener);
+
+    DECL_FUNC_VAR(ReportModuleStartup);
+
+    DECL_FUNC_VAR(RegisterCounters);
+    DECL_FUNC_VAR(UnRegisterCounters);
   }
 }
 
@@ -36,6 +43,8 @@ namespace nCore {
 /// <returns>True if the core is succefully initalized.</returns>
 HRESULT nCore::System::_Init(HMODULE hCoreInstance) {
   INIT_FUNC(FetchMonitorInfo);
+  INIT_FUNC(FetchWindowState);
+  INIT_FUNC(FetchWindowTitle);
 
   INIT_FUNC(LoadFolder);
   INIT_FUNC(LoadFolderItem);
@@ -51,6 +60,11 @@ HRESULT nCore::System::_Init(HMODULE hCoreInstance) {
   INIT_FUNC(AddWindowRegistrationListener);
   INIT_FUNC(RemoveWindowRegistrationListener);
 
+  INIT_FUNC(ReportModuleStartup);
+
+  INIT_FUNC(RegisterCounters);
+  INIT_FUNC(UnRegisterCounters);
+
   return S_OK;
 }
 
@@ -60,6 +74,8 @@ HRESULT nCore::System::_Init(HMODULE hCoreInstance) {
 /// </summary>
 void nCore::System::_DeInit() {
   FUNC_VAR_NAME(FetchMonitorInfo) = nullptr;
+  FUNC_VAR_NAME(FetchWindowState) = nullptr;
+  FUNC_VAR_NAME(FetchWindowTitle) = nullptr;
 
   FUNC_VAR_NAME(LoadFolder) = nullptr;
   FUNC_VAR_NAME(LoadFolderItem) = nullptr;
@@ -74,6 +90,11 @@ void nCore::System::_DeInit() {
   FUNC_VAR_NAME(FindRegisteredWindow) = nullptr;
   FUNC_VAR_NAME(AddWindowRegistrationListener) = nullptr;
   FUNC_VAR_NAME(RemoveWindowRegistrationListener) = nullptr;
+
+  FUNC_VAR_NAME(ReportModuleStartup) = nullptr;
+
+  FUNC_VAR_NAME(RegisterCounters) = nullptr;
+  FUNC_VAR_NAME(UnRegisterCounters) = nullptr;
 }
 
 
@@ -132,12 +153,42 @@ void nCore::System::RemoveWindowRegistrationListener(LPCTSTR prefix, Window *lis
 }
 
 
+void nCore::System::ReportModuleStartup(LPCWSTR module, const ModuleStartupTiming &timing) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(ReportModuleStartup)(module, timing);
+}
+
+
+void nCore::System::RegisterCounters(LPCWSTR group, COUNTERPROC proc) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(RegisterCounters)(group, proc);
+}
+
+
+void nCore::System::UnRegisterCounters(LPCWSTR group) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(UnRegisterCounters)(group);
+}
+
+
 MonitorInfo &nCore::FetchMonitorInfo() {
   ASSERT(nCore::Initialized());
   return FUNC_VAR_NAME(FetchMonitorInfo)();
 }
 
 
+const WindowStateTable &nCore::FetchWindowState() {
+  ASSERT(nCore::Initialized());
+  return FUNC_VAR_NAME(FetchWindowState)();
+}
+
+
+bool nCore::FetchWindowTitle(HWND window, LPWSTR title, UINT cchTitle) {
+  ASSERT(nCore::Initialized());
+  return FUNC_VAR_NAME(FetchWindowTitle)(window, title, cchTitle);
+}
+
+
 UINT64 nCore::LoadFolder(LoadFolderRequest &request, FileSystemLoaderResponseHandler *handler) {
   ASSERT(nCore::Initialized());
   return FUNC_VAR_NAME(LoadFolder)(request, handler);
@@ -0,0 +1,78 @@
+//-------------------------------------------------------------------------------------------------
+// /nCoreCom/Tracing.cpp
+// The nModules Project
+//
+// Scoped spans, recorded into nCore's trace while a capture is running.
+//-------------------------------------------------------------------------------------------------
+#include "Core.h"
+#include "CoreComHelpers.h"
+#include "Tracing.h"
+
+// The calling thread's trace buffer, once it has recorded a span.
+static __declspec(thread) TraceBuffer *tBuffer = nullptr;
+
+namespace nCore {
+  namespace Tracing {
+    // Spans recorded before the module connects, or after it disconnects, read this.
+    const volatile LONG gNotCapturing = 0;
+    const volatile LONG *gCapturing = &gNotCapturing;
+
+    // The functions exported by the core.
+    const volatile LONG *GetTraceCaptureFlag();
+    TraceBuffer *GetTraceBuffer();
+    UINT RegisterTraceSite(LPCSTR name);
+
+    // Pointers to functions in the core. Initalized by _Init, reset by _DeInit.
+    DECL_FUNC_VAR(GetTraceCaptureFlag);
+    DECL_FUNC_VAR(GetTraceBuffer);
+    DECL_FUNC_VAR(RegisterTraceSite);
+  }
+}
+
+
+/// <summary>
+/// Connects the spans of this module to nCore's capture.
+/// </summary>
+HRESULT nCore::Tracing::_Init(HMODULE hCoreInstance) {
+  INIT_FUNC(GetTraceCaptureFlag);
+  INIT_FUNC(GetTraceBuffer);
+  INIT_FUNC(RegisterTraceSite);
+
+  gCapturing = FUNC_VAR_NAME(GetTraceCaptureFlag)();
+
+  return S_OK;
+}
+
+
+/// <summary>
+/// Disconnects the spans of this module from nCore.
+/// </summary>
+void nCore::Tracing::_DeInit() {
+  gCapturing = &gNotCapturing;
+
+  FUNC_VAR_NAME(GetTraceCaptureFlag) = nullptr;
+  FUNC_VAR_NAME(GetTraceBuffer) = nullptr;
+  FUNC_VAR_NAME(RegisterTraceSite) = nullptr;
+}
+
+
+TraceBuffer *nCore::Tracing::GetThreadBuffer() {
+  if (tBuffer == nullptr) {
+    tBuffer = FUNC_VAR_NAME(GetTraceBuffer)();
+  }
+  return tBuffer;
+}
+
+
+TraceBuffer *nCore::Tracing::SwapThreadBuffer(TraceBuffer *buffer) {
+  TraceBuffer *old = tBuffer;
+  tBuffer = buffer;
+  return old;
+}
+
+
+UINT nCore::Tracing::RegisterSite(Site &site) {
+  UINT id = FUNC_VAR_NAME(RegisterTraceSite)(site.name);
+  InterlockedExchange(&site.id, LONG(id));
+  return id;
+}
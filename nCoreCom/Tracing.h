@@ -0,0 +1,96 @@
+//-------------------------------------------------------------------------------------------------
+// /nCoreCom/Tracing.h
+// The nModules Project
+//
+// Scoped spans, recorded into nCore's trace while a capture is running.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../nShared/BuildOptions.h"
+
+#include "../Utilities/Common.h"
+#include "../Utilities/TraceBuffer.hpp"
+
+namespace nCore {
+  namespace Tracing {
+    /// <summary>
+    /// A place in the code where spans are recorded. The id is handed out by nCore the first time
+    /// a span is recorded there.
+    /// </summary>
+    struct Site {
+      const char *name;
+      volatile LONG id;
+    };
+
+    // Points at nCore's capture flag while connected, and at gNotCapturing otherwise.
+    extern const volatile LONG *gCapturing;
+    extern const volatile LONG gNotCapturing;
+
+    /// <summary>
+    /// Returns the calling thread's trace buffer, which is owned by nCore.
+    /// </summary>
+    TraceBuffer *GetThreadBuffer();
+
+    /// <summary>
+    /// Replaces the calling thread's trace buffer, returning the old one. Used to measure the
+    /// cost of a span without touching the capture.
+    /// </summary>
+    TraceBuffer *SwapThreadBuffer(TraceBuffer *buffer);
+
+    /// <summary>
+    /// Looks up the id of a site.
+    /// </summary>
+    UINT RegisterSite(Site &site);
+
+    /// <summary>
+    /// Records the time from its construction to its destruction. While no capture is running,
+    /// this is a single load and branch each way.
+    /// </summary>
+    class Span {
+    public:
+      Span(Site &site, UINT64 arg) {
+        if (*gCapturing != 0) {
+          mSite = &site;
+          mArg = arg;
+          mBuffer = GetThreadBuffer();
+          QueryPerformanceCounter((LARGE_INTEGER*)&mStart);
+        } else {
+          mBuffer = nullptr;
+        }
+      }
+
+      ~Span() {
+        // The module may have disconnected from nCore since the span started.
+        if (mBuffer != nullptr && gCapturing != &gNotCapturing) {
+          __int64 end;
+          QueryPerformanceCounter((LARGE_INTEGER*)&end);
+          UINT id = mSite->id != 0 ? UINT(mSite->id) : RegisterSite(*mSite);
+          mBuffer->Record(id, mStart, end, mArg);
+        }
+      }
+
+    private:
+      Span(const Span &);
+      Span &operator=(const Span &);
+
+    private:
+      TraceBuffer *mBuffer;
+      Site *mSite;
+      __int64 mStart;
+      UINT64 mArg;
+    };
+  }
+}
+
+// Spans are only compiled in when BUILDOPTIONS_TRACING is defined.
+#if defined(BUILDOPTIONS_TRACING)
+#define TRACE_SPAN_JOIN2(a, b) a ## b
+#define TRACE_SPAN_JOIN(a, b) TRACE_SPAN_JOIN2(a, b)
+#define TRACE_SPAN_ARG(name, arg) \
+  static nCore::Tracing::Site TRACE_SPAN_JOIN(sTraceSite, __LINE__) = { name, 0 }; \
+  nCore::Tracing::Span TRACE_SPAN_JOIN(traceSpan, __LINE__)(TRACE_SPAN_JOIN(sTraceSite, __LINE__), UINT64(arg))
+#else
+#define TRACE_SPAN_ARG(name, arg)
+#endif
+
+#define TRACE_SPAN(name) TRACE_SPAN_ARG(name, 0)
@@ -31,8 +31,14 @@ struct BangItem {
 static const BangItem bangMap[] = {
   // Sets the work area.
   BangItem(L"SetWorkArea", [] (HWND, LPCTSTR args) {
-    WorkArea::ParseLine(&nCore::FetchMonitorInfo(), args);
-    SendNotifyMessage(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETWORKAREA, 0);
+    if (WorkArea::ParseLine(args)) {
+      WorkArea::Apply(&nCore::FetchMonitorInfo());
+    }
+  }),
+
+  // Works out the work area again, after bars have moved.
+  BangItem(L"UpdateWorkArea", [] (HWND, LPCTSTR) {
+    WorkArea::Apply(&nCore::FetchMonitorInfo());
   }),
 
   // Adds a click handler.
@@ -63,6 +69,15 @@ static const BangItem bangMap[] = {
   // Sets or clears the invalid all on update flag.
   BangItem(L"SetInvalidateAllOnUpdate", [] (HWND, LPCTSTR args) {
     g_pDesktopPainter->SetInvalidateAllOnUpdate(LiteStep::ParseBool(args));
+  }),
+
+  // Starts decoding a wallpaper, ahead of it being set.
+  BangItem(L"PreloadWallpaper", [] (HWND, LPCTSTR args) {
+    WCHAR path[MAX_PATH];
+    LPWSTR buffers[] = { path };
+    if (LiteStep::CommandTokenize(args, buffers, _countof(buffers), nullptr) == 1) {
+      g_pDesktopPainter->PreloadWallpaper(path);
+    }
   })
 };
 
@@ -15,6 +15,7 @@
 #include "../Utilities/StopWatch.hpp"
 #include "../nCoreCom/Core.h"
 #include "ClickHandler.hpp"
+#include "WallpaperCache.hpp"
 #include <wincodec.h>
 #include <assert.h>
 #include <algorithm>
@@ -23,6 +24,9 @@ extern ClickHandler * g_pClickHandler;
 
 using namespace D2D1;
 
+// Posted by the thread pool once a wallpaper has been decoded. WM_APP + 1 is taken by nDesk.cpp.
+#define NDESK_WALLPAPERDECODED (WM_APP + 2)
+
 /// <summary>
 /// Creates a new instance of the DesktopPainter class.
 /// </summary>
@@ -32,6 +36,7 @@ DesktopPainter::DesktopPainter(HWND hWnd) : Window(hWnd, L"nDesk", g_pClickHandl
   m_pOldWallpaperBrush = nullptr;
   m_TransitionEffect = nullptr;
   m_bInvalidateAllOnUpdate = false;
+  mWallpaperId = 0;
   mDontRenderWallpaper = LiteStep::GetRCBool(L"nDeskDontRenderWallpaper", TRUE) != FALSE;
   this->transitionStartTime = 0;
   this->transitionEndTime = 0;
@@ -89,6 +94,8 @@ DesktopPainter::~DesktopPainter() {
 
   //Close the wallpaper registry key
   RegCloseKey(hWallpaperKey);
+
+  WallpaperCache::Clear();
 }
 
 /// <summary>
@@ -277,6 +284,41 @@ void DesktopPainter::UpdateWallpaper(bool bNoTransition) {
   Redraw();
 }
 
+/// <summary>
+/// Should be called when the wallpaper might have changed. Starts decoding the new wallpaper on
+/// the thread pool, and switches to it once it has been decoded.
+/// </summary>
+void DesktopPainter::WallpaperChanged() {
+  if (mDontRenderWallpaper) {
+    UpdateWallpaper();
+    return;
+  }
+
+  WCHAR path[MAX_PATH];
+  WallpaperCache::Layout layout;
+  GetWallpaperSettings(path, _countof(path), layout);
+
+  // If the wallpaper isn't ready yet, we will be back here once it is. Settings other than the
+  // wallpaper also change the registry key, so it may well be the one we are showing already.
+  UINT64 id;
+  if (WallpaperCache::Prefetch(path, layout, m_hWnd, NDESK_WALLPAPERDECODED, id) && id != mWallpaperId) {
+    UpdateWallpaper();
+    Repaint();
+  }
+}
+
+/// <summary>
+/// Starts decoding the specified wallpaper, so that it is ready when it is switched to.
+/// </summary>
+void DesktopPainter::PreloadWallpaper(LPCWSTR path) {
+  WCHAR currentPath[MAX_PATH];
+  WallpaperCache::Layout layout;
+  GetWallpaperSettings(currentPath, _countof(currentPath), layout);
+
+  UINT64 id;
+  WallpaperCache::Prefetch(path, layout, nullptr, 0, id);
+}
+
 /// <summary>
 /// Causes the whole desktop window to be redrawn
 /// </summary>
@@ -302,9 +344,8 @@ void DesktopPainter::TransitionStart() {
 
   while (m_pOldWallpaperBrush != nullptr) {
     mRenderTarget->BeginDraw();
-    bool inAnimation = true;
     PaintComposite();
-    PaintChildren(inAnimation, &this->m_TransitionSettings.WPRect);
+    PaintChildren(&this->m_TransitionSettings.WPRect);
     mRenderTarget->EndDraw();
   }
   Redraw();
@@ -343,11 +384,8 @@ LRESULT DesktopPainter::HandleMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
 	//Check if the wallpaper registry has been changed
 	if (WaitForSingleObject(hWallpaperEvent, 0) == WAIT_OBJECT_0)
 	{
-		//Fetch the new wallpaper
-		UpdateWallpaper();
-
-		//Force window to redraw
-		this->Repaint();
+		//Start fetching the new wallpaper
+		WallpaperChanged();
 
 		//RegNotifyChangeKeyValue() expires after the event has changed state
 		RegNotifyChangeKeyValue(hWallpaperKey, FALSE, REG_NOTIFY_CHANGE_LAST_SET, hWallpaperEvent, TRUE);
@@ -357,14 +395,16 @@ LRESULT DesktopPainter::HandleMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
   case WM_ERASEBKGND:
     return 1;
 
+  case NDESK_WALLPAPERDECODED:
+    WallpaperChanged();
+    return 0;
+
   case WM_PAINT:
     {
       if (!mDontRenderWallpaper) {
 
         UpdateLock lock(this);
 
-        bool inAnimation = false;
-
         RECT updateRect;
 
         if (GetUpdateRect(hWnd, &updateRect, FALSE) != FALSE) {
@@ -385,7 +425,7 @@ LRESULT DesktopPainter::HandleMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
               Paint(&d2dUpdateRect);
             }
 
-            PaintChildren(inAnimation, &d2dUpdateRect);
+            PaintChildren(&d2dUpdateRect);
 
             mRenderTarget->PopAxisAlignedClip();
 
@@ -406,8 +446,6 @@ LRESULT DesktopPainter::HandleMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
 
           if (this->m_pOldWallpaperBrush != NULL) {
             Redraw();
-          } else if (inAnimation) {
-            PostMessage(hWnd, WM_ANIMATIONPAINT, 0, 0);
           }
         }
       } else {
@@ -425,43 +463,50 @@ LRESULT DesktopPainter::HandleMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
 }
 
 /// <summary>
-/// Creates a brush of the current wallpaper.
+/// Reads the wallpaper settings from the registry, and works out the layout of the desktop.
 /// </summary>
-HRESULT DesktopPainter::CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush) {
-  //
-  HRESULT hr = S_OK;
-
-  // Information about the wallpaper
-  WCHAR wszWallpaperPath[MAX_PATH];
-  int iWallpaperStyle;
-  bool bTileWallpaper;
-
+void DesktopPainter::GetWallpaperSettings(LPWSTR path, size_t cchPath, WallpaperCache::Layout &layout) {
   // Temporary values
   WCHAR szTemp[32];
   DWORD dwSize, dwType;
 
-  // D2D/WIC interfaces
-  ID2D1Bitmap *pBitmap = nullptr;
-  ID2D1BitmapRenderTarget* pBitmapRender = nullptr;
-  IWICImagingFactory *pWICFactory = nullptr;
-  IWICBitmapDecoder *pDecoder = nullptr;
-  IWICBitmapFrameDecode *pSource = nullptr;
-  IWICFormatConverter *pConverter = nullptr;
-  IWICBitmapScaler *pScaler = nullptr;
-
   // Get the path to the wallpaper
-  dwSize = sizeof(wszWallpaperPath); dwType = REG_SZ;
-  SHGetValueW(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"Wallpaper", &dwType, &wszWallpaperPath, &dwSize);
+  *path = L'\0';
+  dwSize = DWORD(cchPath*sizeof(WCHAR)); dwType = REG_SZ;
+  SHGetValueW(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"Wallpaper", &dwType, path, &dwSize);
 
   // Get whether or not to tile the wallpaper
   dwSize = sizeof(szTemp);
   SHGetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"TileWallpaper", &dwType, &szTemp, &dwSize);
-  bTileWallpaper = _wtoi(szTemp) ? true : false;
+  layout.tile = _wtoi(szTemp) ? true : false;
 
   // Get whether or not to stretch the wallpaper
   dwSize = sizeof(szTemp);
   SHGetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"WallpaperStyle", &dwType, &szTemp, &dwSize);
-  iWallpaperStyle = _wtoi(szTemp);
+  layout.style = _wtoi(szTemp);
+
+  const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
+  const MonitorInfo::Monitor &primaryMonitor = nCore::FetchMonitorInfo().GetMonitor(0);
+  layout.primaryWidth = primaryMonitor.width;
+  layout.primaryHeight = primaryMonitor.height;
+  layout.desktopWidth = virtualDesktop.width;
+  layout.desktopHeight = virtualDesktop.height;
+}
+
+/// <summary>
+/// Creates a brush of the current wallpaper.
+/// </summary>
+HRESULT DesktopPainter::CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush) {
+  // Information about the wallpaper
+  WCHAR wszWallpaperPath[MAX_PATH];
+  WallpaperCache::Layout layout;
+
+  // D2D/WIC interfaces
+  ID2D1Bitmap *pBitmap = nullptr;
+  ID2D1BitmapRenderTarget* pBitmapRender = nullptr;
+  IWICBitmapSource *pWallpaper = nullptr;
+
+  GetWallpaperSettings(wszWallpaperPath, _countof(wszWallpaperPath), layout);
 
   // Create a bitmap the size of the virtual screen
   mRenderTarget->CreateCompatibleRenderTarget(&pBitmapRender);
@@ -473,25 +518,19 @@ HRESULT DesktopPainter::CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush) {
   DWORD DesktopColor = GetSysColor(COLOR_DESKTOP);
   pBitmapRender->Clear(D2D1::ColorF(RGB(GetBValue(DesktopColor), GetGValue(DesktopColor), GetRValue(DesktopColor))));
 
-  // Load the desktop background
-  Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&pWICFactory));
-  if (SUCCEEDED(hr = pWICFactory->CreateDecoderFromFilename(wszWallpaperPath, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &pDecoder))) {
-    // Get the first frame of the wallpaper
-    pDecoder->GetFrame(0, &pSource);
-
+  // Load the desktop background, already scaled to the size it is drawn at. Normally it has been
+  // decoded on the thread pool by now.
+  if (SUCCEEDED(WallpaperCache::Get(wszWallpaperPath, layout, &pWallpaper, mWallpaperId))) {
     // Get the size of the wallpaper
     UINT cxWallpaper, cyWallpaper;
-    pSource->GetSize(&cxWallpaper, &cyWallpaper);
+    pWallpaper->GetSize(&cxWallpaper, &cyWallpaper);
 
-    const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
-    const MonitorInfo::Monitor &primaryMonitor = nCore::FetchMonitorInfo().GetMonitor(0);
+    // Convert it to a D2D1 bitmap
+    mRenderTarget->CreateBitmapFromWicBitmap(pWallpaper, 0, &pBitmap);
 
-    if (bTileWallpaper) {
-      // Convert it to a D2D1 bitmap
-      pWICFactory->CreateFormatConverter(&pConverter);
-      pConverter->Initialize(pSource, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
-      mRenderTarget->CreateBitmapFromWicBitmap(pConverter, 0, &pBitmap);
+    const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
 
+    if (layout.tile) {
       // The x/y points where we should start tiling the image
       int xInitial = -virtualDesktop.rect.left + (int)floor((float)virtualDesktop.rect.left / cxWallpaper)*cxWallpaper;
       int yInitial = -virtualDesktop.rect.top + (int)floor((float)virtualDesktop.rect.top / cyWallpaper)*cyWallpaper;
@@ -504,77 +543,10 @@ HRESULT DesktopPainter::CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush) {
       }
     } else // Some type of stretching
     {
-      // Work out the dimensions the wallpaper should be stretched to
-      int WallpaperResX, WallpaperResY;
-      double scaleX, scaleY;
-      switch (iWallpaperStyle) {
-      case 2: // Stretch
-        {
-          WallpaperResX = primaryMonitor.width;
-          WallpaperResY = primaryMonitor.height;
-        }
-        break;
-
-      case 6: // Fit
-        {
-          scaleX = (double)primaryMonitor.width / cxWallpaper;
-          scaleY = (double)primaryMonitor.height / cyWallpaper;
-          if (scaleX > scaleY) {
-            WallpaperResY = primaryMonitor.height;
-            WallpaperResX = (int)(scaleY*cxWallpaper);
-          } else {
-            WallpaperResY = (int)(scaleX*cyWallpaper);
-            WallpaperResX = primaryMonitor.width;
-          }
-        }
-        break;
-
-      case 10: // Fill
-        {
-          scaleX = (double)primaryMonitor.width / cxWallpaper;
-          scaleY = (double)primaryMonitor.height / cyWallpaper;
-          if (scaleX < scaleY) {
-            WallpaperResY = primaryMonitor.height;
-            WallpaperResX = (int)(scaleY*cxWallpaper);
-          } else {
-            WallpaperResY = (int)(scaleX*cyWallpaper);
-            WallpaperResX = primaryMonitor.width;
-          }
-        }
-        break;
-
-      case 22: // Span, essentially a fill over the virtual desktop
-        {
-          scaleX = (double)virtualDesktop.width / cxWallpaper;
-          scaleY = (double)virtualDesktop.height / cyWallpaper;
-          if (scaleX < scaleY) {
-            WallpaperResY = virtualDesktop.height;
-            WallpaperResX = (int)(scaleY*cxWallpaper);
-          } else {
-            WallpaperResY = (int)(scaleX*cyWallpaper);
-            WallpaperResX = virtualDesktop.width;
-          }
-        }
-        break;
-
-      default: // Center (actually 0), but this way we can fail graciously if the value is invalid
-        {
-          WallpaperResX = cxWallpaper;
-          WallpaperResY = cyWallpaper;
-        }
-        break;
-      }
-
-      // Stretch the wallpaper as necesary
-      pWICFactory->CreateBitmapScaler(&pScaler);
-      pScaler->Initialize(pSource, (UINT)WallpaperResX, (UINT)WallpaperResY, WICBitmapInterpolationModeCubic);
-
-      // Convert it to a D2D1 bitmap
-      pWICFactory->CreateFormatConverter(&pConverter);
-      pConverter->Initialize(pScaler, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
-      mRenderTarget->CreateBitmapFromWicBitmap(pConverter, 0, &pBitmap);
+      // The dimensions the wallpaper has been stretched to
+      int WallpaperResX = (int)cxWallpaper, WallpaperResY = (int)cyWallpaper;
 
-      if (iWallpaperStyle == 22) {
+      if (layout.style == 22) {
         // Center the stretched wallpaper on the virtual desktop
         D2D1_RECT_F dest, source;
         dest.left = 0;
@@ -632,11 +604,8 @@ HRESULT DesktopPainter::CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush) {
       }
     }
 
-    SAFERELEASE(pConverter);
-    SAFERELEASE(pDecoder);
     SAFERELEASE(pBitmap);
-    SAFERELEASE(pSource);
-    SAFERELEASE(pScaler);
+    SAFERELEASE(pWallpaper);
   }
 
   // Finish rendering
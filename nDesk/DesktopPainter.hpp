@@ -9,6 +9,7 @@
 
 #include "../Utilities/CommonD2D.h"
 #include "TransitionEffects.h"
+#include "WallpaperCache.hpp"
 #include "../nShared/StateRender.hpp"
 #include "../nShared/Window.hpp"
 
@@ -65,6 +66,8 @@ public:
     void SetInvalidateAllOnUpdate(bool);
 
     void UpdateWallpaper(bool bNoTransition = false);
+    void WallpaperChanged();
+    void PreloadWallpaper(LPCWSTR path);
     void Resize();
     LRESULT WINAPI HandleMessage(HWND, UINT, WPARAM, LPARAM);
     HWND GetWindow();
@@ -88,6 +91,7 @@ private:
     void TransitionEnd();
     TransitionEffect* TransitionEffectFromType(TransitionType transitionType);
 
+    void GetWallpaperSettings(LPWSTR path, size_t cchPath, WallpaperCache::Layout &layout);
     HRESULT CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush);
 
     //
@@ -101,6 +105,9 @@ private:
     ID2D1BitmapBrush* m_pWallpaperBrush;
     ID2D1BitmapBrush* m_pOldWallpaperBrush;
 
+    // The id, in the wallpaper cache, of the wallpaper we are showing.
+    UINT64 mWallpaperId;
+
     StateRender<States> mStateRender;
 
     //
@@ -10,9 +10,6 @@
 #include <ctime>
 #include <math.h>
 
-using std::min;
-using std::max;
-
 /// <summary>
 /// Constructor
 /// </summary>
@@ -20,19 +17,19 @@ GridEffect::GridEffect(GridType fadeType, GridStyle gridStyle) {
   m_gridType = fadeType;
   m_gridStyle = gridStyle;
   srand((unsigned)time(NULL));
-  m_StartTimes = nullptr;
-  m_Squares = nullptr;
   m_iSquaresY = 0;
   m_iSquaresX = 0;
   m_iSquares = 0;
+  m_pMaskBitmap = nullptr;
+  m_pMaskBrush = nullptr;
+  m_pLayer = nullptr;
 }
 
 /// <summary>
 /// Destructor
 /// </summary>
 GridEffect::~GridEffect() {
-  free(m_StartTimes);
-  free(m_Squares);
+  DiscardMaskResources();
 }
 
 /// <summary>
@@ -55,81 +52,18 @@ void GridEffect::Start(ID2D1BitmapBrush *oldBrush, ID2D1BitmapBrush *newBrush) {
     m_pNewBrush = newBrush;
   }
 
-  // Generate values in the range [0, 1 - fadeTime]
+  GridMask::Order order = GridMask::Order::Random;
   switch (m_gridType) {
-  case RANDOM: {
-      for (int i = 0; i < m_iSquares; i++) {
-        m_StartTimes[i] = (rand() % 10000 * (1.0f - m_pTransitionSettings->fFadeTime)) / 10000.0f;
-      }
-      break;
-    }
-
-  case LINEAR_HORIZONTAL: {
-      int i = 0;
-      for (int y = 0; y < m_iSquaresY; y++) {
-        for (int x = 0; x < m_iSquaresX; x++) {
-          m_StartTimes[x*m_iSquaresY + y] = (i++)*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-      }
-      break;
-    }
-
-  case LINEAR_VERTICAL: {
-      for (int i = 0; i < m_iSquares; i++) {
-        m_StartTimes[i] = i*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-      }
-      break;
-    }
-
-  case TRIANGULAR: {
-      float alpha = (float)atan2((double)m_iSquaresY, (double)m_iSquaresX);
-      float up = sqrt(float(m_iSquaresX*m_iSquaresX + m_iSquaresY*m_iSquaresY)) / (1.0f - m_pTransitionSettings->fFadeTime);
-      for (int x = 0; x < m_iSquaresX; x++) {
-        for (int y = 0; y < m_iSquaresY; y++) {
-          m_StartTimes[x*m_iSquaresY + y] = sqrt(float(x*x + y*y))*cos(atan2((float)y, (float)x) - alpha) / up;
-        }
-      }
-      break;
-    }
-
-  case CLOCKWISE: {
-      int index = 0;
-      for (int depth = 0; depth < min(m_iSquaresX, m_iSquaresY) / 2; depth++) {
-        for (int x = depth; x < m_iSquaresX - depth - 1; x++) {
-          m_StartTimes[x*m_iSquaresY + depth] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int y = depth; y < m_iSquaresY - depth - 1; y++) {
-          m_StartTimes[(m_iSquaresX - depth - 1)*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int x = m_iSquaresX - depth - 1; x > depth; x--) {
-          m_StartTimes[(x + 1)*m_iSquaresY - depth - 1] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int y = m_iSquaresY - depth - 1; y > depth; y--) {
-          m_StartTimes[depth*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-      }
-      break;
-    }
-
-  case COUNTERCLOCKWISE: {
-      int index = 0;
-      for (int depth = 0; depth < min(m_iSquaresX, m_iSquaresY) / 2; depth++) {
-        for (int y = depth; y < m_iSquaresY - depth - 1; y++) {
-          m_StartTimes[depth*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int x = depth; x < m_iSquaresX - depth - 1; x++) {
-          m_StartTimes[(x + 1)*m_iSquaresY - depth - 1] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int y = m_iSquaresY - depth - 1; y > depth; y--) {
-          m_StartTimes[(m_iSquaresX - depth - 1)*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int x = m_iSquaresX - depth - 1; x > depth; x--) {
-          m_StartTimes[x*m_iSquaresY + depth] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-      }
-      break;
-    }
+  case RANDOM: order = GridMask::Order::Random; break;
+  case LINEAR_VERTICAL: order = GridMask::Order::LinearVertical; break;
+  case LINEAR_HORIZONTAL: order = GridMask::Order::LinearHorizontal; break;
+  case TRIANGULAR: order = GridMask::Order::Triangular; break;
+  case CLOCKWISE: order = GridMask::Order::Clockwise; break;
+  case COUNTERCLOCKWISE: order = GridMask::Order::CounterClockwise; break;
   }
+
+  GridMask::StartTimes(order, m_iSquaresX, m_iSquaresY, m_pTransitionSettings->fFadeTime,
+    m_StartTimes.data());
 }
 
 /// <summary>
@@ -141,17 +75,27 @@ void GridEffect::Paint(ID2D1RenderTarget* renderTarget, float fProgress) {
   }
 
   renderTarget->FillRectangle(m_pTransitionSettings->WPRect, m_pOldBrush);
-  for (int i = 0; i < m_iSquares; i++) {
-    m_pNewBrush->SetOpacity(min(1.0f, max(fProgress - m_StartTimes[i], 0.0f) / m_pTransitionSettings->fFadeTime));
-    renderTarget->FillRectangle(m_Squares[i], m_pNewBrush);
+  if (m_iSquares == 0 || FAILED(CreateMaskResources(renderTarget))) {
+    return;
   }
+
+  // Rather than drawing every square on its own, work out the opacity of all of them and draw the
+  // new wallpaper once, through a mask with one pixel per square.
+  GridMask::Render(m_StartTimes.data(), m_iSquares, fProgress, m_pTransitionSettings->fFadeTime,
+    m_Mask.data());
+  m_pMaskBitmap->CopyFromMemory(nullptr, m_Mask.data(), m_iSquaresX);
+
+  renderTarget->PushLayer(D2D1::LayerParameters(m_pTransitionSettings->WPRect, nullptr,
+    D2D1_ANTIALIAS_MODE_ALIASED, D2D1::IdentityMatrix(), 1.0f, m_pMaskBrush), m_pLayer);
+  renderTarget->FillRectangle(m_pTransitionSettings->WPRect, m_pNewBrush);
+  renderTarget->PopLayer();
 }
 
 /// <summary>
 /// End of the effect. Should cleanup.
 /// </summary>
 void GridEffect::End() {
-  m_pNewBrush->SetOpacity(1.0f);
+  DiscardMaskResources();
 
   m_pOldBrush = NULL;
   m_pNewBrush = NULL;
@@ -165,19 +109,47 @@ void GridEffect::Resize() {
   m_iSquaresY = (int)ceil(m_pTransitionSettings->WPRect.bottom / m_pTransitionSettings->iSquareSize);
   m_iSquares = m_iSquaresY * m_iSquaresX;
 
-  // Reallocate memory for the squares
-  m_StartTimes = (float*)realloc(m_StartTimes, sizeof(float)*m_iSquares);
-  m_Squares = (D2D1_RECT_F*)realloc(m_Squares, sizeof(D2D1_RECT_F)*m_iSquares);
-
-  // Work out the square positions
-  int square = 0;
-  for (float x = m_pTransitionSettings->WPRect.left; x < m_pTransitionSettings->WPRect.right; x += m_pTransitionSettings->iSquareSize) {
-    for (float y = m_pTransitionSettings->WPRect.top; y < m_pTransitionSettings->WPRect.bottom; y += m_pTransitionSettings->iSquareSize) {
-      m_Squares[square].left = x;
-      m_Squares[square].right = x + m_pTransitionSettings->iSquareSize;
-      m_Squares[square].top = y;
-      m_Squares[square].bottom = y + m_pTransitionSettings->iSquareSize;
-      square++;
-    }
+  m_StartTimes.assign(m_iSquares, 0.0f);
+  m_Mask.assign(m_iSquares, 0);
+
+  // The mask has to be recreated at the new size
+  DiscardMaskResources();
+}
+
+/// <summary>
+/// Creates the mask and the layer it is applied through, unless they already exist.
+/// </summary>
+HRESULT GridEffect::CreateMaskResources(ID2D1RenderTarget* renderTarget) {
+  if (m_pLayer != nullptr) {
+    return S_OK;
   }
-}
\ No newline at end of file
+
+  HRESULT hr = renderTarget->CreateBitmap(D2D1::SizeU(m_iSquaresX, m_iSquaresY),
+    D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)),
+    &m_pMaskBitmap);
+  if (SUCCEEDED(hr)) {
+    hr = renderTarget->CreateBitmapBrush(m_pMaskBitmap, D2D1::BitmapBrushProperties(
+      D2D1_EXTEND_MODE_CLAMP, D2D1_EXTEND_MODE_CLAMP, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR),
+      &m_pMaskBrush);
+  }
+  if (SUCCEEDED(hr)) {
+    float squareSize = float(m_pTransitionSettings->iSquareSize);
+    m_pMaskBrush->SetTransform(D2D1::Matrix3x2F::Scale(squareSize, squareSize) *
+      D2D1::Matrix3x2F::Translation(m_pTransitionSettings->WPRect.left, m_pTransitionSettings->WPRect.top));
+    hr = renderTarget->CreateLayer(&m_pLayer);
+  }
+  if (FAILED(hr)) {
+    DiscardMaskResources();
+  }
+
+  return hr;
+}
+
+/// <summary>
+/// Releases the mask and the layer.
+/// </summary>
+void GridEffect::DiscardMaskResources() {
+  SAFERELEASE(m_pLayer);
+  SAFERELEASE(m_pMaskBrush);
+  SAFERELEASE(m_pMaskBitmap);
+}
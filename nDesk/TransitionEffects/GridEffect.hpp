@@ -8,6 +8,9 @@
 #pragma once
 
 #include "../TransitionEffect.hpp"
+#include "GridMask.hpp"
+
+#include <vector>
 
 class GridEffect : public TransitionEffect {
 public:
@@ -36,6 +39,13 @@ public:
     void Resize();
     void End();
 
+private:
+    // Creates the mask and the layer it is applied through.
+    HRESULT CreateMaskResources(ID2D1RenderTarget* renderTarget);
+
+    // Releases the mask and the layer.
+    void DiscardMaskResources();
+
 private:
     // The type of fade we are doing
     GridType m_gridType;
@@ -43,12 +53,21 @@ private:
     // The
     GridStyle m_gridStyle;
 
-    // When to start showing the square
-    float* m_StartTimes;
+    // When to start showing each square, row by row
+    std::vector<float> m_StartTimes;
 
-    // Where the squares are of the screen
-    D2D1_RECT_F* m_Squares;
+    // The opacity of each square, row by row
+    std::vector<uint8_t> m_Mask;
 
     // The number of squares in a row/column
     int m_iSquaresY, m_iSquaresX, m_iSquares;
+
+    // m_Mask on the GPU, one pixel per square
+    ID2D1Bitmap* m_pMaskBitmap;
+
+    // Stretches the mask over the screen, without blending between squares
+    ID2D1BitmapBrush* m_pMaskBrush;
+
+    // The layer the new wallpaper is drawn through
+    ID2D1Layer* m_pLayer;
 };
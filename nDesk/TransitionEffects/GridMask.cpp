@@ -0,0 +1,127 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/TransitionEffects/GridMask.cpp
+// The nModules Project
+//
+// Works out the opacity of every square of a grid transition.
+//-------------------------------------------------------------------------------------------------
+#include "GridMask.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+
+/// <summary>
+/// Gives the squares of a spiral consecutive start times, from the outermost ring in.
+/// </summary>
+template <bool clockwise>
+static void Spiral(int columns, int rows, float step, float *startTimes) {
+  int index = 0;
+  auto set = [&] (int x, int y) {
+    startTimes[y*columns + x] = index++ * step;
+  };
+
+  int depths = std::min(columns, rows) / 2;
+  for (int depth = 0; depth < depths; ++depth) {
+    int right = columns - depth - 1, bottom = rows - depth - 1;
+    if (clockwise) {
+      for (int x = depth; x < right; ++x) set(x, depth);
+      for (int y = depth; y < bottom; ++y) set(right, y);
+      for (int x = right; x > depth; --x) set(x, bottom);
+      for (int y = bottom; y > depth; --y) set(depth, y);
+    } else {
+      for (int y = depth; y < bottom; ++y) set(depth, y);
+      for (int x = depth; x < right; ++x) set(x, bottom);
+      for (int y = bottom; y > depth; --y) set(right, y);
+      for (int x = right; x > depth; --x) set(x, depth);
+    }
+  }
+
+  // When the shorter side is odd, a single row or column is left in the middle. It goes last, in
+  // the direction of the spiral.
+  int depth = depths;
+  if (columns <= rows && columns % 2 == 1) {
+    for (int y = depth; y < rows - depth; ++y) set(depth, clockwise ? y : rows - y - 1);
+  } else if (rows < columns && rows % 2 == 1) {
+    for (int x = depth; x < columns - depth; ++x) set(clockwise ? x : columns - x - 1, depth);
+  }
+}
+
+
+/// <summary>
+/// Works out when each square starts fading, as a fraction of the transition in the range
+/// [0, 1 - fadeTime].
+/// </summary>
+void GridMask::StartTimes(Order order, int columns, int rows, float fadeTime, float *startTimes) {
+  int count = columns * rows;
+  if (count <= 0) {
+    return;
+  }
+  float span = 1.0f - fadeTime;
+  float step = span / count;
+
+  switch (order) {
+  case Order::Random:
+    for (int i = 0; i < count; ++i) {
+      startTimes[i] = (rand() % 10000 * span) / 10000.0f;
+    }
+    break;
+
+  case Order::LinearVertical:
+    for (int y = 0; y < rows; ++y) {
+      float *row = startTimes + y*columns;
+      for (int x = 0; x < columns; ++x) {
+        row[x] = float(x*rows + y) * step;
+      }
+    }
+    break;
+
+  case Order::LinearHorizontal:
+    for (int i = 0; i < count; ++i) {
+      startTimes[i] = float(i) * step;
+    }
+    break;
+
+  case Order::Triangular:
+    {
+      // The distance of each square from the top left corner, along the diagonal, scaled so that
+      // the bottom right corner starts at 1 - fadeTime.
+      float length = sqrtf(float(columns*columns + rows*rows));
+      float dx = float(columns) / length * span / length;
+      float dy = float(rows) / length * span / length;
+      for (int y = 0; y < rows; ++y) {
+        float *row = startTimes + y*columns;
+        float base = float(y) * dy;
+        for (int x = 0; x < columns; ++x) {
+          row[x] = base + float(x) * dx;
+        }
+      }
+    }
+    break;
+
+  case Order::Clockwise:
+    Spiral<true>(columns, rows, step, startTimes);
+    break;
+
+  case Order::CounterClockwise:
+    Spiral<false>(columns, rows, step, startTimes);
+    break;
+  }
+}
+
+
+/// <summary>
+/// Works out the opacity of each square at the specified point of the transition.
+/// </summary>
+void GridMask::Render(const float *startTimes, int count, float progress, float fadeTime,
+    uint8_t *mask) {
+  // opacity = clamp((progress - start) / fadeTime, 0, 1) * 255, rounded. Written without branches
+  // so that the compiler can vectorize it.
+  float scale = 255.0f / std::max(fadeTime, 1e-6f);
+  float offset = progress * scale + 0.5f;
+  for (int i = 0; i < count; ++i) {
+    float alpha = offset - startTimes[i] * scale;
+    alpha = std::min(std::max(alpha, 0.0f), 255.0f);
+    mask[i] = uint8_t(alpha);
+  }
+}
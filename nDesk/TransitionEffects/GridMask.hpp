@@ -0,0 +1,60 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/TransitionEffects/GridMask.hpp
+// The nModules Project
+//
+// Works out the opacity of every square of a grid transition.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+/// <summary>
+/// A grid transition fades in a grid of squares, each starting at its own time. These functions
+/// work on tables with one entry per square, stored row by row, so that the table of opacities can
+/// be handed straight to the renderer as an alpha mask, one pixel per square.
+/// </summary>
+namespace GridMask {
+  /// <summary>
+  /// The order in which the squares start fading.
+  /// </summary>
+  enum class Order {
+    // In a random order.
+    Random,
+
+    // Down each column, from the left column to the right.
+    LinearVertical,
+
+    // Across each row, from the top row to the bottom.
+    LinearHorizontal,
+
+    // In diagonal bands, from the top left corner to the bottom right.
+    Triangular,
+
+    // In a clockwise spiral, from the edges in.
+    Clockwise,
+
+    // In a counterclockwise spiral, from the edges in.
+    CounterClockwise
+  };
+
+  /// <summary>
+  /// Works out when each square starts fading, as a fraction of the transition in the range
+  /// [0, 1 - fadeTime].
+  /// </summary>
+  /// <param name="order">The order the squares should start in.</param>
+  /// <param name="columns">The number of squares in each row.</param>
+  /// <param name="rows">The number of squares in each column.</param>
+  /// <param name="fadeTime">How long each square takes to fade, as a fraction of the transition.</param>
+  /// <param name="startTimes">Receives columns*rows start times.</param>
+  void StartTimes(Order order, int columns, int rows, float fadeTime, float *startTimes);
+
+  /// <summary>
+  /// Works out the opacity of each square at the specified point of the transition.
+  /// </summary>
+  /// <param name="startTimes">The start time of each square.</param>
+  /// <param name="count">The number of squares.</param>
+  /// <param name="progress">How far along the transition is, in the range [0, 1].</param>
+  /// <param name="fadeTime">How long each square takes to fade, as a fraction of the transition.</param>
+  /// <param name="mask">Receives the opacity of each square, from 0 to 255.</param>
+  void Render(const float *startTimes, int count, float progress, float fadeTime, uint8_t *mask);
+}
@@ -0,0 +1,436 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WallpaperCache.cpp
+// The nModules Project
+//
+// Decodes and scales wallpapers on the thread pool.
+//-------------------------------------------------------------------------------------------------
+#include "WallpaperCache.hpp"
+
+#include "../nShared/Factories.h"
+
+#include "../Utilities/StopWatch.hpp"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+
+
+/// <summary>
+/// A decoded wallpaper, or one which is being decoded.
+/// </summary>
+struct Wallpaper {
+  UINT64 id;
+
+  // The lowercased full path, which is what wallpapers are matched by.
+  std::wstring key;
+  std::wstring path;
+  WallpaperCache::Layout layout;
+
+  // When the file was last written to, and its size, as of when it was requested.
+  ULONGLONG writeTime;
+  ULONGLONG fileSize;
+
+  // Set by the thread pool once the wallpaper has been decoded. Null once nDesk's thread has
+  // collected the result, or if the wallpaper was never queued.
+  HANDLE pending;
+
+  // Set by the thread pool right before it notifies the window, so that the window can tell
+  // that the wallpaper is ready before the event is.
+  volatile LONG finished;
+
+  // The window to notify once the wallpaper has been decoded.
+  HWND window;
+  UINT message;
+
+  // True once nDesk's thread has a result for this wallpaper.
+  bool decoded;
+
+  // The result of the decode, and the decoded pixels if it succeeded.
+  HRESULT hr;
+  IWICBitmap *bitmap;
+  UINT64 bytes;
+};
+
+
+// At most this many wallpapers are kept, most recently used first. The most recent one is kept
+// even if it is over the byte budget.
+static const size_t sMaxWallpapers = 3;
+static const UINT64 sMaxBytes = 128*1024*1024;
+
+static std::list<std::shared_ptr<Wallpaper>> sWallpapers;
+
+// The size of all decoded wallpapers in sWallpapers.
+static UINT64 sBytes = 0;
+
+static UINT64 sNextId = 1;
+
+static WallpaperCache::Stats sStats = { 0, 0, 0, 0.0 };
+
+
+/// <summary>
+/// Works out the size the wallpaper should be scaled to.
+/// </summary>
+static void ScaledSize(const WallpaperCache::Layout &layout, UINT width, UINT height,
+    UINT &scaledWidth, UINT &scaledHeight) {
+  scaledWidth = width;
+  scaledHeight = height;
+  if (layout.tile || width == 0 || height == 0) {
+    return;
+  }
+
+  double scaleX, scaleY;
+  switch (layout.style) {
+  case 2: // Stretch
+    scaledWidth = layout.primaryWidth;
+    scaledHeight = layout.primaryHeight;
+    break;
+
+  case 6: // Fit
+    scaleX = (double)layout.primaryWidth / width;
+    scaleY = (double)layout.primaryHeight / height;
+    if (scaleX > scaleY) {
+      scaledHeight = layout.primaryHeight;
+      scaledWidth = (UINT)(scaleY*width);
+    } else {
+      scaledHeight = (UINT)(scaleX*height);
+      scaledWidth = layout.primaryWidth;
+    }
+    break;
+
+  case 10: // Fill
+    scaleX = (double)layout.primaryWidth / width;
+    scaleY = (double)layout.primaryHeight / height;
+    if (scaleX < scaleY) {
+      scaledHeight = layout.primaryHeight;
+      scaledWidth = (UINT)(scaleY*width);
+    } else {
+      scaledHeight = (UINT)(scaleX*height);
+      scaledWidth = layout.primaryWidth;
+    }
+    break;
+
+  case 22: // Span, essentially a fill over the virtual desktop
+    scaleX = (double)layout.desktopWidth / width;
+    scaleY = (double)layout.desktopHeight / height;
+    if (scaleX < scaleY) {
+      scaledHeight = layout.desktopHeight;
+      scaledWidth = (UINT)(scaleY*width);
+    } else {
+      scaledHeight = (UINT)(scaleX*height);
+      scaledWidth = layout.desktopWidth;
+    }
+    break;
+
+  default: // Center (actually 0), but this way we can fail graciously if the value is invalid
+    break;
+  }
+}
+
+
+/// <summary>
+/// Loads the wallpaper, scales it and converts it to 32bpp PBGRA.
+/// </summary>
+static void Decode(Wallpaper *wallpaper, IWICImagingFactory *factory) {
+  IWICBitmapDecoder *decoder = nullptr;
+  IWICBitmapFrameDecode *frame = nullptr;
+  IWICBitmapScaler *scaler = nullptr;
+  IWICFormatConverter *converter = nullptr;
+  IWICBitmapSource *source = nullptr;
+  UINT width = 0, height = 0, scaledWidth = 0, scaledHeight = 0;
+
+  wallpaper->bitmap = nullptr;
+  wallpaper->bytes = 0;
+
+  HRESULT hr = factory->CreateDecoderFromFilename(wallpaper->path.c_str(), nullptr, GENERIC_READ,
+    WICDecodeMetadataCacheOnDemand, &decoder);
+  if (SUCCEEDED(hr)) {
+    hr = decoder->GetFrame(0, &frame);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = frame->GetSize(&width, &height);
+    source = frame;
+  }
+  if (SUCCEEDED(hr)) {
+    ScaledSize(wallpaper->layout, width, height, scaledWidth, scaledHeight);
+    if (scaledWidth != width || scaledHeight != height) {
+      hr = factory->CreateBitmapScaler(&scaler);
+      if (SUCCEEDED(hr)) {
+        hr = scaler->Initialize(frame, scaledWidth, scaledHeight, WICBitmapInterpolationModeCubic);
+        source = scaler;
+      }
+    }
+  }
+  if (SUCCEEDED(hr)) {
+    hr = factory->CreateFormatConverter(&converter);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = converter->Initialize(source, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
+      nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
+  }
+  if (SUCCEEDED(hr)) {
+    // Cache on load, so that decoding and scaling happens here rather than when the bitmap is used.
+    hr = factory->CreateBitmapFromSource(converter, WICBitmapCacheOnLoad, &wallpaper->bitmap);
+  }
+  if (SUCCEEDED(hr)) {
+    wallpaper->bytes = UINT64(scaledWidth) * scaledHeight * 4;
+  }
+
+  SAFERELEASE(converter);
+  SAFERELEASE(scaler);
+  SAFERELEASE(frame);
+  SAFERELEASE(decoder);
+  wallpaper->hr = hr;
+}
+
+
+/// <summary>
+/// Decodes a wallpaper on the thread pool.
+/// </summary>
+static void CALLBACK DecodeCallback(PTP_CALLBACK_INSTANCE instance, LPVOID context) {
+  Wallpaper *wallpaper = reinterpret_cast<Wallpaper*>(context);
+
+  // Only signal nDesk once this callback has returned, so that nDesk can't be unloaded while it
+  // is still running.
+  SetEventWhenCallbackReturns(instance, wallpaper->pending);
+
+  // nDesk's WIC factory lives in its STA, so the pool thread gets one of its own.
+  IWICImagingFactory *factory = nullptr;
+  HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  if (SUCCEEDED(hr)) {
+    hr = CoCreateInstance(CLSID_WICImagingFactory1, nullptr, CLSCTX_INPROC_SERVER,
+      IID_IWICImagingFactory, reinterpret_cast<LPVOID*>(&factory));
+    if (SUCCEEDED(hr)) {
+      Decode(wallpaper, factory);
+      factory->Release();
+    }
+    CoUninitialize();
+  }
+  if (FAILED(hr)) {
+    wallpaper->hr = hr;
+  }
+
+  // Prefetch may be handing us a window at the same time. Either it sees that we are finished,
+  // or we see its window.
+  InterlockedExchange(&wallpaper->finished, 1);
+  HWND window = (HWND)InterlockedCompareExchangePointer((PVOID*)&wallpaper->window, nullptr, nullptr);
+  if (window != nullptr) {
+    PostMessage(window, wallpaper->message, 0, 0);
+  }
+}
+
+
+/// <summary>
+/// Returns the key of the wallpaper at the specified path.
+/// </summary>
+static std::wstring MakeKey(LPCWSTR path) {
+  WCHAR fullPath[MAX_PATH];
+  DWORD length = GetFullPathNameW(path, _countof(fullPath), fullPath, nullptr);
+  std::wstring key(length != 0 && length < _countof(fullPath) ? fullPath : path);
+  std::transform(key.begin(), key.end(), key.begin(), ::towlower);
+  return key;
+}
+
+
+/// <summary>
+/// True if wallpapers scaled for the two layouts are the same.
+/// </summary>
+static bool SameLayout(const WallpaperCache::Layout &a, const WallpaperCache::Layout &b) {
+  return a.style == b.style && a.tile == b.tile && a.primaryWidth == b.primaryWidth &&
+    a.primaryHeight == b.primaryHeight && a.desktopWidth == b.desktopWidth &&
+    a.desktopHeight == b.desktopHeight;
+}
+
+
+/// <summary>
+/// Returns the entry for the specified wallpaper, adding a blank one if there isn't one. The
+/// entry is moved to the front of the list.
+/// </summary>
+static Wallpaper &Find(LPCWSTR path, const WallpaperCache::Layout &layout, bool &added) {
+  std::wstring key = MakeKey(path);
+
+  ULONGLONG writeTime = 0, fileSize = 0;
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (GetFileAttributesEx(path, GetFileExInfoStandard, &data) != FALSE) {
+    writeTime = ULONGLONG(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime;
+    fileSize = ULONGLONG(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+  }
+
+  auto iter = std::find_if(sWallpapers.begin(), sWallpapers.end(),
+    [&key, &layout, writeTime, fileSize] (const std::shared_ptr<Wallpaper> &wallpaper) -> bool {
+      return wallpaper->key == key && wallpaper->writeTime == writeTime &&
+        wallpaper->fileSize == fileSize && SameLayout(wallpaper->layout, layout);
+    });
+
+  added = iter == sWallpapers.end();
+  if (added) {
+    std::shared_ptr<Wallpaper> wallpaper(new Wallpaper);
+    wallpaper->id = sNextId++;
+    wallpaper->key = key;
+    wallpaper->path = path;
+    wallpaper->layout = layout;
+    wallpaper->writeTime = writeTime;
+    wallpaper->fileSize = fileSize;
+    wallpaper->pending = nullptr;
+    wallpaper->finished = 0;
+    wallpaper->window = nullptr;
+    wallpaper->message = 0;
+    wallpaper->decoded = false;
+    wallpaper->hr = E_FAIL;
+    wallpaper->bitmap = nullptr;
+    wallpaper->bytes = 0;
+    sWallpapers.push_front(wallpaper);
+  } else if (iter != sWallpapers.begin()) {
+    sWallpapers.splice(sWallpapers.begin(), sWallpapers, iter);
+  }
+
+  return *sWallpapers.front();
+}
+
+
+/// <summary>
+/// Takes the result of a wallpaper which was queued on the thread pool, waiting for it if need be.
+/// </summary>
+static void Collect(Wallpaper &wallpaper) {
+  WaitForSingleObject(wallpaper.pending, INFINITE);
+  CloseHandle(wallpaper.pending);
+  wallpaper.pending = nullptr;
+  wallpaper.decoded = true;
+  sBytes += wallpaper.bytes;
+  ++sStats.decodedAhead;
+}
+
+
+/// <summary>
+/// Drops the least recently used wallpapers until the cache is back within its budget. The most
+/// recently used one, and any which are still being decoded, are kept.
+/// </summary>
+static void Trim() {
+  size_t count = sWallpapers.size();
+  for (auto iter = std::prev(sWallpapers.end());
+      iter != sWallpapers.begin() && (count > sMaxWallpapers || sBytes > sMaxBytes);) {
+    Wallpaper &wallpaper = **iter;
+
+    // Wallpapers which were prefetched but never asked for are collected here. The pool has
+    // nothing left to do but return, so this doesn't wait long.
+    if (wallpaper.pending != nullptr && InterlockedCompareExchange(&wallpaper.finished, 0, 0) != 0) {
+      Collect(wallpaper);
+    }
+
+    if (wallpaper.pending == nullptr) {
+      if (wallpaper.decoded) {
+        sBytes -= wallpaper.bytes;
+      }
+      SAFERELEASE(wallpaper.bitmap);
+      iter = std::prev(sWallpapers.erase(iter));
+      --count;
+    } else {
+      --iter;
+    }
+  }
+}
+
+
+/// <summary>
+/// Starts decoding the wallpaper on the thread pool, unless it is already decoded, or being
+/// decoded.
+/// </summary>
+bool WallpaperCache::Prefetch(LPCWSTR path, const Layout &layout, HWND window, UINT message,
+    UINT64 &id) {
+  bool added;
+  Wallpaper &wallpaper = Find(path, layout, added);
+  id = wallpaper.id;
+
+  bool ready;
+  if (added) {
+    wallpaper.window = window;
+    wallpaper.message = message;
+
+    // If the wallpaper can't be queued, Get will decode it.
+    wallpaper.pending = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (wallpaper.pending != nullptr &&
+        TrySubmitThreadpoolCallback(DecodeCallback, &wallpaper, nullptr) == FALSE) {
+      CloseHandle(wallpaper.pending);
+      wallpaper.pending = nullptr;
+    }
+    ready = wallpaper.pending == nullptr;
+  } else if (wallpaper.pending != nullptr) {
+    // Someone else asked for this one first, possibly without a window to notify.
+    if (window != nullptr) {
+      wallpaper.message = message;
+      InterlockedExchangePointer((PVOID*)&wallpaper.window, window);
+    }
+    ready = InterlockedCompareExchange(&wallpaper.finished, 0, 0) != 0;
+  } else {
+    ready = true;
+  }
+
+  Trim();
+  return ready;
+}
+
+
+/// <summary>
+/// Retrieves the wallpaper, decoded, scaled for the layout and converted to 32bpp PBGRA.
+/// </summary>
+HRESULT WallpaperCache::Get(LPCWSTR path, const Layout &layout, IWICBitmapSource **bitmap,
+    UINT64 &id) {
+  *bitmap = nullptr;
+
+  bool added;
+  Wallpaper &wallpaper = Find(path, layout, added);
+  id = wallpaper.id;
+
+  if (wallpaper.pending != nullptr) {
+    if (WaitForSingleObject(wallpaper.pending, 0) == WAIT_TIMEOUT) {
+      StopWatch watch;
+      WaitForSingleObject(wallpaper.pending, INFINITE);
+      sStats.waitTime += watch.GetTime() * 1000.0;
+    }
+    Collect(wallpaper);
+  } else if (wallpaper.decoded) {
+    ++sStats.reused;
+  } else {
+    IWICImagingFactory *factory = nullptr;
+    if (SUCCEEDED(wallpaper.hr = Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory)))) {
+      Decode(&wallpaper, factory);
+    }
+    wallpaper.decoded = true;
+    sBytes += wallpaper.bytes;
+    ++sStats.decodedInline;
+  }
+
+  HRESULT hr = wallpaper.hr;
+  if (SUCCEEDED(hr)) {
+    *bitmap = wallpaper.bitmap;
+    wallpaper.bitmap->AddRef();
+  }
+
+  Trim();
+  return hr;
+}
+
+
+/// <summary>
+/// Drops every decoded wallpaper, waiting for any which are still being decoded.
+/// </summary>
+void WallpaperCache::Clear() {
+  for (auto &wallpaper : sWallpapers) {
+    if (wallpaper->pending != nullptr) {
+      WaitForSingleObject(wallpaper->pending, INFINITE);
+      CloseHandle(wallpaper->pending);
+      wallpaper->pending = nullptr;
+    }
+    SAFERELEASE(wallpaper->bitmap);
+  }
+  sWallpapers.clear();
+  sBytes = 0;
+}
+
+
+/// <summary>
+/// Returns the counters for all wallpapers requested since the module was loaded.
+/// </summary>
+const WallpaperCache::Stats &WallpaperCache::GetStats() {
+  return sStats;
+}
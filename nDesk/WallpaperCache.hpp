@@ -0,0 +1,85 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WallpaperCache.hpp
+// The nModules Project
+//
+// Decodes and scales wallpapers on the thread pool.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/Common.h"
+
+#include <wincodec.h>
+
+/// <summary>
+/// Decoding a large wallpaper, and scaling it to the desktop, takes long enough to visibly stall
+/// the desktop. Wallpapers are instead decoded and scaled on the thread pool, and the window which
+/// asked for one is sent a message once it is ready.
+///
+/// The last few wallpapers are kept, keyed by their path, the time the file was last written to,
+/// its size, and the layout they were scaled for. Changing back to a recent wallpaper, or redrawing
+/// the current one after the render target is lost, doesn't decode it again.
+///
+/// All functions must be called from nDesk's thread.
+/// </summary>
+namespace WallpaperCache {
+  /// <summary>
+  /// How a wallpaper is laid out on the desktop.
+  /// </summary>
+  struct Layout {
+    // The WallpaperStyle and TileWallpaper registry values.
+    int style;
+    bool tile;
+
+    // The size of the primary monitor, and of the virtual desktop.
+    int primaryWidth;
+    int primaryHeight;
+    int desktopWidth;
+    int desktopHeight;
+  };
+
+  /// <summary>
+  /// Counters for all wallpapers requested since the module was loaded.
+  /// </summary>
+  struct Stats {
+    // Wallpapers which were decoded on the thread pool.
+    ULONGLONG decodedAhead;
+
+    // Wallpapers which were decoded on nDesk's thread, because nobody asked for them in advance.
+    ULONGLONG decodedInline;
+
+    // Requests which were served by a wallpaper which had already been decoded.
+    ULONGLONG reused;
+
+    // The time nDesk's thread spent waiting for the thread pool, in milliseconds.
+    double waitTime;
+  };
+
+  /// <summary>
+  /// Starts decoding the wallpaper on the thread pool, unless it is already decoded, or being
+  /// decoded. Once it is decoded, message is posted to window, if there is one.
+  /// </summary>
+  /// <param name="id">Set to the id of the decoded wallpaper.</param>
+  /// <returns>True if the wallpaper is ready to be retrieved, without waiting.</returns>
+  bool Prefetch(LPCWSTR path, const Layout &layout, HWND window, UINT message, UINT64 &id);
+
+  /// <summary>
+  /// Retrieves the wallpaper, decoded, scaled for the layout and converted to 32bpp PBGRA. Waits
+  /// for the thread pool if it is being decoded, and decodes it right away if nobody asked for it
+  /// in advance. The caller must release the bitmap.
+  /// </summary>
+  /// <param name="id">
+  /// Set to the id of the decoded wallpaper. Two requests get the same id only if they would get
+  /// the same pixels.
+  /// </param>
+  HRESULT Get(LPCWSTR path, const Layout &layout, IWICBitmapSource **bitmap, UINT64 &id);
+
+  /// <summary>
+  /// Drops every decoded wallpaper, waiting for any which are still being decoded.
+  /// </summary>
+  void Clear();
+
+  /// <summary>
+  /// Returns the counters for all wallpapers requested since the module was loaded.
+  /// </summary>
+  const Stats &GetStats();
+}
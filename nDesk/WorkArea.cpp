@@ -7,65 +7,165 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "../nShared/LiteStep.h"
 #include "WorkArea.h"
+#include "WorkAreaSolver.hpp"
 #include "../nCoreCom/Core.h"
 #include "../nShared/ErrorHandler.h"
+#include "../nShared/Window.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+// Margins declared by *nDeskWorkArea lines and !nDeskSetWorkArea, in the order they were declared.
+struct Declaration {
+    // The monitor the margins are for, or UINT(-1) for all monitors.
+    UINT monitor;
+    WorkAreaSolver::Margins margins;
+};
+static std::vector<Declaration> sDeclarations;
+
+// The names of the windows which take up the edges they are docked to.
+static std::vector<std::wstring> sBars;
+
+
+/// <summary>
+/// Sets the workareas, leaving monitors whose workarea is already right alone, and lets everyone
+/// know once if anything changed.
+/// </summary>
+static void SetWorkAreas(const std::vector<RECT> &monitors, const std::vector<RECT> &workAreas)
+{
+    bool changed = false;
+
+    for (size_t i = 0; i < monitors.size(); ++i)
+    {
+        MONITORINFO info;
+        info.cbSize = sizeof(info);
+        HMONITOR monitor = MonitorFromRect(&monitors[i], MONITOR_DEFAULTTONULL);
+        if (monitor != nullptr && GetMonitorInfoW(monitor, &info) && EqualRect(&info.rcWork, &workAreas[i]))
+        {
+            continue;
+        }
+        SystemParametersInfoW(SPI_SETWORKAREA, 0, const_cast<PRECT>(&workAreas[i]), 0);
+        changed = true;
+    }
+
+    if (changed)
+    {
+        SendNotifyMessageW(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETWORKAREA, 0);
+    }
+}
 
 
 /// <summary>
-/// Sets the workarea for some monitor.
+/// Adds a workarea declaration, replacing any earlier one it overrides.
 /// </summary>
-/// <param name="mInfo"></param>
-/// <param name="pszLine"></param>
-void WorkArea::ParseLine(MonitorInfo *mInfo, LPCTSTR pszLine)
+/// <param name="pszLine">(MONITOR) (LEFT) (TOP) (RIGHT) (BOTTOM)</param>
+/// <returns>False if the line is not a valid declaration.</returns>
+bool WorkArea::ParseLine(LPCTSTR pszLine)
 {
     TCHAR szMonitor[16], szLeft[16], szTop[16], szRight[16], szBottom[16];
     LPTSTR szTokens[] = { szMonitor, szLeft, szTop, szRight, szBottom };
-    int left, top, right, bottom;
-
-    using namespace LiteStep;
 
     // Parse the input string
     if (LiteStep::LCTokenize(pszLine, szTokens, 5, nullptr) == 5)
     {
-        left = _wtoi(szLeft);
-        top = _wtoi(szTop);
-        right = _wtoi(szRight);
-        bottom = _wtoi(szBottom);
-
-        UINT monitor = ParseMonitor(szMonitor, UINT(-2));
-
-        if (monitor == UINT(-1))
+        UINT monitor = LiteStep::ParseMonitor(szMonitor, UINT(-2));
+        if (monitor != UINT(-2))
         {
-            for (auto &monitor : mInfo->GetMonitors())
+            Declaration declaration = { monitor, { _wtoi(szLeft), _wtoi(szTop), _wtoi(szRight), _wtoi(szBottom) } };
+
+            // A declaration for all monitors overrides everything before it.
+            for (auto iter = sDeclarations.begin(); iter != sDeclarations.end();)
             {
-                RECT r = { monitor.rect.left + left, monitor.rect.top + top, monitor.rect.right - right, monitor.rect.bottom - bottom };
-                SystemParametersInfoW(SPI_SETWORKAREA, 1, &r, 0);
+                if (monitor == UINT(-1) || iter->monitor == monitor)
+                {
+                    iter = sDeclarations.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
             }
-            return;
-        }
-        else if (monitor < mInfo->GetMonitorCount())
-        {
-            RECT mRect = mInfo->GetMonitor(monitor).rect;
-            RECT r = { mRect.left + left, mRect.top + top, mRect.right - right, mRect.bottom - bottom };
-            SystemParametersInfoW(SPI_SETWORKAREA, 1, &r, 0);
-            return;
+            sDeclarations.push_back(declaration);
+            return true;
         }
     }
 
     ErrorHandler::Error(ErrorHandler::Level::Warning, L"%s\nIs not a valid workarea declaration!", pszLine);
+    return false;
 }
 
 
 /// <summary>
-/// Reads and applies all settings from the RC files.
+/// Reads all workarea settings from the RC files.
 /// </summary>
-/// <param name="mInfo">A current MonitorInfo.</param>
-void WorkArea::LoadSettings(MonitorInfo *mInfo, bool /* isRefresh */) {
-    LiteStep::IterateOverLines(L"*nDeskWorkArea", [mInfo] (LPCTSTR line) {
-        ParseLine(mInfo, line);
+void WorkArea::LoadSettings() {
+    sDeclarations.clear();
+    sBars.clear();
+
+    LiteStep::IterateOverLines(L"*nDeskWorkArea", [] (LPCTSTR line) {
+        ParseLine(line);
+    });
+    LiteStep::IterateOverLineTokens(L"*nDeskWorkAreaBar", [] (LPCTSTR name) {
+        sBars.emplace_back(name);
     });
+}
+
+
+/// <summary>
+/// Returns true if any bars are configured.
+/// </summary>
+bool WorkArea::HasBars() {
+    return !sBars.empty();
+}
+
+
+/// <summary>
+/// Works out the workarea of every monitor from the declared margins and the bars which are
+/// currently shown, and applies it.
+/// </summary>
+/// <param name="mInfo">A current MonitorInfo.</param>
+void WorkArea::Apply(MonitorInfo *mInfo) {
+    const std::vector<MonitorInfo::Monitor> &monitors = mInfo->GetMonitors();
+
+    std::vector<WorkAreaSolver::Rect> monitorRects(monitors.size());
+    for (size_t i = 0; i < monitors.size(); ++i) {
+        const RECT &rect = monitors[i].rect;
+        WorkAreaSolver::Rect monitorRect = { rect.left, rect.top, rect.right, rect.bottom };
+        monitorRects[i] = monitorRect;
+    }
+
+    WorkAreaSolver::Margins noMargins = { 0, 0, 0, 0 };
+    std::vector<WorkAreaSolver::Margins> margins(monitors.size(), noMargins);
+    for (const Declaration &declaration : sDeclarations) {
+        if (declaration.monitor == UINT(-1)) {
+            std::fill(margins.begin(), margins.end(), declaration.margins);
+        } else if (declaration.monitor < margins.size()) {
+            margins[declaration.monitor] = declaration.margins;
+        }
+    }
 
-    SendNotifyMessageW(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETWORKAREA, 0);
+    std::vector<WorkAreaSolver::Rect> bars;
+    for (const std::wstring &name : sBars) {
+        Window *window = nCore::System::FindRegisteredWindow(name.c_str());
+        RECT rect;
+        if (window != nullptr && window->IsVisible() && GetWindowRect(window->GetWindowHandle(), &rect)) {
+            WorkAreaSolver::Rect bar = { rect.left, rect.top, rect.right, rect.bottom };
+            bars.push_back(bar);
+        }
+    }
+
+    std::vector<WorkAreaSolver::Rect> solved(monitors.size());
+    WorkAreaSolver::Solve(monitorRects.data(), margins.data(), monitors.size(), bars.data(),
+        bars.size(), solved.data());
+
+    std::vector<RECT> rects(monitors.size()), workAreas(monitors.size());
+    for (size_t i = 0; i < monitors.size(); ++i) {
+        rects[i] = monitors[i].rect;
+        RECT workArea = { solved[i].left, solved[i].top, solved[i].right, solved[i].bottom };
+        workAreas[i] = workArea;
+    }
+    SetWorkAreas(rects, workAreas);
 }
 
 
@@ -74,8 +174,9 @@ void WorkArea::LoadSettings(MonitorInfo *mInfo, bool /* isRefresh */) {
 /// </summary>
 /// <param name="mInfo">A current MonitorInfo.</param>
 void WorkArea::ResetWorkAreas(MonitorInfo *mInfo) {
-  for (auto &monitor : mInfo->GetMonitors()) {
-    SystemParametersInfoW(SPI_SETWORKAREA, 1, const_cast<PRECT>(&monitor.rect), 0);
-  }
-  SendNotifyMessageW(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETWORKAREA, 0);
+    std::vector<RECT> rects;
+    for (auto &monitor : mInfo->GetMonitors()) {
+        rects.push_back(monitor.rect);
+    }
+    SetWorkAreas(rects, rects);
 }
@@ -10,7 +10,9 @@
 #include "../nShared/MonitorInfo.hpp"
 
 namespace WorkArea {
-    void LoadSettings(MonitorInfo *, bool = false);
+    void LoadSettings();
+    void Apply(MonitorInfo *);
     void ResetWorkAreas(MonitorInfo *);
-    void ParseLine(MonitorInfo *, LPCTSTR);
+    bool ParseLine(LPCTSTR);
+    bool HasBars();
 }
@@ -0,0 +1,84 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WorkAreaSolver.cpp
+// The nModules Project
+//
+// Works out the workarea of every monitor.
+//-------------------------------------------------------------------------------------------------
+#include "WorkAreaSolver.hpp"
+
+#include <algorithm>
+
+
+/// <summary>
+/// Works out how much of each edge of a monitor a bar takes up.
+/// </summary>
+WorkAreaSolver::Margins WorkAreaSolver::Reservation(const Rect &monitor, const Rect &bar) {
+  Margins reserved = { 0, 0, 0, 0 };
+
+  // Only the part of the bar which is on the monitor counts.
+  Rect clipped = {
+    std::max(monitor.left, bar.left),
+    std::max(monitor.top, bar.top),
+    std::min(monitor.right, bar.right),
+    std::min(monitor.bottom, bar.bottom)
+  };
+  int32_t width = clipped.right - clipped.left, height = clipped.bottom - clipped.top;
+  if (width <= 0 || height <= 0) {
+    return reserved;
+  }
+
+  if (width >= height) {
+    int32_t toTop = clipped.top - monitor.top, toBottom = monitor.bottom - clipped.bottom;
+    if (toTop <= toBottom && toTop <= height) {
+      reserved.top = clipped.bottom - monitor.top;
+    } else if (toBottom < toTop && toBottom <= height) {
+      reserved.bottom = monitor.bottom - clipped.top;
+    }
+  } else {
+    int32_t toLeft = clipped.left - monitor.left, toRight = monitor.right - clipped.right;
+    if (toLeft <= toRight && toLeft <= width) {
+      reserved.left = clipped.right - monitor.left;
+    } else if (toRight < toLeft && toRight <= width) {
+      reserved.right = monitor.right - clipped.left;
+    }
+  }
+
+  return reserved;
+}
+
+
+/// <summary>
+/// Works out the workarea of each monitor.
+/// </summary>
+void WorkAreaSolver::Solve(const Rect *monitors, const Margins *margins, size_t monitorCount,
+    const Rect *bars, size_t barCount, Rect *workAreas) {
+  for (size_t i = 0; i < monitorCount; ++i) {
+    const Rect &monitor = monitors[i];
+    Margins edges = margins[i];
+
+    for (size_t j = 0; j < barCount; ++j) {
+      Margins reserved = Reservation(monitor, bars[j]);
+      edges.left = std::max(edges.left, reserved.left);
+      edges.top = std::max(edges.top, reserved.top);
+      edges.right = std::max(edges.right, reserved.right);
+      edges.bottom = std::max(edges.bottom, reserved.bottom);
+    }
+
+    Rect &workArea = workAreas[i];
+    workArea.left = monitor.left + edges.left;
+    workArea.top = monitor.top + edges.top;
+    workArea.right = monitor.right - edges.right;
+    workArea.bottom = monitor.bottom - edges.bottom;
+
+    // If the edges leave nothing along an axis, ignore them along that axis, rather than hand
+    // Windows an empty workarea.
+    if (workArea.left >= workArea.right) {
+      workArea.left = monitor.left;
+      workArea.right = monitor.right;
+    }
+    if (workArea.top >= workArea.bottom) {
+      workArea.top = monitor.top;
+      workArea.bottom = monitor.bottom;
+    }
+  }
+}
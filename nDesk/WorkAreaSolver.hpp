@@ -0,0 +1,48 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WorkAreaSolver.hpp
+// The nModules Project
+//
+// Works out the workarea of every monitor.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// <summary>
+/// The workarea of a monitor is what is left of it once the declared margins, and the bars docked
+/// to its edges, have been taken off. A margin and a bar on the same edge don't add up -- the
+/// larger of the two wins, so that a margin can be declared as a fallback for a bar which may not
+/// be there.
+///
+/// Everything is in physical pixels, in virtual desktop coordinates. Monitors with different DPIs
+/// need no special treatment, as long as the bars are measured in physical pixels as well.
+/// </summary>
+namespace WorkAreaSolver {
+  struct Rect {
+    int32_t left, top, right, bottom;
+  };
+
+  struct Margins {
+    int32_t left, top, right, bottom;
+  };
+
+  /// <summary>
+  /// Works out how much of each edge of a monitor a bar takes up. A bar takes up the edge along
+  /// its long side which is closest to it, as long as it is no further from that edge than it is
+  /// thick. Bars which are off the monitor, or float further out, take up nothing.
+  /// </summary>
+  Margins Reservation(const Rect &monitor, const Rect &bar);
+
+  /// <summary>
+  /// Works out the workarea of each monitor.
+  /// </summary>
+  /// <param name="monitors">The rectangle of each monitor.</param>
+  /// <param name="margins">The declared margins of each monitor.</param>
+  /// <param name="monitorCount">The number of monitors.</param>
+  /// <param name="bars">The rectangle of each window which takes up the edge it is docked to.</param>
+  /// <param name="barCount">The number of bars.</param>
+  /// <param name="workAreas">Receives the workarea of each monitor.</param>
+  void Solve(const Rect *monitors, const Margins *margins, size_t monitorCount, const Rect *bars,
+    size_t barCount, Rect *workAreas);
+}
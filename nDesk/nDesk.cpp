@@ -10,6 +10,7 @@
 #include "../nShared/MonitorInfo.hpp"
 #include "../nShared/LSModule.hpp"
 #include "DesktopPainter.hpp"
+#include "WallpaperCache.hpp"
 #include "ClickHandler.hpp"
 #include "WorkArea.h"
 #include "Bangs.h"
@@ -23,6 +24,9 @@
 // The messages we want from the core
 UINT gLSMessages[] = { LM_GETREVID, LM_REFRESH, 0 };
 
+// Posted to apply the workarea once the modules which own the bars have had a chance to load.
+#define NDESK_APPLYWORKAREA (WM_APP + 1)
+
 // Class pointers
 DesktopPainter *g_pDesktopPainter;
 ClickHandler *g_pClickHandler;
@@ -31,6 +35,18 @@ ClickHandler *g_pClickHandler;
 LSModule gLSModule(TEXT(MODULE_NAME), TEXT(MODULE_AUTHOR), MakeVersion(MODULE_VERSION));
 
 
+/// <summary>
+/// Reports the wallpaper cache counters to nCore.
+/// </summary>
+static void ReportWallpaperCounters(COUNTERSINK report, LPVOID sink) {
+    const WallpaperCache::Stats &stats = WallpaperCache::GetStats();
+    report(sink, L"decodedAhead", double(stats.decodedAhead));
+    report(sink, L"decodedInline", double(stats.decodedInline));
+    report(sink, L"reused", double(stats.reused));
+    report(sink, L"waitTime", stats.waitTime);
+}
+
+
 /// <summary>
 /// Called by the LiteStep core when this module is loaded.
 /// </summary>
@@ -72,9 +88,16 @@ EXPORT_CDECL(int) initModuleW(HWND /* parent */, HINSTANCE instance, LPCWSTR /*
     // Load settings
     nDesk::Settings::Load();
 
-    // Reset the work area for all monitors
-    WorkArea::ResetWorkAreas(&nCore::FetchMonitorInfo());
-    WorkArea::LoadSettings(&nCore::FetchMonitorInfo());
+    // Set the work area for all monitors
+    WorkArea::LoadSettings();
+    WorkArea::Apply(&nCore::FetchMonitorInfo());
+    if (WorkArea::HasBars()) {
+        PostMessage(g_pDesktopPainter->GetWindow(), NDESK_APPLYWORKAREA, 0, 0);
+    }
+
+    nCore::System::RegisterCounters(L"nDesk.Wallpapers", ReportWallpaperCounters);
+
+    gLSModule.StartupCompleted();
 
     return 0;
 }
@@ -89,6 +112,7 @@ void quitModule(HINSTANCE /* instance */) {
 
     // Unregister bangs
     Bangs::_Unregister();
+    nCore::System::UnRegisterCounters(L"nDesk.Wallpapers");
 
     // Delete global classes
     if (g_pDesktopPainter) delete g_pDesktopPainter;
@@ -125,11 +149,19 @@ LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM
     case LM_REFRESH:
         {
             g_pClickHandler->Refresh();
-            WorkArea::LoadSettings(&nCore::FetchMonitorInfo(), true);
+            WorkArea::LoadSettings();
+            WorkArea::Apply(&nCore::FetchMonitorInfo());
+            if (WorkArea::HasBars()) {
+                PostMessage(window, NDESK_APPLYWORKAREA, 0, 0);
+            }
             nDesk::Settings::Load();
         }
         return 0;
 
+    case NDESK_APPLYWORKAREA:
+        WorkArea::Apply(&nCore::FetchMonitorInfo());
+        return 0;
+
     case WM_PAINT:
     case WM_ERASEBKGND:
         return g_pDesktopPainter->HandleMessage(window, message, wParam, lParam);
@@ -151,18 +183,24 @@ LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM
 
     case NCORE_DISPLAYCHANGE:
         {
-            // TODO::Ensure
-            g_pDesktopPainter->Resize();
-            nDesk::Settings::OnResolutionChange();
-            WorkArea::LoadSettings(&nCore::FetchMonitorInfo());
-            InvalidateRect(nullptr, nullptr, TRUE);
+            // Workarea changes are broadcast as display changes as well. Only the workareas need
+            // to be worked out again for those.
+            static UINT64 layoutVersion = 0;
+            const MonitorInfo &monitorInfo = nCore::FetchMonitorInfo();
+            if (monitorInfo.GetVersion() != layoutVersion) {
+                layoutVersion = monitorInfo.GetVersion();
+                g_pDesktopPainter->Resize();
+                nDesk::Settings::OnResolutionChange();
+                InvalidateRect(nullptr, nullptr, TRUE);
+            }
+            WorkArea::Apply(&nCore::FetchMonitorInfo());
         }
         break;
 
     case WM_SETTINGCHANGE:
         {
             if (wParam == SPI_SETDESKWALLPAPER) {
-                g_pDesktopPainter->UpdateWallpaper();
+                g_pDesktopPainter->WallpaperChanged();
                 return 0;
             }
         }
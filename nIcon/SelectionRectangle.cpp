@@ -55,15 +55,6 @@ void SelectionRectangle::UpdatePosition(D2D1_RECT_F /* parentPosition */) {
 }
 
 
-/// <summary>
-/// IPaintable::UpdateDWMColor
-/// Called when the DWM color has changed. Returns true if this Paintable is currently using the DWM color.
-/// </summary>
-bool SelectionRectangle::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget* renderTarget) {
-  return mBackBrush.UpdateDWMColor(newColor, renderTarget);
-}
-
-
 void SelectionRectangle::Init(Settings *parentSettings) {
   Settings *settings = parentSettings->CreateChild(L"SelectionRectangle");
   Settings *outlineSettings = settings->CreateChild(L"Outline");
@@ -141,14 +141,16 @@ void Tile::Hide() {
 
 
 /// <summary>
-/// Updates the icon.
+/// Swaps in a re-extracted icon. The old icon stays up until the new one is ready, and isn't
+/// touched at all if the new one has the same pixels.
 /// </summary>
-/// <param name="repaint">Repaints the icon.</param>
-void Tile::UpdateIcon(bool repaint) {
-  mWindow->ClearOverlays();
-  if (repaint) {
-    mWindow->Repaint();
+/// <returns>True if the icon changed.</returns>
+bool Tile::RefreshThumbnail(LoadThumbnailResponse &thumbnail) {
+  if (thumbnail.hash == mThumbnailHash) {
+    return false;
   }
+  SetThumbnail(thumbnail);
+  return true;
 }
 
 
@@ -179,7 +181,7 @@ bool Tile::IsGhosted() {
 /// Enabled ghots mode -- i.e. when the tile is "cut"
 /// </summary>
 void Tile::SetGhost() {
-  mIconOverlay->GetBrush()->SetOpacity(mTileSettings.mGhostOpacity);
+  mIconOverlay->SetOpacity(mTileSettings.mGhostOpacity);
   mGhosted = true;
 }
 
@@ -188,7 +190,7 @@ void Tile::SetGhost() {
 /// Enabled ghots mode -- i.e. when the tile is "cut"
 /// </summary>
 void Tile::ClearGhost() {
-  mIconOverlay->GetBrush()->SetOpacity(1.0f);
+  mIconOverlay->SetOpacity(1.0f);
   mGhosted = false;
 }
 
@@ -221,6 +223,10 @@ void Tile::SetThumbnail(LoadThumbnailResponse &thumbnail) {
   } else {
     ASSERT(false);
   }
+  mThumbnailHash = thumbnail.hash;
+  if (mGhosted) {
+    mIconOverlay->SetOpacity(mTileSettings.mGhostOpacity);
+  }
   mWindow->Repaint();
 }
 
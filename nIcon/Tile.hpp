@@ -51,8 +51,8 @@ public:
   // Renames this item.
   void Rename(PCITEMID_CHILD newItem);
 
-  // Updates the icon.
-  void UpdateIcon(bool repaint = true);
+  // Swaps in a re-extracted icon, if it differs from the current one.
+  bool RefreshThumbnail(LoadThumbnailResponse &thumbnail);
 
   // Shows the right-click menu for the icon.
   void ShowContextMenu();
@@ -90,6 +90,9 @@ private:
   //
   Window::OVERLAY mIconOverlay;
 
+  // The hash of the pixels of the current icon.
+  UINT64 mThumbnailHash;
+
   // True if the mouse is currently above the icon.
   bool mMouseOver;
 
@@ -25,6 +25,13 @@
         | SHCNE_RMDIR | SHCNE_RENAMEITEM | SHCNE_RENAMEFOLDER | SHCNE_UPDATEITEM \
         | SHCNE_UPDATEDIR | SHCNE_UPDATEIMAGE | SHCNE_ASSOCCHANGED
 
+// How long to wait for more change notifications before applying the ones which have arrived, in
+// milliseconds. About a frame.
+static const UINT sChangeDelay = 16;
+
+// Returned by FindPendingChange when there is no pending change for an item.
+static const size_t sNoChange = size_t(-1);
+
 static const WindowSettings sWindowDefaults([] (WindowSettings &defaults) {
   defaults.width = 500;
   defaults.height = 300;
@@ -47,6 +54,27 @@ static const StateRender<TileGroup::State>::InitData sInitData([](StateRender<Ti
 });
 
 
+/// <summary>
+/// Hashes the bytes of an ITEMID.
+/// </summary>
+static size_t HashItem(PCITEMID_CHILD item) {
+  const BYTE *bytes = reinterpret_cast<const BYTE*>(item);
+  size_t hash = 2166136261u;
+  for (USHORT i = 0; i < item->mkid.cb; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+
+/// <summary>
+/// Checks if two ITEMIDs have the same bytes.
+/// </summary>
+static bool ItemsEqual(PCITEMID_CHILD a, PCITEMID_CHILD b) {
+  return a->mkid.cb == b->mkid.cb && memcmp(a, b, a->mkid.cb) == 0;
+}
+
+
 /// <summary>
 /// Constructor
 /// </summary>
@@ -59,7 +87,11 @@ TileGroup::TileGroup(LPCTSTR prefix)
   , mInRectangleSelection(false)
   , mNextPositionID(0)
   , mRootFolder(nullptr)
+  , mPendingUpdateAll(false)
+  , mChangeTimer(0)
 {
+  ZeroMemory(&mRefreshStats, sizeof(mRefreshStats));
+
   LoadSettings();
 
   WindowSettings windowSettings;
@@ -102,6 +134,12 @@ TileGroup::~TileGroup() {
     mWindow->ReleaseUserMessage(mIconLoadedMessage);
   }
 
+  if (mChangeTimer != 0) {
+    mWindow->ClearCallbackTimer(mChangeTimer);
+  }
+  DiscardPendingChanges();
+  mCreateLock.reset();
+
   for (auto tile : mTiles) {
     delete tile;
   }
@@ -189,6 +227,10 @@ void TileGroup::SetFolder(LPWSTR folder) {
     SHChangeNotifyDeregister(mChangeNotifyUID);
     mChangeNotifyUID = 0;
   }
+  DiscardPendingChanges();
+  mRefreshRequests.clear();
+  mCreateRequests.clear();
+  mCreateLock.reset();
 
   // Get the folder we are interested in
   if (_wcsicmp(folder, L"desktop") == 0) {
@@ -223,6 +265,14 @@ void TileGroup::SetFolder(LPWSTR folder) {
 
 LPARAM TileGroup::FolderLoaded(UINT64 id, LoadFolderResponse *response) {
   Window::UpdateLock lock(mWindow);
+  if (mRefreshRequests.erase(id) != 0) {
+    // Items which have come or gone since are left to the change notifications.
+    for (auto &item : response->items) {
+      RefreshIcon(&item, false);
+    }
+    return 0;
+  }
+
   for (auto item : response->items) {
     ItemLoaded(id, &item);
   }
@@ -231,33 +281,48 @@ LPARAM TileGroup::FolderLoaded(UINT64 id, LoadFolderResponse *response) {
 
 
 LPARAM TileGroup::ItemLoaded(UINT64 id, LoadItemResponse *item) {
-  int iconPosition = GetIconPosition(item->id);
-  RECT pos = mLayoutSettings.RectFromID(iconPosition, mTileWidth, mTileHeight, int(mWindow->GetSize().width + 0.5f), int(mWindow->GetSize().height + 0.5f));
-  Tile *icon = new Tile(this, item->id, mWorkingFolder, mTileWidth, mTileHeight, mTileSettings, item->thumbnail);
-  icon->SetPosition(iconPosition, (int)pos.left, (int)pos.top);
-  mTiles.push_back(icon);
+  if (mRefreshRequests.erase(id) != 0) {
+    RefreshIcon(item, true);
+    return 0;
+  }
+
+  // The item may have been created more than once while it was being loaded.
+  if (FindIcon(item->id, false) == mTiles.end()) {
+    int iconPosition = GetIconPosition(item->id);
+    RECT pos = mLayoutSettings.RectFromID(iconPosition, mTileWidth, mTileHeight, int(mWindow->GetSize().width + 0.5f), int(mWindow->GetSize().height + 0.5f));
+    Tile *icon = new Tile(this, item->id, mWorkingFolder, mTileWidth, mTileHeight, mTileSettings, item->thumbnail);
+    icon->SetPosition(iconPosition, (int)pos.left, (int)pos.top);
+    mTiles.push_back(icon);
+    IndexIcon(std::prev(mTiles.end()));
+  }
+
+  // Once the last tile of a burst of creates is in, they are all painted at once.
+  if (mCreateRequests.erase(id) != 0 && mCreateRequests.empty()) {
+    mCreateLock.reset();
+  }
 
   return 0;
 }
 
 
 /// <summary>
-/// Add's the icon with the specified ID to the view
+/// Add's the icon with the specified ID to the view. Returns the ID of the load request, or 0 if
+/// the icon isn't added.
 /// </summary>
-void TileGroup::AddIcon(PCITEMID_CHILD pidl) {
-  // Don't add existing icons
-  if (FindIcon(pidl) != nullptr) return;
+UINT64 TileGroup::AddIcon(PCITEMID_CHILD pidl) {
+  // Don't add existing icons. Created items are new, so there is no need to look beyond the index.
+  if (FindIcon(pidl, false) != mTiles.end()) return 0;
 
   // Check if the icon should be supressed
   WCHAR buffer[MAX_PATH];
   GetDisplayNameOf(pidl, SHGDN_FORPARSING, buffer, _countof(buffer));
-  if (mHiddenItems.find(buffer) != mHiddenItems.end()) return;
+  if (mHiddenItems.find(buffer) != mHiddenItems.end()) return 0;
 
   LoadItemRequest request;
   request.folder = mWorkingFolder;
   request.targetIconWidth = mTileSettings.mIconSize;
   request.id = ILClone(pidl);
-  nCore::LoadFolderItem(request, this);
+  return nCore::LoadFolderItem(request, this);
 }
 
 
@@ -265,15 +330,14 @@ void TileGroup::AddIcon(PCITEMID_CHILD pidl) {
 ///
 /// </summary>
 void TileGroup::RemoveIcon(PCITEMID_CHILD pidl) {
-  mTiles.remove_if([pidl, this] (Tile *tile) -> bool {
-    if (tile->CompareID(pidl) == 0) {
-      mEmptySpots.insert(tile->GetPositionID());
-      delete tile;
-      return true;
-    }
-    return false;
-  });
-  mWindow->Repaint();
+  auto icon = FindIcon(pidl, true);
+  if (icon != mTiles.end()) {
+    mEmptySpots.insert((*icon)->GetPositionID());
+    UnindexIcon(icon);
+    delete *icon;
+    mTiles.erase(icon);
+    mWindow->Repaint();
+  }
 }
 
 
@@ -281,9 +345,21 @@ void TileGroup::RemoveIcon(PCITEMID_CHILD pidl) {
 ///
 /// </summary>
 void TileGroup::UpdateIcon(PCITEMID_CHILD pidl) {
-  auto icon = FindIcon(pidl);
-  if (icon != nullptr) {
-    icon->UpdateIcon();
+  auto icon = FindIcon(pidl, true);
+  if (icon != mTiles.end()) {
+    if (!ItemsEqual((*icon)->GetItem(), pidl)) {
+      // The ID changed along with the file, so the tile was found by scanning. Take on the new ID,
+      // so that the index finds it next time.
+      UnindexIcon(icon);
+      (*icon)->Rename(pidl);
+      IndexIcon(icon);
+    }
+
+    LoadItemRequest request;
+    request.folder = mWorkingFolder;
+    request.targetIconWidth = mTileSettings.mIconSize;
+    request.id = ILClone((*icon)->GetItem());
+    mRefreshRequests.insert(nCore::LoadFolderItem(request, this));
   }
 }
 
@@ -292,9 +368,11 @@ void TileGroup::UpdateIcon(PCITEMID_CHILD pidl) {
 ///
 /// </summary>
 void TileGroup::RenameIcon(PCITEMID_CHILD oldID, PCITEMID_CHILD newID) {
-  auto icon = FindIcon(oldID);
-  if (icon != nullptr) {
-    icon->Rename(newID);
+  auto icon = FindIcon(oldID, true);
+  if (icon != mTiles.end()) {
+    UnindexIcon(icon);
+    (*icon)->Rename(newID);
+    IndexIcon(icon);
   }
 }
 
@@ -315,24 +393,76 @@ int TileGroup::GetIconPosition(PCITEMID_CHILD /* pidl */) {
 /// <summary>
 ///
 /// </summary>
-Tile *TileGroup::FindIcon(PCITEMID_CHILD pidl) const {
-  for (auto tile : mTiles) {
-    if (tile->CompareID(pidl) == 0) {
-      return tile;
+/// <param name="scan">
+/// The ID of a file changes along with its size and write time, so the ID in a notification may
+/// not have the same bytes as the tile's. If scan is true, and the index has no match, every tile
+/// is compared by the shell.
+/// </param>
+std::list<Tile*>::iterator TileGroup::FindIcon(PCITEMID_CHILD pidl, bool scan) {
+  auto range = mTileIndex.equal_range(HashItem(pidl));
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    if ((*iter->second)->CompareID(pidl) == 0) {
+      return iter->second;
+    }
+  }
+
+  if (scan) {
+    for (auto iter = mTiles.begin(); iter != mTiles.end(); ++iter) {
+      if ((*iter)->CompareID(pidl) == 0) {
+        return iter;
+      }
     }
   }
-  return nullptr;
+
+  return mTiles.end();
 }
 
 
 /// <summary>
-/// Updates all icons.
+/// Adds a tile to the index, under its current ID.
+/// </summary>
+void TileGroup::IndexIcon(std::list<Tile*>::iterator icon) {
+  mTileIndex.emplace(HashItem((*icon)->GetItem()), icon);
+}
+
+
+/// <summary>
+/// Removes a tile from the index. Must be called before the tile's ID changes.
+/// </summary>
+void TileGroup::UnindexIcon(std::list<Tile*>::iterator icon) {
+  auto range = mTileIndex.equal_range(HashItem((*icon)->GetItem()));
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    if (iter->second == icon) {
+      mTileIndex.erase(iter);
+      return;
+    }
+  }
+}
+
+
+/// <summary>
+/// Re-extracts all icons, in a single background pass over the folder.
 /// </summary>
 void TileGroup::UpdateAllIcons() {
-  for (auto icon : mTiles) {
-    icon->UpdateIcon(false);
+  LoadFolderRequest request;
+  request.blackList = mHiddenItems;
+  request.folder = mWorkingFolder;
+  request.targetIconWidth = mTileSettings.mIconSize;
+  mRefreshRequests.insert(nCore::LoadFolder(request, this));
+}
+
+
+/// <summary>
+/// Swaps a re-extracted icon into its tile, if it has changed.
+/// </summary>
+void TileGroup::RefreshIcon(LoadItemResponse *item, bool scan) {
+  auto icon = FindIcon(item->id, scan);
+  if (icon != mTiles.end()) {
+    ++mRefreshStats.reextracted;
+    if ((*icon)->RefreshThumbnail(item->thumbnail)) {
+      ++mRefreshStats.changed;
+    }
   }
-  mWindow->Repaint();
 }
 
 
@@ -734,6 +864,14 @@ UINT TileGroup::GetIconLoadedMessage() const {
 }
 
 
+/// <summary>
+/// Returns the counters for icon refreshes.
+/// </summary>
+const TileGroup::RefreshStats &TileGroup::GetRefreshStats() const {
+  return mRefreshStats;
+}
+
+
 /// <summary>
 /// Handles change notifications for the current folder.
 /// </summary>
@@ -747,36 +885,211 @@ LRESULT TileGroup::HandleChangeNotify(HANDLE changeHandle, DWORD processId) {
     case SHCNE_ATTRIBUTES:
     case SHCNE_UPDATEITEM:
     case SHCNE_UPDATEDIR:
-      UpdateIcon(ILFindLastID(idList[0]));
+      QueueChange(ChangeType::Update, ILFindLastID(idList[0]));
       break;
 
     case SHCNE_MKDIR:
     case SHCNE_CREATE:
-      AddIcon(ILFindLastID(idList[0]));
+      QueueChange(ChangeType::Create, ILFindLastID(idList[0]));
       break;
 
     case SHCNE_RMDIR:
     case SHCNE_DELETE:
-      RemoveIcon(ILFindLastID(idList[0]));
+      QueueChange(ChangeType::Remove, ILFindLastID(idList[0]));
       break;
 
     case SHCNE_RENAMEITEM:
     case SHCNE_RENAMEFOLDER:
-      RenameIcon(ILFindLastID(idList[0]), ILFindLastID(idList[1]));
+      QueueChange(ChangeType::Rename, ILFindLastID(idList[0]), ILFindLastID(idList[1]));
       break;
 
     case SHCNE_ASSOCCHANGED:
     case SHCNE_UPDATEIMAGE:
-      UpdateAllIcons();
+      mPendingUpdateAll = true;
       break;
     }
 
     SHChangeNotification_Unlock(notifyLock);
+
+    if (mChangeTimer == 0) {
+      mChangeTimer = mWindow->SetCallbackTimer(sChangeDelay, this);
+    }
   }
   return 0;
 }
 
 
+/// <summary>
+/// Queues up a change to an item, folding it into any change to the same item which is already
+/// queued. Copying thousands of files to the desktop will then only cost a single pass.
+/// </summary>
+void TileGroup::QueueChange(ChangeType type, PCITEMID_CHILD item, PCITEMID_CHILD newItem) {
+  size_t pending = FindPendingChange(item);
+  ChangeType pendingType = pending == sNoChange ? ChangeType::None : mPendingChanges[pending].type;
+
+  switch (type) {
+  case ChangeType::Create:
+    if (pendingType == ChangeType::Create || pendingType == ChangeType::Update ||
+        pendingType == ChangeType::Rename) {
+      // The tile will already be there.
+      return;
+    }
+    if (pendingType == ChangeType::Remove) {
+      // Deleted and created again, like a file which is overwritten. The tile just has to be
+      // updated.
+      mPendingChanges[pending].type = ChangeType::Update;
+      return;
+    }
+    break;
+
+  case ChangeType::Remove:
+    if (pendingType == ChangeType::Remove) {
+      return;
+    }
+    if (pendingType == ChangeType::Create || pendingType == ChangeType::Update) {
+      mPendingChanges[pending].type = ChangeType::None;
+      ForgetPendingChange(item);
+
+      // Created and deleted again, before the tile was ever added.
+      if (pendingType == ChangeType::Create && FindIcon(item, false) == mTiles.end()) {
+        return;
+      }
+    }
+    break;
+
+  case ChangeType::Update:
+    if (mPendingUpdateAll || pendingType == ChangeType::Create || pendingType == ChangeType::Update ||
+        pendingType == ChangeType::Remove) {
+      return;
+    }
+    break;
+
+  case ChangeType::Rename:
+    if (pendingType == ChangeType::Create) {
+      // Created and renamed. Just create it under the new name.
+      mPendingChanges[pending].type = ChangeType::None;
+      ForgetPendingChange(item);
+      QueueChange(ChangeType::Create, newItem);
+      return;
+    }
+    ForgetPendingChange(item);
+    break;
+  }
+
+  PendingChange change = { type, ILClone(item), newItem ? ILClone(newItem) : nullptr };
+  mPendingChanges.push_back(change);
+
+  // Renames are found by the new ID from now on.
+  PCITEMID_CHILD key = type == ChangeType::Rename ? newItem : item;
+  ForgetPendingChange(key);
+  mPendingIndex.emplace(HashItem(key), mPendingChanges.size() - 1);
+}
+
+
+/// <summary>
+/// Returns the index of the latest pending change to an item, or sNoChange if there isn't one.
+/// </summary>
+size_t TileGroup::FindPendingChange(PCITEMID_CHILD item) const {
+  auto range = mPendingIndex.equal_range(HashItem(item));
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    const PendingChange &change = mPendingChanges[iter->second];
+    if (ItemsEqual(change.type == ChangeType::Rename ? change.newItem : change.item, item)) {
+      return iter->second;
+    }
+  }
+  return sNoChange;
+}
+
+
+/// <summary>
+/// Stops later changes to an item from being folded into the ones which are already queued.
+/// </summary>
+void TileGroup::ForgetPendingChange(PCITEMID_CHILD item) {
+  size_t pending = FindPendingChange(item);
+  if (pending != sNoChange) {
+    auto range = mPendingIndex.equal_range(HashItem(item));
+    for (auto iter = range.first; iter != range.second; ++iter) {
+      if (iter->second == pending) {
+        mPendingIndex.erase(iter);
+        return;
+      }
+    }
+  }
+}
+
+
+/// <summary>
+/// Applies all queued changes, with a single repaint.
+/// </summary>
+void TileGroup::ApplyPendingChanges() {
+  if (mChangeTimer != 0) {
+    mWindow->ClearCallbackTimer(mChangeTimer);
+    mChangeTimer = 0;
+  }
+
+  // Shell calls may pump messages, so more changes can come in while these are applied.
+  std::vector<PendingChange> changes;
+  changes.swap(mPendingChanges);
+  mPendingIndex.clear();
+  bool updateAll = mPendingUpdateAll;
+  mPendingUpdateAll = false;
+
+  Window::UpdateLock lock(mWindow);
+
+  for (PendingChange &change : changes) {
+    switch (change.type) {
+    case ChangeType::Create:
+      {
+        UINT64 request = AddIcon(change.item);
+        if (request != 0) {
+          mCreateRequests.insert(request);
+        }
+      }
+      break;
+
+    case ChangeType::Remove:
+      RemoveIcon(change.item);
+      break;
+
+    case ChangeType::Update:
+      if (!updateAll) {
+        UpdateIcon(change.item);
+      }
+      break;
+
+    case ChangeType::Rename:
+      RenameIcon(change.item, change.newItem);
+      break;
+    }
+    ILFree(change.item);
+    ILFree(change.newItem);
+  }
+
+  if (updateAll) {
+    UpdateAllIcons();
+  }
+
+  // The tiles arrive one message at a time. Keep the window from painting until they all have.
+  if (!mCreateRequests.empty() && !mCreateLock) {
+    mCreateLock.reset(new Window::UpdateLock(mWindow));
+  }
+}
+
+
+/// <summary>
+/// Drops all queued changes.
+/// </summary>
+void TileGroup::DiscardPendingChanges() {
+  for (PendingChange &change : mPendingChanges) {
+    ILFree(change.item);
+    ILFree(change.newItem);
+  }
+  mPendingChanges.clear();
+  mPendingIndex.clear();
+  mPendingUpdateAll = false;
+}
+
+
 /// <summary>
 /// Handles window messages.
 /// </summary>
@@ -785,6 +1098,11 @@ LRESULT WINAPI TileGroup::HandleMessage(HWND window, UINT message, WPARAM wParam
     return HandleChangeNotify(HANDLE(wParam), DWORD(lParam));
   }
 
+  if (mChangeTimer != 0 && message == WM_TIMER && wParam == mChangeTimer) {
+    ApplyPendingChanges();
+    return 0;
+  }
+
   if (mContextMenu3) {
     LRESULT result;
     if (SUCCEEDED(mContextMenu3->HandleMenuMsg2(message, wParam, lParam, &result))) {
@@ -880,6 +1198,9 @@ LRESULT WINAPI TileGroup::HandleMessage(HWND window, UINT message, WPARAM wParam
     break;
 
   case Window::WM_TOPPARENTLOST:
+    // The timer is going away along with the top parent.
+    mChangeTimer = 0;
+    ApplyPendingChanges();
     mChangeNotifyMsg = 0;
     if (mChangeNotifyUID != 0) {
       SHChangeNotifyDeregister(mChangeNotifyUID);
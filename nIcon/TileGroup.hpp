@@ -20,9 +20,13 @@
 
 #include "../Utilities/StringUtils.h"
 
+#include <list>
+#include <memory>
 #include <set>
 #include <ShlObj.h>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 class TileGroup : public Drawable, public FileSystemLoaderResponseHandler {
 public:
@@ -31,6 +35,17 @@ public:
     Count
   };
 
+  /// <summary>
+  /// Counters for icon refreshes.
+  /// </summary>
+  struct RefreshStats {
+    // Tiles whose icon was extracted again.
+    ULONGLONG reextracted;
+
+    // Tiles whose re-extracted icon turned out to be different, and was swapped in.
+    ULONGLONG changed;
+  };
+
 public:
   explicit TileGroup(LPCTSTR prefix);
   ~TileGroup();
@@ -46,6 +61,30 @@ public:
 private:
   LRESULT HandleChangeNotify(HANDLE changeHandle, DWORD processId);
 
+  // Change notifications are queued, and applied together once the burst is over.
+private:
+  enum class ChangeType {
+    None,
+    Create,
+    Remove,
+    Update,
+    Rename
+  };
+
+  struct PendingChange {
+    ChangeType type;
+    PITEMID_CHILD item;
+
+    // The new ID of the item, for renames.
+    PITEMID_CHILD newItem;
+  };
+
+  void QueueChange(ChangeType type, PCITEMID_CHILD item, PCITEMID_CHILD newItem = nullptr);
+  size_t FindPendingChange(PCITEMID_CHILD item) const;
+  void ForgetPendingChange(PCITEMID_CHILD item);
+  void ApplyPendingChanges();
+  void DiscardPendingChanges();
+
 public:
   void SetFolder(LPWSTR path);
 
@@ -55,17 +94,21 @@ public:
   void HandleClipboardChange();
   void ClearAllGhosting(bool repaint);
   UINT GetIconLoadedMessage() const;
+  const RefreshStats &GetRefreshStats() const;
 
 private:
   HRESULT GetDisplayNameOf(PCITEMID_CHILD pidl, SHGDNF flags, LPWSTR buf, UINT cchBuf) const;
   HRESULT GetFolderPath(LPWSTR buf, UINT cchBuf) const;
-  void AddIcon(PCITEMID_CHILD pidl);
+  UINT64 AddIcon(PCITEMID_CHILD pidl);
   void RemoveIcon(PCITEMID_CHILD pidl);
   void UpdateIcon(PCITEMID_CHILD pidl);
   void UpdateAllIcons();
+  void RefreshIcon(LoadItemResponse *item, bool scan);
   void RenameIcon(PCITEMID_CHILD oldID, PCITEMID_CHILD newID);
   int GetIconPosition(PCITEMID_CHILD);
-  Tile *FindIcon(PCITEMID_CHILD) const;
+  std::list<Tile*>::iterator FindIcon(PCITEMID_CHILD, bool scan);
+  void IndexIcon(std::list<Tile*>::iterator);
+  void UnindexIcon(std::list<Tile*>::iterator);
 
   void ImportFolderContents();
   void AddNameFilter(LPCWSTR name);
@@ -94,6 +137,32 @@ private:
   // All icons currently part of this group.
   std::list<Tile*> mTiles;
 
+  // mTiles, by the hash of each tile's ITEMID.
+  std::unordered_multimap<size_t, std::list<Tile*>::iterator> mTileIndex;
+
+  // Change notifications which have yet to be applied, in the order they arrived.
+  std::vector<PendingChange> mPendingChanges;
+
+  // The latest entry in mPendingChanges for each item, by the hash of its ITEMID.
+  std::unordered_multimap<size_t, size_t> mPendingIndex;
+
+  // True if every icon should be updated once the pending changes are applied.
+  bool mPendingUpdateAll;
+
+  // Fires when the pending changes should be applied.
+  UINT_PTR mChangeTimer;
+
+  // Outstanding requests to re-extract icons.
+  std::unordered_set<UINT64> mRefreshRequests;
+
+  // Outstanding loads of the tiles created by the latest pending changes.
+  std::unordered_set<UINT64> mCreateRequests;
+
+  // Held while mCreateRequests is not empty, so that those tiles are painted together.
+  std::unique_ptr<Window::UpdateLock> mCreateLock;
+
+  RefreshStats mRefreshStats;
+
   // Return value of the latest SHChangeNofityRegister call.
   ULONG mChangeNotifyUID;
   UINT mChangeNotifyMsg;
@@ -72,6 +72,7 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
   sNextClipboardViewer = SetClipboardViewer(gLSModule.GetMessageWindow());
   OleInitialize(nullptr);
   LoadSettings();
+  gLSModule.StartupCompleted();
   return 0;
 }
 
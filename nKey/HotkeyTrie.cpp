@@ -0,0 +1,142 @@
+//-------------------------------------------------------------------------------------------------
+// /nKey/HotkeyTrie.cpp
+// The nModules Project
+//
+// Tracks hotkeys which are sequences of key presses.
+//-------------------------------------------------------------------------------------------------
+#include "HotkeyTrie.hpp"
+
+#include <assert.h>
+
+
+HotkeyTrie::HotkeyTrie() {
+  Clear();
+}
+
+
+/// <summary>
+/// Removes every node but the root, and ends any sequence.
+/// </summary>
+void HotkeyTrie::Clear() {
+  Node root;
+  root.mods = 0;
+  root.key = 0;
+  root.flags = 0;
+  root.parent = sNone;
+  root.action = sNone;
+
+  mNodes.clear();
+  mNodes.push_back(root);
+  mPending = sNone;
+}
+
+
+/// <summary>
+/// Returns the child of node which is reached by the specified press, or sNone.
+/// </summary>
+uint32_t HotkeyTrie::FindChild(uint32_t node, uint32_t mods, uint32_t key) const {
+  for (uint32_t child : mNodes[node].children) {
+    if (mNodes[child].mods == mods && mNodes[child].key == key) {
+      return child;
+    }
+  }
+  return sNone;
+}
+
+
+/// <summary>
+/// Returns the child of node which is reached by the specified press, adding it if there isn't
+/// one.
+/// </summary>
+uint32_t HotkeyTrie::AddChild(uint32_t node, uint32_t mods, uint32_t key, uint32_t flags,
+    bool &added) {
+  uint32_t child = FindChild(node, mods, key);
+  added = child == sNone;
+  if (added) {
+    Node newNode;
+    newNode.mods = mods;
+    newNode.key = key;
+    newNode.flags = flags;
+    newNode.parent = node;
+    newNode.action = sNone;
+
+    child = uint32_t(mNodes.size());
+    mNodes.push_back(newNode);
+    mNodes[node].children.push_back(child);
+  }
+  return child;
+}
+
+
+/// <summary>
+/// Removes the most recently added node, which must not have any children.
+/// </summary>
+void HotkeyTrie::RemoveLast() {
+  assert(mNodes.size() > 1 && mNodes.back().children.empty());
+  mNodes[mNodes.back().parent].children.pop_back();
+  mNodes.pop_back();
+}
+
+
+/// <summary>
+/// Returns the specified node.
+/// </summary>
+const HotkeyTrie::Node &HotkeyTrie::GetNode(uint32_t node) const {
+  return mNodes[node];
+}
+
+
+/// <summary>
+/// Sets the action of a node.
+/// </summary>
+void HotkeyTrie::SetAction(uint32_t node, uint32_t action) {
+  mNodes[node].action = action;
+}
+
+
+/// <summary>
+/// Returns the number of nodes, the root included.
+/// </summary>
+uint32_t HotkeyTrie::GetNodeCount() const {
+  return uint32_t(mNodes.size());
+}
+
+
+/// <summary>
+/// Handles a registered hotkey, which leads to the specified node.
+/// </summary>
+uint32_t HotkeyTrie::Press(uint32_t node) {
+  // The keys which continue a sequence may well be hotkeys of their own. They can only be
+  // registered once, so a press of one may arrive as either.
+  if (mPending != sNone) {
+    uint32_t next = FindChild(mPending, mNodes[node].mods, mNodes[node].key);
+    mPending = sNone;
+    if (next != sNone) {
+      node = next;
+    }
+  }
+
+  if (!mNodes[node].children.empty()) {
+    mPending = node;
+    return sNone;
+  }
+  return node;
+}
+
+
+/// <summary>
+/// Ends the sequence in progress, because its time ran out.
+/// </summary>
+uint32_t HotkeyTrie::Timeout() {
+  uint32_t node = mPending;
+  mPending = sNone;
+  return node != sNone && mNodes[node].action != sNone ? node : sNone;
+}
+
+
+/// <summary>
+/// Returns the node reached by the sequence in progress, or sNone.
+/// </summary>
+uint32_t HotkeyTrie::GetPending() const {
+  return mPending;
+}
@@ -0,0 +1,102 @@
+//-------------------------------------------------------------------------------------------------
+// /nKey/HotkeyTrie.hpp
+// The nModules Project
+//
+// Tracks hotkeys which are sequences of key presses.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// Every hotkey is a path from the root, one node per key press. A plain hotkey is a single child
+/// of the root. Pressing a node which has children starts a sequence, during which the next press
+/// either continues it, or starts over from the root.
+///
+/// The trie only decides which node was reached. Registering the keys, and timing out the
+/// sequence, is up to the caller.
+/// </summary>
+class HotkeyTrie {
+public:
+  static const uint32_t sNone = 0xFFFFFFFF;
+  static const uint32_t sRoot = 0;
+
+  struct Node {
+    // The key press which leads to this node.
+    uint32_t mods;
+    uint32_t key;
+
+    // Passed on to the caller untouched. nKey keeps extra RegisterHotKey flags here.
+    uint32_t flags;
+
+    uint32_t parent;
+
+    // The action to run when this node is reached, or sNone.
+    uint32_t action;
+
+    std::vector<uint32_t> children;
+  };
+
+public:
+  HotkeyTrie();
+
+public:
+  /// <summary>
+  /// Removes every node but the root, and ends any sequence.
+  /// </summary>
+  void Clear();
+
+  /// <summary>
+  /// Returns the child of node which is reached by the specified press, or sNone.
+  /// </summary>
+  uint32_t FindChild(uint32_t node, uint32_t mods, uint32_t key) const;
+
+  /// <summary>
+  /// Returns the child of node which is reached by the specified press, adding it if there isn't
+  /// one.
+  /// </summary>
+  uint32_t AddChild(uint32_t node, uint32_t mods, uint32_t key, uint32_t flags, bool &added);
+
+  /// <summary>
+  /// Removes the most recently added node, which must not have any children.
+  /// </summary>
+  void RemoveLast();
+
+  /// <summary>
+  /// Returns the specified node.
+  /// </summary>
+  const Node &GetNode(uint32_t node) const;
+
+  /// <summary>
+  /// Sets the action of a node.
+  /// </summary>
+  void SetAction(uint32_t node, uint32_t action);
+
+  /// <summary>
+  /// Returns the number of nodes, the root included.
+  /// </summary>
+  uint32_t GetNodeCount() const;
+
+  /// <summary>
+  /// Handles a registered hotkey, which leads to the specified node. If a sequence is in progress
+  /// and the press continues it, the sequence advances instead.
+  /// </summary>
+  /// <returns>The node whose action should run, or sNone if a sequence is now in progress.</returns>
+  uint32_t Press(uint32_t node);
+
+  /// <summary>
+  /// Ends the sequence in progress, because its time ran out.
+  /// </summary>
+  /// <returns>The node the sequence had reached, if it has an action, otherwise sNone.</returns>
+  uint32_t Timeout();
+
+  /// <summary>
+  /// Returns the node reached by the sequence in progress, or sNone.
+  /// </summary>
+  uint32_t GetPending() const;
+
+private:
+  std::vector<Node> mNodes;
+  uint32_t mPending;
+};
@@ -0,0 +1,145 @@
+//-------------------------------------------------------------------------------------------------
+// /nKey/VirtualKeys.cpp
+// The nModules Project
+//
+// The names of the virtual keys which nKey knows about without a VK table.
+//-------------------------------------------------------------------------------------------------
+#include "VirtualKeys.hpp"
+
+#define VIRTUAL_KEY(name) { _CRT_WIDE(#name), name }
+
+const VirtualKeys::Name VirtualKeys::gBuiltIn[] = {
+  VIRTUAL_KEY(VK_CANCEL),
+  VIRTUAL_KEY(VK_BACK),
+  VIRTUAL_KEY(VK_TAB),
+  VIRTUAL_KEY(VK_CLEAR),
+  VIRTUAL_KEY(VK_RETURN),
+  VIRTUAL_KEY(VK_SHIFT),
+  VIRTUAL_KEY(VK_CONTROL),
+  VIRTUAL_KEY(VK_MENU),
+  VIRTUAL_KEY(VK_PAUSE),
+  VIRTUAL_KEY(VK_CAPITAL),
+  VIRTUAL_KEY(VK_KANA),
+  VIRTUAL_KEY(VK_HANGUL),
+  VIRTUAL_KEY(VK_JUNJA),
+  VIRTUAL_KEY(VK_FINAL),
+  VIRTUAL_KEY(VK_HANJA),
+  VIRTUAL_KEY(VK_KANJI),
+  VIRTUAL_KEY(VK_ESCAPE),
+  VIRTUAL_KEY(VK_CONVERT),
+  VIRTUAL_KEY(VK_NONCONVERT),
+  VIRTUAL_KEY(VK_ACCEPT),
+  VIRTUAL_KEY(VK_MODECHANGE),
+  VIRTUAL_KEY(VK_SPACE),
+  VIRTUAL_KEY(VK_PRIOR),
+  VIRTUAL_KEY(VK_NEXT),
+  VIRTUAL_KEY(VK_END),
+  VIRTUAL_KEY(VK_HOME),
+  VIRTUAL_KEY(VK_LEFT),
+  VIRTUAL_KEY(VK_UP),
+  VIRTUAL_KEY(VK_RIGHT),
+  VIRTUAL_KEY(VK_DOWN),
+  VIRTUAL_KEY(VK_SELECT),
+  VIRTUAL_KEY(VK_PRINT),
+  VIRTUAL_KEY(VK_EXECUTE),
+  VIRTUAL_KEY(VK_SNAPSHOT),
+  VIRTUAL_KEY(VK_INSERT),
+  VIRTUAL_KEY(VK_DELETE),
+  VIRTUAL_KEY(VK_HELP),
+  VIRTUAL_KEY(VK_LWIN),
+  VIRTUAL_KEY(VK_RWIN),
+  VIRTUAL_KEY(VK_APPS),
+  VIRTUAL_KEY(VK_SLEEP),
+  VIRTUAL_KEY(VK_NUMPAD0),
+  VIRTUAL_KEY(VK_NUMPAD1),
+  VIRTUAL_KEY(VK_NUMPAD2),
+  VIRTUAL_KEY(VK_NUMPAD3),
+  VIRTUAL_KEY(VK_NUMPAD4),
+  VIRTUAL_KEY(VK_NUMPAD5),
+  VIRTUAL_KEY(VK_NUMPAD6),
+  VIRTUAL_KEY(VK_NUMPAD7),
+  VIRTUAL_KEY(VK_NUMPAD8),
+  VIRTUAL_KEY(VK_NUMPAD9),
+  VIRTUAL_KEY(VK_MULTIPLY),
+  VIRTUAL_KEY(VK_ADD),
+  VIRTUAL_KEY(VK_SEPARATOR),
+  VIRTUAL_KEY(VK_SUBTRACT),
+  VIRTUAL_KEY(VK_DECIMAL),
+  VIRTUAL_KEY(VK_DIVIDE),
+  VIRTUAL_KEY(VK_F1),
+  VIRTUAL_KEY(VK_F2),
+  VIRTUAL_KEY(VK_F3),
+  VIRTUAL_KEY(VK_F4),
+  VIRTUAL_KEY(VK_F5),
+  VIRTUAL_KEY(VK_F6),
+  VIRTUAL_KEY(VK_F7),
+  VIRTUAL_KEY(VK_F8),
+  VIRTUAL_KEY(VK_F9),
+  VIRTUAL_KEY(VK_F10),
+  VIRTUAL_KEY(VK_F11),
+  VIRTUAL_KEY(VK_F12),
+  VIRTUAL_KEY(VK_F13),
+  VIRTUAL_KEY(VK_F14),
+  VIRTUAL_KEY(VK_F15),
+  VIRTUAL_KEY(VK_F16),
+  VIRTUAL_KEY(VK_F17),
+  VIRTUAL_KEY(VK_F18),
+  VIRTUAL_KEY(VK_F19),
+  VIRTUAL_KEY(VK_F20),
+  VIRTUAL_KEY(VK_F21),
+  VIRTUAL_KEY(VK_F22),
+  VIRTUAL_KEY(VK_F23),
+  VIRTUAL_KEY(VK_F24),
+  VIRTUAL_KEY(VK_NUMLOCK),
+  VIRTUAL_KEY(VK_SCROLL),
+  VIRTUAL_KEY(VK_LSHIFT),
+  VIRTUAL_KEY(VK_RSHIFT),
+  VIRTUAL_KEY(VK_LCONTROL),
+  VIRTUAL_KEY(VK_RCONTROL),
+  VIRTUAL_KEY(VK_LMENU),
+  VIRTUAL_KEY(VK_RMENU),
+  VIRTUAL_KEY(VK_BROWSER_BACK),
+  VIRTUAL_KEY(VK_BROWSER_FORWARD),
+  VIRTUAL_KEY(VK_BROWSER_REFRESH),
+  VIRTUAL_KEY(VK_BROWSER_STOP),
+  VIRTUAL_KEY(VK_BROWSER_SEARCH),
+  VIRTUAL_KEY(VK_BROWSER_FAVORITES),
+  VIRTUAL_KEY(VK_BROWSER_HOME),
+  VIRTUAL_KEY(VK_VOLUME_MUTE),
+  VIRTUAL_KEY(VK_VOLUME_DOWN),
+  VIRTUAL_KEY(VK_VOLUME_UP),
+  VIRTUAL_KEY(VK_MEDIA_NEXT_TRACK),
+  VIRTUAL_KEY(VK_MEDIA_PREV_TRACK),
+  VIRTUAL_KEY(VK_MEDIA_STOP),
+  VIRTUAL_KEY(VK_MEDIA_PLAY_PAUSE),
+  VIRTUAL_KEY(VK_LAUNCH_MAIL),
+  VIRTUAL_KEY(VK_LAUNCH_MEDIA_SELECT),
+  VIRTUAL_KEY(VK_LAUNCH_APP1),
+  VIRTUAL_KEY(VK_LAUNCH_APP2),
+  VIRTUAL_KEY(VK_OEM_1),
+  VIRTUAL_KEY(VK_OEM_PLUS),
+  VIRTUAL_KEY(VK_OEM_COMMA),
+  VIRTUAL_KEY(VK_OEM_MINUS),
+  VIRTUAL_KEY(VK_OEM_PERIOD),
+  VIRTUAL_KEY(VK_OEM_2),
+  VIRTUAL_KEY(VK_OEM_3),
+  VIRTUAL_KEY(VK_OEM_4),
+  VIRTUAL_KEY(VK_OEM_5),
+  VIRTUAL_KEY(VK_OEM_6),
+  VIRTUAL_KEY(VK_OEM_7),
+  VIRTUAL_KEY(VK_OEM_8),
+  VIRTUAL_KEY(VK_OEM_102),
+  VIRTUAL_KEY(VK_PROCESSKEY),
+  VIRTUAL_KEY(VK_PACKET),
+  VIRTUAL_KEY(VK_ATTN),
+  VIRTUAL_KEY(VK_CRSEL),
+  VIRTUAL_KEY(VK_EXSEL),
+  VIRTUAL_KEY(VK_EREOF),
+  VIRTUAL_KEY(VK_PLAY),
+  VIRTUAL_KEY(VK_ZOOM),
+  VIRTUAL_KEY(VK_NONAME),
+  VIRTUAL_KEY(VK_PA1),
+  VIRTUAL_KEY(VK_OEM_CLEAR),
+};
+
+const size_t VirtualKeys::gBuiltInCount = _countof(VirtualKeys::gBuiltIn);
@@ -0,0 +1,23 @@
+//-------------------------------------------------------------------------------------------------
+// /nKey/VirtualKeys.hpp
+// The nModules Project
+//
+// The names of the virtual keys which nKey knows about without a VK table.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/Common.h"
+
+namespace VirtualKeys {
+  struct Name {
+    LPCWSTR name;
+    UINT code;
+  };
+
+  /// <summary>
+  /// Every named virtual key in WinUser.h, by its VK_ name. Keys which are typed as a single
+  /// character are left out, as are the mouse buttons.
+  /// </summary>
+  extern const Name gBuiltIn[];
+  extern const size_t gBuiltInCount;
+}
@@ -5,56 +5,113 @@
 // nKey entry points.
 //-------------------------------------------------------------------------------------------------
 #define _CRT_SECURE_NO_WARNINGS
+#include "HotkeyTrie.hpp"
 #include "Version.h"
+#include "VirtualKeys.hpp"
 
 #include "../nShared/ErrorHandler.h"
 #include "../nShared/LiteStep.h"
 #include "../nShared/LSModule.hpp"
 
-#include "../Utilities/StringUtils.h"
+#include "../Utilities/LineTokenizer.hpp"
+#include "../Utilities/PerfectHash.hpp"
+#include "../Utilities/StopWatch.hpp"
 
-#include <unordered_map>
+#include <algorithm>
 #include <Shlwapi.h>
 #include <strsafe.h>
+#include <vector>
 
-typedef std::unordered_map<int, std::wstring> HotkeyMap;
-typedef StringKeyedMaps<std::wstring, UINT, CaseSensitive>::UnorderedMap VKMap;
+/// <summary>
+/// The command of a hotkey, split up when it is loaded.
+/// </summary>
+struct Action {
+  // The bang and its arguments, if the command is a bang.
+  std::wstring bang;
+  std::wstring args;
+
+  // The command, if it isn't.
+  std::wstring command;
+};
+
+/// <summary>
+/// Counters for all hotkeys pressed since the module was loaded.
+/// </summary>
+struct DispatchStats {
+  // WM_HOTKEY messages which were handled.
+  ULONGLONG presses;
+
+  // Actions which were started right away by a press.
+  ULONGLONG actions;
+
+  // Sequences which were started, and the ones which ran out of time.
+  ULONGLONG sequences;
+  ULONGLONG timeouts;
+
+  // The time from when a key was pressed until its WM_HOTKEY was handled, in milliseconds. Only
+  // as precise as GetMessageTime.
+  ULONGLONG totalQueueDelay;
+  DWORD maxQueueDelay;
+
+  // The time from when WM_HOTKEY was handled until the action started, in milliseconds.
+  double totalHandlingTime;
+  double maxHandlingTime;
+};
 
-static void LoadSettings();
 static void LoadHotKeys();
 static void LoadVKeyTable();
-static std::pair<bool, LPCWSTR> AddHotkey(UINT mods, UINT key, LPCWSTR command);
+static std::pair<bool, LPCWSTR> AddHotkey(UINT mods, LPCWSTR keys, LPCWSTR command);
+static bool ParseSequence(UINT mods, LPCWSTR keys, std::vector<std::pair<UINT, UINT>> &presses);
+static Action ParseCommand(LPCWSTR command);
 static UINT ParseMods(LPCWSTR mods);
 static UINT ParseKey(LPCWSTR key);
+static void Dispatch(uint32_t node);
+static void EndSequence();
+static void RunAction(uint32_t action);
+static void ShowDispatchStats();
 
 // The messages we want from the core
 static UINT gLSMessages[] = { LM_GETREVID, LM_REFRESH, 0 };
 
-// All hotkey mappings
-static HotkeyMap gHotKeys;
+// All hotkeys. The id each hotkey is registered with is the index of its node.
+static HotkeyTrie gHotKeys;
+
+// The commands of all hotkeys, as indexed by the action of their nodes.
+static std::vector<Action> gActions;
+
+// The built-in names, and the definitions loaded from vk104.txt
+static PerfectHash<UINT> gVKCodes;
+
+// The keys which are registered while a sequence is in progress.
+static std::vector<int> gSequenceIds;
+
+// The time the next key of a sequence has to be pressed within, in milliseconds.
+static UINT gSequenceTimeout;
 
-// Definitions loaded from vk104.txt
-static VKMap gVKCodes;
+static DispatchStats gStats = { 0, 0, 0, 0, 0, 0, 0.0, 0.0 };
 
-// Used for assigning hotkeys.
-static int gId = 0;
+// Goes off when the sequence in progress runs out of time.
+static const UINT_PTR sSequenceTimer = 1;
 
 // The LiteStep module class
 static LSModule gLSModule(TEXT(MODULE_NAME), TEXT(MODULE_AUTHOR), MakeVersion(MODULE_VERSION));
 
 
 static void Load() {
+  gSequenceTimeout = LiteStep::GetRCInt(L"nKeySequenceTimeout", 1000);
   LoadVKeyTable();
   LoadHotKeys();
 }
 
 
 static void Unload() {
-  for (auto &hotkey : gHotKeys) {
-    UnregisterHotKey(gLSModule.GetMessageWindow(), hotkey.first);
+  EndSequence();
+  for (uint32_t node : gHotKeys.GetNode(HotkeyTrie::sRoot).children) {
+    UnregisterHotKey(gLSModule.GetMessageWindow(), int(node));
   }
-  gHotKeys.clear();
-  gVKCodes.clear();
+  gHotKeys.Clear();
+  gActions.clear();
+  gVKCodes.Clear();
 }
 
 
@@ -74,6 +131,12 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
     return 1;
   }
   Load();
+
+  LiteStep::AddBangCommand(L"!nKeyDispatchStats", [] (HWND, LPCTSTR) -> void {
+    ShowDispatchStats();
+  });
+
+  gLSModule.StartupCompleted();
   return 0;
 }
 
@@ -83,6 +146,7 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
 /// </summary>
 /// <param name="instance">Handle to this module's instance.</param>
 EXPORT_CDECL(void) quitModule(HINSTANCE /* instance */) {
+  LiteStep::RemoveBangCommand(L"!nKeyDispatchStats");
   Unload();
   gLSModule.DeInitalize();
 }
@@ -112,9 +176,18 @@ LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM
     return 0;
 
   case WM_HOTKEY:
-    HotkeyMap::iterator hotkey = gHotKeys.find((int)wParam);
-    if (hotkey != gHotKeys.end()) {
-      LiteStep::LSExecute(window, hotkey->second.c_str(), 0);
+    Dispatch(uint32_t(wParam));
+    return 0;
+
+  case WM_TIMER:
+    if (wParam == sSequenceTimer) {
+      // A sequence which stopped at a hotkey of its own runs that one.
+      uint32_t node = gHotKeys.Timeout();
+      EndSequence();
+      ++gStats.timeouts;
+      if (node != HotkeyTrie::sNone) {
+        RunAction(gHotKeys.GetNode(node).action);
+      }
     }
     return 0;
   }
@@ -122,26 +195,160 @@ LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM
 }
 
 
+/// <summary>
+/// Handles a press of the hotkey registered for the specified node.
+/// </summary>
+static void Dispatch(uint32_t node) {
+  StopWatch stopWatch;
+  DWORD queueDelay = GetTickCount() - DWORD(GetMessageTime());
+  ++gStats.presses;
+  gStats.totalQueueDelay += queueDelay;
+  gStats.maxQueueDelay = std::max(gStats.maxQueueDelay, queueDelay);
+
+  if (node == HotkeyTrie::sRoot || node >= gHotKeys.GetNodeCount()) {
+    return;
+  }
+
+  // Whichever way the press goes, any sequence in progress is over.
+  uint32_t reached = gHotKeys.Press(node);
+  EndSequence();
+
+  if (reached == HotkeyTrie::sNone) {
+    // Register the keys which continue the sequence, for as long as it lasts. Keys which are
+    // taken, including by other hotkeys of ours, fail to register. Presses of those which are
+    // ours still arrive, under the id of the other hotkey, and Press sorts them out.
+    const HotkeyTrie::Node &pending = gHotKeys.GetNode(gHotKeys.GetPending());
+    for (uint32_t child : pending.children) {
+      const HotkeyTrie::Node &next = gHotKeys.GetNode(child);
+      if (RegisterHotKey(gLSModule.GetMessageWindow(), int(child), next.mods | next.flags, next.key) != FALSE) {
+        gSequenceIds.push_back(int(child));
+      }
+    }
+    SetTimer(gLSModule.GetMessageWindow(), sSequenceTimer, gSequenceTimeout, nullptr);
+    ++gStats.sequences;
+    return;
+  }
+
+  double handlingTime = stopWatch.GetTime() * 1000.0;
+  ++gStats.actions;
+  gStats.totalHandlingTime += handlingTime;
+  gStats.maxHandlingTime = std::max(gStats.maxHandlingTime, handlingTime);
+
+  RunAction(gHotKeys.GetNode(reached).action);
+}
+
+
+/// <summary>
+/// Unregisters the keys of the sequence in progress, if there is one.
+/// </summary>
+static void EndSequence() {
+  KillTimer(gLSModule.GetMessageWindow(), sSequenceTimer);
+  for (int id : gSequenceIds) {
+    UnregisterHotKey(gLSModule.GetMessageWindow(), id);
+  }
+  gSequenceIds.clear();
+}
+
+
+/// <summary>
+/// Runs the command of a hotkey.
+/// </summary>
+static void RunAction(uint32_t action) {
+  const Action &toRun = gActions[action];
+  if (!toRun.bang.empty()) {
+    LiteStep::ParseBangCommandW(gLSModule.GetMessageWindow(), toRun.bang.c_str(), toRun.args.c_str());
+  } else {
+    LiteStep::LSExecute(gLSModule.GetMessageWindow(), toRun.command.c_str(), 0);
+  }
+}
+
+
 /// <summary>
 /// Adds a hotkey.
 /// </summary>
-static std::pair<bool, LPCWSTR> AddHotkey(UINT mods, UINT key, LPCWSTR command) {
-  if (mods == -1 || key == -1) {
+static std::pair<bool, LPCWSTR> AddHotkey(UINT mods, LPCWSTR keys, LPCWSTR command) {
+  std::vector<std::pair<UINT, UINT>> presses;
+  if (mods == -1 || !ParseSequence(mods, keys, presses)) {
     return std::make_pair(false, L"Invalid modifiers or key.");
   }
 
-  // Register the hotkey
-  if (RegisterHotKey(gLSModule.GetMessageWindow(), gId, mods, key) == FALSE) {
-    return std::make_pair(false, L"Failed to register the hotkey. Probably already taken.");
+  UINT flags = mods & MOD_NOREPEAT;
+  uint32_t node = HotkeyTrie::sRoot;
+  for (auto &press : presses) {
+    bool added;
+    uint32_t child = gHotKeys.AddChild(node, press.first, press.second, flags, added);
+
+    // Only the first key of a hotkey stays registered. The rest are registered while a sequence
+    // is in progress.
+    if (added && node == HotkeyTrie::sRoot && RegisterHotKey(gLSModule.GetMessageWindow(),
+        int(child), press.first | flags, press.second) == FALSE) {
+      gHotKeys.RemoveLast();
+      return std::make_pair(false, L"Failed to register the hotkey. Probably already taken.");
+    }
+    node = child;
+  }
+
+  if (gHotKeys.GetNode(node).action != HotkeyTrie::sNone) {
+    return std::make_pair(false, L"The hotkey is already defined.");
   }
 
-  // Add the hotkey definition to the map
-  gHotKeys[gId++] = command;
+  gHotKeys.SetAction(node, uint32_t(gActions.size()));
+  gActions.push_back(ParseCommand(command));
 
   return std::make_pair(true, nullptr);
 }
 
 
+/// <summary>
+/// Splits a key sequence, like k,ctrl+c, into its presses. The first press gets the modifiers of
+/// the line, the rest only their own.
+/// </summary>
+static bool ParseSequence(UINT mods, LPCWSTR keys, std::vector<std::pair<UINT, UINT>> &presses) {
+  std::wstring sequence(keys);
+  size_t start = 0;
+  while (start < sequence.size()) {
+    // Search from the second character, so that a comma on its own is a key.
+    size_t end = std::min(sequence.find(L',', start + 1), sequence.size());
+    std::wstring key = sequence.substr(start, end - start);
+    UINT keyMods = start == 0 ? mods & ~MOD_NOREPEAT : 0;
+
+    // Likewise, a + on its own is a key.
+    size_t plus = key.size() > 1 ? key.rfind(L'+', key.size() - 2) : std::wstring::npos;
+    if (plus != std::wstring::npos) {
+      std::wstring modNames = key.substr(0, plus);
+      std::transform(modNames.begin(), modNames.end(), modNames.begin(), ::towlower);
+      keyMods |= ParseMods(modNames.c_str()) & ~MOD_NOREPEAT;
+      key.erase(0, plus + 1);
+    }
+
+    UINT vk = ParseKey(key.c_str());
+    if (vk == -1) {
+      return false;
+    }
+    presses.push_back(std::make_pair(keyMods, vk));
+    start = end + 1;
+  }
+
+  return !presses.empty();
+}
+
+
+/// <summary>
+/// Splits a bang command into the bang and its arguments, so that running it doesn't have to.
+/// </summary>
+static Action ParseCommand(LPCWSTR command) {
+  Action action;
+  if (*command == L'!') {
+    size_t length = wcscspn(command, L" \t");
+    action.bang.assign(command, length);
+    action.args = command + length + wcsspn(command + length, L" \t");
+  } else {
+    action.command = command;
+  }
+  return action;
+}
+
+
 /// <summary>
 /// Loads VK definitions
 /// </summary>
@@ -152,6 +359,12 @@ static void LoadVKeyTable() {
   LPWSTR endPtr;
   UINT vkey;
 
+  // Definitions from the file override the built-in ones.
+  std::vector<std::pair<std::wstring, UINT>> names;
+  for (size_t i = 0; i < VirtualKeys::gBuiltInCount; ++i) {
+    names.push_back(std::make_pair(VirtualKeys::gBuiltIn[i].name, VirtualKeys::gBuiltIn[i].code));
+  }
+
   if (LiteStep::GetRCLine(L"nKeyVKTable", path, _countof(path), L"") != 0) {
     PathUnquoteSpaces(path);
     errno_t result = _wfopen_s(&file, path, L"rt, ccs=UTF-8");
@@ -164,7 +377,7 @@ static void LoadVKeyTable() {
         if (LiteStep::LCTokenize(line, tokens, 2, nullptr) == 2) {
           vkey = wcstoul(code, &endPtr, 0);
           if (*code != L'\0' && (*endPtr == L'\0' || *endPtr == L';')) {
-            gVKCodes[name] = vkey;
+            names.push_back(std::make_pair(name, vkey));
           } else {
             ErrorHandler::Error(ErrorHandler::Level::Warning,
               L"Invalid line in nKeyVKTable.\n%ls", line);
@@ -180,6 +393,8 @@ static void LoadVKeyTable() {
         L"Unable to open nKeyVKTable, %ls\n%ls", _wcserror(result), path);
     }
   }
+
+  gVKCodes.Build(names);
 }
 
 
@@ -187,19 +402,25 @@ static void LoadVKeyTable() {
 /// Reads through the .rc files and load *HotKeys
 /// </summary>
 static void LoadHotKeys() {
-  WCHAR line[MAX_LINE_LENGTH], mods[128], key[128], command[MAX_LINE_LENGTH];
-  LPWSTR tokens[] = { mods, key };
+  WCHAR line[MAX_LINE_LENGTH], mods[128];
   LPVOID f = LiteStep::LCOpenW(nullptr);
 
   while (LiteStep::LCReadNextConfigW(f, L"*HotKey", line, _countof(line))) {
-    LiteStep::LCTokenizeW(line + _countof("*HotKey"), tokens, 2, command);
+    // The keys are terminated in place, and the command is the rest of the line.
+    LineTokenizer tokenizer(line + _countof("*HotKey"));
+    StringSpan modsToken;
+    LPCWSTR keys = L"";
+    tokenizer.Next(modsToken);
+    tokenizer.NextTerminated(keys);
+    LPCWSTR command = tokenizer.Rest() != nullptr ? tokenizer.Rest() : L"";
 
     // ParseMods expects szMods to be all lowercase.
+    modsToken.CopyTo(mods, _countof(mods));
     _wcslwr_s(mods, _countof(mods));
-    std::pair<bool, LPCWSTR> result = AddHotkey(ParseMods(mods), ParseKey(key), command);
+    std::pair<bool, LPCWSTR> result = AddHotkey(ParseMods(mods), keys, command);
     if (!result.first) {
       ErrorHandler::Error(ErrorHandler::Level::Warning,
-        L"Error while registering hotkey %ls %ls.\n%ls", mods, key, result.second);
+        L"Error while registering hotkey %ls %ls.\n%ls", mods, keys, result.second);
     }
   }
 
@@ -216,9 +437,9 @@ static UINT ParseKey(LPCWSTR key) {
     return VkKeyScanW(key[0]) & 0xFF;
   } else {
     // Check if it's in our table
-    VKMap::const_iterator vk = gVKCodes.find(key);
-    if (vk != gVKCodes.end()) {
-      return vk->second;
+    UINT vk;
+    if (gVKCodes.Find(key, vk)) {
+      return vk;
     }
   }
 
@@ -239,3 +460,27 @@ static UINT ParseMods(LPCWSTR modsStr) {
   if (wcsstr(modsStr, L"norepeat") != nullptr) mods |= MOD_NOREPEAT;
   return mods;
 }
+
+
+/// <summary>
+/// Shows the counters for all hotkeys pressed since the module was loaded.
+/// </summary>
+static void ShowDispatchStats() {
+  WCHAR text[512];
+  StringCchPrintfW(text, _countof(text),
+    L"Hotkeys pressed: \t%llu\n"
+    L"Actions started: \t%llu\n"
+    L"Sequences started: \t%llu\n"
+    L"Sequences timed out: \t%llu\n"
+    L"\n"
+    L"Average delay before WM_HOTKEY: \t%.1f ms\n"
+    L"Longest delay before WM_HOTKEY: \t%u ms\n"
+    L"Average time from WM_HOTKEY to action: \t%.3f ms\n"
+    L"Longest time from WM_HOTKEY to action: \t%.3f ms",
+    gStats.presses, gStats.actions, gStats.sequences, gStats.timeouts,
+    gStats.presses == 0 ? 0.0 : double(gStats.totalQueueDelay) / gStats.presses,
+    gStats.maxQueueDelay,
+    gStats.actions == 0 ? 0.0 : gStats.totalHandlingTime / gStats.actions,
+    gStats.maxHandlingTime);
+  MessageBoxW(nullptr, text, L"nKey dispatch latency", MB_OK | MB_ICONINFORMATION);
+}
@@ -91,6 +91,8 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR path) {
   // Load settings
   LoadSettings();
 
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 
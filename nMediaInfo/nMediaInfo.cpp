@@ -54,6 +54,8 @@ EXPORT_CDECL(int) initModuleW(HWND /* parent */, HINSTANCE instance, LPCWSTR /*
   Bangs::_Register();
   Update();
 
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 
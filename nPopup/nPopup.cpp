@@ -21,6 +21,7 @@
 #include "../nShared/LSModule.hpp"
 
 #include "../Utilities/AlgorithmExtension.h"
+#include "../Utilities/LineTokenizer.hpp"
 #include "../Utilities/StringUtils.h"
 
 #include <map>
@@ -107,6 +108,8 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR path)
     // Load settings
     LoadPopups();
 
+    gLSModule.StartupCompleted();
+
     return 0;
 }
 
@@ -392,42 +395,42 @@ PopupLineType ProcessPopupLine(LPCTSTR line, ContentPopup::ContentSource & sourc
                                LPTSTR icon, UINT cchIcon,
                                LPTSTR prefix, UINT cchPrefix)
 {
-    TCHAR token[MAX_LINE_LENGTH];
-    LPCTSTR linePointer = line;
+    LineTokenizer tokenizer(line);
+    StringSpan token;
 
-    LiteStep::GetToken(linePointer, nullptr, &linePointer, FALSE); // Drop *Popup
+    tokenizer.Next(token); // Drop *Popup
 
     // The first token will be ~Folder, ~New, !Separator, !Info, !Container, .icon=, or a title.
-    LiteStep::GetToken(linePointer, token, &linePointer, FALSE);
-    if (_wcsicmp(token, L"~New") == 0)
+    tokenizer.Next(token);
+    if (token.Equals(L"~New"))
     {
         return PopupLineType::EndNew;
     }
-    else if (_wcsicmp(token, L"~Folder") == 0)
+    else if (token.Equals(L"~Folder"))
     {
         return PopupLineType::EndFolder;
     }
-    else if (_wcsicmp(token, L"!Separator") == 0)
+    else if (token.Equals(L"!Separator"))
     {
         return PopupLineType::Separator;
     }
-    else if (_wcsicmp(token, L"!Container") == 0)
+    else if (token.Equals(L"!Container"))
     {
         // The next token should be a prefix.
-        if (LiteStep::GetToken(linePointer, token, &linePointer, FALSE) == FALSE)
+        if (!tokenizer.Next(token))
         {
             return PopupLineType::Invalid;
         }
-        StringCchCopy(prefix, cchPrefix, token);
+        token.CopyTo(prefix, cchPrefix);
         return PopupLineType::Container;
     }
     else
     {
         // If we have a .icon, copy it over and move forward.
-        if (_wcsnicmp(token, L".icon=", 6) == 0)
+        if (token.StartsWith(L".icon="))
         {
-            StringCchCopy(icon, cchIcon, token+6);
-            if (LiteStep::GetToken(linePointer, token, &linePointer, FALSE) == FALSE)
+            StringSpan(token.begin + 6, token.length - 6).CopyTo(icon, cchIcon);
+            if (!tokenizer.Next(token))
             {
                 return PopupLineType::Invalid; // Ending after .icon=
             }
@@ -437,11 +440,11 @@ PopupLineType ProcessPopupLine(LPCTSTR line, ContentPopup::ContentSource & sourc
             *icon = L'\0';
         }
 
-        if (_wcsicmp(token, L"!Info") == 0)
+        if (token.Equals(L"!Info"))
         {
-            if (LiteStep::GetToken(linePointer, token, &linePointer, FALSE) != FALSE)
+            if (tokenizer.Next(token))
             {
-                StringCchCopy(title, cchTitle, token);
+                token.CopyTo(title, cchTitle);
             }
             else
             {
@@ -451,14 +454,14 @@ PopupLineType ProcessPopupLine(LPCTSTR line, ContentPopup::ContentSource & sourc
         }
         else
         {
-            StringCchCopy(title, cchTitle, token);
+            token.CopyTo(title, cchTitle);
             // The token after the title is either !New, Folder, or a command.
 
             // Store a copy to here, if this turns out to be a command
-            LPCTSTR commandPointer = linePointer;
+            LPCTSTR commandPointer = tokenizer.Rest();
 
             // This would be an empty command, or something, might as well mark it invalid.
-            if (LiteStep::GetToken(linePointer, token, &linePointer, FALSE) == FALSE)
+            if (!tokenizer.Next(token))
             {
                 return PopupLineType::Invalid;
             }
@@ -466,73 +469,73 @@ PopupLineType ProcessPopupLine(LPCTSTR line, ContentPopup::ContentSource & sourc
             //
             PopupLineType type;
 
-            if (_wcsicmp(token, L"!New") == 0)
+            if (token.Equals(L"!New"))
             {
                 // !New is followed by the bang command
-                if (LiteStep::GetToken(linePointer, token, &linePointer, FALSE) == FALSE)
+                if (!tokenizer.Next(token))
                 {
                     return PopupLineType::Invalid;
                 }
-                StringCchCopy(command, cchCommand, token);
+                token.CopyTo(command, cchCommand);
                 type = PopupLineType::New;
             }
-            else if (_wcsicmp(token, L"Folder") == 0)
+            else if (token.Equals(L"Folder"))
             {
                 type = PopupLineType::Folder;
             }
-            else if (_wcsicmp(token, L"!PopupAdminTools") == 0)
+            else if (token.Equals(L"!PopupAdminTools"))
             {
                 source = ContentPopup::ContentSource::ADMIN_TOOLS;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupControlPanel") == 0)
+            else if (token.Equals(L"!PopupControlPanel"))
             {
                 source = ContentPopup::ContentSource::CONTROL_PANEL;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupMyComputer") == 0)
+            else if (token.Equals(L"!PopupMyComputer"))
             {
                 source = ContentPopup::ContentSource::MY_COMPUTER;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupNetwork") == 0)
+            else if (token.Equals(L"!PopupNetwork"))
             {
                 source = ContentPopup::ContentSource::NETWORK;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupPrinters") == 0)
+            else if (token.Equals(L"!PopupPrinters"))
             {
                 source = ContentPopup::ContentSource::PRINTERS;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupPrograms") == 0)
+            else if (token.Equals(L"!PopupPrograms"))
             {
                 source = ContentPopup::ContentSource::PROGRAMS;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupRecentDocuments") == 0)
+            else if (token.Equals(L"!PopupRecentDocuments"))
             {
                 source = ContentPopup::ContentSource::RECENT_DOCUMENTS;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupRecycleBin") == 0)
+            else if (token.Equals(L"!PopupRecycleBin"))
             {
                 source = ContentPopup::ContentSource::RECYCLE_BIN;
                 type = PopupLineType::Content;
             }
-            else if (_wcsicmp(token, L"!PopupStartMenu") == 0)
+            else if (token.Equals(L"!PopupStartMenu"))
             {
                 source = ContentPopup::ContentSource::START_MENU;
                 type = PopupLineType::Content;
             }
-            else if (_wcsnicmp(token, L"!PopupFolder:", _countof("!PopupFolder:") - 1) == 0)
+            else if (token.StartsWith(L"!PopupFolder:"))
             {
                 source = ContentPopup::ContentSource::PATH;
                 StringCchCopy(command, cchCommand, commandPointer + _countof("!PopupFolder:"));
                 command[wcslen(command)-1] = L'\0';
                 type = PopupLineType::ContentPath;
             }
-            else if (_wcsnicmp(token, L"!PopupDynamicFolder:", _countof("!PopupDynamicFolder:") - 1) == 0)
+            else if (token.StartsWith(L"!PopupDynamicFolder:"))
             {
                 source = ContentPopup::ContentSource::PATH;
                 StringCchCopy(command, cchCommand, commandPointer + _countof("!PopupDynamicFolder:"));
@@ -548,9 +551,9 @@ PopupLineType ProcessPopupLine(LPCTSTR line, ContentPopup::ContentSource & sourc
             // Everything, save commands, may be followed by a prefix.
             if (type != PopupLineType::Command)
             {
-                if (LiteStep::GetToken(linePointer, token, &linePointer, FALSE) != FALSE)
+                if (tokenizer.Next(token))
                 {
-                    StringCchCopy(prefix, cchPrefix, token);
+                    token.CopyTo(prefix, cchPrefix);
                 }
                 else
                 {
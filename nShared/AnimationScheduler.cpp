@@ -0,0 +1,228 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/AnimationScheduler.cpp
+// The nModules Project
+//
+// Drives all running animations from a single frame clock.
+//-------------------------------------------------------------------------------------------------
+#include "AnimationScheduler.hpp"
+
+#include <algorithm>
+
+
+/// <summary>
+/// Constructor
+/// </summary>
+AnimationScheduler::AnimationScheduler(Clock clock, FrameSource frameSource, GroupUpdate groupUpdate)
+  : mClock(clock)
+  , mFrameSource(frameSource)
+  , mGroupUpdate(groupUpdate)
+  , mRunning(false)
+  , mTicking(false)
+  , mStatsStart(0)
+  , mStatsFrames(0)
+  , mStatsCost(0)
+{
+  ZeroMemory(&mStats, sizeof(mStats));
+}
+
+
+/// <summary>
+/// Starts animating the property key of owner, replacing any animation of the same property.
+/// </summary>
+void AnimationScheduler::Start(const void *owner, UINT_PTR key, void *group, const float *from,
+    const float *to, int count, float duration, Easing::Type easing, Setter setter) {
+  Stop(owner, key);
+
+  if (duration <= 0.0f) {
+    setter(to);
+    return;
+  }
+
+  Animation animation;
+  animation.owner = owner;
+  animation.key = key;
+  animation.group = group;
+  animation.start = mClock();
+  animation.duration = duration;
+  animation.easing = easing;
+  animation.count = count < sMaxValues ? count : sMaxValues;
+  for (int i = 0; i < animation.count; ++i) {
+    animation.from[i] = from[i];
+    animation.to[i] = to[i];
+  }
+  animation.setter = std::move(setter);
+  animation.done = false;
+  mAnimations.push_back(std::move(animation));
+
+  if (!mRunning) {
+    mRunning = true;
+    mStatsStart = mClock();
+    mStatsFrames = 0;
+    mStatsCost = 0;
+    mFrameSource(true);
+  }
+}
+
+
+/// <summary>
+/// Stops every animation of owner.
+/// </summary>
+void AnimationScheduler::Stop(const void *owner) {
+  for (Animation &animation : mAnimations) {
+    if (animation.owner == owner) {
+      animation.done = true;
+    }
+  }
+  if (!mTicking) {
+    Compact();
+  }
+}
+
+
+/// <summary>
+/// Stops the animation of the property key of owner.
+/// </summary>
+void AnimationScheduler::Stop(const void *owner, UINT_PTR key) {
+  for (Animation &animation : mAnimations) {
+    if (animation.owner == owner && animation.key == key) {
+      animation.done = true;
+    }
+  }
+  if (!mTicking) {
+    Compact();
+  }
+}
+
+
+/// <summary>
+/// Stops every animation in group.
+/// </summary>
+void AnimationScheduler::StopGroup(const void *group) {
+  for (Animation &animation : mAnimations) {
+    if (animation.group == group) {
+      animation.done = true;
+    }
+  }
+  if (!mTicking) {
+    Compact();
+  }
+}
+
+
+/// <summary>
+/// Returns true if any property of owner is being animated.
+/// </summary>
+bool AnimationScheduler::IsAnimating(const void *owner) const {
+  for (const Animation &animation : mAnimations) {
+    if (animation.owner == owner && !animation.done) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/// <summary>
+/// Returns true if any animation is running.
+/// </summary>
+bool AnimationScheduler::IsRunning() const {
+  return mRunning;
+}
+
+
+/// <summary>
+/// Steps all running animations to the current time.
+/// </summary>
+void AnimationScheduler::Tick() {
+  if (mTicking) {
+    return;
+  }
+
+  double now = mClock();
+
+  // Keep the animations of each group next to each other, so each group is updated in one go.
+  std::stable_sort(mAnimations.begin(), mAnimations.end(), [] (const Animation &a, const Animation &b) {
+    return a.group < b.group;
+  });
+
+  // Animations started by the setters are added past the end, and wait for the next frame.
+  mTicking = true;
+  size_t count = mAnimations.size();
+  for (size_t first = 0; first < count;) {
+    void *group = mAnimations[first].group;
+    size_t last = first;
+    while (last < count && mAnimations[last].group == group) {
+      ++last;
+    }
+    mGroupUpdate(group, [this, first, last, now] () {
+      for (size_t i = first; i < last; ++i) {
+        if (!mAnimations[i].done) {
+          Step(mAnimations[i], now);
+        }
+      }
+    });
+    first = last;
+  }
+  mTicking = false;
+
+  double end = mClock();
+  ++mStats.frames;
+  ++mStatsFrames;
+  mStatsCost += end - now;
+  if (end - mStatsStart >= 1.0) {
+    mStats.framesPerSecond = float(mStatsFrames / (end - mStatsStart));
+    mStats.frameCost = float(mStatsCost * 1000.0 / mStatsFrames);
+    mStatsStart = end;
+    mStatsFrames = 0;
+    mStatsCost = 0;
+  }
+
+  Compact();
+}
+
+
+/// <summary>
+/// Returns the frame statistics.
+/// </summary>
+const AnimationScheduler::Stats &AnimationScheduler::GetStats() const {
+  return mStats;
+}
+
+
+/// <summary>
+/// Moves an animation to where it should be at the specified time.
+/// </summary>
+void AnimationScheduler::Step(Animation &animation, double now) {
+  float progress = float((now - animation.start) / animation.duration);
+  if (progress >= 1.0f) {
+    progress = 1.0f;
+    animation.done = true;
+  } else if (progress < 0.0f) {
+    progress = 0.0f;
+  }
+
+  // The last frame lands exactly on the target, whatever rounding the easing does.
+  float eased = Easing::Transform(progress, animation.easing);
+  float values[sMaxValues];
+  for (int i = 0; i < animation.count; ++i) {
+    values[i] = animation.done ? animation.to[i]
+      : animation.from[i] + (animation.to[i] - animation.from[i])*eased;
+  }
+
+  animation.setter(values);
+}
+
+
+/// <summary>
+/// Removes finished animations, and stops the frame source when there is nothing left.
+/// </summary>
+void AnimationScheduler::Compact() {
+  mAnimations.erase(std::remove_if(mAnimations.begin(), mAnimations.end(), [] (const Animation &animation) {
+    return animation.done;
+  }), mAnimations.end());
+
+  if (mRunning && mAnimations.empty()) {
+    mRunning = false;
+    mFrameSource(false);
+  }
+}
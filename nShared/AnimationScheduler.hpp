@@ -0,0 +1,151 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/AnimationScheduler.hpp
+// The nModules Project
+//
+// Drives all running animations from a single frame clock.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "Easing.h"
+
+#include "../Utilities/Common.h"
+
+#include <deque>
+#include <functional>
+
+/// <summary>
+/// Runs animations of arbitrary properties. Every animation moves up to 4 floats from one set of
+/// values to another, and hands the current values to a setter each frame. All animations are
+/// stepped by the same Tick, and the animations of a frame are handed out one group at a time, so
+/// that the owner can batch the updates of each group.
+///
+/// The scheduler gets the time from the clock it is given, and asks its frame source to start or
+/// stop calling Tick, so it can be driven by anything -- a window timer, or a test.
+/// </summary>
+class AnimationScheduler {
+public:
+  // Returns the current time, in seconds.
+  typedef std::function<double ()> Clock;
+
+  // Asked to start calling Tick regularly when run is true, and to stop when it is false.
+  typedef std::function<void (bool run)> FrameSource;
+
+  // Runs update, which steps every animation in the specified group.
+  typedef std::function<void (void *group, const std::function<void ()> &update)> GroupUpdate;
+
+  // Receives the current values of an animation.
+  typedef std::function<void (const float *values)> Setter;
+
+  // The maximum number of values a single animation can move.
+  static const int sMaxValues = 4;
+
+  /// <summary>
+  /// Frame statistics, recalculated about once a second while animations are running.
+  /// </summary>
+  struct Stats {
+    // Frames ticked per second.
+    float framesPerSecond;
+
+    // The average time, in milliseconds, spent stepping animations in a frame.
+    float frameCost;
+
+    // The number of frames ticked since the scheduler was created.
+    ULONGLONG frames;
+  };
+
+public:
+  AnimationScheduler(Clock clock, FrameSource frameSource, GroupUpdate groupUpdate);
+
+public:
+  /// <summary>
+  /// Starts animating the property key of owner, replacing any animation of the same property.
+  /// A duration of 0 applies the target values right away.
+  /// </summary>
+  void Start(const void *owner, UINT_PTR key, void *group, const float *from, const float *to,
+    int count, float duration, Easing::Type easing, Setter setter);
+
+  /// <summary>
+  /// Stops every animation of owner, leaving the properties where they currently are.
+  /// </summary>
+  void Stop(const void *owner);
+
+  /// <summary>
+  /// Stops the animation of the property key of owner.
+  /// </summary>
+  void Stop(const void *owner, UINT_PTR key);
+
+  /// <summary>
+  /// Stops every animation in group, regardless of owner.
+  /// </summary>
+  void StopGroup(const void *group);
+
+  /// <summary>
+  /// Returns true if any property of owner is being animated.
+  /// </summary>
+  bool IsAnimating(const void *owner) const;
+
+  /// <summary>
+  /// Returns true if any animation is running.
+  /// </summary>
+  bool IsRunning() const;
+
+  /// <summary>
+  /// Steps all running animations to the current time.
+  /// </summary>
+  void Tick();
+
+  /// <summary>
+  /// Returns the frame statistics.
+  /// </summary>
+  const Stats &GetStats() const;
+
+private:
+  struct Animation {
+    const void *owner;
+    UINT_PTR key;
+    void *group;
+    double start;
+    float duration;
+    Easing::Type easing;
+    int count;
+    float from[sMaxValues];
+    float to[sMaxValues];
+    Setter setter;
+
+    // Set when the animation has completed, or was stopped while a frame was being ticked.
+    bool done;
+  };
+
+private:
+  /// <summary>
+  /// Moves an animation to where it should be at the specified time.
+  /// </summary>
+  void Step(Animation &animation, double now);
+
+  /// <summary>
+  /// Removes finished animations, and stops the frame source when there is nothing left.
+  /// </summary>
+  void Compact();
+
+private:
+  Clock mClock;
+  FrameSource mFrameSource;
+  GroupUpdate mGroupUpdate;
+
+  // A deque, so that animations started by a setter don't move the one which is running.
+  std::deque<Animation> mAnimations;
+
+  // True while the frame source is calling Tick.
+  bool mRunning;
+
+  // True while Tick is stepping animations. Animations are only flagged as done during this time,
+  // since removing them would pull them out from under the loop.
+  bool mTicking;
+
+  Stats mStats;
+
+  // The frames, and time spent in them, since the statistics were last calculated.
+  double mStatsStart;
+  UINT mStatsFrames;
+  double mStatsCost;
+};
@@ -149,6 +149,10 @@ void Balloon::Hide() {
 /// Shows the balloon
 /// </summary>
 void Balloon::Show(LPCWSTR title, LPCWSTR text, HICON icon, LPSIZE iconSize, LPRECT targetPosition) {
+  // The balloon may already be showing, in which case it's updated in a single paint.
+  Window::UpdateLock lock(mWindow);
+  mWindow->ClearOverlays();
+
   int offsetLeft;
   if (icon != nullptr) {
     D2D1_RECT_F f = { 4, 4, float(4 + iconSize->cx), float(4 + iconSize->cy) };
@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/BangBatch.cpp
+// The nModules Project
+//
+// Runs a group of window bangs as a single update.
+//-------------------------------------------------------------------------------------------------
+#include "BangBatch.hpp"
+#include "LiteStep.h"
+
+#include "../nCoreCom/Tracing.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+
+// The number of open scopes.
+static int sDepth = 0;
+
+// The locks held during the open batch, by the handle of the top-level window they are on.
+static std::map<HWND, std::unique_ptr<Window::UpdateLock>> sLocks;
+
+// The deferred repaint count at the time the batch was opened.
+static ULONGLONG sRepaintsAtOpen = 0;
+
+static BangBatch::Stats sStats = { 0, 0, 0, 0 };
+
+
+/// <summary>
+/// Opens a batch, unless one is already open.
+/// </summary>
+BangBatch::Scope::Scope() {
+  if (sDepth++ == 0) {
+    sRepaintsAtOpen = Window::GetDeferredRepaintCount();
+  }
+}
+
+
+/// <summary>
+/// Commits the batch, if this is the outermost scope.
+/// </summary>
+BangBatch::Scope::~Scope() {
+  if (--sDepth != 0) {
+    return;
+  }
+
+  ULONGLONG repaints = Window::GetDeferredRepaintCount() - sRepaintsAtOpen;
+  ULONGLONG committed = std::min(repaints, ULONGLONG(sLocks.size()));
+
+  ++sStats.batches;
+  sStats.repaints += repaints;
+  sStats.repaintsAvoided += repaints - committed;
+
+  // Releasing the last lock on a top-level window repaints it, if anything asked it to. Painting
+  // may run more bangs, or even open a new batch, so the locks are moved out of the way first.
+  std::map<HWND, std::unique_ptr<Window::UpdateLock>> locks;
+  locks.swap(sLocks);
+  locks.clear();
+}
+
+
+/// <summary>
+/// Wraps finder, so that lookups made through it take part in any open batch.
+/// </summary>
+BangBatch::Finder BangBatch::Batched(Finder finder) {
+  return [finder] (LPCTSTR name) -> Window* {
+    // Windows are looked up again for every bang, as the last one may have destroyed them.
+    Window *window = finder(name);
+    if (sDepth != 0 && window != nullptr) {
+      // Windows which aren't part of a top-level window yet have nothing to repaint.
+      HWND handle = window->GetWindowHandle();
+      if (handle != nullptr && sLocks.find(handle) == sLocks.end()) {
+        sLocks[handle].reset(new Window::UpdateLock(window));
+      }
+    }
+    return window;
+  };
+}
+
+
+/// <summary>
+/// Runs a single bang command.
+/// </summary>
+void BangBatch::Execute(LPCTSTR command) {
+  TRACE_SPAN("BangBatch::Execute");
+  if (sDepth != 0) {
+    ++sStats.commands;
+  }
+  LiteStep::LSExecute(nullptr, command, SW_SHOWNORMAL);
+}
+
+
+/// <summary>
+/// Runs each of the quoted, or bracketed, bang commands in commands as one batch.
+/// </summary>
+void BangBatch::Run(LPCTSTR commands) {
+  Scope scope;
+
+  TCHAR command[MAX_LINE_LENGTH];
+  LPCTSTR next = commands;
+  while (LiteStep::GetToken(next, command, &next, TRUE) != FALSE) {
+    Execute(command);
+  }
+}
+
+
+/// <summary>
+/// Returns the counters for all committed batches.
+/// </summary>
+const BangBatch::Stats &BangBatch::GetStats() {
+  return sStats;
+}
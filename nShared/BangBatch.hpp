@@ -0,0 +1,75 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/BangBatch.hpp
+// The nModules Project
+//
+// Runs a group of window bangs as a single update.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "Window.hpp"
+
+#include <functional>
+
+/// <summary>
+/// While a batch is open, the top-level windows of the windows found through a batched finder are
+/// kept update locked until the batch is committed. Every top-level window touched by the batch
+/// then repaints once, no matter how many of its properties were changed.
+///
+/// Bangs may destroy windows while the batch is open, so the batch keeps no window pointers. The
+/// locks are kept by window handle, and a window clears the locks on it when it is destroyed.
+/// </summary>
+namespace BangBatch {
+  // Maps a window name to a window.
+  typedef std::function<Window* (LPCTSTR)> Finder;
+
+  /// <summary>
+  /// Counters for all committed batches.
+  /// </summary>
+  struct Stats {
+    // Batches which have been committed.
+    ULONGLONG batches;
+
+    // Bang commands which were run as part of a batch.
+    ULONGLONG commands;
+
+    // Repaints which were requested while a batch was open.
+    ULONGLONG repaints;
+
+    // Of those, the ones which were folded into the single repaint of their top-level window.
+    ULONGLONG repaintsAvoided;
+  };
+
+  /// <summary>
+  /// Opens a batch for as long as it exists. Scopes may be nested; the batch is committed when the
+  /// outermost one goes away.
+  /// </summary>
+  class Scope {
+  public:
+    Scope();
+    ~Scope();
+
+  private:
+    Scope(const Scope&);
+    Scope &operator=(const Scope&);
+  };
+
+  /// <summary>
+  /// Wraps finder, so that lookups made through it take part in any open batch.
+  /// </summary>
+  Finder Batched(Finder finder);
+
+  /// <summary>
+  /// Runs a single bang command. Counted as part of the open batch, if there is one.
+  /// </summary>
+  void Execute(LPCTSTR command);
+
+  /// <summary>
+  /// Runs each of the quoted, or bracketed, bang commands in commands as one batch.
+  /// </summary>
+  void Run(LPCTSTR commands);
+
+  /// <summary>
+  /// Returns the counters for all committed batches.
+  /// </summary>
+  const Stats &GetStats();
+}
@@ -8,14 +8,15 @@
 #include "../Utilities/Common.h"
 #include "Brush.hpp"
 #include "Color.h"
-#include "Factories.h"
+#include "DWMColorRegistry.hpp"
+#include "ImageDecoder.hpp"
 #include "LiteStep.h"
 #include <wincodec.h>
 #include "../nCoreCom/Core.h"
 #include "../Utilities/StringUtils.h"
 #include <algorithm>
+#include <vector>
 #include "ErrorHandler.h"
-#include <Shlwapi.h>
 
 
 Brush::Brush()
@@ -26,6 +27,11 @@ Brush::Brush()
     , gradientStopCount(0)
     , gradientStops(nullptr)
     , mTransformTimeStamp(0)
+    , mRenderTarget(nullptr)
+    , mUsesDWMColor(false)
+    , mRegistered(false)
+    , mShowingColor(false)
+    , mShownColor(0)
     , scalingMode(ImageScalingMode::Center)
 {}
 
@@ -45,6 +51,8 @@ void Brush::Load(BrushSettings* settings) {
 
   if (_wcsicmp(this->brushSettings->brushType, L"Image") == 0) {
     this->brushType = Type::Image;
+    // Get the image decoding while the window is being set up.
+    ImageDecoder::Prefetch(this->brushSettings->image);
   } else if (_wcsicmp(this->brushSettings->brushType, L"LinearGradient") == 0) {
     this->brushType = Type::LinearGradient;
     this->gradientStart = D2D1::Point2F(this->brushSettings->gradientStartX,
@@ -94,6 +102,8 @@ void Brush::Load(BrushSettings* settings) {
   }
 
   this->imageEdges = brushSettings->imageEdges;
+
+  UpdateDWMRegistration();
 }
 
 
@@ -105,28 +115,82 @@ void Brush::LoadGradientStops() {
   using namespace LiteStep;
 
   std::unique_ptr<IColorVal> defaultColor = Color::Create(0xFF000000);
+  std::vector<IColorVal*> colors;
+  std::vector<float> positions;
 
   while (GetToken(colorPointer, colorToken, &colorPointer, FALSE) != FALSE &&
       GetToken(stopPointer, stopToken, &stopPointer, FALSE) != FALSE) {
-    float stop;
     LPWSTR endPtr;
+    colors.push_back(ParseColor(colorToken, defaultColor.get()));
+    positions.push_back(wcstof(stopToken, &endPtr));
+  }
+
+  if (colors.empty()) {
+    return;
+  }
+
+  UINT first = this->gradientStopCount;
+  this->gradientStopCount += UINT(colors.size());
+  this->gradientStops = (D2D1_GRADIENT_STOP*)realloc(this->gradientStops,
+      this->gradientStopCount*sizeof(D2D1_GRADIENT_STOP));
+  this->gradientStopColors = (IColorVal**)realloc(this->gradientStopColors,
+      this->gradientStopCount*sizeof(IColorVal*));
+
+  std::vector<ARGB> values(colors.size());
+  for (size_t i = 0; i < colors.size(); ++i) {
+    this->gradientStopColors[first + i] = colors[i];
+    this->gradientStops[first + i].position = positions[i];
+    values[i] = colors[i]->Evaluate();
+  }
+  Color::ARGBToD2D(values.data(), this->gradientStops + first, values.size());
+}
+
 
-    IColorVal *color = ParseColor(colorToken, defaultColor.get());
-    stop = wcstof(stopToken, &endPtr);
+void Brush::UpdateDWMRegistration() {
+  bool usesDWMColor = false;
+
+  switch (this->brushType) {
+  case Type::SolidColor:
+    usesDWMColor = !this->brushSettings->color->IsConstant();
+    break;
 
-    this->gradientStops = (D2D1_GRADIENT_STOP*)realloc(this->gradientStops,
-        ++this->gradientStopCount*sizeof(D2D1_GRADIENT_STOP));
-    this->gradientStopColors = (IColorVal**)realloc(this->gradientStopColors,
-        this->gradientStopCount*sizeof(IColorVal*));
-    this->gradientStopColors[this->gradientStopCount - 1] = color;
-    this->gradientStops[this->gradientStopCount - 1].color = Color::ARGBToD2D(color->Evaluate());
-    this->gradientStops[this->gradientStopCount - 1].position = stop;
+  case Type::LinearGradient:
+  case Type::RadialGradient:
+    for (UINT i = 0; i < this->gradientStopCount && !usesDWMColor; ++i) {
+      usesDWMColor = !this->gradientStopColors[i]->IsConstant();
+    }
+    break;
+  }
+
+  mUsesDWMColor = usesDWMColor;
+  SyncDWMRegistration();
+}
+
+
+void Brush::SyncDWMRegistration() {
+  // Only brushes with live device resources are registered. The registry never has to deal with a
+  // render target which has gone away along with its window.
+  bool registered = mUsesDWMColor && mRenderTarget != nullptr;
+  if (registered != mRegistered) {
+    if (registered) {
+      DWMColorRegistry::Register(this);
+    } else {
+      DWMColorRegistry::Unregister(this);
+    }
+    mRegistered = registered;
   }
 }
 
 
 void Brush::Discard() {
   SAFERELEASE(this->brush);
+  mRenderTarget = nullptr;
+  SyncDWMRegistration();
+}
+
+
+ID2D1RenderTarget *Brush::GetRenderTarget() const {
+  return mRenderTarget;
 }
 
 
@@ -135,11 +199,13 @@ HRESULT Brush::ReCreate(ID2D1RenderTarget* renderTarget) {
 
   if (renderTarget) {
     SAFERELEASE(this->brush);
+    mRenderTarget = renderTarget;
+    SyncDWMRegistration();
 
     switch (this->brushType) {
     case Type::SolidColor:
       {
-        hr = renderTarget->CreateSolidColorBrush(Color::ARGBToD2D(this->brushSettings->color->Evaluate()), (ID2D1SolidColorBrush**)&this->brush);
+        hr = renderTarget->CreateSolidColorBrush(Color::ARGBToD2D(GetShownColor()), (ID2D1SolidColorBrush**)&this->brush);
       }
       break;
 
@@ -415,7 +481,8 @@ bool Brush::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) {
   switch (this->brushType) {
   case Type::SolidColor:
     {
-      if (!this->brushSettings->color->IsConstant() && this->brush) {
+      // An animation owns the color until it applies its target with SetColor.
+      if (!this->brushSettings->color->IsConstant() && this->brush && !mShowingColor) {
         ((ID2D1SolidColorBrush*) this->brush)->SetColor(
           Color::ARGBToD2D(this->brushSettings->color->Evaluate(newColor)));
         ret = true;
@@ -426,15 +493,18 @@ bool Brush::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) {
   case Type::LinearGradient:
   case Type::RadialGradient:
     {
+      std::vector<ARGB> values(this->gradientStopCount);
       for (UINT i = 0; i < this->gradientStopCount; ++i) {
-        if (!this->gradientStopColors[i]->IsConstant()) {
-          this->gradientStops[i].color =
-            Color::ARGBToD2D(this->gradientStopColors[i]->Evaluate(newColor));
+        if (this->gradientStopColors[i]->IsConstant()) {
+          values[i] = this->gradientStopColors[i]->Evaluate();
+        } else {
+          values[i] = this->gradientStopColors[i]->Evaluate(newColor);
           ret = true;
         }
       }
 
       if (ret) {
+        Color::ARGBToD2D(values.data(), this->gradientStops, values.size());
         ReCreate(renderTarget);
       }
     }
@@ -446,37 +516,20 @@ bool Brush::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) {
 
 
 HRESULT Brush::LoadImageFile(ID2D1RenderTarget *renderTarget, LPCTSTR image, ID2D1Brush **brush) {
-  IWICImagingFactory *factory = nullptr;
-  IWICBitmap *wicBitmap = nullptr;
-  IWICFormatConverter *converter = nullptr;
+  IWICBitmapSource *source = nullptr;
   ID2D1Bitmap *bitmap = nullptr;
-  Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory));
-  HRESULT hr = E_FAIL;
-
-  HBITMAP hBitmap = LiteStep::LoadLSImage(image, nullptr);
-  if (hBitmap) {
-    hr = factory->CreateFormatConverter(&converter);
-    if (SUCCEEDED(hr)) {
-      hr = factory->CreateBitmapFromHBITMAP(hBitmap, nullptr, WICBitmapUseAlpha, &wicBitmap);
-    }
-    if (SUCCEEDED(hr)) {
-      hr = converter->Initialize(wicBitmap, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
-        nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
-    }
-    if (SUCCEEDED(hr)) {
-      hr = renderTarget->CreateBitmapFromWicBitmap(converter, nullptr, &bitmap);
-    }
-    if (SUCCEEDED(hr)) {
-      hr = renderTarget->CreateBitmapBrush(bitmap, reinterpret_cast<ID2D1BitmapBrush**>(brush));
-    }
 
-    DeleteObject(hBitmap);
-    SAFERELEASE(wicBitmap);
-    SAFERELEASE(bitmap);
-    SAFERELEASE(converter);
-  } else if (!PathFileExists(image)) {
-    hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  // The image is normally decoded by now, so all that is left is to upload it.
+  HRESULT hr = ImageDecoder::Get(image, &source);
+  if (SUCCEEDED(hr)) {
+    hr = renderTarget->CreateBitmapFromWicBitmap(source, nullptr, &bitmap);
   }
+  if (SUCCEEDED(hr)) {
+    hr = renderTarget->CreateBitmapBrush(bitmap, reinterpret_cast<ID2D1BitmapBrush**>(brush));
+  }
+
+  SAFERELEASE(source);
+  SAFERELEASE(bitmap);
 
   return hr;
 }
@@ -484,12 +537,28 @@ HRESULT Brush::LoadImageFile(ID2D1RenderTarget *renderTarget, LPCTSTR image, ID2
 
 void Brush::SetColor(const IColorVal *color) {
   this->brushSettings->color = std::unique_ptr<IColorVal>(color->Copy());
+  mShowingColor = false;
   if (this->brushType == Type::SolidColor) {
     if (this->brush) {
       ((ID2D1SolidColorBrush*) this->brush)->SetColor(
         Color::ARGBToD2D(this->brushSettings->color->Evaluate()));
     }
   }
+  UpdateDWMRegistration();
+}
+
+
+void Brush::ShowColor(ARGB color) {
+  mShowingColor = true;
+  mShownColor = color;
+  if (this->brushType == Type::SolidColor && this->brush) {
+    ((ID2D1SolidColorBrush*) this->brush)->SetColor(Color::ARGBToD2D(color));
+  }
+}
+
+
+ARGB Brush::GetShownColor() const {
+  return mShowingColor ? mShownColor : this->brushSettings->color->Evaluate();
 }
 
 
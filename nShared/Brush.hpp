@@ -56,6 +56,11 @@ public:
     explicit Brush();
     virtual ~Brush();
 
+private:
+    // The DWMColorRegistry refers to brushes by address, and the gradient stops are owned.
+    Brush(const Brush &);
+    Brush &operator=(const Brush &);
+
 public:
     // Loads brush settings.
     void Load(BrushSettings *settings);
@@ -63,9 +68,12 @@ public:
     // Updates the brush to the new position of the window.
     void UpdatePosition(D2D1_RECT_F position, WindowData *windowData);
 
-    //
+    // Re-evaluates the colors which depend on the DWM color.
     bool UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget);
 
+    // The render target the brush was last created for, or nullptr if it has been discarded.
+    ID2D1RenderTarget *GetRenderTarget() const;
+
     // The brush.
     ID2D1Brush *brush;
 
@@ -87,6 +95,14 @@ public:
 
 public:
     void SetColor(const IColorVal *color); 
+
+    // Shows the specified color without changing the settings, until the next SetColor. Used by
+    // animations, which set a new color every frame.
+    void ShowColor(ARGB color);
+
+    // The color the brush is currently showing.
+    ARGB GetShownColor() const;
+
     void SetImage(ID2D1RenderTarget *renderTarget, LPCTSTR path); 
     BrushSettings *GetBrushSettings();
     void CheckTransforms(WindowData *wndData);
@@ -115,6 +131,13 @@ private:
     // Loads render targets.
     void LoadGradientStops();
 
+    // Works out whether any of the brush's colors refer to the DWM color.
+    void UpdateDWMRegistration();
+
+    // Registers the brush with the DWMColorRegistry while it uses the DWM color and has device
+    // resources, and unregisters it otherwise.
+    void SyncDWMRegistration();
+
     //
     void ScaleImage(WindowData *windowData);
     
@@ -142,6 +165,21 @@ private:
     // The last time a change which requires the transforms to be recomputed occured.
     ULONGLONG mTransformTimeStamp;
 
+    // The render target the brush was last created for.
+    ID2D1RenderTarget *mRenderTarget;
+
+    // True if any of the brush's colors refer to the DWM color.
+    bool mUsesDWMColor;
+
+    // True if the brush is registered with the DWMColorRegistry.
+    bool mRegistered;
+
+    // True while the brush shows mShownColor, rather than the color in its settings.
+    bool mShowingColor;
+
+    // The color set by ShowColor.
+    ARGB mShownColor;
+
     union
     {
         // The center of a radial gradient.
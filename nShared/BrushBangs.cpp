@@ -6,6 +6,7 @@
 //
 //--------------------------------------------------------------------------------------
 #include "BrushBangs.h"
+#include "BangBatch.hpp"
 #include "LiteStep.h"
 
 #include "../nCoreCom/Core.h"
@@ -110,6 +111,7 @@ static const struct BangItem
             IColorVal* color;
             if (ParseColor(arg, &color))
             {
+                Window::GetAnimationScheduler().Stop(window, UINT_PTR(brush));
                 brush->SetColor(color);
                 delete color;
                 window->Repaint();
@@ -188,6 +190,24 @@ static const struct BangItem
             window->Repaint();
         }
     }),*/
+    BangItem(L"AnimateColor",            [] (HWND, LPCTSTR args) -> void
+    {
+        // window [brushowner] [brush] color duration easing
+        Window *window = nullptr;
+        Brush *brush = FindBrush(&args, 3, window);
+        if (brush)
+        {
+            TCHAR color[MAX_RCCOMMAND], duration[MAX_RCCOMMAND], easing[MAX_RCCOMMAND];
+            LPTSTR tokens[] = { color, duration, easing };
+            IColorVal* value;
+            if (LiteStep::CommandTokenize(args, tokens, _countof(tokens), nullptr) == 3
+                && ParseColor(color, &value))
+            {
+                window->AnimateBrushColor(brush, value, _wtoi(duration), Easing::EasingFromString(easing));
+                delete value;
+            }
+        }
+    }),
     BangItem(L"SetImage",                [] (HWND, LPCTSTR args) -> void
     {
         Window *window = nullptr;
@@ -237,7 +257,7 @@ static const struct BangItem
 void BrushBangs::Register(LPCTSTR prefix, std::function<Window* (LPCTSTR)> windowFinder)
 {
     TCHAR bangName[64];
-    ::windowFinder = windowFinder;
+    ::windowFinder = BangBatch::Batched(windowFinder);
     for (BangItem item : BangMap)
     {
         StringCchPrintf(bangName, _countof(bangName), L"!%s%s", prefix, item.name);
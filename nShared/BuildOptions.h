@@ -8,3 +8,6 @@
 
 // Enable to use asserts, even in release.
 //#define BUILDOPTIONS_ASSERTS
+
+// Disable to compile out all TRACE_SPANs.
+#define BUILDOPTIONS_TRACING
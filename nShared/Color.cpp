@@ -15,6 +15,16 @@
 #include <unordered_map>
 #include <functional>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#define COLOR_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define COLOR_USE_AVX2
+#include <immintrin.h>
+#endif
+
 typedef StringKeyedMaps<LPCWSTR, ARGB>::UnorderedMap ColorMap;
 
 // Predefined colors. These contain all the CSS3 named colors, and some extras.
@@ -271,6 +281,351 @@ static ColorMap namedColors = {
 };
 
 
+#if defined(COLOR_USE_SSE2)
+/// <summary>
+/// Four lanes of SSE2. The batch kernels below are written against this interface, so that the
+/// same code runs on 8 lanes where AVX2 is available.
+/// </summary>
+struct SSE2Lanes {
+  typedef __m128 Float;
+  typedef __m128i Int;
+  enum { count = 4 };
+
+  static Float Set(float value) { return _mm_set1_ps(value); }
+  static Int Set(int value) { return _mm_set1_epi32(value); }
+  static Int Load(const ARGB *colors) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors)); }
+  static void Store(ARGB *colors, Int value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(colors), value); }
+
+  static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+  static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+  static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+  static Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+  static Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+  static Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+  static Float Abs(Float a) { return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF))); }
+  static Int Equal(Float a, Float b) { return _mm_castps_si128(_mm_cmpeq_ps(a, b)); }
+  static Int Greater(Float a, Float b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+
+  static Int Add(Int a, Int b) { return _mm_add_epi32(a, b); }
+  static Int Equal(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+  static Int Less(Int a, Int b) { return _mm_cmplt_epi32(a, b); }
+  static Int And(Int a, Int b) { return _mm_and_si128(a, b); }
+  static Int AndNot(Int mask, Int b) { return _mm_andnot_si128(mask, b); }
+  static Int Or(Int a, Int b) { return _mm_or_si128(a, b); }
+  static Int ShiftLeft(Int a, int bits) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+  static Int ShiftRight(Int a, int bits) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(bits)); }
+  static Float Select(Int mask, Float a, Float b) {
+    return _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(mask), a), _mm_andnot_ps(_mm_castsi128_ps(mask), b));
+  }
+
+  static Float ToFloat(Int a) { return _mm_cvtepi32_ps(a); }
+  static Int Truncate(Float a) { return _mm_cvttps_epi32(a); }
+  static Float AsFloat(Int a) { return _mm_castsi128_ps(a); }
+  static Int AsInt(Float a) { return _mm_castps_si128(a); }
+
+  /// <summary>
+  /// Reads the first 4 fields of 4 structures which are stride bytes apart, one field per vector.
+  /// </summary>
+  static void LoadColumns(const void *in, size_t stride, Float &c0, Float &c1, Float &c2, Float &c3) {
+    const BYTE *bytes = reinterpret_cast<const BYTE*>(in);
+    c0 = _mm_loadu_ps(reinterpret_cast<const float*>(bytes));
+    c1 = _mm_loadu_ps(reinterpret_cast<const float*>(bytes + stride));
+    c2 = _mm_loadu_ps(reinterpret_cast<const float*>(bytes + 2 * stride));
+    c3 = _mm_loadu_ps(reinterpret_cast<const float*>(bytes + 3 * stride));
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  }
+
+  /// <summary>
+  /// Writes the first 4 fields of 4 structures which are stride bytes apart, one field per vector.
+  /// </summary>
+  static void StoreColumns(void *out, size_t stride, Float c0, Float c1, Float c2, Float c3) {
+    BYTE *bytes = reinterpret_cast<BYTE*>(out);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(reinterpret_cast<float*>(bytes), c0);
+    _mm_storeu_ps(reinterpret_cast<float*>(bytes + stride), c1);
+    _mm_storeu_ps(reinterpret_cast<float*>(bytes + 2 * stride), c2);
+    _mm_storeu_ps(reinterpret_cast<float*>(bytes + 3 * stride), c3);
+  }
+};
+#endif
+
+
+#if defined(COLOR_USE_AVX2)
+/// <summary>
+/// Eight lanes of AVX2.
+/// </summary>
+struct AVX2Lanes {
+  typedef __m256 Float;
+  typedef __m256i Int;
+  enum { count = 8 };
+
+  static Float Set(float value) { return _mm256_set1_ps(value); }
+  static Int Set(int value) { return _mm256_set1_epi32(value); }
+  static Int Load(const ARGB *colors) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colors)); }
+  static void Store(ARGB *colors, Int value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(colors), value); }
+
+  static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+  static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+  static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+  static Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+  static Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+  static Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+  static Float Abs(Float a) { return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF))); }
+  static Int Equal(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+  static Int Greater(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+
+  static Int Add(Int a, Int b) { return _mm256_add_epi32(a, b); }
+  static Int Equal(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+  static Int Less(Int a, Int b) { return _mm256_cmpgt_epi32(b, a); }
+  static Int And(Int a, Int b) { return _mm256_and_si256(a, b); }
+  static Int AndNot(Int mask, Int b) { return _mm256_andnot_si256(mask, b); }
+  static Int Or(Int a, Int b) { return _mm256_or_si256(a, b); }
+  static Int ShiftLeft(Int a, int bits) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+  static Int ShiftRight(Int a, int bits) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(bits)); }
+  static Float Select(Int mask, Float a, Float b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+
+  static Float ToFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+  static Int Truncate(Float a) { return _mm256_cvttps_epi32(a); }
+  static Float AsFloat(Int a) { return _mm256_castsi256_ps(a); }
+  static Int AsInt(Float a) { return _mm256_castps_si256(a); }
+
+  /// <summary>
+  /// Reads the first 4 fields of 8 structures which are stride bytes apart, one field per vector.
+  /// </summary>
+  static void LoadColumns(const void *in, size_t stride, Float &c0, Float &c1, Float &c2, Float &c3) {
+    __m128 low[4], high[4];
+    SSE2Lanes::LoadColumns(in, stride, low[0], low[1], low[2], low[3]);
+    SSE2Lanes::LoadColumns(reinterpret_cast<const BYTE*>(in) + 4 * stride, stride, high[0], high[1], high[2],
+      high[3]);
+    c0 = _mm256_insertf128_ps(_mm256_castps128_ps256(low[0]), high[0], 1);
+    c1 = _mm256_insertf128_ps(_mm256_castps128_ps256(low[1]), high[1], 1);
+    c2 = _mm256_insertf128_ps(_mm256_castps128_ps256(low[2]), high[2], 1);
+    c3 = _mm256_insertf128_ps(_mm256_castps128_ps256(low[3]), high[3], 1);
+  }
+
+  /// <summary>
+  /// Writes the first 4 fields of 8 structures which are stride bytes apart, one field per vector.
+  /// </summary>
+  static void StoreColumns(void *out, size_t stride, Float c0, Float c1, Float c2, Float c3) {
+    SSE2Lanes::StoreColumns(out, stride, _mm256_castps256_ps128(c0), _mm256_castps256_ps128(c1),
+      _mm256_castps256_ps128(c2), _mm256_castps256_ps128(c3));
+    SSE2Lanes::StoreColumns(reinterpret_cast<BYTE*>(out) + 4 * stride, stride, _mm256_extractf128_ps(c0, 1),
+      _mm256_extractf128_ps(c1, 1), _mm256_extractf128_ps(c2, 1), _mm256_extractf128_ps(c3, 1));
+  }
+};
+#endif
+
+
+#if defined(COLOR_USE_SSE2)
+/// <summary>
+/// Rounds each lane the way (int)floor(value + 0.5f) does.
+/// </summary>
+template <class L>
+static inline typename L::Int RoundToInt(typename L::Float value) {
+  typename L::Float half = L::Add(value, L::Set(0.5f));
+  typename L::Int truncated = L::Truncate(half);
+
+  // Truncation rounds negative values up. The mask is -1 in the lanes which are one too high.
+  return L::Add(truncated, L::Greater(L::ToFloat(truncated), half));
+}
+
+
+/// <summary>
+/// fmodf(value, 2.0f), for values within the range of int.
+/// </summary>
+template <class L>
+static inline typename L::Float Mod2(typename L::Float value) {
+  typename L::Float halves = L::ToFloat(L::Truncate(L::Mul(value, L::Set(0.5f))));
+  return L::Sub(value, L::Add(halves, halves));
+}
+
+
+/// <summary>
+/// Assembles ARGB colors from the largest (c), middle (x), and smallest (m) channel values, placed
+/// according to the sextant of the hue, the way the switches in AHSLToARGB and AHSVToARGB do.
+/// </summary>
+template <class L>
+static inline typename L::Int PlaceChannels(typename L::Int alpha, typename L::Int sextant,
+    typename L::Int c, typename L::Int x, typename L::Int m) {
+  typedef typename L::Int Int;
+  Int s0 = L::Equal(sextant, L::Set(0)), s1 = L::Equal(sextant, L::Set(1)), s2 = L::Equal(sextant, L::Set(2));
+  Int s3 = L::Equal(sextant, L::Set(3)), s4 = L::Equal(sextant, L::Set(4)), s5 = L::Equal(sextant, L::Set(5));
+
+  // Lanes outside of the 6 sextants match none of these, and come out black.
+  Int red = L::Or(L::And(L::Or(s0, s5), c), L::Or(L::And(L::Or(s1, s4), x), L::And(L::Or(s2, s3), m)));
+  Int green = L::Or(L::And(L::Or(s1, s2), c), L::Or(L::And(L::Or(s0, s3), x), L::And(L::Or(s4, s5), m)));
+  Int blue = L::Or(L::And(L::Or(s3, s4), c), L::Or(L::And(L::Or(s2, s5), x), L::And(L::Or(s0, s1), m)));
+
+  return L::Or(L::Or(L::ShiftLeft(alpha, 24), L::ShiftLeft(red, 16)), L::Or(L::ShiftLeft(green, 8), blue));
+}
+
+
+/// <summary>
+/// Converts L::count AHSL colors to ARGB.
+/// </summary>
+template <class L>
+static inline void AHSLToARGBLanes(const AHSL *colors, ARGB *out) {
+  typedef typename L::Float Float;
+  Float alpha, hue, saturation, lightness;
+  L::LoadColumns(colors, sizeof(AHSL), alpha, hue, saturation, lightness);
+
+  Float nSaturation = L::Div(saturation, L::Set(float(COLOR_MAX_SATURATION)));
+  Float nLightness = L::Div(lightness, L::Set(float(COLOR_MAX_LIGHTNESS)));
+  Float h = L::Div(L::ToFloat(L::AsInt(hue)), L::Set(60.0f));
+  Float chroma = L::Mul(nSaturation,
+    L::Sub(L::Set(1.0f), L::Abs(L::Sub(L::Mul(L::Set(2.0f), nLightness), L::Set(1.0f)))));
+  Float m = L::Sub(nLightness, L::Div(chroma, L::Set(2.0f)));
+  Float x = L::Mul(chroma, L::Sub(L::Set(1.0f), L::Abs(L::Sub(Mod2<L>(h), L::Set(1.0f)))));
+
+  const Float byteMax = L::Set(255.0f);
+  L::Store(out, PlaceChannels<L>(L::AsInt(alpha), L::Truncate(h),
+    RoundToInt<L>(L::Mul(L::Add(chroma, m), byteMax)),
+    RoundToInt<L>(L::Mul(L::Add(x, m), byteMax)),
+    RoundToInt<L>(L::Mul(m, byteMax))));
+}
+
+
+/// <summary>
+/// Converts L::count AHSV colors to ARGB.
+/// </summary>
+template <class L>
+static inline void AHSVToARGBLanes(const AHSV *colors, ARGB *out) {
+  typedef typename L::Float Float;
+  Float alpha, hue, saturation, value;
+  L::LoadColumns(colors, sizeof(AHSV), alpha, hue, saturation, value);
+
+  // AHSVToARGB takes whole percentages.
+  Float nSaturation = L::Div(L::ToFloat(L::Truncate(saturation)), L::Set(float(COLOR_MAX_SATURATION)));
+  Float nValue = L::Div(L::ToFloat(L::Truncate(value)), L::Set(float(COLOR_MAX_VALUE)));
+  Float h = L::Div(L::ToFloat(L::AsInt(hue)), L::Set(60.0f));
+  Float chroma = L::Mul(nValue, nSaturation);
+  Float m = L::Sub(nValue, chroma);
+  Float x = L::Mul(chroma, L::Sub(L::Set(1.0f), L::Abs(L::Sub(Mod2<L>(h), L::Set(1.0f)))));
+
+  const Float byteMax = L::Set(255.0f);
+  L::Store(out, PlaceChannels<L>(L::AsInt(alpha), L::Truncate(h),
+    L::Truncate(L::Mul(L::Add(chroma, m), byteMax)),
+    L::Truncate(L::Mul(L::Add(x, m), byteMax)),
+    L::Truncate(L::Mul(m, byteMax))));
+}
+
+
+/// <summary>
+/// Splits L::count ARGB colors into their channels, and computes the hue the way ARGBToAHSL and
+/// ARGBToAHSV do.
+/// </summary>
+template <class L>
+static inline void SplitChannels(const ARGB *colors, typename L::Int &alpha, typename L::Int &hue,
+    typename L::Float &max, typename L::Float &min) {
+  typedef typename L::Float Float;
+  typedef typename L::Int Int;
+  const Float byteMax = L::Set(255.0f);
+  const Int byteMask = L::Set(0xFF);
+
+  Int argb = L::Load(colors);
+  Float r = L::Div(L::ToFloat(L::And(L::ShiftRight(argb, 16), byteMask)), byteMax);
+  Float g = L::Div(L::ToFloat(L::And(L::ShiftRight(argb, 8), byteMask)), byteMax);
+  Float b = L::Div(L::ToFloat(L::And(argb, byteMask)), byteMax);
+  alpha = L::ShiftRight(argb, 24);
+
+  max = L::Max(r, L::Max(g, b));
+  min = L::Min(r, L::Min(g, b));
+  Float chroma = L::Sub(max, min);
+
+  // All three candidates are computed, and picked in the same order as the scalar versions. Lanes
+  // with a chroma of 0 divide by 0 here, and are zeroed at the end.
+  Float hueR = L::Mul(L::Set(60.0f), L::Div(L::Sub(g, b), chroma));
+  Float hueG = L::Mul(L::Set(60.0f), L::Add(L::Div(L::Sub(b, r), chroma), L::Set(2.0f)));
+  Float hueB = L::Mul(L::Set(60.0f), L::Add(L::Div(L::Sub(r, g), chroma), L::Set(4.0f)));
+  hue = L::Truncate(L::Select(L::Equal(max, r), hueR, L::Select(L::Equal(max, g), hueG, hueB)));
+  hue = L::Add(hue, L::And(L::Less(hue, L::Set(0)), L::Set(360)));
+  hue = L::AndNot(L::Equal(chroma, L::Set(0.0f)), hue);
+}
+
+
+/// <summary>
+/// Converts L::count ARGB colors to AHSL.
+/// </summary>
+template <class L>
+static inline void ARGBToAHSLLanes(const ARGB *colors, AHSL *out) {
+  typedef typename L::Float Float;
+  typename L::Int alpha, hue;
+  Float max, min;
+  SplitChannels<L>(colors, alpha, hue, max, min);
+
+  Float chroma = L::Sub(max, min);
+  Float lightness = L::Div(L::Add(max, min), L::Set(2.0f));
+  Float divisor = L::Sub(L::Set(1.0f), L::Abs(L::Sub(L::Mul(L::Set(2.0f), lightness), L::Set(1.0f))));
+  Float saturation = L::Div(L::Mul(L::Set(float(COLOR_MAX_SATURATION)), chroma), divisor);
+  saturation = L::AsFloat(L::AndNot(L::Equal(divisor, L::Set(0.0f)), L::AsInt(saturation)));
+
+  L::StoreColumns(out, sizeof(AHSL), L::AsFloat(alpha), L::AsFloat(hue), saturation,
+    L::Mul(L::Set(float(COLOR_MAX_LIGHTNESS)), lightness));
+}
+
+
+/// <summary>
+/// Converts L::count ARGB colors to AHSV.
+/// </summary>
+template <class L>
+static inline void ARGBToAHSVLanes(const ARGB *colors, AHSV *out) {
+  typedef typename L::Float Float;
+  typename L::Int alpha, hue;
+  Float max, min;
+  SplitChannels<L>(colors, alpha, hue, max, min);
+
+  // The scalar version stores these as UCHARs.
+  const typename L::Int byteMask = L::Set(0xFF);
+  Float saturation = L::Div(L::Mul(L::Set(float(COLOR_MAX_SATURATION)), L::Sub(max, min)), max);
+  saturation = L::ToFloat(L::AndNot(L::Equal(max, L::Set(0.0f)), L::And(L::Truncate(saturation), byteMask)));
+  Float value = L::ToFloat(L::And(L::Truncate(L::Mul(L::Set(float(COLOR_MAX_VALUE)), max)), byteMask));
+
+  L::StoreColumns(out, sizeof(AHSV), L::AsFloat(alpha), L::AsFloat(hue), saturation, value);
+}
+
+
+/// <summary>
+/// Converts L::count ARGB colors to D2D_COLOR_F structures which are stride bytes apart.
+/// </summary>
+template <class L>
+static inline void ARGBToD2DLanes(const ARGB *colors, float *out, size_t stride) {
+  typedef typename L::Float Float;
+  const Float byteMax = L::Set(255.0f);
+  const typename L::Int byteMask = L::Set(0xFF);
+
+  typename L::Int argb = L::Load(colors);
+  Float r = L::Div(L::ToFloat(L::And(L::ShiftRight(argb, 16), byteMask)), byteMax);
+  Float g = L::Div(L::ToFloat(L::And(L::ShiftRight(argb, 8), byteMask)), byteMax);
+  Float b = L::Div(L::ToFloat(L::And(argb, byteMask)), byteMax);
+  Float a = L::Div(L::ToFloat(L::ShiftRight(argb, 24)), byteMax);
+  L::StoreColumns(out, stride, r, g, b, a);
+}
+#endif
+
+
+/// <summary>
+/// Converts an array of ARGB colors to D2D_COLOR_F structures which are stride bytes apart.
+/// </summary>
+static void ARGBToD2DStrided(const ARGB *colors, float *out, size_t stride, size_t count) {
+  size_t i = 0;
+
+#if defined(COLOR_USE_AVX2)
+  for (; i + AVX2Lanes::count <= count; i += AVX2Lanes::count) {
+    ARGBToD2DLanes<AVX2Lanes>(colors + i, reinterpret_cast<float*>(reinterpret_cast<BYTE*>(out) + stride * i), stride);
+  }
+#endif
+#if defined(COLOR_USE_SSE2)
+  for (; i + SSE2Lanes::count <= count; i += SSE2Lanes::count) {
+    ARGBToD2DLanes<SSE2Lanes>(colors + i, reinterpret_cast<float*>(reinterpret_cast<BYTE*>(out) + stride * i), stride);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    *reinterpret_cast<D2D_COLOR_F*>(reinterpret_cast<BYTE*>(out) + stride * i) = Color::ARGBToD2D(colors[i]);
+  }
+}
+
+
 /// <summary>
 /// Converts an ARGB formatted color to a D2D_COLOR_F format.
 /// </summary>
@@ -285,6 +640,22 @@ D2D_COLOR_F Color::ARGBToD2D(ARGB argb) {
 }
 
 
+/// <summary>
+/// Converts an array of ARGB formatted colors to D2D_COLOR_F format.
+/// </summary>
+void Color::ARGBToD2D(const ARGB *colors, D2D_COLOR_F *out, size_t count) {
+  ARGBToD2DStrided(colors, &out->r, sizeof(D2D_COLOR_F), count);
+}
+
+
+/// <summary>
+/// Sets the colors of an array of gradient stops. The positions are left alone.
+/// </summary>
+void Color::ARGBToD2D(const ARGB *colors, D2D1_GRADIENT_STOP *stops, size_t count) {
+  ARGBToD2DStrided(colors, &stops->color.r, sizeof(D2D1_GRADIENT_STOP), count);
+}
+
+
 /// <summary>
 /// Converts a D2D_COLOR_F formatted color to the ARGB format.
 /// </summary>
@@ -373,11 +744,42 @@ ARGB Color::AHSLToARGB(int alpha, int hue, float saturation, float lightness) {
 }
 
 
+/// <summary>
+/// Converts an array of AHSL colors to ARGB.
+/// </summary>
+void Color::AHSLToARGB(const AHSL *colors, ARGB *out, size_t count) {
+  size_t i = 0;
+
+#if defined(COLOR_USE_AVX2)
+  for (; i + AVX2Lanes::count <= count; i += AVX2Lanes::count) {
+    AHSLToARGBLanes<AVX2Lanes>(colors + i, out + i);
+  }
+#endif
+#if defined(COLOR_USE_SSE2)
+  for (; i + SSE2Lanes::count <= count; i += SSE2Lanes::count) {
+    AHSLToARGBLanes<SSE2Lanes>(colors + i, out + i);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    out[i] = AHSLToARGB(colors[i]);
+  }
+}
+
+
 ARGB Color::HSVToARGB(int hue, int saturation, int value) {
   return AHSVToARGB(0xFF, hue, saturation, value);
 }
 
 
+/// <summary>
+/// Converts an AHSV to an ARGB. The saturation and value are truncated to whole percentages.
+/// </summary>
+ARGB Color::AHSVToARGB(AHSV color) {
+  return AHSVToARGB(color.alpha, color.hue, int(color.saturation), int(color.value));
+}
+
+
 ARGB Color::AHSVToARGB(int alpha, int hue, int saturation, int value) {
   // Normalize the input
   float nSaturation = float(saturation) / COLOR_MAX_SATURATION;
@@ -401,6 +803,29 @@ ARGB Color::AHSVToARGB(int alpha, int hue, int saturation, int value) {
 }
 
 
+/// <summary>
+/// Converts an array of AHSV colors to ARGB.
+/// </summary>
+void Color::AHSVToARGB(const AHSV *colors, ARGB *out, size_t count) {
+  size_t i = 0;
+
+#if defined(COLOR_USE_AVX2)
+  for (; i + AVX2Lanes::count <= count; i += AVX2Lanes::count) {
+    AHSVToARGBLanes<AVX2Lanes>(colors + i, out + i);
+  }
+#endif
+#if defined(COLOR_USE_SSE2)
+  for (; i + SSE2Lanes::count <= count; i += SSE2Lanes::count) {
+    AHSVToARGBLanes<SSE2Lanes>(colors + i, out + i);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    out[i] = AHSVToARGB(colors[i]);
+  }
+}
+
+
 AHSL Color::ARGBToAHSL(ARGB color) {
   AHSL ret;
   D2D_COLOR_F c = ARGBToD2D(color);
@@ -426,14 +851,40 @@ AHSL Color::ARGBToAHSL(ARGB color) {
   }
 
   float L = (M + m) / 2.0f;
+  float D = 1.0f - fabs(2.0f*L - 1.0f);
 
+  // Black and white have no saturation. Dividing through would give NaN, which AHSLToARGB turns
+  // into black.
   ret.lightness = COLOR_MAX_LIGHTNESS*L;
-  ret.saturation = COLOR_MAX_SATURATION*C / (1.0f - fabs(2.0f*L - 1.0f));
+  ret.saturation = D == 0 ? 0.0f : COLOR_MAX_SATURATION*C / D;
 
   return ret;
 }
 
 
+/// <summary>
+/// Converts an array of ARGB colors to AHSL.
+/// </summary>
+void Color::ARGBToAHSL(const ARGB *colors, AHSL *out, size_t count) {
+  size_t i = 0;
+
+#if defined(COLOR_USE_AVX2)
+  for (; i + AVX2Lanes::count <= count; i += AVX2Lanes::count) {
+    ARGBToAHSLLanes<AVX2Lanes>(colors + i, out + i);
+  }
+#endif
+#if defined(COLOR_USE_SSE2)
+  for (; i + SSE2Lanes::count <= count; i += SSE2Lanes::count) {
+    ARGBToAHSLLanes<SSE2Lanes>(colors + i, out + i);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    out[i] = ARGBToAHSL(colors[i]);
+  }
+}
+
+
 AHSV Color::ARGBToAHSV(ARGB color) {
   AHSV ret;
   D2D_COLOR_F c = ARGBToD2D(color);
@@ -459,12 +910,35 @@ AHSV Color::ARGBToAHSV(ARGB color) {
   }
 
   ret.value = UCHAR(COLOR_MAX_VALUE*M);
-  ret.saturation = UCHAR(COLOR_MAX_SATURATION*C / M);
+  ret.saturation = M == 0 ? 0 : UCHAR(COLOR_MAX_SATURATION*C / M);
 
   return ret;
 }
 
 
+/// <summary>
+/// Converts an array of ARGB colors to AHSV.
+/// </summary>
+void Color::ARGBToAHSV(const ARGB *colors, AHSV *out, size_t count) {
+  size_t i = 0;
+
+#if defined(COLOR_USE_AVX2)
+  for (; i + AVX2Lanes::count <= count; i += AVX2Lanes::count) {
+    ARGBToAHSVLanes<AVX2Lanes>(colors + i, out + i);
+  }
+#endif
+#if defined(COLOR_USE_SSE2)
+  for (; i + SSE2Lanes::count <= count; i += SSE2Lanes::count) {
+    ARGBToAHSVLanes<SSE2Lanes>(colors + i, out + i);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    out[i] = ARGBToAHSV(colors[i]);
+  }
+}
+
+
 ARGB Color::Mix(ARGB color1, ARGB color2, float weight) {
   AHSL HSLcolor1 = ARGBToAHSL(color1);
   AHSL HSLcolor2 = ARGBToAHSL(color2);
@@ -478,6 +952,107 @@ ARGB Color::Mix(ARGB color1, ARGB color2, float weight) {
 }
 
 
+/// <summary>
+/// Mixes two arrays of colors, pairwise, with the same weight.
+/// </summary>
+void Color::Mix(const ARGB *colors1, const ARGB *colors2, float weight, ARGB *out, size_t count) {
+  // Work through the arrays in blocks, so that the intermediate values stay on the stack.
+  AHSL block1[64], block2[64];
+  for (size_t start = 0; start < count; start += _countof(block1)) {
+    size_t blockSize = std::min(count - start, _countof(block1));
+    ARGBToAHSL(colors1 + start, block1, blockSize);
+    ARGBToAHSL(colors2 + start, block2, blockSize);
+    for (size_t i = 0; i < blockSize; ++i) {
+      block1[i].alpha = int(Lerp(float(block1[i].alpha), float(block2[i].alpha), weight) + 0.5f);
+      block1[i].lightness = Lerp(block1[i].lightness, block2[i].lightness, weight);
+      block1[i].saturation = Lerp(block1[i].saturation, block2[i].saturation, weight);
+      block1[i].hue = int(WrappingLerp(float(block1[i].hue), float(block2[i].hue), weight, 0, COLOR_MAX_HUE));
+    }
+    AHSLToARGB(block1, out + start, blockSize);
+  }
+}
+
+
+/// <summary>
+/// Converts colors to AHSL in blocks, adjusts each of them, and converts them back.
+/// </summary>
+template <class Adjust>
+static void AdjustAHSL(ARGB *colors, size_t count, Adjust adjust) {
+  AHSL block[64];
+  for (size_t start = 0; start < count; start += _countof(block)) {
+    size_t blockSize = std::min(count - start, _countof(block));
+    Color::ARGBToAHSL(colors + start, block, blockSize);
+    for (size_t i = 0; i < blockSize; ++i) {
+      adjust(block[i]);
+    }
+    Color::AHSLToARGB(block, colors + start, blockSize);
+  }
+}
+
+
+/// <summary>
+/// Wraps a hue into [0, 360).
+/// </summary>
+static int WrapHue(int hue) {
+  hue %= 360;
+  return hue < 0 ? hue + 360 : hue;
+}
+
+
+/// <summary>
+/// Adds amount to the lightness of each color. Negative amounts darken.
+/// </summary>
+void Color::Lighten(ARGB *colors, size_t count, float amount) {
+  AdjustAHSL(colors, count, [amount] (AHSL &color) {
+    color.lightness = Clamp(color.lightness + amount, 0.0f, (float)COLOR_MAX_LIGHTNESS);
+  });
+}
+
+
+void Color::SetLightness(ARGB *colors, size_t count, float lightness) {
+  lightness = Clamp(lightness, 0.0f, (float)COLOR_MAX_LIGHTNESS);
+  AdjustAHSL(colors, count, [lightness] (AHSL &color) {
+    color.lightness = lightness;
+  });
+}
+
+
+/// <summary>
+/// Adds amount to the saturation of each color. Negative amounts desaturate.
+/// </summary>
+void Color::Saturate(ARGB *colors, size_t count, float amount) {
+  AdjustAHSL(colors, count, [amount] (AHSL &color) {
+    color.saturation = Clamp(color.saturation + amount, 0.0f, (float)COLOR_MAX_SATURATION);
+  });
+}
+
+
+void Color::SetSaturation(ARGB *colors, size_t count, float saturation) {
+  saturation = Clamp(saturation, 0.0f, (float)COLOR_MAX_SATURATION);
+  AdjustAHSL(colors, count, [saturation] (AHSL &color) {
+    color.saturation = saturation;
+  });
+}
+
+
+/// <summary>
+/// Turns the hue of each color by the specified number of degrees.
+/// </summary>
+void Color::Spin(ARGB *colors, size_t count, int degrees) {
+  AdjustAHSL(colors, count, [degrees] (AHSL &color) {
+    color.hue = WrapHue(color.hue + degrees);
+  });
+}
+
+
+void Color::SetHue(ARGB *colors, size_t count, int hue) {
+  hue = WrapHue(hue);
+  AdjustAHSL(colors, count, [hue] (AHSL &color) {
+    color.hue = hue;
+  });
+}
+
+
 IColorVal *Color::Parse(LPCTSTR colorString, const IColorVal* defaultValue) {
   IColorVal *color;
   if (ParseColor(colorString, &color)) {
@@ -60,13 +60,34 @@ namespace Color
     ARGB AHSLToARGB(AHSL color);
     ARGB HSVToARGB(int hue, int saturation, int value);
     ARGB AHSVToARGB(int alpha, int hue, int saturation, int value);
+    ARGB AHSVToARGB(AHSV color);
     AHSL ARGBToAHSL(ARGB color);
     AHSV ARGBToAHSV(ARGB color);
     D2D_COLOR_F ARGBToD2D(ARGB argb);
     ARGB D2DToARGB(D2D_COLOR_F d2d);
 
+    // Batch conversions. Give the same results, bit for bit, as calling the single color versions
+    // on each element, but process four colors at once where SSE2 is available, and eight where
+    // AVX2 is.
+    void ARGBToD2D(const ARGB *colors, D2D_COLOR_F *out, size_t count);
+    void ARGBToD2D(const ARGB *colors, D2D1_GRADIENT_STOP *stops, size_t count);
+    void AHSLToARGB(const AHSL *colors, ARGB *out, size_t count);
+    void AHSVToARGB(const AHSV *colors, ARGB *out, size_t count);
+    void ARGBToAHSL(const ARGB *colors, AHSL *out, size_t count);
+    void ARGBToAHSV(const ARGB *colors, AHSV *out, size_t count);
+
     // Color functions
     ARGB Mix(ARGB color1, ARGB color2, float weight);
+    void Mix(const ARGB *colors1, const ARGB *colors2, float weight, ARGB *out, size_t count);
+
+    // Color functions which work in HSL space. Each adjusts count colors in place, through the
+    // batch conversions.
+    void Lighten(ARGB *colors, size_t count, float amount);
+    void SetLightness(ARGB *colors, size_t count, float lightness);
+    void Saturate(ARGB *colors, size_t count, float amount);
+    void SetSaturation(ARGB *colors, size_t count, float saturation);
+    void Spin(ARGB *colors, size_t count, int degrees);
+    void SetHue(ARGB *colors, size_t count, int hue);
 
     // Parsing
     IColorVal* Parse(LPCTSTR colorString, const IColorVal* defaultValue);
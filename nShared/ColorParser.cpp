@@ -5,12 +5,11 @@
  *  Does the String -> ColorVal conversion.
  *  
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-#include "BinaryColorVal.hpp"
+#include "ColorProgram.hpp"
 #include "DWMColorVal.hpp"
 #include "IColorVal.hpp"
 #include "LiteStep.h"
 #include "LiteralColorVal.hpp"
-#include "UnaryColorVal.hpp"
 
 #include "../Utilities/Math.h"
 
@@ -63,34 +62,28 @@ static struct {
   ARGB(*func)(ARGB, long);
 } gUnaryFunctions[] = {
   { L"Lighten", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.lightness = Clamp(hslColor.lightness + value, 0.0f, (float)COLOR_MAX_LIGHTNESS);
-    return Color::AHSLToARGB(hslColor);
+    Color::Lighten(&color, 1, (float)value);
+    return color;
   } },
   { L"Darken", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.lightness = Clamp(hslColor.lightness - value, 0.0f, (float)COLOR_MAX_LIGHTNESS);
-    return Color::AHSLToARGB(hslColor);
+    Color::Lighten(&color, 1, -(float)value);
+    return color;
   } },
   { L"SetLightness", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.lightness = Clamp((float)value, 0.0f, (float)COLOR_MAX_LIGHTNESS);
-    return Color::AHSLToARGB(hslColor);
+    Color::SetLightness(&color, 1, (float)value);
+    return color;
   } },
   { L"Saturate", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.saturation = Clamp(hslColor.saturation + value, 0.0f, (float)COLOR_MAX_SATURATION);
-    return Color::AHSLToARGB(hslColor);
+    Color::Saturate(&color, 1, (float)value);
+    return color;
   } },
   { L"Desaturate", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.saturation = Clamp(hslColor.saturation - value, 0.0f, (float)COLOR_MAX_SATURATION);
-    return Color::AHSLToARGB(hslColor);
+    Color::Saturate(&color, 1, -(float)value);
+    return color;
   } },
   { L"SetSaturation", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.saturation = Clamp((float)value, 0.0f, (float)COLOR_MAX_SATURATION);
-    return Color::AHSLToARGB(hslColor);
+    Color::SetSaturation(&color, 1, (float)value);
+    return color;
   } },
   { L"Fadein", [] (ARGB color, long value) -> ARGB {
     // Could use bitops exclusively, but iffy when value is out of range.
@@ -103,22 +96,12 @@ static struct {
     return Clamp(value, 0, 0xFF) << 24 | color & 0xFFFFFF;
   } },
   { L"Spin", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.hue += value;
-    hslColor.hue %= 360;
-    if (hslColor.hue < 0) {
-      hslColor.hue += 360;
-    }
-    return Color::AHSLToARGB(hslColor);
+    Color::Spin(&color, 1, value);
+    return color;
   } },
   { L"SetHue", [] (ARGB color, long value) -> ARGB {
-    AHSL hslColor = Color::ARGBToAHSL(color);
-    hslColor.hue = value;
-    hslColor.hue %= 360;
-    if (hslColor.hue < 0) {
-      hslColor.hue += 360;
-    }
-    return Color::AHSLToARGB(hslColor);
+    Color::SetHue(&color, 1, value);
+    return color;
   } }
 };
 
@@ -218,12 +201,13 @@ static int _GetParametersAsInts(LPCWSTR source, UCHAR maxParams, LPINT out) {
 }
 
 
+static bool _Compile(LPCWSTR color, ColorProgram &program);
+
+
 /// <summary>
-/// Extracts an IColorVal and an amount from source.
+/// Extracts a color and an amount from source. The color is compiled into program.
 /// </summary>
-static bool _GetColorAndAmount(LPCWSTR source, IColorVal **color, LPLONG amount) {
-  bool ParseColor(LPCWSTR color, IColorVal **target);
-
+static bool _CompileColorAndAmount(LPCWSTR source, ColorProgram &program, LPLONG amount) {
   WCHAR val1[MAX_LINE_LENGTH], val2[MAX_LINE_LENGTH];
   LPWSTR params[] = { val1, val2 };
   LPWSTR endPtr;
@@ -237,15 +221,15 @@ static bool _GetColorAndAmount(LPCWSTR source, IColorVal **color, LPLONG amount)
     return false;
   }
 
-  return ParseColor(val1, color);
+  return _Compile(val1, program);
 }
 
 
 /// <summary>
-/// Parses a string to to a colorval.
+/// Compiles a color string, appending instructions which leave its value on the stack.
 /// </summary>
 /// <returns>True if the parsing succeeded.</returns>
-bool ParseColor(LPCTSTR color, IColorVal **target) {
+static bool _Compile(LPCWSTR color, ColorProgram &program) {
   // This happens a lot, might as well quit early.
   if (*color == L'\0') {
     return false;
@@ -283,7 +267,7 @@ bool ParseColor(LPCTSTR color, IColorVal **target) {
       return false;
     }
 
-    *target = new LiteralColorVal(colorValue);
+    program.PushLiteral(colorValue);
 
     return true;
   }
@@ -293,7 +277,7 @@ bool ParseColor(LPCTSTR color, IColorVal **target) {
     if (_IsFunctionOf(color, literal.funcName)) {
       int parameters[4];
       if (_GetParametersAsInts(color, literal.numParams, parameters) == literal.numParams) {
-        *target = new LiteralColorVal(literal.func(parameters));
+        program.PushLiteral(literal.func(parameters));
         return true;
       }
       return false;
@@ -303,16 +287,9 @@ bool ParseColor(LPCTSTR color, IColorVal **target) {
   // Check if it is a unary color function.
   for (auto unary : gUnaryFunctions) {
     if (_IsFunctionOf(color, unary.funcName)) {
-      IColorVal *colorVal;
       long amount;
-
-      if (_GetColorAndAmount(color, &colorVal, &amount)) {
-        if (colorVal->IsConstant()) {
-          *target = new LiteralColorVal(unary.func(colorVal->Evaluate(), amount));
-          delete colorVal;
-        } else {
-          *target = new UnaryColorVal(unary.func, colorVal, amount);
-        }
+      if (_CompileColorAndAmount(color, program, &amount)) {
+        program.ApplyUnary(unary.func, amount);
         return true;
       }
       return false;
@@ -326,8 +303,6 @@ bool ParseColor(LPCTSTR color, IColorVal **target) {
       LPTSTR params[] = { val1, val2, val3 };
       LPTSTR endPtr;
 
-      IColorVal *color1, *color2;
-
       if (_GetParameters(color, 3, params, MAX_LINE_LENGTH) != 3) {
         return false;
       }
@@ -338,20 +313,11 @@ bool ParseColor(LPCTSTR color, IColorVal **target) {
         return false;
       }
 
-      if (!ParseColor(val1, &color1)) {
+      if (!_Compile(val1, program) || !_Compile(val2, program)) {
         return false;
       }
 
-      if (!ParseColor(val2, &color2)) {
-        delete color1;
-        return false;
-      }
-
-      if (color1->IsConstant() && color2->IsConstant()) {
-        *target = new LiteralColorVal(binary.func(color1->Evaluate(), color2->Evaluate(), value));
-      } else {
-        *target = new BinaryColorVal(binary.func, color1, color2, value);
-      }
+      program.ApplyBinary(binary.func, value);
 
       return true;
     }
@@ -359,16 +325,39 @@ bool ParseColor(LPCTSTR color, IColorVal **target) {
 
   // Check if it is the DWM color
   if (_wcsicmp(color, L"DWMColor") == 0) {
-    *target = new DWMColorVal();
+    program.PushDWMColor();
     return true;
   }
 
   // Check if it's a named color
   ARGB argb;
   if (Color::GetNamedColor(color, &argb)) {
-    *target = new LiteralColorVal(argb);
+    program.PushLiteral(argb);
     return true;
   }
 
   return false;
 }
+
+
+/// <summary>
+/// Parses a string to to a colorval. Constant subexpressions are folded while compiling, so
+/// anything which does not refer to the DWM color ends up as a literal.
+/// </summary>
+/// <returns>True if the parsing succeeded.</returns>
+bool ParseColor(LPCTSTR color, IColorVal **target) {
+  ColorProgram program;
+  if (!_Compile(color, program)) {
+    return false;
+  }
+
+  if (program.IsConstant()) {
+    *target = new LiteralColorVal(program.Evaluate(0));
+  } else if (program.IsDWMColor()) {
+    *target = new DWMColorVal();
+  } else {
+    *target = new ColorProgram(std::move(program));
+  }
+
+  return true;
+}
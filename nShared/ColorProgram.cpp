@@ -0,0 +1,216 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ColorProgram.cpp
+ *  The nModules Project
+ *
+ *  A color expression, compiled into a flat stack program.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "ColorProgram.hpp"
+#include "DWMColorRegistry.hpp"
+
+
+/// <summary>
+/// Constructor
+/// </summary>
+ColorProgram::ColorProgram()
+    : mDepth(0)
+    , mMaxDepth(0)
+    , mUsesDWMColor(false)
+{
+}
+
+
+/// <summary>
+/// Copy constructor
+/// </summary>
+ColorProgram::ColorProgram(const ColorProgram &other)
+    : mInstructions(other.mInstructions)
+    , mDepth(other.mDepth)
+    , mMaxDepth(other.mMaxDepth)
+    , mUsesDWMColor(other.mUsesDWMColor)
+{
+}
+
+
+/// <summary>
+/// Move constructor
+/// </summary>
+ColorProgram::ColorProgram(ColorProgram &&other)
+    : mInstructions(std::move(other.mInstructions))
+    , mDepth(other.mDepth)
+    , mMaxDepth(other.mMaxDepth)
+    , mUsesDWMColor(other.mUsesDWMColor)
+{
+}
+
+
+/// <summary>
+/// Pushes a constant color.
+/// </summary>
+void ColorProgram::PushLiteral(ARGB color)
+{
+    Instruction instruction;
+    instruction.opCode = OpCode::Literal;
+    instruction.color = color;
+    instruction.unary = nullptr;
+    mInstructions.push_back(instruction);
+
+    if (++mDepth > mMaxDepth)
+    {
+        mMaxDepth = mDepth;
+    }
+}
+
+
+/// <summary>
+/// Pushes the DWM color.
+/// </summary>
+void ColorProgram::PushDWMColor()
+{
+    Instruction instruction;
+    instruction.opCode = OpCode::DWMColor;
+    instruction.color = 0;
+    instruction.unary = nullptr;
+    mInstructions.push_back(instruction);
+    mUsesDWMColor = true;
+
+    if (++mDepth > mMaxDepth)
+    {
+        mMaxDepth = mDepth;
+    }
+}
+
+
+/// <summary>
+/// Applies a unary function to the top of the stack.
+/// </summary>
+void ColorProgram::ApplyUnary(UnaryFunc func, long amount)
+{
+    // An operand which ends in a literal push is that literal, so the call can be made right now.
+    if (mInstructions.back().opCode == OpCode::Literal)
+    {
+        mInstructions.back().color = func(mInstructions.back().color, amount);
+        return;
+    }
+
+    Instruction instruction;
+    instruction.opCode = OpCode::Unary;
+    instruction.amount = amount;
+    instruction.unary = func;
+    mInstructions.push_back(instruction);
+}
+
+
+/// <summary>
+/// Applies a binary function to the top two values of the stack.
+/// </summary>
+void ColorProgram::ApplyBinary(BinaryFunc func, float weight)
+{
+    size_t count = mInstructions.size();
+    if (mInstructions[count - 1].opCode == OpCode::Literal && mInstructions[count - 2].opCode == OpCode::Literal)
+    {
+        mInstructions[count - 2].color = func(mInstructions[count - 2].color, mInstructions[count - 1].color, weight);
+        mInstructions.pop_back();
+        --mDepth;
+        return;
+    }
+
+    Instruction instruction;
+    instruction.opCode = OpCode::Binary;
+    instruction.weight = weight;
+    instruction.binary = func;
+    mInstructions.push_back(instruction);
+    --mDepth;
+}
+
+
+/// <summary>
+/// Returns true if this program does nothing but push the DWM color.
+/// </summary>
+bool ColorProgram::IsDWMColor() const
+{
+    return mInstructions.size() == 1 && mInstructions[0].opCode == OpCode::DWMColor;
+}
+
+
+/// <summary>
+/// IColorVal::IsConstant
+/// Returns true if this is a constant value.
+/// </summary>
+bool ColorProgram::IsConstant() const
+{
+    return !mUsesDWMColor;
+}
+
+
+/// <summary>
+/// IColorVal::Evaluate
+/// Evaluates this color value.
+/// </summary>
+ARGB ColorProgram::Evaluate() const
+{
+    return Run(mUsesDWMColor ? DWMColorRegistry::GetColor() : 0);
+}
+
+
+/// <summary>
+/// IColorVal::Evaluate
+/// Evaluates this color value.
+/// </summary>
+ARGB ColorProgram::Evaluate(ARGB DWMColor) const
+{
+    return Run(DWMColor);
+}
+
+
+/// <summary>
+/// IColorVal::Copy
+/// Creates a deep copy of this value.
+/// </summary>
+IColorVal* ColorProgram::Copy() const
+{
+    return new ColorProgram(*this);
+}
+
+
+/// <summary>
+/// Runs the program.
+/// </summary>
+ARGB ColorProgram::Run(ARGB DWMColor) const
+{
+    // Only deeply right-nested binary functions go past the local stack.
+    ARGB localStack[16];
+    std::vector<ARGB> heapStack;
+    ARGB *stack = localStack;
+    if (mMaxDepth > int(_countof(localStack)))
+    {
+        heapStack.resize(mMaxDepth);
+        stack = heapStack.data();
+    }
+
+    int top = -1;
+    for (const Instruction &instruction : mInstructions)
+    {
+        switch (instruction.opCode)
+        {
+        case OpCode::Literal:
+            stack[++top] = instruction.color;
+            break;
+
+        case OpCode::DWMColor:
+            stack[++top] = DWMColor;
+            break;
+
+        case OpCode::Unary:
+            stack[top] = instruction.unary(stack[top], instruction.amount);
+            break;
+
+        case OpCode::Binary:
+            --top;
+            stack[top] = instruction.binary(stack[top], stack[top + 1], instruction.weight);
+            break;
+        }
+    }
+
+    return stack[0];
+}
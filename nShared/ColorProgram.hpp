@@ -0,0 +1,84 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ColorProgram.hpp
+ *  The nModules Project
+ *
+ *  A color expression, compiled into a flat stack program.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#pragma once
+
+#include "IColorVal.hpp"
+
+#include <vector>
+
+class ColorProgram : public IColorVal
+{
+public:
+    typedef ARGB (*UnaryFunc)(ARGB, long);
+    typedef ARGB (*BinaryFunc)(ARGB, ARGB, float);
+
+private:
+    enum class OpCode : BYTE
+    {
+        Literal,
+        DWMColor,
+        Unary,
+        Binary
+    };
+
+    struct Instruction
+    {
+        OpCode opCode;
+        union
+        {
+            ARGB color;
+            long amount;
+            float weight;
+        };
+        union
+        {
+            UnaryFunc unary;
+            BinaryFunc binary;
+        };
+    };
+
+public:
+    explicit ColorProgram();
+    ColorProgram(const ColorProgram &other);
+    ColorProgram(ColorProgram &&other);
+
+public:
+    // Pushes a constant color.
+    void PushLiteral(ARGB color);
+
+    // Pushes the DWM color.
+    void PushDWMColor();
+
+    // Replaces the top of the stack with func(top, amount). Folded if the top is a constant.
+    void ApplyUnary(UnaryFunc func, long amount);
+
+    // Replaces the top two values with func(second, top, weight). Folded if both are constants.
+    void ApplyBinary(BinaryFunc func, float weight);
+
+    // Returns true if the program is exactly "DWMColor".
+    bool IsDWMColor() const;
+
+public:
+    bool IsConstant() const override;
+    ARGB Evaluate() const override;
+    ARGB Evaluate(ARGB DWMColor) const override;
+    IColorVal* Copy() const override;
+
+private:
+    ARGB Run(ARGB DWMColor) const;
+
+private:
+    std::vector<Instruction> mInstructions;
+
+    // The number of values the program leaves on the stack, and the most it ever holds.
+    int mDepth;
+    int mMaxDepth;
+
+    // True if any instruction pushes the DWM color.
+    bool mUsesDWMColor;
+};
@@ -0,0 +1,102 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  DWMColorRegistry.cpp
+ *  The nModules Project
+ *
+ *  Keeps track of the DWM color, and of the brushes which depend on it.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "DWMColorRegistry.hpp"
+#include "Brush.hpp"
+
+#include <algorithm>
+#include <dwmapi.h>
+#include <vector>
+
+
+static bool sHaveColor = false;
+static ARGB sColor = 0;
+static std::vector<Brush*> sBrushes;
+
+
+/// <summary>
+/// Returns the current DWM colorization color.
+/// </summary>
+ARGB DWMColorRegistry::GetColor() {
+  if (!sHaveColor) {
+    ARGB color = 0;
+    BOOL opaque;
+    DwmGetColorizationColor(&color, &opaque);
+    sColor = Normalize(color);
+    sHaveColor = true;
+  }
+  return sColor;
+}
+
+
+/// <summary>
+/// Fixes up a colorization color as reported by DWM.
+/// </summary>
+ARGB DWMColorRegistry::Normalize(ARGB color) {
+  // When the intensity is really high, the alpha drops to 0 :/
+  if (color >> 24 == 0 && color != 0) {
+    color |= 0xFF000000;
+  }
+  return color;
+}
+
+
+/// <summary>
+/// Starts tracking a brush whose colors depend on the DWM color.
+/// </summary>
+void DWMColorRegistry::Register(Brush *brush) {
+  sBrushes.push_back(brush);
+}
+
+
+/// <summary>
+/// Stops tracking a brush.
+/// </summary>
+void DWMColorRegistry::Unregister(Brush *brush) {
+  auto iter = std::find(sBrushes.begin(), sBrushes.end(), brush);
+  if (iter != sBrushes.end()) {
+    *iter = sBrushes.back();
+    sBrushes.pop_back();
+  }
+}
+
+
+/// <summary>
+/// Called when the DWM color has changed. Every top-level window receives the notification, so
+/// only the first one to pass it on does any work.
+/// </summary>
+bool DWMColorRegistry::Update(ARGB newColor) {
+  if (sHaveColor && sColor == newColor) {
+    return false;
+  }
+  sColor = newColor;
+  sHaveColor = true;
+
+  // Child windows share the render target of their top-level window, so invalidating the window
+  // behind each render target covers everything which may have changed.
+  std::vector<HWND> windows;
+  for (Brush *brush : sBrushes) {
+    ID2D1RenderTarget *renderTarget = brush->GetRenderTarget();
+    if (brush->UpdateDWMColor(newColor, renderTarget) && renderTarget) {
+      ID2D1HwndRenderTarget *hwndTarget;
+      if (SUCCEEDED(renderTarget->QueryInterface(&hwndTarget))) {
+        HWND window = hwndTarget->GetHwnd();
+        if (std::find(windows.begin(), windows.end(), window) == windows.end()) {
+          windows.push_back(window);
+        }
+        hwndTarget->Release();
+      }
+    }
+  }
+
+  for (HWND window : windows) {
+    InvalidateRect(window, nullptr, TRUE);
+    UpdateWindow(window);
+  }
+
+  return true;
+}
@@ -0,0 +1,30 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  DWMColorRegistry.hpp
+ *  The nModules Project
+ *
+ *  Keeps track of the DWM color, and of the brushes which depend on it.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#pragma once
+
+#include "IColorVal.hpp"
+
+class Brush;
+
+namespace DWMColorRegistry {
+  // Returns the current DWM colorization color. Only asks DWM the first time.
+  ARGB GetColor();
+
+  // Fixes up a colorization color as reported by DWM.
+  ARGB Normalize(ARGB color);
+
+  // Starts tracking a brush whose colors depend on the DWM color.
+  void Register(Brush *brush);
+
+  // Stops tracking a brush.
+  void Unregister(Brush *brush);
+
+  // Re-evaluates every registered brush, and repaints the windows they draw to. Does nothing,
+  // and returns false, if newColor is the color which is already in use.
+  bool Update(ARGB newColor);
+}
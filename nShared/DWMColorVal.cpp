@@ -6,7 +6,7 @@
  *  
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "DWMColorVal.hpp"
-#include <dwmapi.h>
+#include "DWMColorRegistry.hpp"
 
 
 /// <summary>
@@ -33,17 +33,7 @@ bool DWMColorVal::IsConstant() const
 /// </summary>
 ARGB DWMColorVal::Evaluate() const
 {
-    ARGB color;
-    BOOL opaque;
-    DwmGetColorizationColor(&color, &opaque);
-
-    // When the intensity is really high, the alpha drops to 0 :/
-    if (color >> 24 == 0 && color != 0)
-    {
-        color |= 0xFF000000;
-    }
-
-    return color;
+    return DWMColorRegistry::GetColor();
 }
 
 
@@ -16,9 +16,12 @@
 /// Easing Name -> Easing::Type
 /// </summary>
 static StringKeyedMaps<LPCWSTR, Easing::Type>::ConstUnorderedMap sStringToEasing({
+  { L"Squared", Easing::Type::Squared },
   { L"Cubic", Easing::Type::Cubic },
+  { L"Quadractic", Easing::Type::Quadractic },
   { L"Sine", Easing::Type::Sine },
   { L"Bounce", Easing::Type::Bounce },
+  { L"Elastic", Easing::Type::Elastic },
   { L"Linear", Easing::Type::Linear }
 });
 
@@ -32,13 +35,40 @@ float Easing::Transform(float progress, Type easingType) {
   switch (easingType) {
   case Type::Linear:
     return progress;
+
+  case Type::Squared:
+    return progress*progress;
+
   case Type::Cubic:
     return progress*progress*progress;
+
+  case Type::Quadractic:
+    return progress*progress*progress*progress;
+
   case Type::Sine:
     return (float)sin(1.57079632679*progress);
+
   case Type::Bounce:
-    //if (progress < 0.6) return progress*progress/0.36f;
-    //if (progress < 0.8) return pow(progress-0.6, 2)
+    // Falls into place, bouncing 3 times on the way.
+    if (progress < 1/2.75f) {
+      return 7.5625f*progress*progress;
+    } else if (progress < 2/2.75f) {
+      progress -= 1.5f/2.75f;
+      return 7.5625f*progress*progress + 0.75f;
+    } else if (progress < 2.5f/2.75f) {
+      progress -= 2.25f/2.75f;
+      return 7.5625f*progress*progress + 0.9375f;
+    }
+    progress -= 2.625f/2.75f;
+    return 7.5625f*progress*progress + 0.984375f;
+
+  case Type::Elastic:
+    // Overshoots the target, and springs back and forth around it as it settles.
+    if (progress <= 0.0f || progress >= 1.0f) {
+      return progress <= 0.0f ? 0.0f : 1.0f;
+    }
+    return (float)(pow(2.0, -10.0*progress)*sin((progress - 0.075)*(2*3.14159265359)/0.3) + 1.0);
+
   default:
     return progress;
   }
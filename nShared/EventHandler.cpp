@@ -10,8 +10,11 @@
 #include <Windowsx.h>
 #include "EventHandler.hpp"
 #include "../nCoreCom/Core.h"
+#include "../nCoreCom/Tracing.h"
 #include "Distance.hpp"
 
+#include <algorithm>
+
 
 /// <summary>
 /// Creates a new instance of the ClickHandler class.
@@ -19,6 +22,7 @@
 EventHandler::EventHandler(Settings* settings) {
   this->settings = settings;
   this->mouseOver = false;
+  this->m_nextOrder = 0;
   LoadSettings();
 }
 
@@ -27,14 +31,14 @@ EventHandler::EventHandler(Settings* settings) {
 /// Destroys this instance of the ClickHandler class.
 /// </summary>
 EventHandler::~EventHandler() {
-  m_clickHandlers.clear();
+  m_buckets.clear();
 }
 
 
 /// <summary>
 /// Call this when a click is triggered.
 /// </summary>
-void EventHandler::HandleMessage(HWND, UINT msg, WPARAM wParam, LPARAM /* lParam */) {
+void EventHandler::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM lParam) {
   ClickData cData;
 
   // Find the type of this click event
@@ -83,16 +87,107 @@ void EventHandler::HandleMessage(HWND, UINT msg, WPARAM wParam, LPARAM /* lParam
   }
 
   cData.mods = GET_KEYSTATE_WPARAM(wParam) & (4 | 8);
-  // GET_X_LPARAM and GET_Y_LPARAM are relative to the desktop window.
-  // cData.area is relative to the virual desktop.
-  //cData.area.left = cData.area.right = GET_X_LPARAM(lParam) + g_pMonitorInfo->m_virtualDesktop.rect.left;
-  //cData.area.top = cData.area.bottom = GET_Y_LPARAM(lParam) + g_pMonitorInfo->m_virtualDesktop.rect.top;
-
-  for (vector<ClickData>::const_iterator iter = m_clickHandlers.begin(); iter != m_clickHandlers.end(); iter++) {
-    if (EventHandler::Matches(cData, *iter)) {
-      LiteStep::LSExecute(nullptr, iter->action, SW_SHOW);
+
+  auto bucket = m_buckets.find(MAKELONG(cData.type, cData.mods));
+  if (bucket == m_buckets.end()) {
+    return;
+  }
+
+  if (bucket->second.areas.empty()) {
+    for (const Handler &handler : bucket->second.anywhere) {
+      Fire(handler.action);
+    }
+    return;
+  }
+
+  // Areas are in screen coordinates. The wheel messages already are, the other mouse messages
+  // are relative to the window, and leave has no position at all.
+  POINT pt;
+  switch (msg) {
+  case WM_MOUSEWHEEL:
+  case WM_MOUSEHWHEEL:
+    pt.x = GET_X_LPARAM(lParam);
+    pt.y = GET_Y_LPARAM(lParam);
+    break;
+  case WM_MOUSELEAVE:
+    GetCursorPos(&pt);
+    break;
+  default:
+    pt.x = GET_X_LPARAM(lParam);
+    pt.y = GET_Y_LPARAM(lParam);
+    ClientToScreen(window, &pt);
+    break;
+  }
+
+  // Fire everything that matches in the order it was added.
+  vector<const Handler*> matches;
+  for (const Handler &handler : bucket->second.anywhere) {
+    matches.push_back(&handler);
+  }
+  for (const Handler &handler : bucket->second.areas) {
+    if (handler.area.left > pt.x) {
+      break;
+    }
+    if (pt.x <= handler.area.right && pt.y >= handler.area.top && pt.y <= handler.area.bottom) {
+      matches.push_back(&handler);
     }
   }
+  std::sort(matches.begin(), matches.end(), [] (const Handler *a, const Handler *b) -> bool {
+    return a->order < b->order;
+  });
+  for (const Handler *handler : matches) {
+    Fire(handler->action);
+  }
+}
+
+
+/// <summary>
+/// Runs an action.
+/// </summary>
+void EventHandler::Fire(const Action &action) {
+  TRACE_SPAN("EventHandler::Fire");
+  if (action.bang.empty()) {
+    LiteStep::LSExecute(nullptr, action.command.c_str(), SW_SHOW);
+  } else {
+    LiteStep::ParseBangCommand(nullptr, action.bang.c_str(), action.args.c_str());
+  }
+}
+
+
+/// <summary>
+/// Splits a single bang into its name and arguments, so that it can be handed straight to
+/// ParseBangCommand. Anything else -- programs, bang groups, bang names made of variables -- is
+/// left for LSExecute. The arguments are still expanded when the bang runs.
+/// </summary>
+EventHandler::Action EventHandler::CompileAction(LPCTSTR action) {
+  Action ret;
+  ret.command = action;
+
+  LPCTSTR start = action;
+  while (*start == L' ' || *start == L'\t') {
+    ++start;
+  }
+  if (*start != L'!') {
+    return ret;
+  }
+
+  LineTokenizer tokenizer(start);
+  StringSpan bang;
+  if (!tokenizer.Next(bang) || std::find(bang.begin, bang.begin + bang.length, L'$') != bang.begin + bang.length) {
+    return ret;
+  }
+  ret.bang = bang.ToString();
+  ret.args = tokenizer.Rest() != nullptr ? tokenizer.Rest() : L"";
+
+  return ret;
+}
+
+
+/// <summary>
+/// True if the area doesn't cover the whole virtual screen.
+/// </summary>
+bool EventHandler::IsRestricted(const RECT &area) {
+  return area.left != LONG_MIN || area.top != LONG_MIN || area.right != LONG_MAX || area.bottom != LONG_MAX;
 }
 
 
@@ -104,53 +199,51 @@ void EventHandler::LoadSettings(bool /* bIsRefresh */) {
 }
 
 
+/// <summary>
+/// Reads a coordinate which has to be followed by something else.
+/// </summary>
+static bool NextDistance(LineTokenizer &tokenizer, Distance &distance) {
+  StringSpan token;
+  TCHAR buffer[64];
+  return tokenizer.Next(token) && tokenizer.Rest() != nullptr && token.CopyTo(buffer, _countof(buffer)) &&
+    Distance::Parse(buffer, distance);
+}
+
+
 /// <summary>
 /// Parses a click line.
 /// </summary>
 EventHandler::ClickData EventHandler::ParseLine(LPCTSTR szLine) {
   // !nDeskOn <type> <mods> <action>
   // !nDeskOn <type> <mods> <left> <top> <right> <bottom> <action>
-  TCHAR szToken[MAX_LINE_LENGTH];
-  LPCTSTR pszNext = szLine;
+  LineTokenizer tokenizer(szLine);
+  StringSpan type, mods;
   ClickData cData;
 
-  using namespace LiteStep;
-
   // Type
-  LiteStep::GetToken(pszNext, szToken, &pszNext, false);
-  cData.type = TypeFromString(szToken);
+  tokenizer.Next(type);
+  cData.type = TypeFromString(type);
 
   // ModKeys
-  LiteStep::GetToken(pszNext, szToken, &pszNext, false);
-  cData.mods = ModsFromString(szToken);
+  tokenizer.Next(mods);
+  cData.mods = ModsFromString(mods);
 
-  if (pszNext == nullptr) {
+  if (tokenizer.Rest() == nullptr) {
     cData.type = UNKNOWN;
     return cData;
   }
 
   // Guess that the rest is an action for now
-  StringCchCopy(cData.action, sizeof(cData.action), pszNext);
+  cData.action = tokenizer.Rest();
   cData.area.left = LONG_MIN; cData.area.right = LONG_MAX;
   cData.area.top = LONG_MIN; cData.area.bottom = LONG_MAX;
 
   // Check if we have 4 valid coordinates followed by some action
   Distance left, top, width, height;
-  if (LiteStep::GetToken(pszNext, szToken, &pszNext, false) == FALSE) return cData;
-  if (pszNext == NULL) return cData;
-  if (!Distance::Parse(szToken, left)) return cData;
-
-  if (LiteStep::GetToken(pszNext, szToken, &pszNext, false) == FALSE) return cData;
-  if (pszNext == NULL) return cData;
-  if (!Distance::Parse(szToken, top)) return cData;
-
-  if (LiteStep::GetToken(pszNext, szToken, &pszNext, false) == FALSE) return cData;
-  if (pszNext == NULL) return cData;
-  if (!Distance::Parse(szToken, width)) return cData;
-
-  if (LiteStep::GetToken(pszNext, szToken, &pszNext, false) == FALSE) return cData;
-  if (pszNext == NULL) return cData;
-  if (!Distance::Parse(szToken, height)) return cData;
+  if (!NextDistance(tokenizer, left)) return cData;
+  if (!NextDistance(tokenizer, top)) return cData;
+  if (!NextDistance(tokenizer, width)) return cData;
+  if (!NextDistance(tokenizer, height)) return cData;
 
   // If these are all valid coordinates
   // TODO::Fix evaluations, or rather don't eval here, for resize purposes
@@ -160,7 +253,7 @@ EventHandler::ClickData EventHandler::ParseLine(LPCTSTR szLine) {
   cData.area.bottom = cData.area.top + (LONG)height.Evaluate(0);
 
   // Then the rest is the action
-  StringCchCopy(cData.action, sizeof(cData.action), pszNext);
+  cData.action = tokenizer.Rest();
 
   return cData;
 }
@@ -176,7 +269,19 @@ void EventHandler::AddHandler(LPCTSTR szLine) {
     return;
   }
 
-  this->m_clickHandlers.push_back(cData);
+  Handler handler;
+  handler.area = cData.area;
+  handler.order = m_nextOrder++;
+  handler.action = CompileAction(cData.action);
+
+  Bucket &bucket = m_buckets[MAKELONG(cData.type, cData.mods)];
+  if (IsRestricted(handler.area)) {
+    auto pos = std::upper_bound(bucket.areas.begin(), bucket.areas.end(), handler,
+      [] (const Handler &a, const Handler &b) -> bool { return a.area.left < b.area.left; });
+    bucket.areas.insert(pos, handler);
+  } else {
+    bucket.anywhere.push_back(handler);
+  }
 }
 
 
@@ -185,58 +290,58 @@ void EventHandler::AddHandler(LPCTSTR szLine) {
 /// </summary>
 void EventHandler::RemoveHandlers(LPCTSTR szLine) {
   ClickData cData = ParseLine(szLine);
-  for (vector<ClickData>::const_iterator iter = m_clickHandlers.begin(); iter != m_clickHandlers.end(); iter++) {
-    if (Matches(*iter, cData)) {
-      m_clickHandlers.erase(iter);
-    }
+  auto bucket = m_buckets.find(MAKELONG(cData.type, cData.mods));
+  if (bucket == m_buckets.end()) {
+    return;
   }
-}
 
-
-/// <summary>
-/// True if ClickData a is "in" ClickData b.
-/// </summary>
-bool EventHandler::Matches(ClickData a, ClickData b) {
-  return  a.type == b.type &&
-    a.mods == b.mods &&
-    a.area.left >= b.area.left &&
-    a.area.right <= b.area.right &&
-    a.area.top >= b.area.top &&
-    a.area.bottom <= b.area.bottom;
+  auto covered = [&cData] (const Handler &handler) -> bool {
+    return handler.area.left >= cData.area.left &&
+      handler.area.right <= cData.area.right &&
+      handler.area.top >= cData.area.top &&
+      handler.area.bottom <= cData.area.bottom;
+  };
+  vector<Handler> &anywhere = bucket->second.anywhere, &areas = bucket->second.areas;
+  anywhere.erase(std::remove_if(anywhere.begin(), anywhere.end(), covered), anywhere.end());
+  areas.erase(std::remove_if(areas.begin(), areas.end(), covered), areas.end());
+
+  if (anywhere.empty() && areas.empty()) {
+    m_buckets.erase(bucket);
+  }
 }
 
 
 /// <summary>
 /// Gets the clicktype from a user input string.
 /// </summary>
-EventHandler::EventType EventHandler::TypeFromString(LPCTSTR str) {
-  if (_wcsicmp(str, L"WheelUp") == 0) return WHEELUP;
-  if (_wcsicmp(str, L"WheelDown") == 0) return WHEELDOWN;
-  if (_wcsicmp(str, L"WheelRight") == 0) return WHEELRIGHT;
-  if (_wcsicmp(str, L"WheelLeft") == 0) return WHEELLEFT;
+EventHandler::EventType EventHandler::TypeFromString(const StringSpan &str) {
+  if (str.Equals(L"WheelUp")) return WHEELUP;
+  if (str.Equals(L"WheelDown")) return WHEELDOWN;
+  if (str.Equals(L"WheelRight")) return WHEELRIGHT;
+  if (str.Equals(L"WheelLeft")) return WHEELLEFT;
 
-  if (_wcsicmp(str, L"LeftClickDown") == 0) return LEFTDOWN;
-  if (_wcsicmp(str, L"LeftClickUp") == 0) return LEFTUP;
-  if (_wcsicmp(str, L"LeftDoubleClick") == 0) return LEFTDOUBLE;
+  if (str.Equals(L"LeftClickDown")) return LEFTDOWN;
+  if (str.Equals(L"LeftClickUp")) return LEFTUP;
+  if (str.Equals(L"LeftDoubleClick")) return LEFTDOUBLE;
 
-  if (_wcsicmp(str, L"MiddleClickDown") == 0) return MIDDLEDOWN;
-  if (_wcsicmp(str, L"MiddleClickUp") == 0) return MIDDLEUP;
-  if (_wcsicmp(str, L"MiddleDoubleClick") == 0) return MIDDLEDOUBLE;
+  if (str.Equals(L"MiddleClickDown")) return MIDDLEDOWN;
+  if (str.Equals(L"MiddleClickUp")) return MIDDLEUP;
+  if (str.Equals(L"MiddleDoubleClick")) return MIDDLEDOUBLE;
 
-  if (_wcsicmp(str, L"RightClickDown") == 0) return RIGHTDOWN;
-  if (_wcsicmp(str, L"RightClickUp") == 0) return RIGHTUP;
-  if (_wcsicmp(str, L"RightDoubleClick") == 0) return RIGHTDOUBLE;
+  if (str.Equals(L"RightClickDown")) return RIGHTDOWN;
+  if (str.Equals(L"RightClickUp")) return RIGHTUP;
+  if (str.Equals(L"RightDoubleClick")) return RIGHTDOUBLE;
 
-  if (_wcsicmp(str, L"X1ClickDown") == 0) return X1DOWN;
-  if (_wcsicmp(str, L"X1ClickUp") == 0) return X1UP;
-  if (_wcsicmp(str, L"X1DoubleClick") == 0) return X1DOUBLE;
+  if (str.Equals(L"X1ClickDown")) return X1DOWN;
+  if (str.Equals(L"X1ClickUp")) return X1UP;
+  if (str.Equals(L"X1DoubleClick")) return X1DOUBLE;
 
-  if (_wcsicmp(str, L"X2ClickDown") == 0) return X2DOWN;
-  if (_wcsicmp(str, L"X2ClickUp") == 0) return X2UP;
-  if (_wcsicmp(str, L"X2DoubleClick") == 0) return X2DOUBLE;
+  if (str.Equals(L"X2ClickDown")) return X2DOWN;
+  if (str.Equals(L"X2ClickUp")) return X2UP;
+  if (str.Equals(L"X2DoubleClick")) return X2DOUBLE;
 
-  if (_wcsicmp(str, L"Leave") == 0) return LEAVE;
-  if (_wcsicmp(str, L"Enter") == 0) return ENTER;
+  if (str.Equals(L"Leave")) return LEAVE;
+  if (str.Equals(L"Enter")) return ENTER;
 
   return UNKNOWN;
 }
@@ -245,21 +350,25 @@ EventHandler::EventType EventHandler::TypeFromString(LPCTSTR str) {
 /// <summary>
 /// Gets the mod value from a string.
 /// </summary>
-WORD EventHandler::ModsFromString(LPTSTR str) {
+WORD EventHandler::ModsFromString(const StringSpan &str) {
   WORD ret = 0x0000;
 
-  LPTSTR context;
-  LPTSTR tok = wcstok_s(str, L"+", &context);
-  while (tok != NULL) {
-    if (_wcsicmp(tok, L"ctrl") == 0) ret |= MK_CONTROL;
-    else if (_wcsicmp(tok, L"mouseleft") == 0) ret |= MK_LBUTTON;
-    else if (_wcsicmp(tok, L"mousemiddle") == 0) ret |= MK_MBUTTON;
-    else if (_wcsicmp(tok, L"mouseright") == 0) ret |= MK_RBUTTON;
-    else if (_wcsicmp(tok, L"shift") == 0) ret |= MK_SHIFT;
-    else if (_wcsicmp(tok, L"mousex1") == 0) ret |= MK_XBUTTON1;
-    else if (_wcsicmp(tok, L"mousex2") == 0) ret |= MK_XBUTTON2;
-    else if (_wcsicmp(tok, L"alt") == 0) ret |= MK_ALT;
-    tok = wcstok_s(NULL, L"+", &context);
+  LPCTSTR end = str.begin + str.length;
+  for (LPCTSTR start = str.begin;;) {
+    LPCTSTR plus = std::find(start, end, L'+');
+    StringSpan tok(start, plus - start);
+    if (tok.Equals(L"ctrl")) ret |= MK_CONTROL;
+    else if (tok.Equals(L"mouseleft")) ret |= MK_LBUTTON;
+    else if (tok.Equals(L"mousemiddle")) ret |= MK_MBUTTON;
+    else if (tok.Equals(L"mouseright")) ret |= MK_RBUTTON;
+    else if (tok.Equals(L"shift")) ret |= MK_SHIFT;
+    else if (tok.Equals(L"mousex1")) ret |= MK_XBUTTON1;
+    else if (tok.Equals(L"mousex2")) ret |= MK_XBUTTON2;
+    else if (tok.Equals(L"alt")) ret |= MK_ALT;
+    if (plus == end) {
+      break;
+    }
+    start = plus + 1;
   }
 
   return ret;
@@ -10,6 +10,10 @@
 #include "LiteStep.h"
 #include "Settings.hpp"
 
+#include "../Utilities/LineTokenizer.hpp"
+
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 using std::vector;
@@ -41,18 +45,42 @@ private:
     EventType type;
     WORD mods; // Modifier keys
     RECT area; // Region of the virtual screen where this event is valid
-    TCHAR action[MAX_LINE_LENGTH]; // Action to fire when this event occurs
+    LPCTSTR action; // Action to fire when this event occurs, pointing into the parsed line
   } ClickData;
 
-  vector<ClickData> m_clickHandlers;
+  // An action, split up ahead of time so that firing it doesn't have to parse it.
+  typedef struct Action {
+    std::wstring command; // The whole action, for anything which isn't a single bang
+    std::wstring bang; // The bang name, if the action is a single bang
+    std::wstring args; // The arguments to the bang
+  } Action;
+
+  typedef struct Handler {
+    RECT area;
+    UINT order; // When the handler was added, relative to the others
+    Action action;
+  } Handler;
+
+  // The handlers for one event type and set of modifiers.
+  typedef struct Bucket {
+    vector<Handler> anywhere; // Handlers which aren't restricted to an area
+    vector<Handler> areas; // Handlers which are, sorted by their left edge
+  } Bucket;
+
+  // Buckets by MAKELONG(type, mods).
+  std::unordered_map<DWORD, Bucket> m_buckets;
+
+  UINT m_nextOrder;
 
   Settings* settings;
 
   void LoadSettings(bool = false);
   ClickData ParseLine(LPCTSTR);
-  EventType TypeFromString(LPCTSTR str);
-  WORD ModsFromString(LPTSTR str);
-  bool Matches(ClickData a, ClickData b);
+  EventType TypeFromString(const StringSpan &str);
+  WORD ModsFromString(const StringSpan &str);
+  static bool IsRestricted(const RECT &area);
+  static Action CompileAction(LPCTSTR action);
+  static void Fire(const Action &action);
 
   bool mouseOver;
 };
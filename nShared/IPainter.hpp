@@ -24,7 +24,4 @@ public:
 
   //
   virtual void UpdatePosition(D2D1_RECT_F parentPosition) = 0;
-
-  //
-  virtual bool UpdateDWMColor(ARGB newColor, ID2D1RenderTarget* renderTarget) = 0;
 };
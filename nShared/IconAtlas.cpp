@@ -0,0 +1,364 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/IconAtlas.cpp
+// The nModules Project
+//
+// Keeps the overlays of a render target in a single bitmap.
+//-------------------------------------------------------------------------------------------------
+#include "IconAtlas.hpp"
+
+#include "../Utilities/ShelfPacker.hpp"
+
+#include <algorithm>
+#include <list>
+#include <vector>
+
+
+// Atlases start out this size, and double until they reach the maximum.
+static const UINT sInitialSize = 512;
+static const UINT sMaxSize = 2048;
+
+// Images larger than this, along either side, are left out of the atlas.
+static const UINT sMaxEntrySize = 256;
+
+// The transparent border around each image, so that filtering never picks up its neighbours.
+static const UINT sGutter = 1;
+
+
+struct Atlas;
+
+/// <summary>
+/// An image in an atlas.
+/// </summary>
+struct IconAtlas::Entry {
+  Atlas *atlas;
+
+  // Where the image is, gutter included.
+  ShelfPacker::Rect slot;
+
+  // Where the image is, gutter excluded.
+  D2D1_RECT_F source;
+
+  UINT64 hash;
+  UINT width, height;
+
+  // The number of overlays using this image.
+  UINT references;
+
+  // The value of sClock when the image was last added.
+  ULONGLONG lastUsed;
+};
+
+/// <summary>
+/// The atlas of a single render target.
+/// </summary>
+struct Atlas {
+  Atlas() : renderTarget(nullptr), bitmap(nullptr), packer(0, 0), references(0), discarded(false) {}
+
+  ID2D1RenderTarget *renderTarget;
+  ID2D1Bitmap *bitmap;
+  ShelfPacker packer;
+
+  // A list, so that entries don't move when others are added or removed.
+  std::list<IconAtlas::Entry> entries;
+
+  // The total number of references to all entries.
+  UINT references;
+
+  // Set once the render target has gone away. No more entries are added.
+  bool discarded;
+};
+
+
+static std::vector<Atlas*> sAtlases;
+
+// Counts calls to Add, to tell which unused images have been unused the longest.
+static ULONGLONG sClock = 0;
+
+static ULONGLONG sSharedHits = 0;
+static ULONGLONG sEvictions = 0;
+static ULONGLONG sRepacks = 0;
+static ULONGLONG sFallbacks = 0;
+static ULONGLONG sDraws = 0;
+
+
+/// <summary>
+/// Creates an empty atlas bitmap.
+/// </summary>
+static HRESULT CreateAtlasBitmap(ID2D1RenderTarget *renderTarget, UINT size, ID2D1Bitmap **bitmap) {
+  return renderTarget->CreateBitmap(D2D1::SizeU(size, size), D2D1::BitmapProperties(
+    D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)), bitmap);
+}
+
+
+/// <summary>
+/// Returns the atlas of the render target, creating it if there isn't one.
+/// </summary>
+static Atlas *GetAtlas(ID2D1RenderTarget *renderTarget) {
+  for (Atlas *atlas : sAtlases) {
+    if (atlas->renderTarget == renderTarget && !atlas->discarded) {
+      return atlas;
+    }
+  }
+
+  Atlas *atlas = new Atlas();
+  if (FAILED(CreateAtlasBitmap(renderTarget, sInitialSize, &atlas->bitmap))) {
+    delete atlas;
+    return nullptr;
+  }
+
+  // Holding on to the render target means that its address can't be reused by another one while
+  // the atlas is around.
+  atlas->renderTarget = renderTarget;
+  atlas->renderTarget->AddRef();
+  atlas->packer.Reset(sInitialSize, sInitialSize);
+  sAtlases.push_back(atlas);
+  return atlas;
+}
+
+
+/// <summary>
+/// Destroys an atlas.
+/// </summary>
+static void Destroy(Atlas *atlas) {
+  sAtlases.erase(std::find(sAtlases.begin(), sAtlases.end(), atlas));
+  SAFERELEASE(atlas->bitmap);
+  SAFERELEASE(atlas->renderTarget);
+  delete atlas;
+}
+
+
+/// <summary>
+/// Hashes the pixels of an image.
+/// </summary>
+static UINT64 Hash(const std::vector<BYTE> &pixels) {
+  UINT64 hash = 14695981039346656037ULL;
+  const UINT32 *words = reinterpret_cast<const UINT32*>(pixels.data());
+  for (size_t i = 0, count = pixels.size() / 4; i < count; ++i) {
+    hash = (hash ^ words[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+/// <summary>
+/// Updates the source rectangle of an entry after its slot has changed.
+/// </summary>
+static void UpdateSource(IconAtlas::Entry &entry) {
+  entry.source = D2D1::RectF(
+    float(entry.slot.x + sGutter),
+    float(entry.slot.y + sGutter),
+    float(entry.slot.x + sGutter + entry.width),
+    float(entry.slot.y + sGutter + entry.height));
+}
+
+
+/// <summary>
+/// Evicts the image which has gone unused the longest.
+/// </summary>
+/// <returns>False if every image is in use.</returns>
+static bool Evict(Atlas &atlas) {
+  auto oldest = atlas.entries.end();
+  for (auto iter = atlas.entries.begin(); iter != atlas.entries.end(); ++iter) {
+    if (iter->references == 0 && (oldest == atlas.entries.end() || iter->lastUsed < oldest->lastUsed)) {
+      oldest = iter;
+    }
+  }
+  if (oldest == atlas.entries.end()) {
+    return false;
+  }
+
+  atlas.packer.Free(oldest->slot);
+  atlas.entries.erase(oldest);
+  ++sEvictions;
+  return true;
+}
+
+
+/// <summary>
+/// Moves every image into a freshly packed bitmap, growing it if that is what it takes to make
+/// room for one more of the specified size.
+/// </summary>
+/// <returns>False if there is no room, even at the maximum size.</returns>
+static bool Repack(Atlas &atlas, UINT width, UINT height, ShelfPacker::Rect &slot) {
+  // Shelves pack best when the tallest images go first.
+  std::vector<IconAtlas::Entry*> order;
+  for (IconAtlas::Entry &entry : atlas.entries) {
+    order.push_back(&entry);
+  }
+  std::sort(order.begin(), order.end(), [] (const IconAtlas::Entry *a, const IconAtlas::Entry *b) {
+    return a->slot.height != b->slot.height ? a->slot.height > b->slot.height : a->slot.width > b->slot.width;
+  });
+
+  UINT maxSize = std::min(sMaxSize, atlas.renderTarget->GetMaximumBitmapSize());
+  std::vector<ShelfPacker::Rect> slots(order.size());
+  for (UINT size = atlas.packer.GetWidth(); size <= maxSize; size *= 2) {
+    ShelfPacker packer(size, size);
+    bool fits = true;
+    for (size_t i = 0; i < order.size() && fits; ++i) {
+      fits = packer.Allocate(order[i]->slot.width, order[i]->slot.height, slots[i]);
+    }
+    if (!fits || !packer.Allocate(width, height, slot)) {
+      continue;
+    }
+
+    ID2D1Bitmap *bitmap = nullptr;
+    if (FAILED(CreateAtlasBitmap(atlas.renderTarget, size, &bitmap))) {
+      return false;
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+      const ShelfPacker::Rect &from = order[i]->slot;
+      D2D1_POINT_2U to = D2D1::Point2U(slots[i].x, slots[i].y);
+      D2D1_RECT_U source = D2D1::RectU(from.x, from.y, from.x + from.width, from.y + from.height);
+      bitmap->CopyFromBitmap(&to, atlas.bitmap, &source);
+      order[i]->slot = slots[i];
+      UpdateSource(*order[i]);
+    }
+
+    SAFERELEASE(atlas.bitmap);
+    atlas.bitmap = bitmap;
+    atlas.packer = packer;
+    ++sRepacks;
+    return true;
+  }
+
+  return false;
+}
+
+
+/// <summary>
+/// Puts an image, which should be 32bpp PBGRA, into the atlas of the render target.
+/// </summary>
+IconAtlas::Entry *IconAtlas::Add(ID2D1RenderTarget *renderTarget, IWICBitmapSource *source) {
+  UINT width, height;
+  if (renderTarget == nullptr || source == nullptr || FAILED(source->GetSize(&width, &height)) ||
+      width == 0 || height == 0 || width > sMaxEntrySize || height > sMaxEntrySize) {
+    ++sFallbacks;
+    return nullptr;
+  }
+
+  // Read the image into the middle of a transparent block the size of its slot.
+  UINT slotWidth = width + 2*sGutter, slotHeight = height + 2*sGutter;
+  UINT stride = slotWidth * 4;
+  std::vector<BYTE> pixels(stride * slotHeight, 0);
+  UINT offset = sGutter*stride + sGutter*4;
+  if (FAILED(source->CopyPixels(nullptr, stride, UINT(pixels.size()) - offset, pixels.data() + offset))) {
+    ++sFallbacks;
+    return nullptr;
+  }
+  UINT64 hash = Hash(pixels);
+
+  Atlas *atlas = GetAtlas(renderTarget);
+  if (atlas == nullptr) {
+    ++sFallbacks;
+    return nullptr;
+  }
+
+  for (Entry &entry : atlas->entries) {
+    if (entry.hash == hash && entry.width == width && entry.height == height) {
+      ++entry.references;
+      ++atlas->references;
+      entry.lastUsed = ++sClock;
+      ++sSharedHits;
+      return &entry;
+    }
+  }
+
+  ShelfPacker::Rect slot;
+  bool placed = atlas->packer.Allocate(slotWidth, slotHeight, slot);
+  while (!placed && Evict(*atlas)) {
+    placed = atlas->packer.Allocate(slotWidth, slotHeight, slot);
+  }
+  if (!placed) {
+    placed = Repack(*atlas, slotWidth, slotHeight, slot);
+  }
+  if (!placed) {
+    ++sFallbacks;
+    return nullptr;
+  }
+
+  D2D1_RECT_U destination = D2D1::RectU(slot.x, slot.y, slot.x + slotWidth, slot.y + slotHeight);
+  atlas->bitmap->CopyFromMemory(&destination, pixels.data(), stride);
+
+  Entry entry;
+  entry.atlas = atlas;
+  entry.slot = slot;
+  entry.hash = hash;
+  entry.width = width;
+  entry.height = height;
+  entry.references = 1;
+  entry.lastUsed = ++sClock;
+  UpdateSource(entry);
+  atlas->entries.push_back(entry);
+  ++atlas->references;
+
+  return &atlas->entries.back();
+}
+
+
+/// <summary>
+/// Lets go of an entry returned by Add. The image stays in the atlas until the room is needed.
+/// </summary>
+void IconAtlas::Release(Entry *entry) {
+  if (entry == nullptr) {
+    return;
+  }
+
+  Atlas *atlas = entry->atlas;
+  --entry->references;
+  if (--atlas->references == 0 && atlas->discarded) {
+    Destroy(atlas);
+  }
+}
+
+
+/// <summary>
+/// Draws an entry.
+/// </summary>
+void IconAtlas::Draw(ID2D1RenderTarget *renderTarget, const Entry *entry,
+    const D2D1_RECT_F &destination, float opacity) {
+  renderTarget->DrawBitmap(entry->atlas->bitmap, &destination, opacity,
+    D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, &entry->source);
+  ++sDraws;
+}
+
+
+/// <summary>
+/// Should be called when the render target is about to go away.
+/// </summary>
+void IconAtlas::Discard(ID2D1RenderTarget *renderTarget) {
+  for (Atlas *atlas : sAtlases) {
+    if (atlas->renderTarget == renderTarget && !atlas->discarded) {
+      atlas->discarded = true;
+      if (atlas->references == 0) {
+        Destroy(atlas);
+      }
+      return;
+    }
+  }
+}
+
+
+/// <summary>
+/// Returns the counters for all atlases of this module.
+/// </summary>
+IconAtlas::Stats IconAtlas::GetStats() {
+  Stats stats;
+  ZeroMemory(&stats, sizeof(stats));
+
+  for (Atlas *atlas : sAtlases) {
+    ++stats.atlases;
+    stats.capacity += UINT64(atlas->packer.GetWidth()) * atlas->packer.GetHeight();
+    for (const Entry &entry : atlas->entries) {
+      ++stats.entries;
+      stats.occupied += UINT64(entry.width) * entry.height;
+    }
+    stats.references += atlas->references;
+  }
+
+  stats.sharedHits = sSharedHits;
+  stats.evictions = sEvictions;
+  stats.repacks = sRepacks;
+  stats.fallbacks = sFallbacks;
+  stats.draws = sDraws;
+  return stats;
+}
@@ -0,0 +1,83 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/IconAtlas.hpp
+// The nModules Project
+//
+// Keeps the overlays of a render target in a single bitmap.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/CommonD2D.h"
+
+#include <wincodec.h>
+
+/// <summary>
+/// Every render target gets one atlas bitmap, which holds the images of all overlays drawn to it.
+/// Overlays are then drawn as parts of that one bitmap, rather than each through a bitmap and brush
+/// of their own, which lets Direct2D draw a whole row of icons without switching textures.
+///
+/// Identical images share a single spot in the atlas. Images which are no longer used stay in the
+/// atlas until it runs out of room, at which point they are evicted, least recently used first. If
+/// that isn't enough, the atlas is repacked, and grown if need be. Images which are too large, or
+/// don't fit even then, are left for the caller to draw on its own.
+/// </summary>
+namespace IconAtlas {
+  struct Entry;
+
+  /// <summary>
+  /// Counters for all atlases of this module.
+  /// </summary>
+  struct Stats {
+    // Atlases which currently exist.
+    UINT atlases;
+
+    // The total area of all atlases, and the part of it which holds images, in pixels.
+    UINT64 capacity;
+    UINT64 occupied;
+
+    // Images in the atlases, and the number of overlays using them. Each overlay would otherwise
+    // have had a bitmap and brush of its own.
+    UINT entries;
+    UINT references;
+
+    // Images which were added while an identical one was already in the atlas.
+    ULONGLONG sharedHits;
+
+    // Unused images which were evicted to make room, and the number of times atlases were repacked.
+    ULONGLONG evictions;
+    ULONGLONG repacks;
+
+    // Images which didn't go in an atlas.
+    ULONGLONG fallbacks;
+
+    // Images drawn from an atlas.
+    ULONGLONG draws;
+  };
+
+  /// <summary>
+  /// Puts an image, which should be 32bpp PBGRA, into the atlas of the render target.
+  /// </summary>
+  /// <returns>The spot in the atlas, or nullptr if the image didn't fit.</returns>
+  Entry *Add(ID2D1RenderTarget *renderTarget, IWICBitmapSource *source);
+
+  /// <summary>
+  /// Lets go of an entry returned by Add.
+  /// </summary>
+  void Release(Entry *entry);
+
+  /// <summary>
+  /// Draws an entry.
+  /// </summary>
+  void Draw(ID2D1RenderTarget *renderTarget, const Entry *entry, const D2D1_RECT_F &destination,
+    float opacity);
+
+  /// <summary>
+  /// Should be called when the render target is about to go away. The atlas is destroyed once the
+  /// last entry in it is released.
+  /// </summary>
+  void Discard(ID2D1RenderTarget *renderTarget);
+
+  /// <summary>
+  /// Returns the counters for all atlases of this module.
+  /// </summary>
+  Stats GetStats();
+}
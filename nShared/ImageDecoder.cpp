@@ -0,0 +1,392 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/ImageDecoder.cpp
+// The nModules Project
+//
+// Decodes LiteStep images on the thread pool, ahead of the brushes which need them.
+//-------------------------------------------------------------------------------------------------
+#include "ImageDecoder.hpp"
+#include "Factories.h"
+#include "LiteStep.h"
+
+#include "../Utilities/StopWatch.hpp"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <Shlwapi.h>
+#include <string>
+#include <strsafe.h>
+#include <unordered_map>
+
+
+/// <summary>
+/// A decoded image, or one which is being decoded.
+/// </summary>
+struct DecodedImage {
+  std::wstring path;
+
+  // The file the path refers to, if it is a plain image file which WIC can decode directly.
+  // Empty if only LoadLSImage understands the path. Resolved on the module's thread.
+  std::wstring file;
+
+  // Set by the thread pool once the image has been decoded. Null once the module's thread has
+  // collected the result, or if the image was never queued.
+  HANDLE pending;
+
+  // True once the module's thread has a result for this image.
+  bool decoded;
+
+  // The result of the decode, and the decoded pixels if it succeeded.
+  HRESULT hr;
+  IWICBitmap *bitmap;
+  UINT64 bytes;
+
+  // When the file was last written to, as of when it was decoded.
+  ULONGLONG writeTime;
+};
+
+
+// Decoded images are dropped, oldest first, once they take up more than this.
+static const UINT64 sMaxBytes = 32*1024*1024;
+
+// Every image which has been requested, by lowercased path.
+static std::unordered_map<std::wstring, std::shared_ptr<DecodedImage>> sImages;
+
+// The keys of sImages, in the order they were requested.
+static std::list<std::wstring> sOrder;
+
+// The size of all decoded images in sImages.
+static UINT64 sBytes = 0;
+
+static ImageDecoder::Stats sStats = { 0, 0, 0, 0.0 };
+
+
+/// <summary>
+/// Returns the time the specified file was last written to, or 0 if it can't be found.
+/// </summary>
+static ULONGLONG LastWriteTime(LPCWSTR path) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (GetFileAttributesEx(path, GetFileExInfoStandard, &data) == FALSE) {
+    return 0;
+  }
+  return ULONGLONG(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime;
+}
+
+
+/// <summary>
+/// Returns the file which decides whether the image is up to date.
+/// </summary>
+static LPCWSTR SourceFile(const DecodedImage &image) {
+  return image.file.empty() ? image.path.c_str() : image.file.c_str();
+}
+
+
+/// <summary>
+/// Works out which file a LiteStep image path refers to, if it is one WIC can decode the same way
+/// LoadLSImage would. Icon extraction (.extract, file.dll,3), .none, merged images and anything
+/// which isn't a common image format is left to LoadLSImage. Reads the LiteStep configuration, so
+/// it must be called from the module's thread.
+/// </summary>
+static std::wstring ResolveImageFile(LPCWSTR path) {
+  static LPCWSTR const extensions[] = {
+    L".bmp", L".gif", L".jpeg", L".jpg", L".png", L".tif", L".tiff"
+  };
+
+  if (*path == L'.' || wcspbrk(path, L",|") != nullptr) {
+    return std::wstring();
+  }
+
+  LPCWSTR extension = PathFindExtension(path);
+  if (std::none_of(std::begin(extensions), std::end(extensions), [extension] (LPCWSTR known) {
+    return _wcsicmp(extension, known) == 0;
+  })) {
+    return std::wstring();
+  }
+
+  // Like LoadLSImage, relative paths are looked up in the theme's image folder.
+  WCHAR file[MAX_PATH];
+  if (PathIsRelative(path)) {
+    if (!LiteStep::LSGetImagePath(file, _countof(file)) || !PathAppend(file, path)) {
+      return std::wstring();
+    }
+  } else if (FAILED(StringCchCopy(file, _countof(file), path))) {
+    return std::wstring();
+  }
+
+  return PathFileExists(file) ? std::wstring(file) : std::wstring();
+}
+
+
+/// <summary>
+/// Converts source to 32bpp PBGRA, and stores the result in image.
+/// </summary>
+static HRESULT Convert(DecodedImage *image, IWICBitmapSource *source, IWICImagingFactory *factory) {
+  IWICFormatConverter *converter = nullptr;
+
+  HRESULT hr = factory->CreateFormatConverter(&converter);
+  if (SUCCEEDED(hr)) {
+    hr = converter->Initialize(source, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
+      nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
+  }
+  if (SUCCEEDED(hr)) {
+    // Cache on load, so that the conversion happens here rather than on the module's thread.
+    hr = factory->CreateBitmapFromSource(converter, WICBitmapCacheOnLoad, &image->bitmap);
+  }
+  if (SUCCEEDED(hr)) {
+    UINT width, height;
+    image->bitmap->GetSize(&width, &height);
+    image->bytes = UINT64(width) * height * 4;
+  }
+
+  SAFERELEASE(converter);
+  return hr;
+}
+
+
+/// <summary>
+/// Decodes the resolved file of the image with WIC. Safe to call from any thread.
+/// </summary>
+static void DecodeFile(DecodedImage *image, IWICImagingFactory *factory) {
+  IWICBitmapDecoder *decoder = nullptr;
+  IWICBitmapFrameDecode *frame = nullptr;
+
+  image->writeTime = LastWriteTime(image->file.c_str());
+  image->bitmap = nullptr;
+  image->bytes = 0;
+
+  HRESULT hr = factory->CreateDecoderFromFilename(image->file.c_str(), nullptr, GENERIC_READ,
+    WICDecodeMetadataCacheOnDemand, &decoder);
+  if (SUCCEEDED(hr)) {
+    hr = decoder->GetFrame(0, &frame);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = Convert(image, frame, factory);
+  }
+
+  SAFERELEASE(frame);
+  SAFERELEASE(decoder);
+  image->hr = hr;
+}
+
+
+/// <summary>
+/// Loads the image through LoadLSImage, which understands every kind of LiteStep image path. Only
+/// safe to call from the module's thread.
+/// </summary>
+static void DecodeLSImage(DecodedImage *image, IWICImagingFactory *factory) {
+  IWICBitmap *source = nullptr;
+
+  image->writeTime = LastWriteTime(image->path.c_str());
+  image->bitmap = nullptr;
+  image->bytes = 0;
+
+  HBITMAP hBitmap = LiteStep::LoadLSImage(image->path.c_str(), nullptr);
+  if (hBitmap == nullptr) {
+    image->hr = PathFileExists(image->path.c_str()) ? E_FAIL : HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    return;
+  }
+
+  HRESULT hr = factory->CreateBitmapFromHBITMAP(hBitmap, nullptr, WICBitmapUseAlpha, &source);
+  if (SUCCEEDED(hr)) {
+    hr = Convert(image, source, factory);
+  }
+
+  DeleteObject(hBitmap);
+  SAFERELEASE(source);
+  image->hr = hr;
+}
+
+
+/// <summary>
+/// Decodes a plain image file on the thread pool. LoadLSImage isn't thread safe, so images which
+/// need it are never queued.
+/// </summary>
+static void CALLBACK DecodeCallback(PTP_CALLBACK_INSTANCE instance, LPVOID context) {
+  DecodedImage *image = reinterpret_cast<DecodedImage*>(context);
+
+  // Only signal the module once this callback has returned, so that the module can't be unloaded
+  // while it is still running.
+  SetEventWhenCallbackReturns(instance, image->pending);
+
+  // The module's WIC factory lives in its STA, so the pool thread gets one of its own.
+  IWICImagingFactory *factory = nullptr;
+  HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  if (SUCCEEDED(hr)) {
+    hr = CoCreateInstance(CLSID_WICImagingFactory1, nullptr, CLSCTX_INPROC_SERVER,
+      IID_IWICImagingFactory, reinterpret_cast<LPVOID*>(&factory));
+    if (SUCCEEDED(hr)) {
+      DecodeFile(image, factory);
+      factory->Release();
+    }
+    CoUninitialize();
+  }
+  if (FAILED(hr)) {
+    image->hr = hr;
+  }
+}
+
+
+/// <summary>
+/// Returns the key of the image at the specified path.
+/// </summary>
+static std::wstring MakeKey(LPCWSTR path) {
+  std::wstring key(path);
+  std::transform(key.begin(), key.end(), key.begin(), ::towlower);
+  return key;
+}
+
+
+/// <summary>
+/// Releases the pixels of an image.
+/// </summary>
+static void Release(DecodedImage &image) {
+  if (image.decoded) {
+    sBytes -= image.bytes;
+  }
+  SAFERELEASE(image.bitmap);
+  image.decoded = false;
+}
+
+
+/// <summary>
+/// Drops the oldest decoded images, other than keep, until the cache is back within its budget.
+/// </summary>
+static void Trim(const std::wstring &keep) {
+  for (auto iter = sOrder.begin(); sBytes > sMaxBytes && iter != sOrder.end();) {
+    auto image = sImages.find(*iter);
+    if (*iter != keep && image->second->decoded) {
+      Release(*image->second);
+      sImages.erase(image);
+      iter = sOrder.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+
+/// <summary>
+/// Returns the entry for the specified image, adding a blank one if there isn't one.
+/// </summary>
+static DecodedImage &Find(LPCWSTR path, const std::wstring &key, bool &added) {
+  auto iter = sImages.find(key);
+  added = iter == sImages.end();
+  if (added) {
+    std::shared_ptr<DecodedImage> image(new DecodedImage);
+    image->path = path;
+    image->file = ResolveImageFile(path);
+    image->pending = nullptr;
+    image->decoded = false;
+    image->hr = E_FAIL;
+    image->bitmap = nullptr;
+    image->bytes = 0;
+    image->writeTime = 0;
+    iter = sImages.insert(std::make_pair(key, image)).first;
+    sOrder.push_back(key);
+  }
+  return *iter->second;
+}
+
+
+/// <summary>
+/// Starts decoding the specified image on the thread pool, unless it is already decoded, or
+/// being decoded.
+/// </summary>
+void ImageDecoder::Prefetch(LPCWSTR path) {
+  if (path == nullptr || *path == L'\0') {
+    return;
+  }
+
+  bool added;
+  DecodedImage &image = Find(path, MakeKey(path), added);
+  if (!added) {
+    return;
+  }
+
+  // Images which only LoadLSImage can read, or which can't be queued, are decoded by Get.
+  if (image.file.empty()) {
+    return;
+  }
+  image.pending = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+  if (image.pending != nullptr && TrySubmitThreadpoolCallback(DecodeCallback, &image, nullptr) == FALSE) {
+    CloseHandle(image.pending);
+    image.pending = nullptr;
+  }
+}
+
+
+/// <summary>
+/// Retrieves the decoded image, in 32bpp PBGRA. Waits for the thread pool if the image is being
+/// decoded, and decodes it right away if nobody asked for it in advance.
+/// </summary>
+HRESULT ImageDecoder::Get(LPCWSTR path, IWICBitmapSource **bitmap) {
+  *bitmap = nullptr;
+
+  std::wstring key = MakeKey(path);
+  bool added;
+  DecodedImage &image = Find(path, key, added);
+
+  if (image.pending != nullptr) {
+    if (WaitForSingleObject(image.pending, 0) == WAIT_TIMEOUT) {
+      StopWatch watch;
+      WaitForSingleObject(image.pending, INFINITE);
+      sStats.waitTime += watch.GetTime() * 1000.0;
+    }
+    CloseHandle(image.pending);
+    image.pending = nullptr;
+    image.decoded = true;
+    sBytes += image.bytes;
+    ++sStats.decodedAhead;
+  } else if (image.decoded && image.writeTime == LastWriteTime(SourceFile(image))) {
+    ++sStats.reused;
+  } else {
+    // Either nobody asked for this image in advance, or the file has changed since.
+    IWICImagingFactory *factory = nullptr;
+    Release(image);
+    if (SUCCEEDED(image.hr = Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory)))) {
+      if (image.file.empty()) {
+        DecodeLSImage(&image, factory);
+      } else {
+        DecodeFile(&image, factory);
+      }
+    }
+    image.decoded = true;
+    sBytes += image.bytes;
+    ++sStats.decodedInline;
+  }
+
+  HRESULT hr = image.hr;
+  if (SUCCEEDED(hr)) {
+    *bitmap = image.bitmap;
+    image.bitmap->AddRef();
+  }
+
+  Trim(key);
+  return hr;
+}
+
+
+/// <summary>
+/// Drops every decoded image, waiting for any which are still being decoded.
+/// </summary>
+void ImageDecoder::Clear() {
+  for (auto &image : sImages) {
+    if (image.second->pending != nullptr) {
+      WaitForSingleObject(image.second->pending, INFINITE);
+      CloseHandle(image.second->pending);
+      image.second->pending = nullptr;
+    }
+    SAFERELEASE(image.second->bitmap);
+  }
+  sImages.clear();
+  sOrder.clear();
+  sBytes = 0;
+}
+
+
+/// <summary>
+/// Returns the counters for all images requested since the module was loaded.
+/// </summary>
+const ImageDecoder::Stats &ImageDecoder::GetStats() {
+  return sStats;
+}
@@ -0,0 +1,66 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/ImageDecoder.hpp
+// The nModules Project
+//
+// Decodes LiteStep images on the thread pool, ahead of the brushes which need them.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/Common.h"
+
+#include <wincodec.h>
+
+/// <summary>
+/// Loading a brush image used to mean reading the file, decoding it and converting it to
+/// premultiplied BGRA, all on the UI thread, right in the middle of creating the window. Brushes
+/// now ask for their image as soon as their settings are read, which starts decoding it on the
+/// thread pool, and only bind the decoded pixels to their render target once the window is created.
+/// Only plain image files are decoded ahead, with WIC. Paths which need LoadLSImage, which isn't
+/// thread safe, are loaded on the module's thread when they are needed.
+///
+/// Decoded images are kept, up to a fixed budget, so that every brush using the same file shares a
+/// single decode. The cache is dropped when the module is refreshed or unloaded.
+///
+/// Prefetch, Get and Clear must all be called from the module's thread.
+/// </summary>
+namespace ImageDecoder {
+  /// <summary>
+  /// Counters for all images requested since the module was loaded.
+  /// </summary>
+  struct Stats {
+    // Images which were decoded on the thread pool.
+    ULONGLONG decodedAhead;
+
+    // Images which were decoded on the module's thread, because nobody asked for them in advance.
+    ULONGLONG decodedInline;
+
+    // Requests which were served by an image which had already been handed out.
+    ULONGLONG reused;
+
+    // The time the module's thread spent waiting for the thread pool, in milliseconds.
+    double waitTime;
+  };
+
+  /// <summary>
+  /// Starts decoding the specified image on the thread pool, unless it is already decoded, or
+  /// being decoded.
+  /// </summary>
+  void Prefetch(LPCWSTR path);
+
+  /// <summary>
+  /// Retrieves the decoded image, in 32bpp PBGRA. Waits for the thread pool if the image is being
+  /// decoded, and decodes it right away if nobody asked for it in advance. The caller must release
+  /// the bitmap.
+  /// </summary>
+  HRESULT Get(LPCWSTR path, IWICBitmapSource **bitmap);
+
+  /// <summary>
+  /// Drops every decoded image, waiting for any which are still being decoded.
+  /// </summary>
+  void Clear();
+
+  /// <summary>
+  /// Returns the counters for all images requested since the module was loaded.
+  /// </summary>
+  const Stats &GetStats();
+}
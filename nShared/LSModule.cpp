@@ -6,7 +6,9 @@
 //-------------------------------------------------------------------------------------------------
 #include "ErrorHandler.h"
 #include "Factories.h"
+#include "IconAtlas.hpp"
 #include "LSModule.hpp"
+#include "Settings.hpp"
 #include "Window.hpp"
 
 #include "../nCoreCom/Core.h"
@@ -16,6 +18,33 @@
 #include <strsafe.h>
 
 
+/// <summary>
+/// Reports the counters of the parts of nShared which are shared by all windows of the module.
+/// </summary>
+static void ReportSharedCounters(COUNTERSINK report, LPVOID sink) {
+  const AnimationScheduler::Stats &animations = Window::GetAnimationScheduler().GetStats();
+  report(sink, L"animation.framesPerSecond", animations.framesPerSecond);
+  report(sink, L"animation.frameCost", animations.frameCost);
+  report(sink, L"animation.frames", double(animations.frames));
+
+  const Settings::CacheStats &settings = Settings::GetCacheStats();
+  report(sink, L"settings.nodesCreated", double(settings.nodesCreated));
+  report(sink, L"settings.nodesReused", double(settings.nodesReused));
+
+  IconAtlas::Stats atlases = IconAtlas::GetStats();
+  report(sink, L"iconAtlas.atlases", atlases.atlases);
+  report(sink, L"iconAtlas.occupancy",
+    atlases.capacity != 0 ? double(atlases.occupied) / atlases.capacity : 0.0);
+  report(sink, L"iconAtlas.entries", atlases.entries);
+  report(sink, L"iconAtlas.references", atlases.references);
+  report(sink, L"iconAtlas.sharedHits", double(atlases.sharedHits));
+  report(sink, L"iconAtlas.evictions", double(atlases.evictions));
+  report(sink, L"iconAtlas.repacks", double(atlases.repacks));
+  report(sink, L"iconAtlas.fallbacks", double(atlases.fallbacks));
+  report(sink, L"iconAtlas.draws", double(atlases.draws));
+}
+
+
 /// <summary>
 /// The main entry point for this DLL.
 /// </summary>
@@ -46,6 +75,9 @@ LSModule::LSModule(LPCTSTR moduleName, LPCTSTR author, VERSION version) {
   this->parent = parent;
   this->version = version;
 
+  ZeroMemory(&mStartupTiming, sizeof(mStartupTiming));
+  mCountersGroup[0] = L'\0';
+
   ErrorHandler::Initialize(moduleName);
 }
 
@@ -62,6 +94,7 @@ bool LSModule::Initialize(HWND parent, HINSTANCE instance, PWNDCLASSEX customMes
   WNDCLASSEX wc;
   TCHAR className[MAX_PATH];
   HRESULT hr;
+  StopWatch stopWatch;
 
   this->parent = parent;
   this->instance = instance;
@@ -115,6 +148,9 @@ bool LSModule::Initialize(HWND parent, HINSTANCE instance, PWNDCLASSEX customMes
   }
   SetWindowLongPtr(this->messageHandler, GWLP_USERDATA, MAGIC_DWORD);
 
+  mStartupTiming.initialize = stopWatch.GetTime() * 1000.0f;
+  mStartupClock.Clock();
+
   return true;
 }
 
@@ -123,7 +159,8 @@ bool LSModule::Initialize(HWND parent, HINSTANCE instance, PWNDCLASSEX customMes
 /// Deinitalizes
 /// </summary>
 void LSModule::DeInitalize() {
-  // Let go of any factories we allocated.
+  // Wait for any images still being decoded, and let go of any factories we allocated.
+  ImageDecoder::Clear();
   Factories::Release();
   CoUninitialize();
 
@@ -150,6 +187,10 @@ void LSModule::DeInitalize() {
   }
 
   // Disconnect from the core
+  if (mCountersGroup[0] != L'\0') {
+    nCore::System::UnRegisterCounters(mCountersGroup);
+    mCountersGroup[0] = L'\0';
+  }
   nCore::Disconnect();
 }
 
@@ -159,6 +200,8 @@ void LSModule::DeInitalize() {
 /// </summary>
 /// <param name="minimumCoreVersion">The minimum core version which is acceptable.</param>
 bool LSModule::ConnectToCore(VERSION minimumCoreVersion) {
+  StopWatch stopWatch;
+
   switch (nCore::Connect(minimumCoreVersion)) {
   case S_OK:
     break;
@@ -168,10 +211,43 @@ bool LSModule::ConnectToCore(VERSION minimumCoreVersion) {
     return false;
   }
 
+  StringCchPrintf(mCountersGroup, _countof(mCountersGroup), L"%s.Shared", this->moduleName);
+  nCore::System::RegisterCounters(mCountersGroup, ReportSharedCounters);
+
+  mStartupTiming.connect = stopWatch.GetTime() * 1000.0f;
+  mStartupClock.Clock();
+
   return true;
 }
 
 
+/// <summary>
+/// Should be called at the end of initModule. Reports how long the module took to start up.
+/// </summary>
+void LSModule::StartupCompleted() {
+  mStartupTiming.load = mStartupClock.GetTime() * 1000.0f;
+
+  ImageDecoder::Stats nothing = { 0, 0, 0, 0.0 };
+  ReportStartupTiming(nothing);
+}
+
+
+/// <summary>
+/// Sends the startup timing to the core, counting the images decoded since imagesBefore.
+/// </summary>
+void LSModule::ReportStartupTiming(const ImageDecoder::Stats &imagesBefore) {
+  const ImageDecoder::Stats &images = ImageDecoder::GetStats();
+  mStartupTiming.imageWait = float(images.waitTime - imagesBefore.waitTime);
+  mStartupTiming.imagesDecodedAhead = UINT(images.decodedAhead - imagesBefore.decodedAhead);
+  mStartupTiming.imagesDecodedInline = UINT(images.decodedInline - imagesBefore.decodedInline);
+
+  // Modules which don't use the core have nobody to report to.
+  if (nCore::Initialized()) {
+    nCore::System::ReportModuleStartup(this->moduleName, mStartupTiming);
+  }
+}
+
+
 /// <summary>
 /// Creates a top-level drawable window.
 /// </summary>
@@ -214,6 +290,20 @@ LRESULT WINAPI LSModule::HandleMessage(HWND window, UINT message, WPARAM wParam,
     }
     return 0;
 
+  case LM_REFRESH:
+    {
+      ImageDecoder::Stats imagesBefore = ImageDecoder::GetStats();
+      StopWatch stopWatch;
+
+      Settings::ClearCache();
+      ImageDecoder::Clear();
+      LRESULT result = ::LSMessageHandler(window, message, wParam, lParam);
+
+      mStartupTiming.refresh = stopWatch.GetTime() * 1000.0f;
+      ReportStartupTiming(imagesBefore);
+      return result;
+    }
+
   default:
     return ::LSMessageHandler(window, message, wParam, lParam);
   }
@@ -8,10 +8,13 @@
 #pragma once
 
 #include "../Utilities/Common.h"
+#include "../Utilities/StopWatch.hpp"
 #include "../Utilities/Versioning.h"
+#include "../nCore/StartupTimings.h"
 #include <map>
 #include <string>
 #include "Drawable.hpp"
+#include "ImageDecoder.hpp"
 
 // Functions which all modules must implement.
 LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM lParam);
@@ -29,6 +32,9 @@ public:
   // Connects to nCore.
   bool ConnectToCore(VERSION minimumCoreVersion);
 
+  // Should be called at the end of initModule. Reports how long the module took to start up.
+  void StartupCompleted();
+
   // Creates a top-level drawable window.
   Window *CreateDrawableWindow(Settings *settings, MessageHandler *msgHandler);
 
@@ -44,6 +50,10 @@ public:
   //
   LRESULT WINAPI HandleMessage(HWND window, UINT message, WPARAM wParam, LPARAM lParam, LPVOID extra) override;
 
+private:
+  // Sends the startup timing to the core, counting the images decoded since imagesBefore.
+  void ReportStartupTiming(const ImageDecoder::Stats &imagesBefore);
+
 private:
   // The window class used by the message handler.
   ATOM messageHandlerClass;
@@ -68,4 +78,13 @@ private:
 
   // The instance of this module.
   HINSTANCE instance;
+
+  // How long each stage of starting up took.
+  ModuleStartupTiming mStartupTiming;
+
+  // Started when Initialize or ConnectToCore, whichever is called last, finishes.
+  StopWatch mStartupClock;
+
+  // The group nShared's counters are reported under, or empty if they aren't registered.
+  TCHAR mCountersGroup[64];
 };
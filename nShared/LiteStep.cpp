@@ -7,10 +7,14 @@
  *  
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "LiteStep.h"
+#include "../Utilities/LineTokenizer.hpp"
 #include <strsafe.h>
 
 using std::function;
 
+static void IterateOverWritableLines(LPCTSTR keyName, function<void(LPTSTR line)> callback);
+static void IterateOverWritableTokens(LPTSTR line, const function<void (LPCTSTR token)> &callback);
+
 
 /// <summary>
 /// Retrives a bool with a particular prefix from the LiteStep configuration.
@@ -20,8 +24,7 @@ using std::function;
 /// <param name="defaultValue">Default value, returned if the key is not specified.</param>
 bool LiteStep::GetPrefixedRCBool(LPCTSTR prefix, LPCTSTR keyName, bool defaultValue)
 {
-    TCHAR prefixedKey[MAX_RCCOMMAND];
-    StringCchPrintf(prefixedKey, _countof(prefixedKey), L"%s%s", prefix, keyName);
+    KeyBuilder<MAX_RCCOMMAND> prefixedKey(prefix, keyName);
     return GetRCBoolDef(prefixedKey, defaultValue ? TRUE : FALSE) != FALSE;
 }
 
@@ -34,8 +37,7 @@ bool LiteStep::GetPrefixedRCBool(LPCTSTR prefix, LPCTSTR keyName, bool defaultVa
 /// <param name="defaultValue">Default value, returned if the key is not specified.</param>
 double LiteStep::GetPrefixedRCDouble(LPCTSTR prefix, LPCTSTR keyName, double defaultValue)
 {
-    TCHAR prefixedKey[MAX_RCCOMMAND];
-    StringCchPrintf(prefixedKey, _countof(prefixedKey), L"%s%s", prefix, keyName);
+    KeyBuilder<MAX_RCCOMMAND> prefixedKey(prefix, keyName);
     return GetRCDouble(prefixedKey, defaultValue);
 }
 
@@ -62,8 +64,7 @@ IColorVal* LiteStep::GetPrefixedRCColor(LPCTSTR prefix, LPCTSTR keyName, const I
 /// <param name="defaultValue">Default value, returned if the key is not specified.</param>
 float LiteStep::GetPrefixedRCFloat(LPCTSTR prefix, LPCTSTR keyName, float defaultValue)
 {
-    TCHAR prefixedKey[MAX_RCCOMMAND];
-    StringCchPrintf(prefixedKey, _countof(prefixedKey), L"%s%s", prefix, keyName);
+    KeyBuilder<MAX_RCCOMMAND> prefixedKey(prefix, keyName);
     return GetRCFloat(prefixedKey, defaultValue);
 }
 
@@ -76,8 +77,7 @@ float LiteStep::GetPrefixedRCFloat(LPCTSTR prefix, LPCTSTR keyName, float defaul
 /// <param name="defaultValue">Default value, returned if the key is not specified.</param>
 int LiteStep::GetPrefixedRCInt(LPCTSTR prefix, LPCTSTR keyName, int defaultValue)
 {
-    TCHAR prefixedKey[MAX_RCCOMMAND];
-    StringCchPrintf(prefixedKey, _countof(prefixedKey), L"%s%s", prefix, keyName);
+    KeyBuilder<MAX_RCCOMMAND> prefixedKey(prefix, keyName);
     return GetRCInt(prefixedKey, defaultValue);
 }
 
@@ -90,8 +90,7 @@ int LiteStep::GetPrefixedRCInt(LPCTSTR prefix, LPCTSTR keyName, int defaultValue
 /// <param name="defaultValue">Default value, returned if the key is not specified.</param>
 __int64 LiteStep::GetPrefixedRCInt64(LPCTSTR prefix, LPCTSTR keyName, __int64 defaultValue)
 {
-    TCHAR prefixedKey[MAX_RCCOMMAND];
-    StringCchPrintf(prefixedKey, _countof(prefixedKey), L"%s%s", prefix, keyName);
+    KeyBuilder<MAX_RCCOMMAND> prefixedKey(prefix, keyName);
     return GetRCInt64(prefixedKey, defaultValue);
 }
 
@@ -107,8 +106,7 @@ __int64 LiteStep::GetPrefixedRCInt64(LPCTSTR prefix, LPCTSTR keyName, __int64 de
 /// <returns>True if the key was found in the configuration.</returns>
 bool LiteStep::GetPrefixedRCLine(LPCTSTR prefix, LPCTSTR keyName, LPTSTR buffer, LPCTSTR defaultValue, size_t cchBuffer)
 {
-    TCHAR prefixedKey[MAX_RCCOMMAND];
-    StringCchPrintf(prefixedKey, _countof(prefixedKey), L"%s%s", prefix, keyName);
+    KeyBuilder<MAX_RCCOMMAND> prefixedKey(prefix, keyName);
     return GetRCLine(prefixedKey, buffer, (UINT)cchBuffer, defaultValue) != FALSE;
 }
 
@@ -160,8 +158,7 @@ bool LiteStep::GetPrefixedRCString(LPCTSTR prefix, LPCTSTR keyName, LPTSTR buffe
     // This is bad, since the first thing GetRCString does is to set *buffer = '\0'
     ASSERT(buffer != defaultValue);
 
-    TCHAR prefixedKey[MAX_RCCOMMAND];
-    StringCchPrintf(prefixedKey, _countof(prefixedKey), L"%s%s", prefix, keyName);
+    KeyBuilder<MAX_RCCOMMAND> prefixedKey(prefix, keyName);
     return GetRCString(prefixedKey, buffer, defaultValue, (UINT)cchBuffer) != FALSE;
 }
 
@@ -172,33 +169,62 @@ bool LiteStep::GetPrefixedRCString(LPCTSTR prefix, LPCTSTR keyName, LPTSTR buffe
 /// <param name="keyName">Key of the lines to iterate over.</param>
 /// <param name="callback">Callback function to be called for each line.</param>
 void LiteStep::IterateOverLines(LPCTSTR keyName, function<void(LPCTSTR line)> callback)
+{
+    IterateOverWritableLines(keyName, [&callback] (LPTSTR line) -> void
+    {
+        callback(line);
+    });
+}
+
+
+/// <summary>
+/// Iterates over all lines with the specified key name, handing out the line buffer itself.
+/// </summary>
+/// <param name="keyName">Key of the lines to iterate over.</param>
+/// <param name="callback">Callback function to be called for each line.</param>
+static void IterateOverWritableLines(LPCTSTR keyName, function<void(LPTSTR line)> callback)
 {
     TCHAR line[MAX_LINE_LENGTH];
-    LPCTSTR callbackLine = line + wcslen(keyName) + 1;
-    LPVOID f = LCOpen(nullptr);
-    while (LCReadNextConfig(f, keyName, line, _countof(line)))
+    LPTSTR callbackLine = line + wcslen(keyName) + 1;
+    LPVOID f = LiteStep::LCOpen(nullptr);
+    while (LiteStep::LCReadNextConfig(f, keyName, line, _countof(line)))
     {
         callback(callbackLine);
     }
-    LCClose(f);
+    LiteStep::LCClose(f);
 }
 
 
 /// <summary>
-/// Iterates over all tokens in the specified line.
+/// Iterates over all tokens in a line which may be written to, terminating each token in place.
 /// </summary>
 /// <param name="line">The line containing tokens.</param>
 /// <param name="callback">Callback function to be called for each token.</param>
-void LiteStep::IterateOverTokens(LPCTSTR line, function<void (LPCTSTR token)> callback)
+static void IterateOverWritableTokens(LPTSTR line, const function<void (LPCTSTR token)> &callback)
 {
-    TCHAR token[MAX_LINE_LENGTH];
-    while (GetToken(line, token, &line, false))
+    LineTokenizer tokenizer(line);
+    LPCTSTR token;
+    while (tokenizer.NextTerminated(token))
     {
         callback(token);
     }
 }
 
 
+/// <summary>
+/// Iterates over all tokens in the specified line.
+/// </summary>
+/// <param name="line">The line containing tokens.</param>
+/// <param name="callback">Callback function to be called for each token.</param>
+void LiteStep::IterateOverTokens(LPCTSTR line, function<void (LPCTSTR token)> callback)
+{
+    // Copy the line once, rather than every token.
+    TCHAR writableLine[MAX_LINE_LENGTH];
+    StringCchCopy(writableLine, _countof(writableLine), line);
+    IterateOverWritableTokens(writableLine, callback);
+}
+
+
 /// <summary>
 /// Iterates over all tokens in all lines with the specified key name.
 /// </summary>
@@ -206,9 +232,9 @@ void LiteStep::IterateOverTokens(LPCTSTR line, function<void (LPCTSTR token)> ca
 /// <param name="callback">Callback function to be called for each token.</param>
 void LiteStep::IterateOverLineTokens(LPCTSTR keyName, function<void (LPCTSTR token)> callback)
 {
-    IterateOverLines(keyName, [callback] (LPCTSTR line) -> void
+    IterateOverWritableLines(keyName, [&callback] (LPTSTR line) -> void
     {
-        IterateOverTokens(line, callback);
+        IterateOverWritableTokens(line, callback);
     });
 }
 
@@ -221,11 +247,11 @@ void LiteStep::IterateOverLineTokens(LPCTSTR keyName, function<void (LPCTSTR tok
 /// <param name="callback">Callback function to be called for each token.</param>
 void LiteStep::IterateOverCommandLineTokens(LPCTSTR prefix, LPCTSTR keyName, function<void (LPCTSTR token)> callback)
 {
-    TCHAR key[MAX_RCCOMMAND];
-    StringCchPrintf(key, _countof(key), L"*%s%s", prefix, keyName);
-    IterateOverLines(key, [callback] (LPCTSTR line) -> void
+    KeyBuilder<MAX_RCCOMMAND> key;
+    key.Append(L"*").Append(prefix).Append(keyName);
+    IterateOverWritableLines(key, [&callback] (LPTSTR line) -> void
     {
-        IterateOverTokens(line, callback);
+        IterateOverWritableTokens(line, callback);
     });
 }
 
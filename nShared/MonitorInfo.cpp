@@ -13,10 +13,33 @@
 #include <assert.h>
 
 
+typedef HRESULT (WINAPI *GETDPIFORMONITORPROC)(HMONITOR, int, UINT*, UINT*);
+
+
+/// <summary>
+/// Retrieves the DPI of a monitor. Before Windows 8.1, every monitor has the system DPI.
+/// </summary>
+static void GetMonitorDpi(HMONITOR monitor, UINT &dpiX, UINT &dpiY) {
+  // GetDpiForMonitor, from shcore.dll, if there is one.
+  static GETDPIFORMONITORPROC getDpiForMonitor = [] () -> GETDPIFORMONITORPROC {
+    HMODULE shcore = LoadLibraryW(L"shcore.dll");
+    return shcore ? GETDPIFORMONITORPROC(GetProcAddress(shcore, "GetDpiForMonitor")) : nullptr;
+  }();
+
+  // 0 is MDT_EFFECTIVE_DPI.
+  if (getDpiForMonitor == nullptr || FAILED(getDpiForMonitor(monitor, 0, &dpiX, &dpiY))) {
+    HDC screen = GetDC(nullptr);
+    dpiX = GetDeviceCaps(screen, LOGPIXELSX);
+    dpiY = GetDeviceCaps(screen, LOGPIXELSY);
+    ReleaseDC(nullptr, screen);
+  }
+}
+
+
 /// <summary>
 /// Creates a new instance of the MonitorInfo class.
 /// </summary>
-MonitorInfo::MonitorInfo() {
+MonitorInfo::MonitorInfo() : mVersion(0) {
   Update();
 }
 
@@ -49,10 +72,6 @@ UINT MonitorInfo::MonitorFromHWND(HWND hWnd) const {
 /// Returns the monitor which contains the biggest area of the specified window.
 /// </summary>
 UINT MonitorInfo::MonitorFromRECT(RECT rect) const {
-  int maxArea = 0;
-  int area = 0;
-  UINT monitor = UINT(-1);
-
   // It happened...
   if (rect.right <= rect.left) {
     rect.right = rect.left + 1;
@@ -61,24 +80,57 @@ UINT MonitorInfo::MonitorFromRECT(RECT rect) const {
     rect.bottom = rect.top + 1;
   }
 
-  // Figure out which monitor contains the bigest part of the RECT.
-  for (UINT i = 0; i < mMonitors.size(); ++i) {
-    area = RectIntersectArea(&rect, &mMonitors[i].rect);
-    if (area > maxArea) {
-      maxArea = area;
-      monitor = i;
-    }
-  }
+  MonitorIndex::Rect query = { rect.left, rect.top, rect.right, rect.bottom };
+  uint32_t monitor = mIndex.FromRect(query);
+  return monitor == MonitorIndex::sNone ? UINT(-1) : UINT(monitor);
+}
+
 
-  return monitor;
+/// <summary>
+/// Returns the monitor which contains the specified point, or UINT(-1) if it isn't on any.
+/// </summary>
+UINT MonitorInfo::MonitorFromPoint(POINT point) const {
+  uint32_t monitor = mIndex.FromPoint(point.x, point.y);
+  return monitor == MonitorIndex::sNone ? UINT(-1) : UINT(monitor);
+}
+
+
+/// <summary>
+/// Returns a number which changes whenever a monitor is added, removed, moved, resized, or changes
+/// its DPI. Changes to workareas don't count. Anything which is worked out from the monitor layout
+/// only has to be worked out again once this changes.
+/// </summary>
+UINT64 MonitorInfo::GetVersion() const {
+  return mVersion;
 }
 
 
 /// <summary>
-/// Updates the list of monitors. Should be called when ...
+/// Updates the list of monitors. Should be called when the display configuration, or a workarea,
+/// changes.
 /// </summary>
 void MonitorInfo::Update() {
-  mMonitors.clear();
+  std::vector<Monitor> monitors;
+  monitors.reserve(GetSystemMetrics(SM_CMONITORS));
+  monitors.emplace_back();
+  EnumDisplayMonitors(nullptr, nullptr, EnumMonitorsCallback, (LPARAM)&monitors);
+
+  bool layoutChanged = monitors.size() != mMonitors.size();
+  for (size_t i = 0; i < monitors.size() && !layoutChanged; ++i) {
+    layoutChanged = !EqualRect(&monitors[i].rect, &mMonitors[i].rect) ||
+      monitors[i].dpiX != mMonitors[i].dpiX || monitors[i].dpiY != mMonitors[i].dpiY;
+  }
+
+  mMonitors.swap(monitors);
+  if (layoutChanged || mVersion == 0) {
+    std::vector<MonitorIndex::Rect> rects;
+    for (const Monitor &monitor : mMonitors) {
+      MonitorIndex::Rect rect = { monitor.rect.left, monitor.rect.top, monitor.rect.right, monitor.rect.bottom };
+      rects.push_back(rect);
+    }
+    mIndex.Build(rects.data(), UINT(rects.size()));
+    ++mVersion;
+  }
 
   mVirtualDesktop.rect.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
   mVirtualDesktop.rect.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
@@ -89,10 +141,8 @@ void MonitorInfo::Update() {
   ZeroMemory(&mVirtualDesktop.workArea, sizeof(RECT));
   mVirtualDesktop.workAreaHeight = 0;
   mVirtualDesktop.workAreaWidth = 0;
-
-  mMonitors.reserve(GetSystemMetrics(SM_CMONITORS));
-  mMonitors.emplace_back();
-  EnumDisplayMonitors(nullptr, nullptr, EnumMonitorsCallback, (LPARAM)this);
+  mVirtualDesktop.dpiX = mMonitors[0].dpiX;
+  mVirtualDesktop.dpiY = mMonitors[0].dpiY;
 }
 
 
@@ -134,9 +184,9 @@ const std::vector<MonitorInfo::Monitor> &MonitorInfo::GetMonitors() const {
 /// Callback for EnumDisplayMonitors. Adds a monitor to the list of monitors.
 /// </summary>
 /// <param name="hMonitor">Handle to the monitor to add.</param>
-/// <param name="lParam">A pointer to the MonitorInfo class to add this monitor to.</param>
+/// <param name="lParam">A pointer to the vector of monitors to add this monitor to.</param>
 BOOL CALLBACK MonitorInfo::EnumMonitorsCallback(HMONITOR hMonitor, HDC, LPRECT, LPARAM lParam) {
-  MonitorInfo *self = (MonitorInfo*)lParam;
+  std::vector<Monitor> &monitors = *(std::vector<Monitor>*)lParam;
 
   MONITORINFO mi;
   mi.cbSize = sizeof(MONITORINFO);
@@ -144,9 +194,9 @@ BOOL CALLBACK MonitorInfo::EnumMonitorsCallback(HMONITOR hMonitor, HDC, LPRECT,
 
   bool isPrimary = (mi.dwFlags & MONITORINFOF_PRIMARY) == MONITORINFOF_PRIMARY;
   if (!isPrimary) {
-    self->mMonitors.emplace_back();
+    monitors.emplace_back();
   }
-  MonitorInfo::Monitor &monitor = isPrimary ? self->mMonitors[0] : self->mMonitors.back();
+  MonitorInfo::Monitor &monitor = isPrimary ? monitors[0] : monitors.back();
 
   monitor.rect = mi.rcMonitor;
   monitor.height = mi.rcMonitor.bottom - mi.rcMonitor.top;
@@ -156,5 +206,7 @@ BOOL CALLBACK MonitorInfo::EnumMonitorsCallback(HMONITOR hMonitor, HDC, LPRECT,
   monitor.workAreaHeight = mi.rcWork.bottom - mi.rcWork.top;
   monitor.workAreaWidth = mi.rcWork.right - mi.rcWork.left;
 
+  GetMonitorDpi(hMonitor, monitor.dpiX, monitor.dpiY);
+
   return TRUE;
 }
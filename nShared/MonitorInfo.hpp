@@ -7,6 +7,7 @@
 #pragma once
 
 #include "../Utilities/Common.h"
+#include "../Utilities/MonitorIndex.hpp"
 
 #include <vector>
 
@@ -19,6 +20,8 @@ public:
     int height;
     int workAreaWidth;
     int workAreaHeight;
+    UINT dpiX;
+    UINT dpiY;
   };
 
 public:
@@ -28,6 +31,8 @@ public:
   void Update();
   UINT MonitorFromHWND(HWND hWnd) const;
   UINT MonitorFromRECT(RECT rect) const;
+  UINT MonitorFromPoint(POINT point) const;
+  UINT64 GetVersion() const;
 
   UINT GetMonitorCount() const;
   const Monitor &GetMonitor(UINT id) const;
@@ -43,4 +48,10 @@ private:
 
   // The virtual desktop
   Monitor mVirtualDesktop;
+
+  // Finds monitors by position.
+  MonitorIndex mIndex;
+
+  // Increased whenever a monitor is added, removed, moved, resized, or changes its DPI.
+  UINT64 mVersion;
 };
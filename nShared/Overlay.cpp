@@ -18,6 +18,8 @@ using namespace D2D1;
 Overlay::Overlay(D2D1_RECT_F position, D2D1_RECT_F parentPosition, IWICBitmapSource* source, int zOrder) {
   this->position = position;
   this->source = source;
+  this->opacity = 1.0f;
+  this->atlasEntry = nullptr;
   this->brush = nullptr;
   this->renderTarget = nullptr;
   this->zOrder = zOrder;
@@ -43,7 +45,7 @@ HRESULT Overlay::ReCreateDeviceResources(ID2D1RenderTarget* renderTarget) {
   this->renderTarget = renderTarget;
 
   if (renderTarget != NULL && this->source != NULL) {
-    ASSERT(this->brush == NULL);
+    ASSERT(this->brush == NULL && this->atlasEntry == NULL);
 
     // Create our helper objects.
     hr = Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory));
@@ -62,22 +64,29 @@ HRESULT Overlay::ReCreateDeviceResources(ID2D1RenderTarget* renderTarget) {
       hr = scaler->Initialize(source, (UINT)(position.right - position.left), (UINT)(position.bottom - position.top), WICBitmapInterpolationModeCubic);
     }
 
-    // Convert it to an ID2D1Bitmap
     if (SUCCEEDED(hr)) {
       hr = converter->Initialize(scaler, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, NULL, 0.f, WICBitmapPaletteTypeMedianCut);
     }
-    if (SUCCEEDED(hr)) {
-      hr = renderTarget->CreateBitmapFromWicBitmap(converter, 0, &bitmap);
-    }
 
-    // Create a brush based on the bitmap
+    // Put it in the icon atlas, if it fits
     if (SUCCEEDED(hr)) {
-      hr = renderTarget->CreateBitmapBrush(bitmap, &this->brush);
+      this->atlasEntry = IconAtlas::Add(renderTarget, converter);
     }
 
-    // Move the origin of the brush to match the overlay position
-    if (SUCCEEDED(hr)) {
-      this->brush->SetTransform(Matrix3x2F::Translation(this->drawingPosition.left, this->drawingPosition.top));
+    // Otherwise, convert it to an ID2D1Bitmap
+    if (SUCCEEDED(hr) && this->atlasEntry == nullptr) {
+      hr = renderTarget->CreateBitmapFromWicBitmap(converter, 0, &bitmap);
+
+      // Create a brush based on the bitmap
+      if (SUCCEEDED(hr)) {
+        hr = renderTarget->CreateBitmapBrush(bitmap, &this->brush);
+      }
+
+      // Move the origin of the brush to match the overlay position
+      if (SUCCEEDED(hr)) {
+        this->brush->SetTransform(Matrix3x2F::Translation(this->drawingPosition.left, this->drawingPosition.top));
+        this->brush->SetOpacity(this->opacity);
+      }
     }
 
     // Release stuff
@@ -91,6 +100,8 @@ HRESULT Overlay::ReCreateDeviceResources(ID2D1RenderTarget* renderTarget) {
 
 
 void Overlay::DiscardDeviceResources() {
+  IconAtlas::Release(this->atlasEntry);
+  this->atlasEntry = nullptr;
   SAFERELEASE(this->brush);
   this->renderTarget = nullptr;
 }
@@ -112,13 +123,17 @@ void Overlay::UpdatePosition(D2D1_RECT_F parentPosition) {
 
 
 void Overlay::Paint(ID2D1RenderTarget* renderTarget) {
-  if (this->brush != NULL) {
+  if (this->atlasEntry != nullptr) {
+    IconAtlas::Draw(renderTarget, this->atlasEntry, this->drawingPosition, this->opacity);
+  } else if (this->brush != NULL) {
     renderTarget->FillRectangle(this->drawingPosition, this->brush);
   }
 }
 
 
 void Overlay::SetSource(IWICBitmapSource* source) {
+  IconAtlas::Release(this->atlasEntry);
+  this->atlasEntry = nullptr;
   SAFERELEASE(this->brush);
   SAFERELEASE(this->source);
   this->source = source;
@@ -126,16 +141,14 @@ void Overlay::SetSource(IWICBitmapSource* source) {
 }
 
 
-ID2D1BitmapBrush *Overlay::GetBrush() {
-  return brush;
+void Overlay::SetOpacity(float opacity) {
+  this->opacity = opacity;
+  if (this->brush) {
+    this->brush->SetOpacity(opacity);
+  }
 }
 
 
 int Overlay::GetZOrder() {
   return this->zOrder;
 }
-
-
-bool Overlay::UpdateDWMColor(ARGB, ID2D1RenderTarget*) {
-  return false;
-}
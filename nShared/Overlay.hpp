@@ -6,6 +6,7 @@
 //-------------------------------------------------------------------------------------------------
 #pragma once
 
+#include "IconAtlas.hpp"
 #include "IPainter.hpp"
 
 class Overlay : IPainter {
@@ -18,16 +19,21 @@ public:
   void DiscardDeviceResources() override;
   void Paint(ID2D1RenderTarget *renderTarget) override;
   HRESULT ReCreateDeviceResources(ID2D1RenderTarget *renderTarget) override;
-  bool UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) override;
   void UpdatePosition(D2D1_RECT_F parentPosition);
 
   void SetSource(IWICBitmapSource *source);
-  ID2D1BitmapBrush *GetBrush();
+  void SetOpacity(float opacity);
   int GetZOrder();
 
 private:
   D2D1_RECT_F position;
   D2D1_RECT_F drawingPosition;
+  float opacity;
+
+  // Where the image is in the render target's icon atlas.
+  IconAtlas::Entry *atlasEntry;
+
+  // Used instead of the atlas for images which don't fit in it.
   ID2D1BitmapBrush *brush;
   IWICBitmapSource *source; // We need to keep the source image in order to be able to recreate the overlay.
   ID2D1RenderTarget *renderTarget;
@@ -9,44 +9,116 @@
 #include "ErrorHandler.h"
 
 #include <strsafe.h>
+#include <unordered_map>
+#include <vector>
 
-using std::unique_ptr;
 using std::function;
 using namespace LiteStep;
 
 
+// Group chain nodes, by lower case prefix and the address of the node they fall back to.
+static std::unordered_map<std::wstring, std::weak_ptr<const Settings>> sNodes;
+
+// The Group setting of every prefix which has been looked at, by lower case prefix.
+static std::unordered_map<std::wstring, std::wstring> sGroups;
+
+// The size of sNodes after expired nodes were last removed from it.
+static size_t sNodesAfterSweep = 0;
+
+static Settings::CacheStats sCacheStats = { 0, 0 };
+
+
+/// <summary>
+/// Returns the Group setting of the specified prefix.
+/// </summary>
+static const std::wstring &GetGroup(LPCTSTR prefix) {
+  TCHAR key[MAX_RCCOMMAND];
+  StringCchCopy(key, _countof(key), prefix);
+  _wcslwr_s(key);
+
+  auto iter = sGroups.find(key);
+  if (iter == sGroups.end()) {
+    TCHAR group[MAX_LINE_LENGTH];
+    GetPrefixedRCString(prefix, L"Group", group, L"", _countof(group));
+    iter = sGroups.emplace(key, group).first;
+  }
+  return iter->second;
+}
+
+
+/// <summary>
+/// Appends prefix, followed by the prefixes of the groups it belongs to, to chain.
+/// </summary>
+static void GetGroupChain(LPCTSTR prefix, std::vector<std::wstring> &chain) {
+  size_t first = chain.size();
+  chain.push_back(prefix);
+
+  for (;;) {
+    const std::wstring &group = GetGroup(chain.back().c_str());
+    if (group.empty()) {
+      return;
+    }
+
+    // Avoid circular definitions
+    for (size_t i = first; i < chain.size(); ++i) {
+      if (_wcsicmp(chain[i].c_str(), group.c_str()) == 0) {
+        // We found a circle :/
+
+        // Show an error message
+        TCHAR message[MAX_LINE_LENGTH];
+        StringCchCopy(message, _countof(message), L"Circular group definition!\n");
+
+        // A -> B -> C -> ... -> C
+        for (size_t j = first; j < chain.size(); ++j) {
+          StringCchCat(message, _countof(message), chain[j].c_str());
+          StringCchCat(message, _countof(message), L" -> ");
+        }
+        StringCchCat(message, _countof(message), group.c_str());
+
+        ErrorHandler::Error(ErrorHandler::Level::Critical, message);
+
+        // And break out of the chain
+        return;
+      }
+    }
+
+    chain.push_back(group);
+  }
+}
+
+
 /// <summary>
 /// Initalizes a new Settings class.
 /// </summary>
 /// <param name="prefix">The RC prefix to use.</param>
 Settings::Settings(LPCTSTR prefix) {
   StringCchCopy(mPrefix, _countof(mPrefix), prefix);
-  mGroup = unique_ptr<Settings>(GreateGroup(nullptr));
+
+  std::vector<std::wstring> chain;
+  GetGroupChain(prefix, chain);
+  mGroup = InternChain(chain, 1);
 }
 
 
 /// <summary>
-/// Creates a deep copy of the specified group.
+/// Creates a copy of the specified settings. The group chain is shared, since it never changes.
 /// </summary>
 /// <param name="settings">The settings to copy.</param>
 Settings::Settings(LPCSettings settings) {
   StringCchCopy(mPrefix, _countof(mPrefix), settings->mPrefix);
-  if (settings->mGroup != nullptr) {
-    mGroup = unique_ptr<Settings>(new (std::nothrow) Settings(settings->mGroup.get()));
-  } else {
-    mGroup = nullptr;
-  }
+  mGroup = settings->mGroup;
 }
 
 
 /// <summary>
-/// Initalizes a new Settings class, due to the precense of a Group setting in another class.
+/// Initalizes a new Settings class, which falls back to the specified group.
 /// </summary>
 /// <param name="prefix">The RC prefix to use.</param>
-/// <param name="prefixTrail">A list of previous group names.</param>
-Settings::Settings(LPCTSTR prefix, LPCTSTR prefixTrail[]) {
+/// <param name="group">The settings to fall back to.</param>
+Settings::Settings(LPCTSTR prefix, std::shared_ptr<const Settings> group)
+  : mGroup(group)
+{
   StringCchCopy(mPrefix, _countof(mPrefix), prefix);
-  mGroup = unique_ptr<Settings>(GreateGroup(prefixTrail));
 }
 
 
@@ -55,26 +127,16 @@ Settings::Settings(LPCTSTR prefix, LPCTSTR prefixTrail[]) {
 /// a related setting LabelIcon, you should call ->GetChild("Icon").
 /// </summary>
 LPSettings Settings::CreateChild(LPCTSTR prefix) const {
-  LPSettings head, newTail;
-  LPCSettings thisTail;
   TCHAR newPrefix[MAX_RCCOMMAND];
 
-  StringCchPrintf(newPrefix, _countof(newPrefix), L"%s%s", mPrefix, prefix);
-  head = new Settings(newPrefix);
-  thisTail = this;
-  newTail = head;
-
-  while (thisTail->mGroup != nullptr) {
-    thisTail = thisTail->mGroup.get();
-    StringCchPrintf(newPrefix, _countof(newPrefix), L"%s%s", thisTail->mPrefix, prefix);
-    while (newTail->mGroup != nullptr) {
-      newTail = newTail->mGroup.get();
-    }
-
-    newTail->mGroup = unique_ptr<Settings>(new Settings(newPrefix));
+  // Every prefix this falls back to gets a child prefix of its own, along with its groups.
+  std::vector<std::wstring> chain;
+  for (LPCSettings tail = this; tail != nullptr; tail = tail->mGroup.get()) {
+    StringCchPrintf(newPrefix, _countof(newPrefix), L"%s%s", tail->mPrefix, prefix);
+    GetGroupChain(newPrefix, chain);
   }
 
-  return head;
+  return new Settings(chain[0].c_str(), InternChain(chain, 1));
 }
 
 
@@ -83,9 +145,14 @@ LPSettings Settings::CreateChild(LPCTSTR prefix) const {
 /// settings fall back to that group as a default.
 /// </summary>
 void Settings::AppendGroup(LPCSettings group) {
-  LPSettings tail;
-  for (tail = this; tail->mGroup != nullptr; tail = tail->mGroup.get());
-  tail->mGroup = unique_ptr<Settings>(new (std::nothrow) Settings(group));
+  std::vector<std::wstring> chain;
+  for (LPCSettings tail = mGroup.get(); tail != nullptr; tail = tail->mGroup.get()) {
+    chain.push_back(tail->mPrefix);
+  }
+  for (LPCSettings tail = group; tail != nullptr; tail = tail->mGroup.get()) {
+    chain.push_back(tail->mPrefix);
+  }
+  mGroup = InternChain(chain, 0);
 }
 
 
@@ -98,57 +165,68 @@ LPCTSTR Settings::GetPrefix() const {
 
 
 /// <summary>
-/// Gets the value we should use for m_pGroup.
+/// Returns the shared node for prefix, falling back to group, creating it if there is none.
 /// </summary>
-/// <param name="prefixTrail">A list of previous group names.</param>
-/// <returns>The value we should use for m_pGroup.</returns>
-Settings* Settings::GreateGroup(LPCTSTR prefixTrail[]) {
-  TCHAR group[MAX_LINE_LENGTH];
-  GetPrefixedRCString(mPrefix, L"Group", group, L"", _countof(group));
+std::shared_ptr<const Settings> Settings::Intern(LPCTSTR prefix, const std::shared_ptr<const Settings> &group) {
+  TCHAR key[MAX_RCCOMMAND + 24];
+  StringCchPrintf(key, _countof(key), L"%s|%p", prefix, group.get());
+  _wcslwr_s(key);
 
-  // If there is no group
-  if (group[0] == L'\0') {
-    // We need to free pszPrev at this point.
-    if (prefixTrail != nullptr) {
-      free((LPVOID)prefixTrail);
-    }
+  std::weak_ptr<const Settings> &entry = sNodes[key];
+  std::shared_ptr<const Settings> node = entry.lock();
+  if (node != nullptr) {
+    ++sCacheStats.nodesReused;
+    return node;
+  }
 
-    return nullptr;
+  node = std::shared_ptr<const Settings>(new Settings(prefix, group));
+  entry = node;
+  ++sCacheStats.nodesCreated;
+
+  // Nodes go away with their last user, so drop their entries every now and then.
+  if (sNodes.size() >= 2 * sNodesAfterSweep + 64) {
+    for (auto iter = sNodes.begin(); iter != sNodes.end();) {
+      if (iter->second.expired()) {
+        iter = sNodes.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+    sNodesAfterSweep = sNodes.size();
   }
 
-  // Avoid circular definitions
-  int i = 0;
-  if (prefixTrail != nullptr) {
-    for (; prefixTrail[i] != nullptr; ++i) {
-      if (_wcsicmp(prefixTrail[i], group) == 0) {
-        // We found a circle :/
+  return node;
+}
 
-        // Show an error message
-        TCHAR message[MAX_LINE_LENGTH];
-        StringCchCopy(message, _countof(message), L"Circular group definition!\n");
 
-        // A -> B -> C -> ... -> C
-        for (int j = 0; prefixTrail[j] != NULL; j++) {
-          StringCchCat(message, _countof(message), prefixTrail[j]);
-          StringCchCat(message, _countof(message), L" -> ");
-        }
-        StringCchCat(message, _countof(message), group);
+/// <summary>
+/// Returns the shared chain of nodes for chain[first], chain[first + 1], ...
+/// </summary>
+std::shared_ptr<const Settings> Settings::InternChain(const std::vector<std::wstring> &chain, size_t first) {
+  std::shared_ptr<const Settings> node;
+  for (size_t i = chain.size(); i > first; --i) {
+    node = Intern(chain[i - 1].c_str(), node);
+  }
+  return node;
+}
 
-        ErrorHandler::Error(ErrorHandler::Level::Critical, message);
 
-        // And break out of the chain
-        free((LPVOID)prefixTrail);
-        return nullptr;
-      }
-    }
-  }
+/// <summary>
+/// Forgets all shared nodes and cached Group settings. Settings created after this will read the
+/// RC files again.
+/// </summary>
+void Settings::ClearCache() {
+  sNodes.clear();
+  sGroups.clear();
+  sNodesAfterSweep = 0;
+}
 
-  // Allocate space for storing the prefix of this setting
-  prefixTrail = (LPCTSTR*)realloc(prefixTrail, (i + 2)*sizeof(LPCTSTR));
-  prefixTrail[i] = mPrefix;
-  prefixTrail[i + 1] = nullptr;
 
-  return new Settings(group, prefixTrail);
+/// <summary>
+/// Returns the counters for the shared nodes.
+/// </summary>
+const Settings::CacheStats &Settings::GetCacheStats() {
+  return sCacheStats;
 }
 
 
@@ -369,6 +447,11 @@ void Settings::SetString(LPCTSTR key, LPCTSTR value) const {
   TCHAR keyName[MAX_LINE_LENGTH];
   StringCchPrintf(keyName, _countof(keyName), L"%s%s", mPrefix, key);
   LSSetVariable(keyName, value);
+
+  // Changing a group invalidates every chain which was built through it.
+  if (_wcsicmp(key, L"Group") == 0) {
+    ClearCache();
+  }
 }
 
 
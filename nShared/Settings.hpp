@@ -11,27 +11,56 @@
 #include "../Utilities/CommonD2D.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 class Settings;
 typedef Settings * LPSettings;
 typedef const Settings * LPCSettings;
 
+/// <summary>
+/// Reads RC settings with a certain prefix, falling back to the groups it belongs to. The fallback
+/// nodes never change once created, so they are shared between every Settings with the same chain
+/// of prefixes, and freed along with the last one.
+/// </summary>
 class Settings {
+public:
+  /// <summary>
+  /// Counters for the shared fallback nodes.
+  /// </summary>
+  struct CacheStats {
+    // Nodes which had to be created.
+    ULONGLONG nodesCreated;
+
+    // Times an existing node was used instead of creating one.
+    ULONGLONG nodesReused;
+  };
+
 public:
   explicit Settings(LPCTSTR prefix);
   explicit Settings(LPCSettings settings);
 
 private:
-  Settings(LPCTSTR prefix, LPCTSTR prefixTrail[]);
+  Settings(LPCTSTR prefix, std::shared_ptr<const Settings> group);
 
 public:
   LPSettings CreateChild(LPCTSTR prefix) const;
   void AppendGroup(LPCSettings group);
   LPCTSTR GetPrefix() const;
 
+public:
+  // Forgets the shared nodes and cached Group settings, after the RC files have changed.
+  static void ClearCache();
+
+  // Returns the counters for the shared nodes.
+  static const CacheStats &GetCacheStats();
+
 private:
-  // Creates the Settings * for this settings group.
-  LPSettings GreateGroup(LPCTSTR prefixTrail[]);
+  // Returns the shared node for prefix, falling back to group.
+  static std::shared_ptr<const Settings> Intern(LPCTSTR prefix, const std::shared_ptr<const Settings> &group);
+
+  // Returns the shared chain of nodes for chain[first], chain[first + 1], ...
+  static std::shared_ptr<const Settings> InternChain(const std::vector<std::wstring> &chain, size_t first);
 
   // Basic getters and setters
 public:
@@ -94,6 +123,6 @@ private:
   // The fully specified prefix to read settings from the RC files with.
   TCHAR mPrefix[MAX_RCCOMMAND];
 
-  // Where to get settings from if they are not specified for our own prefix.
-  std::unique_ptr<Settings> mGroup;
+  // Where to get settings from if they are not specified for our own prefix. Shared.
+  std::shared_ptr<const Settings> mGroup;
 };
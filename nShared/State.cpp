@@ -35,6 +35,11 @@ State::~State() {
 }
 
 
+const State::Settings * State::GetSettings() {
+  return &mStateSettings;
+}
+
+
 void State::UpdatePosition(D2D1_RECT_F position, WindowData *windowData) {
   windowData->drawingArea.rect = position;
 
@@ -145,17 +150,6 @@ HRESULT State::ReCreateDeviceResources(ID2D1RenderTarget* renderTarget) {
 }
 
 
-bool State::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) {
-  bool ret = false;
-  ret = mBrushes[BrushType::Background].UpdateDWMColor(newColor, renderTarget) || ret;
-  ret = mBrushes[BrushType::Outline].UpdateDWMColor(newColor, renderTarget) || ret;
-  ret = mBrushes[BrushType::Text].UpdateDWMColor(newColor, renderTarget) || ret;
-  ret = mBrushes[BrushType::TextStroke].UpdateDWMColor(newColor, renderTarget) || ret;
-
-  return ret;
-}
-
-
 /// <summary>
 /// Gets the "Desired" size of the window, given the specified constraints.
 /// </summary>
@@ -238,12 +232,12 @@ void State::SetTextOffsets(float left, float top, float right, float bottom) {
 
 
 void State::SetCornerRadiusX(float radius) {
-  //this->drawingArea.radiusX = this->outlineArea.radiusX = radius;
+  mStateSettings.cornerRadiusX = radius;
 }
 
 
 void State::SetCornerRadiusY(float radius) {
-  //this->drawingArea.radiusY = this->outlineArea.radiusY = radius;
+  mStateSettings.cornerRadiusY = radius;
 }
 
 
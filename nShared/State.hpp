@@ -166,7 +166,6 @@ public:
     void PaintText(ID2D1RenderTarget* renderTarget, WindowData *windowData, class Window *window);
     HRESULT ReCreateDeviceResources(ID2D1RenderTarget* renderTarget);
     void UpdatePosition(D2D1_RECT_F position, WindowData *windowData);
-    bool UpdateDWMColor(ARGB newColor, ID2D1RenderTarget* renderTarget);
 
     // IBrushOwner
 public:
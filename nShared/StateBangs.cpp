@@ -6,6 +6,7 @@
 //
 //--------------------------------------------------------------------------------------
 #include "StateBangs.h"
+#include "BangBatch.hpp"
 #include "LiteStep.h"
 #include <strsafe.h>
 #include "../nCoreCom/Core.h"
@@ -199,7 +200,7 @@ static struct BangItem {
 /// </summary>
 void StateBangs::Register(LPCTSTR prefix, std::function<Window* (LPCTSTR)> windowFinder) {
     TCHAR bangName[64];
-    ::windowFinder = windowFinder;
+    ::windowFinder = BangBatch::Batched(windowFinder);
     for (BangItem item : BangMap) {
         StringCchPrintf(bangName, _countof(bangName), L"!%s%s", prefix, item.name);
         LiteStep::AddBangCommand(bangName, item.proc);
@@ -204,6 +204,22 @@ public:
     }
 
 
+    void SetCornerRadius(float x, float y) override
+    {
+        for (State &state : mStates)
+        {
+            state.SetCornerRadiusX(x);
+            state.SetCornerRadiusY(y);
+        }
+    }
+
+
+    State *GetBaseState() override
+    {
+        return &mStates[StateEnum::Base];
+    }
+
+
     /// <summary>
     /// 
     /// </summary>
@@ -288,18 +304,6 @@ public:
     }
 
 
-    bool UpdateDWMColor(ARGB newColor, ID2D1RenderTarget* renderTarget) override
-    {
-        bool ret = false;
-
-        for (State &state : mStates)
-        {
-            ret = state.UpdateDWMColor(newColor, renderTarget) || ret;
-        }
-
-        return ret;
-    }
-
     void UpdateText(IStateWindowData *windowData) override
     {
         StateWindowData<StateEnum> *data;
@@ -6,14 +6,17 @@
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "Color.h"
+#include "DWMColorRegistry.hpp"
 #include "ErrorHandler.h"
 #include "Factories.h"
+#include "IconAtlas.hpp"
 #include "LiteStep.h"
 #include "MessageHandler.hpp"
 #include "Window.hpp"
 #include "WindowSettings.hpp"
 
 #include "../nCoreCom/Core.h"
+#include "../nCoreCom/Tracing.h"
 
 #include "../Utilities/CommonD2D.h"
 #include "../Utilities/Math.h"
@@ -30,6 +33,35 @@
 using std::map;
 
 
+/// <summary>
+/// The properties of a window which can be animated. Brush colors are keyed by the brush.
+/// </summary>
+enum class AnimatedProperty : UINT_PTR {
+  Geometry = 1,
+  Opacity,
+  CornerRadius,
+  TextOffsets
+};
+
+
+// The interval between animation frames, in milliseconds.
+static const UINT sAnimationFrameInterval = 16;
+
+// The thread timer which ticks the animation scheduler, while it has anything to do.
+static UINT_PTR sAnimationTimer = 0;
+
+// The number of repaints which have been held back by an UpdateLock.
+static ULONGLONG sDeferredRepaints = 0;
+
+
+/// <summary>
+/// Steps all window animations.
+/// </summary>
+static void CALLBACK AnimationTimerProc(HWND, UINT, UINT_PTR, DWORD) {
+  Window::GetAnimationScheduler().Tick();
+}
+
+
 /// <summary>
 /// Constructor used to create a DrawableWindow for a pre-existing window. Used by nDesk.
 /// </summary>
@@ -46,7 +78,6 @@ void Window::TextChangeHandler(LPVOID drawable) {
 /// <param name="msgHandler">The default message handler for this window.</param>
 Window::Window(Settings* settings, MessageHandler* msgHandler)
     : activeChild(nullptr)
-    , mAnimating(false)
     , initialized(false)
     , isTrackingMouse(false)
     , msgHandler(msgHandler)
@@ -66,6 +97,13 @@ Window::Window(Settings* settings, MessageHandler* msgHandler)
     , mCoveredByFullscreen(false)
     , mWindowData(nullptr)
     , mStateRender(nullptr)
+    , mOpacity(1.0f)
+    , mOpacityLayer(nullptr)
+    , mHitTestValid(false)
+    , mMessageCount(0)
+    , mMessageCountAtRateStart(0)
+    , mMessageRateStart(0)
+    , mMessageRate(0.0f)
 {
     ZeroMemory(&this->drawingArea, sizeof(this->drawingArea));
 }
@@ -80,7 +118,7 @@ Window::Window(Settings* settings, MessageHandler* msgHandler)
 Window::Window(HWND window, LPCTSTR prefix, MessageHandler *msgHandler)
     : Window(new Settings(prefix), msgHandler)
 {
-    this->timerIDs = new UIDGenerator<UINT_PTR>(1);
+    this->timerIDs = new UIDGenerator<UINT_PTR>(VT_FIRSTREGISTERED);
     this->userMsgIDs = new UIDGenerator<UINT>(WM_FIRSTREGISTERED);
     this->window = window;
 
@@ -111,6 +149,7 @@ Window::Window(LPCTSTR parent, Settings *settings, MessageHandler *msgHandler)
     if (mParent)
     {
         mParent->children.push_back(this);
+        mParent->mHitTestValid = false;
         this->window = mParent->window;
     }
     else
@@ -131,7 +170,7 @@ Window::Window(LPCTSTR parent, Settings *settings, MessageHandler *msgHandler)
 Window::Window(HWND /* parent */, LPCTSTR windowClass, HINSTANCE instance, Settings* settings, MessageHandler* msgHandler)
     : Window(new Settings(settings), msgHandler)
 {
-    this->timerIDs = new UIDGenerator<UINT_PTR>(1);
+    this->timerIDs = new UIDGenerator<UINT_PTR>(VT_FIRSTREGISTERED);
     this->userMsgIDs = new UIDGenerator<UINT>(WM_FIRSTREGISTERED);
 
     // Create the window
@@ -187,6 +226,13 @@ Window::Window(Window* parent, Settings* settings, MessageHandler* msgHandler)
 /// </summary>
 Window::~Window() {
   this->initialized = false;
+
+  // Animations of this window, or of children which will end up without a top-level window.
+  GetAnimationScheduler().Stop(this);
+  if (!mIsChild) {
+    GetAnimationScheduler().StopGroup(this);
+  }
+
   if (mParent) {
     mParent->RemoveChild(this);
   } else if (mIsChild) {
@@ -321,22 +367,84 @@ Window::PAINTER Window::AddPrePainter(IPainter* painter)
 
 
 /// <summary>
-/// Performs an animation step.
+/// Animates one of the brushes this window paints with to the specified color.
 /// </summary>
-void Window::Animate() {
-  float progress = Easing::Transform(Clamp(0.0f, mAnimationClock.GetTime() / mAnimationDuration, 1.0f), mAnimationEasing);
+/// <param name="brush">The brush to animate. Must be owned by one of this window's states.</param>
+/// <param name="color">The color to animate to.</param>
+/// <param name="duration">The number of milliseconds to complete the animation in.</param>
+/// <param name="easing">The easing to use.</param>
+void Window::AnimateBrushColor(Brush *brush, const IColorVal *color, int duration, Easing::Type easing) {
+  ARGB current = brush->GetShownColor();
+  ARGB target = color->Evaluate();
+  float from[] = {
+    float(current >> 24), float((current >> 16) & 0xFF), float((current >> 8) & 0xFF), float(current & 0xFF)
+  };
+  float to[] = {
+    float(target >> 24), float((target >> 16) & 0xFF), float((target >> 8) & 0xFF), float(target & 0xFF)
+  };
+
+  // Intermediate frames only change what the brush shows. The target is handed to the brush once
+  // it is reached, so a color which depends on the DWM color keeps tracking it afterwards.
+  std::shared_ptr<IColorVal> targetColor(color->Copy());
+  GetAnimationScheduler().Start(this, UINT_PTR(brush), GetTopLevelWindow(), from, to, 4,
+      duration / 1000.0f, easing, [this, brush, target, targetColor] (const float *values) -> void {
+    ARGB step = 0;
+    for (int i = 0; i < 4; ++i) {
+      step = step << 8 | ARGB(Clamp(0.0f, values[i] + 0.5f, 255.0f));
+    }
+    if (step == target) {
+      brush->SetColor(targetColor.get());
+    } else {
+      brush->ShowColor(step);
+    }
+    Repaint();
+  });
+}
 
-  if (progress >= 1.0f) {
-    mAnimating = false;
-  }
 
-  Rect step;
-  step.left = mAnimationStart.left + (mAnimationTarget.left - mAnimationStart.left)*progress;
-  step.top = mAnimationStart.top + (mAnimationTarget.top - mAnimationStart.top)*progress;
-  step.right = mAnimationStart.right + (mAnimationTarget.right - mAnimationStart.right)*progress;
-  step.bottom = mAnimationStart.bottom + (mAnimationTarget.bottom - mAnimationStart.bottom)*progress;
+/// <summary>
+/// Animates the corner radius of all states.
+/// </summary>
+void Window::AnimateCornerRadius(float x, float y, int duration, Easing::Type easing) {
+  const State::Settings *settings = mStateRender->GetBaseState()->GetSettings();
+  float from[] = { settings->cornerRadiusX, settings->cornerRadiusY };
+  float to[] = { x, y };
+
+  GetAnimationScheduler().Start(this, UINT_PTR(AnimatedProperty::CornerRadius),
+      GetTopLevelWindow(), from, to, 2, duration / 1000.0f, easing, [this] (const float *values) -> void {
+    SetCornerRadius(values[0], values[1]);
+  });
+}
+
+
+/// <summary>
+/// Animates the opacity of this window.
+/// </summary>
+void Window::AnimateOpacity(float opacity, int duration, Easing::Type easing) {
+  GetAnimationScheduler().Start(this, UINT_PTR(AnimatedProperty::Opacity),
+      GetTopLevelWindow(), &mOpacity, &opacity, 1, duration / 1000.0f, easing, [this] (const float *values) -> void {
+    // Not through SetOpacity, which stops this animation.
+    mOpacity = Clamp(0.0f, values[0], 1.0f);
+    Repaint();
+  });
+}
+
 
-  SetPosition(step.left, step.top, step.right - step.left, step.bottom - step.top);
+/// <summary>
+/// Animates the text offsets of all states.
+/// </summary>
+void Window::AnimateTextOffsets(float left, float top, float right, float bottom, int duration,
+    Easing::Type easing) {
+  const State::Settings *settings = mStateRender->GetBaseState()->GetSettings();
+  float from[] = {
+    settings->textOffsetLeft, settings->textOffsetTop, settings->textOffsetRight, settings->textOffsetBottom
+  };
+  float to[] = { left, top, right, bottom };
+
+  GetAnimationScheduler().Start(this, UINT_PTR(AnimatedProperty::TextOffsets),
+      GetTopLevelWindow(), from, to, 4, duration / 1000.0f, easing, [this] (const float *values) -> void {
+    SetTextOffsets(values[0], values[1], values[2], values[3]);
+  });
 }
 
 
@@ -349,8 +457,14 @@ void Window::ClearCallbackTimer(UINT_PTR timer)
     if (!mIsChild)
     {
         KillTimer(this->window, timer);
-        this->timers.erase(timer);
-        this->timerIDs->ReleaseID(timer);
+
+        // Timers are regularly cleared more than once, so only give back IDs which are in use.
+        size_t index = timer - VT_FIRSTREGISTERED;
+        if (timer >= VT_FIRSTREGISTERED && index < mTimerHandlers.size() && mTimerHandlers[index] != nullptr)
+        {
+            mTimerHandlers[index] = nullptr;
+            this->timerIDs->ReleaseID(timer);
+        }
     }
     else if(mParent)
     {
@@ -382,6 +496,7 @@ Window *Window::CreateChild(Settings* childSettings, MessageHandler* msgHandler)
 {
     Window* child = new Window(this, childSettings, msgHandler);
     children.push_back(child);
+    mHitTestValid = false;
     return child;
 }
 
@@ -393,6 +508,11 @@ void Window::DiscardDeviceResources()
 {
     if (!mIsChild)
     {
+        // The atlas goes away once the overlays below have let go of it.
+        if (mRenderTarget != nullptr)
+        {
+            IconAtlas::Discard(mRenderTarget);
+        }
         SAFERELEASE(mRenderTarget);
     }
     else
@@ -409,6 +529,7 @@ void Window::DiscardDeviceResources()
         overlay->DiscardDeviceResources();
     }
     mStateRender->DiscardDeviceResources();
+    SAFERELEASE(mOpacityLayer);
     for (IPainter *painter : this->postPainters)
     {
         painter->DiscardDeviceResources();
@@ -563,6 +684,118 @@ LPCWSTR Window::GetText()
 }
 
 
+/// <summary>
+/// Returns the scheduler which runs the animations of all windows. It ticks from a thread timer
+/// while anything is animating, and updates each top-level window once per frame.
+/// </summary>
+AnimationScheduler &Window::GetAnimationScheduler() {
+  static AnimationScheduler scheduler(
+    [] () -> double {
+      LARGE_INTEGER frequency, counter;
+      QueryPerformanceFrequency(&frequency);
+      QueryPerformanceCounter(&counter);
+      return double(counter.QuadPart) / double(frequency.QuadPart);
+    },
+    [] (bool run) -> void {
+      if (run) {
+        sAnimationTimer = SetTimer(nullptr, 0, sAnimationFrameInterval, AnimationTimerProc);
+      } else if (sAnimationTimer != 0) {
+        KillTimer(nullptr, sAnimationTimer);
+        sAnimationTimer = 0;
+      }
+    },
+    [] (void *group, const std::function<void ()> &update) -> void {
+      UpdateLock lock((Window*)group);
+      update();
+    }
+  );
+  return scheduler;
+}
+
+
+/// <summary>
+/// Counts a message towards the message rate of this window.
+/// </summary>
+void Window::CountMessage() {
+  ++mMessageCount;
+  ULONGLONG now = GetTickCount64();
+  if (now - mMessageRateStart >= 1000) {
+    mMessageRate = float(mMessageCount - mMessageCountAtRateStart) * 1000.0f / float(now - mMessageRateStart);
+    mMessageRateStart = now;
+    mMessageCountAtRateStart = mMessageCount;
+  }
+}
+
+
+/// <summary>
+/// Returns the time it took to paint the most recent frames of this window, in microseconds.
+/// </summary>
+const RollingHistogram &Window::GetFrameTimes() const {
+  return mFrameTimes;
+}
+
+
+/// <summary>
+/// Returns the number of messages this window has handled.
+/// </summary>
+ULONGLONG Window::GetMessageCount() const {
+  return mMessageCount;
+}
+
+
+/// <summary>
+/// Returns the number of messages handled per second, over the last second in which this window
+/// got any messages. 0 if it has been idle for longer than that.
+/// </summary>
+float Window::GetMessageRate() const {
+  return GetTickCount64() - mMessageRateStart < 2000 ? mMessageRate : 0.0f;
+}
+
+
+/// <summary>
+/// Rebuilds the index used to find the child under the mouse.
+/// </summary>
+void Window::UpdateHitTest() {
+  mHitTest.Clear();
+  for (Window *child : this->children) {
+    if (!child->mWindowSettings.clickThrough) {
+      const D2D1_RECT_F &pos = child->drawingArea;
+      mHitTest.Add(child, pos.left, pos.top, pos.right, pos.bottom);
+    }
+  }
+  mHitTest.Build();
+  mHitTestValid = true;
+}
+
+
+/// <summary>
+/// Returns the number of repaints which have been held back by an UpdateLock.
+/// </summary>
+ULONGLONG Window::GetDeferredRepaintCount() {
+  return sDeferredRepaints;
+}
+
+
+/// <summary>
+/// Returns the opacity this window is painted with.
+/// </summary>
+float Window::GetOpacity() const {
+  return mOpacity;
+}
+
+
+/// <summary>
+/// Returns the top-level window of this window stack.
+/// </summary>
+Window *Window::GetTopLevelWindow() {
+  Window *window = this;
+  while (window->mIsChild && window->mParent) {
+    window = window->mParent;
+  }
+  return window;
+}
+
+
 /// <summary>
 /// Returns the window handle of the top-level window this window belongs to.
 /// </summary>
@@ -604,6 +837,8 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
 {
     UNREFERENCED_PARAMETER(extra);
 
+    CountMessage();
+
     // Forward mouse messages to the lowest level child window which the mouse is over.
     if (msg >= WM_MOUSEFIRST && msg <= WM_MOUSELAST && !mDontForwardMouse)
     {
@@ -615,17 +850,15 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
 
         if (mCaptureHandler == nullptr)
         {
-            for (Window *child : this->children)
+            if (!mHitTestValid)
             {
-                if (!child->mWindowSettings.clickThrough)
-                {
-                    D2D1_RECT_F pos = child->drawingArea;
-                    if (xPos >= pos.left && xPos <= pos.right && yPos >= pos.top && yPos <= pos.bottom)
-                    {
-                        handler = child;
-                        break;
-                    }
-                }
+                UpdateHitTest();
+            }
+
+            Window *child;
+            if (mHitTest.Find(float(xPos), float(yPos), child))
+            {
+                handler = child;
             }
 
             if (msg == WM_MOUSEMOVE)
@@ -695,7 +928,6 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
 
     case WM_PAINT:
         {
-            bool inAnimation = false;
             RECT updateRect;
 
             UpdateLock lock(this);
@@ -704,6 +936,10 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
             {
                 if (ReCreateDeviceResources() == S_OK)
                 {
+                    TRACE_SPAN_ARG("Window::Paint", UINT_PTR(this));
+                    LARGE_INTEGER frameStart, frameEnd, frequency;
+                    QueryPerformanceCounter(&frameStart);
+
                     D2D1_RECT_F d2dUpdateRect = D2D1::RectF(
                         (FLOAT)updateRect.left, (FLOAT)updateRect.top, (FLOAT)updateRect.right, (FLOAT)updateRect.bottom);
 
@@ -711,12 +947,18 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
                     mRenderTarget->PushAxisAlignedClip(&d2dUpdateRect, D2D1_ANTIALIAS_MODE_ALIASED);
                     mRenderTarget->Clear();
 
-                    Paint(inAnimation, &d2dUpdateRect);
+                    Paint(&d2dUpdateRect);
 
                     mRenderTarget->PopAxisAlignedClip();
 
                     // If EndDraw fails we need to recreate all device-dependent resources
-                    if (mRenderTarget->EndDraw() == D2DERR_RECREATE_TARGET)
+                    HRESULT endDraw = mRenderTarget->EndDraw();
+
+                    QueryPerformanceCounter(&frameEnd);
+                    QueryPerformanceFrequency(&frequency);
+                    mFrameTimes.Add(uint32_t((frameEnd.QuadPart - frameStart.QuadPart) * 1000000 / frequency.QuadPart));
+
+                    if (endDraw == D2DERR_RECREATE_TARGET)
                     {
                         DiscardDeviceResources();
                     }
@@ -732,32 +974,20 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
                 //    SendMessage(hwnd, WM_PAINT, 0, 0);
                 //    return TRUE;
                 //}, 0);
-
-                // Handled specially here for top-level windows, as we must NOT resize
-                // the top-level window between BeginPaint and EndPaint.
-                if (mAnimating)
-                {
-                    Animate();
-                }
             }
 
             // We just painted, don't update
             mNeedsUpdate = false;
-
-            if (inAnimation)
-            {
-                PostMessage(window, WM_ANIMATIONPAINT, 0, 0);
-            }
         }
         return 0;
 
     case WM_TIMER:
         {
-            UpdateLock updateLock(this);
-            map<UINT_PTR, MessageHandler*>::const_iterator iter = timers.find(wParam);
-            if (iter != timers.end())
+            size_t index = wParam - VT_FIRSTREGISTERED;
+            if (wParam >= VT_FIRSTREGISTERED && index < mTimerHandlers.size() && mTimerHandlers[index] != nullptr)
             {
-                return iter->second->HandleMessage(window, msg, wParam, lParam, this);
+                UpdateLock updateLock(this);
+                return mTimerHandlers[index]->HandleMessage(window, msg, wParam, lParam, this);
             }
         }
         return 0;
@@ -766,16 +996,8 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
         {
             UpdateLock updateLock(this);
 
-            // When the intensity is really high, the alpha drops to 0 :/
-            if (wParam >> 24 == 0 && wParam != 0)
-            {
-                wParam |= 0xFF000000;
-            }
-
-            if (UpdateDWMColor(ARGB(wParam)))
-            {
-                UpdateWindow(this->window);
-            }
+            // Only the brushes which refer to the DWM color are touched, once per module.
+            DWMColorRegistry::Update(DWMColorRegistry::Normalize(ARGB(wParam)));
         }
         return 0;
 
@@ -791,22 +1013,16 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
             }
         }
         return 0;
-
-    case WM_ANIMATIONPAINT:
-        {
-            //PostMessage(window, WM_PAINT, 0, 0);
-        }
-        return 0;
     }
 
     // Forward registered user messages.
-    if (msg >= WM_FIRSTREGISTERED)
+    if (msg >= WM_FIRSTREGISTERED && msg - WM_FIRSTREGISTERED < mUserMessageHandlers.size())
     {
-        UpdateLock updateLock(this);
-        map<UINT,MessageHandler*>::const_iterator handler = this->userMessages.find(msg);
-        if (handler != this->userMessages.end())
+        MessageHandler *handler = mUserMessageHandlers[msg - WM_FIRSTREGISTERED];
+        if (handler != nullptr)
         {
-            return handler->second->HandleMessage(window, msg, wParam, lParam, this);
+            UpdateLock updateLock(this);
+            return handler->HandleMessage(window, msg, wParam, lParam, this);
         }
     }
 
@@ -928,13 +1144,22 @@ void Window::Move(Distance x, Distance y)
 /// <summary>
 /// Removes the specified child.
 /// </summary>
-void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
+void Window::Paint(D2D1_RECT_F *updateRect)
 {
     UpdateLock lock(this);
-    if (this->visible && RectIntersectArea(updateRect, &this->drawingArea) > 0)
+    if (this->visible && mOpacity > 0.0f && RectIntersectArea(updateRect, &this->drawingArea) > 0)
     {
         mRenderTarget->PushAxisAlignedClip(this->drawingArea, D2D1_ANTIALIAS_MODE_ALIASED);
 
+        // Everything, including the children, goes through a layer when we are translucent.
+        bool layered = mOpacity < 1.0f &&
+            (mOpacityLayer != nullptr || SUCCEEDED(mRenderTarget->CreateLayer(&mOpacityLayer)));
+        if (layered)
+        {
+            mRenderTarget->PushLayer(D2D1::LayerParameters(this->drawingArea, nullptr,
+                D2D1_ANTIALIAS_MODE_ALIASED, D2D1::IdentityMatrix(), mOpacity), mOpacityLayer);
+        }
+
         // Paint the active state's background.
         mStateRender->Paint(mRenderTarget, mWindowData);
 
@@ -951,7 +1176,7 @@ void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
         PaintOverlays(updateRect);
 
         // Paint all children.
-        PaintChildren(inAnimation, updateRect);
+        PaintChildren(updateRect);
 
         // Post painters.
         for (IPainter *painter : this->postPainters)
@@ -959,10 +1184,9 @@ void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
             painter->Paint(mRenderTarget);
         }
 
-        inAnimation |= mAnimating;
-        if (mAnimating && mIsChild)
+        if (layered)
         {
-            Animate();
+            mRenderTarget->PopLayer();
         }
 
         mRenderTarget->PopAxisAlignedClip();
@@ -973,11 +1197,11 @@ void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
 /// <summary>
 /// Paints all child windows.
 /// </summary>
-void Window::PaintChildren(bool &inAnimation, D2D1_RECT_F *updateRect)
+void Window::PaintChildren(D2D1_RECT_F *updateRect)
 {
     for (Window *child : this->children)
     {
-        child->Paint(inAnimation, updateRect);
+        child->Paint(updateRect);
     }
 }
 
@@ -1022,7 +1246,11 @@ UINT Window::RegisterUserMessage(MessageHandler* msgHandler)
     if (!mIsChild)
     {
         UINT ret = this->userMsgIDs->GetNewID();
-        this->userMessages.insert(std::pair<UINT, MessageHandler*>(ret, msgHandler));
+        if (ret - WM_FIRSTREGISTERED >= mUserMessageHandlers.size())
+        {
+            mUserMessageHandlers.resize(ret - WM_FIRSTREGISTERED + 1, nullptr);
+        }
+        mUserMessageHandlers[ret - WM_FIRSTREGISTERED] = msgHandler;
         return ret;
     }
     else if (mParent)
@@ -1045,8 +1273,12 @@ void Window::ReleaseUserMessage(UINT message)
 {
     if (!mIsChild)
     {
-        this->userMessages.erase(message);
-        this->userMsgIDs->ReleaseID(message);
+        if (message >= WM_FIRSTREGISTERED && message - WM_FIRSTREGISTERED < mUserMessageHandlers.size() &&
+            mUserMessageHandlers[message - WM_FIRSTREGISTERED] != nullptr)
+        {
+            mUserMessageHandlers[message - WM_FIRSTREGISTERED] = nullptr;
+            this->userMsgIDs->ReleaseID(message);
+        }
     }
     else if (mParent)
     {
@@ -1083,6 +1315,7 @@ void Window::Resize(Distance width, Distance height)
 /// <returns>S_OK if successful, an error code otherwise.</returns>
 HRESULT Window::ReCreateDeviceResources()
 {
+    TRACE_SPAN("Window::ReCreateDeviceResources");
     HRESULT hr = S_OK;
 
     if (!mRenderTarget)
@@ -1163,7 +1396,12 @@ void Window::PopUpdateLock(UpdateLock *lock)
 {
     if (!mIsChild)
     {
-        mActiveLocks.erase(lock);
+        auto iter = std::find(mActiveLocks.begin(), mActiveLocks.end(), lock);
+        if (iter != mActiveLocks.end())
+        {
+            *iter = mActiveLocks.back();
+            mActiveLocks.pop_back();
+        }
         if (mActiveLocks.empty() && mNeedsUpdate)
         {
             mNeedsUpdate = false;
@@ -1184,7 +1422,7 @@ void Window::PushUpdateLock(UpdateLock *lock)
 {
     if (!mIsChild)
     {
-        mActiveLocks.insert(lock);
+        mActiveLocks.push_back(lock);
         lock->mWindow = this;
     }
     else if (mParent)
@@ -1218,6 +1456,7 @@ void Window::ReleaseMouseCapture()
 void Window::RemoveChild(Window *child)
 {
     this->children.remove(child);
+    mHitTestValid = false;
     if (child == this->activeChild)
     {
         this->activeChild = nullptr;
@@ -1271,6 +1510,7 @@ void Window::Repaint(LPCRECT region)
             else
             {
                 mNeedsUpdate = true;
+                ++sDeferredRepaints;
             }
         }
     }
@@ -1323,7 +1563,7 @@ void Window::SetAlwaysOnTop(bool value)
 
 
 /// <summary>
-/// Starts a new animation, or updates the parameters of the current one.
+/// Starts a new animation of the position and size of this window, replacing the current one.
 /// </summary>
 /// <param name="x">The x coordinate to animate to.</param>
 /// <param name="y">The y coordinate to animate to.</param>
@@ -1333,14 +1573,22 @@ void Window::SetAlwaysOnTop(bool value)
 /// <param name="easing">The easing to use.</param>
 void Window::SetAnimation(Distance x, Distance y, Distance width, Distance height, int duration, Easing::Type easing)
 {
-    mAnimationTarget = Rect(x, y, x + width, y + height);
-    mAnimationStart = Rect(mWindowSettings.x, mWindowSettings.y, mWindowSettings.x + mWindowSettings.width, mWindowSettings.y + mWindowSettings.height);
-    mAnimationEasing = easing;
-    mAnimationClock.Clock();
-    mAnimationDuration = duration / 1000.0f;
-    mAnimating = true;
+    // The scheduler moves the progress from 0 to 1, and the distances are interpolated here.
+    Rect start(mWindowSettings.x, mWindowSettings.y, mWindowSettings.x + mWindowSettings.width, mWindowSettings.y + mWindowSettings.height);
+    Rect target(x, y, x + width, y + height);
+    float from = 0.0f, to = 1.0f;
 
-    Repaint();
+    GetAnimationScheduler().Start(this, UINT_PTR(AnimatedProperty::Geometry),
+        GetTopLevelWindow(), &from, &to, 1, duration / 1000.0f, easing, [this, start, target] (const float *values) mutable -> void
+    {
+        float progress = values[0];
+        Rect step;
+        step.left = start.left + (target.left - start.left)*progress;
+        step.top = start.top + (target.top - start.top)*progress;
+        step.right = start.right + (target.right - start.right)*progress;
+        step.bottom = start.bottom + (target.bottom - start.bottom)*progress;
+        SetPosition(step.left, step.top, step.right - step.left, step.bottom - step.top);
+    });
 }
 
 
@@ -1355,7 +1603,11 @@ UINT_PTR Window::SetCallbackTimer(UINT elapse, MessageHandler* msgHandler)
     if (!mIsChild)
     {
         UINT_PTR ret = SetTimer(this->window, this->timerIDs->GetNewID(), elapse, NULL);
-        this->timers.insert(std::pair<UINT_PTR, MessageHandler*>(ret, msgHandler));
+        if (ret - VT_FIRSTREGISTERED >= mTimerHandlers.size())
+        {
+            mTimerHandlers.resize(ret - VT_FIRSTREGISTERED + 1, nullptr);
+        }
+        mTimerHandlers[ret - VT_FIRSTREGISTERED] = msgHandler;
         return ret;
     }
     else if (mParent)
@@ -1376,6 +1628,34 @@ UINT_PTR Window::SetCallbackTimer(UINT elapse, MessageHandler* msgHandler)
 void Window::SetClickThrough(bool value)
 {
     mWindowSettings.clickThrough = value;
+    if (mParent)
+    {
+        mParent->mHitTestValid = false;
+    }
+}
+
+
+/// <summary>
+/// Sets the corner radius of all states.
+/// </summary>
+void Window::SetCornerRadius(float x, float y)
+{
+    mStateRender->SetCornerRadius(x, y);
+    mStateRender->UpdatePosition(this->drawingArea, mWindowData);
+    Repaint();
+}
+
+
+/// <summary>
+/// Sets the opacity this window, and its children, are painted with.
+/// </summary>
+/// <param name="opacity">The opacity, between 0 and 1.</param>
+void Window::SetOpacity(float opacity)
+{
+    // An explicit opacity overrides any running fade.
+    GetAnimationScheduler().Stop(this, UINT_PTR(AnimatedProperty::Opacity));
+    mOpacity = Clamp(0.0f, opacity, 1.0f);
+    Repaint();
 }
 
 
@@ -1427,39 +1707,6 @@ void Window::SendToAll(HWND window, UINT msg, WPARAM wParam, LPARAM lParam, LPVO
     }
 }
 
-// Called when the DWM color has changed. Windows should invalidate
-// if appropriate, but not update, in response to this.
-bool Window::UpdateDWMColor(ARGB newColor)
-{
-    bool ret = false;
-
-    // It's important that ret is on the right hand side, to prevent short-circuiting
-    for (IPainter *painter : this->prePainters)
-    {
-        ret = painter->UpdateDWMColor(newColor, mRenderTarget) || ret;
-    }
-
-    ret = mStateRender->UpdateDWMColor(newColor, mRenderTarget) || ret;
-
-    for (IPainter *painter : this->postPainters)
-    {
-        ret = painter->UpdateDWMColor(newColor, mRenderTarget) || ret;
-    }
-
-    if (ret)
-    {
-        RECT r = { (LONG)drawingArea.left, (LONG)drawingArea.top, (LONG)drawingArea.right, (LONG)drawingArea.bottom };
-        InvalidateRect(this->window, &r, TRUE);
-    }
-
-    for (Window *child : this->children)
-    {
-        ret = child->UpdateDWMColor(newColor) || ret;
-    }
-
-    return ret;
-}
-
 
 /// <summary>
 /// Updates variables which are dependent on the parent window.
@@ -1491,6 +1738,7 @@ void Window::SetParent(Window *newParent)
 
     mParent = newParent;
     mParent->children.push_back(this);
+    mParent->mHitTestValid = false;
 
     UpdateParentVariables();
     SendToAll(this->window, WM_NEWTOPPARENT, 0, 0, this);
@@ -1569,6 +1817,7 @@ void Window::SetPosition(Distance x, Distance y, Distance width, Distance height
       mParent->drawingArea.left + mPosition.x + mSize.width,
       mParent->drawingArea.top + mPosition.y + mSize.height
     );
+    mParent->mHitTestValid = false;
   }
 
   // Update all paintables.
@@ -1668,6 +1917,8 @@ void Window::SetText(LPCWSTR text)
 void Window::SetTextOffsets(float left, float top, float right, float bottom)
 {
     mStateRender->SetTextOffsets(left, top, right, bottom);
+    mStateRender->UpdatePosition(this->drawingArea, mWindowData);
+    Repaint();
 }
 
 
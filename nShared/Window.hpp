@@ -16,11 +16,14 @@
 #include <list>
 #include <map>
 #include "../Utilities/UIDGenerator.hpp"
+#include "AnimationScheduler.hpp"
 #include "Easing.h"
 #include "../nCore/IParsedText.hpp"
 #include "IPainter.hpp"
 #include "BrushSettings.hpp"
+#include "../Utilities/HitTestIndex.hpp"
 #include "../Utilities/PointerIterator.hpp"
+#include "../Utilities/RollingHistogram.hpp"
 #include "../Utilities/StopWatch.hpp"
 #include "IBrushOwner.hpp"
 #include "IStateRender.hpp"
@@ -79,9 +82,6 @@ public:
         // lParam: Custom value sent to move
         WM_POSITIONCHANGE,
 
-        //
-        WM_ANIMATIONPAINT,
-
         //
         WM_HIDDEN,
 
@@ -134,6 +134,18 @@ public:
     PAINTER AddPrePainter(IPainter *painter);
     PAINTER AddPostPainter(IPainter *painter);
 
+    // Animates one of the brushes this window paints with to the specified color.
+    void AnimateBrushColor(class Brush *brush, const IColorVal *color, int duration, Easing::Type easing);
+
+    // Animates the corner radius of all states.
+    void AnimateCornerRadius(float x, float y, int duration, Easing::Type easing);
+
+    // Animates the opacity of this window.
+    void AnimateOpacity(float opacity, int duration, Easing::Type easing);
+
+    // Animates the text offsets of all states.
+    void AnimateTextOffsets(float left, float top, float right, float bottom, int duration, Easing::Type easing);
+
     // Stops a timer.
     void ClearCallbackTimer(UINT_PTR);
 
@@ -158,12 +170,30 @@ public:
     //
     IBrushOwner *GetBrushOwner(LPCTSTR name);
 
+    // Returns the scheduler which runs the animations of all windows.
+    static AnimationScheduler &GetAnimationScheduler();
+
+    // Returns the number of repaints which have been held back by an UpdateLock.
+    static ULONGLONG GetDeferredRepaintCount();
+
     // Returns the current drawing settings.
     WindowSettings *GetDrawingSettings();
 
+    // Returns the time it took to paint the most recent frames of this window, in microseconds.
+    const RollingHistogram &GetFrameTimes() const;
+
     // Gets the "desired" size for a given width and height.
     void GetDesiredSize(int maxWidth, int maxHeight, LPSIZE size);
 
+    // Returns the number of messages this window has handled.
+    ULONGLONG GetMessageCount() const;
+
+    // Returns the number of messages this window has recently handled per second.
+    float GetMessageRate() const;
+
+    // Returns the opacity this window is painted with.
+    float GetOpacity() const;
+
     // Returns the position of this window, relative to its top-level parent.
     D2D1_RECT_F GetDrawingRect();
 
@@ -244,12 +274,18 @@ public:
     //
     void SetClickThrough(bool value);
 
+    // Sets the corner radius of all states.
+    void SetCornerRadius(float x, float y);
+
     // Sets the message handler for this window.
     void SetMessageHandler(MessageHandler *msgHandler);
 
     // Captures mouse input.
     void SetMouseCapture(MessageHandler *captureHandler = nullptr);
 
+    // Sets the opacity this window, and its children, are painted with.
+    void SetOpacity(float opacity);
+
     // Sets the paragraph alignment of this Window.
     void SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT alignment);
 
@@ -298,13 +334,13 @@ public:
 
 protected:
     // Paints this window.
-    void Paint(bool &inAnimation, D2D1_RECT_F *updateRect);
+    void Paint(D2D1_RECT_F *updateRect);
 
     // Paints all overlays.
     void PaintOverlays(D2D1_RECT_F *updateRect);
 
     // Paints all children.
-    void PaintChildren(bool &inAnimation, D2D1_RECT_F *updateRect);
+    void PaintChildren(D2D1_RECT_F *updateRect);
 
     // The render target to draw to.
     ID2D1HwndRenderTarget *mRenderTarget;
@@ -322,13 +358,15 @@ private:
     // Sends a message to every child window, all the way down the tree.
     void SendToAll(HWND, UINT, WPARAM, LPARAM, LPVOID);
 
-    // Called when the DWM color has changed. Windows should invalidate
-    // if appropriate, but not update, in response to this.
-    bool UpdateDWMColor(ARGB newColor);
-
 private:
-    //
-    void Animate();
+    // Returns the top-level window of this window stack.
+    Window *GetTopLevelWindow();
+
+    // Rebuilds the index used to find the child under the mouse.
+    void UpdateHitTest();
+
+    // Counts a message towards the message rate.
+    void CountMessage();
 
     // Removes the specified child.
     void RemoveChild(Window* child);
@@ -352,23 +390,28 @@ private:
     // The child window the mouse is currently over.
     Window* activeChild;
 
-    // True if we are currently animating.
-    bool mAnimating;
+    // The children which take mouse input, indexed by position. Rebuilt when mHitTestValid is false.
+    HitTestIndex<Window*> mHitTest;
+
+    // False when a child has been added, removed, moved or made click-through.
+    bool mHitTestValid;
 
-    // The easing we are using for the current animation.
-    Easing::Type mAnimationEasing;
+    // The number of messages handled, and the count and time at which the current second began.
+    ULONGLONG mMessageCount;
+    ULONGLONG mMessageCountAtRateStart;
+    ULONGLONG mMessageRateStart;
 
-    // How long, in seconds, the animation should last.
-    float mAnimationDuration;
+    // Messages handled per second, as of the end of the last full second.
+    float mMessageRate;
 
-    // If we are currently doing an animation, the position at the start of the animation.
-    Rect mAnimationStart;
+    // The opacity this window is painted with.
+    float mOpacity;
 
-    // If we are currently doing an animation, how far along we are.
-    StopWatch mAnimationClock;
+    // The layer used to paint with an opacity below 1.
+    ID2D1Layer *mOpacityLayer;
 
-    // If we are currently doing an animation, the position target of the animation.
-    Rect mAnimationTarget;
+    // How long the most recent WM_PAINTs took, from BeginDraw to EndDraw.
+    RollingHistogram mFrameTimes;
 
     // The children of this Window.
     std::list<Window*> children;
@@ -412,8 +455,8 @@ private:
     // Timer ID generator.
     UIDGenerator<UINT_PTR>* timerIDs;
 
-    // Registered timer ID's.
-    std::map<UINT_PTR, MessageHandler*> timers;
+    // Registered timer handlers, indexed by timer ID - VT_FIRSTREGISTERED.
+    std::vector<MessageHandler*> mTimerHandlers;
 
     // Used by the top-level window to track the mouse.
     TRACKMOUSEEVENT trackMouseStruct;
@@ -421,8 +464,8 @@ private:
     // User msg ID generator.
     UIDGenerator<UINT>* userMsgIDs;
 
-    // Registered user messages.
-    std::map<UINT, MessageHandler*> userMessages;
+    // Registered user message handlers, indexed by message - WM_FIRSTREGISTERED.
+    std::vector<MessageHandler*> mUserMessageHandlers;
 
     // Whether or not we are visible.
     bool visible;
@@ -452,7 +495,7 @@ private:
     std::map<std::wstring, IBrushOwner*> mBrushOwners;
 
     // All currently active locks.
-    std::set<UpdateLock*> mActiveLocks;
+    std::vector<UpdateLock*> mActiveLocks;
 
 public:
     // Registers a part of this window as a drop-region
@@ -5,6 +5,7 @@
  *  Bangs for drawable windows.
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "BangBatch.hpp"
 #include "LiteStep.h"
 #include "WindowBangs.h"
 #include <strsafe.h>
@@ -14,10 +15,11 @@
 namespace WindowBangs
 {
     // Specified by the module during _Register. Used to map names -> drawables.
-    static Window* (*drawableFinder)(LPCTSTR) = nullptr;
+    static std::function<Window* (LPCTSTR)> drawableFinder;
 
     static const BangItem BangMap[] =
     {
+        { L"Batch",                      Batch                      },
         { L"Hide",                       Hide                       },
         { L"Show",                       Show                       },
         { L"Toggle",                     Toggle                     },
@@ -28,8 +30,11 @@ namespace WindowBangs
         { L"Position",                   Position                   },
         { L"SetAlwaysOnTop",             SetAlwaysOnTop             },
         { L"SetClickThrough",            SetClickThrough            },
+        { L"SetCornerRadius",            SetCornerRadius            },
+        { L"SetOpacity",                 SetOpacity                 },
         { L"SetParent",                  SetParent                  },
-        { L"SetText",                    SetText                    }
+        { L"SetText",                    SetText                    },
+        { L"SetTextOffsets",             SetTextOffsets             }
     };
 }
 
@@ -43,7 +48,7 @@ using namespace LiteStep;
 void WindowBangs::Register(LPCTSTR prefix, Window* (*drawableFinder)(LPCTSTR))
 {
     TCHAR bangName[64];
-    WindowBangs::drawableFinder = drawableFinder;
+    WindowBangs::drawableFinder = BangBatch::Batched(drawableFinder);
     for (BangItem item : BangMap) {
         StringCchPrintf(bangName, _countof(bangName), L"!%s%s", prefix, item.name);
         LiteStep::AddBangCommand(bangName, item.command);
@@ -64,6 +69,15 @@ void WindowBangs::UnRegister(LPCTSTR prefix) {
 }
 
 
+/// <summary>
+/// Runs a list of quoted, or bracketed, bang commands. Every window they touch repaints once, after
+/// the last command has run.
+/// </summary>
+void WindowBangs::Batch(HWND, LPCTSTR args) {
+    BangBatch::Run(args);
+}
+
+
 /// <summary>
 /// Hides the window.
 /// </summary>
@@ -251,6 +265,54 @@ void WindowBangs::SetClickThrough(HWND, LPCTSTR args) {
 }
 
 
+/// <summary>
+/// Changes the corner radius of the window's states, optionally animating it.
+/// </summary>
+void WindowBangs::SetCornerRadius(HWND, LPCTSTR args) {
+    TCHAR prefix[MAX_RCCOMMAND], x[MAX_RCCOMMAND], y[MAX_RCCOMMAND], durationstr[MAX_RCCOMMAND],
+        easingstr[MAX_RCCOMMAND];
+    LPTSTR tokens [] = { prefix, x, y, durationstr, easingstr };
+
+    int numTokens = LiteStep::CommandTokenize(args, tokens, _countof(tokens), nullptr);
+
+    if (numTokens >= 3) {
+        Window* drawable = drawableFinder(prefix);
+        if (drawable != nullptr) {
+            if (numTokens == 3) {
+                drawable->SetCornerRadius(wcstof(x, nullptr), wcstof(y, nullptr));
+            } else {
+                drawable->AnimateCornerRadius(wcstof(x, nullptr), wcstof(y, nullptr), _wtoi(durationstr),
+                    numTokens == 4 ? Easing::Type::Linear : Easing::EasingFromString(easingstr));
+            }
+        }
+    }
+}
+
+
+/// <summary>
+/// Changes the opacity of the window, optionally animating it.
+/// </summary>
+void WindowBangs::SetOpacity(HWND, LPCTSTR args) {
+    TCHAR prefix[MAX_RCCOMMAND], value[MAX_RCCOMMAND], durationstr[MAX_RCCOMMAND],
+        easingstr[MAX_RCCOMMAND];
+    LPTSTR tokens [] = { prefix, value, durationstr, easingstr };
+
+    int numTokens = LiteStep::CommandTokenize(args, tokens, _countof(tokens), nullptr);
+
+    if (numTokens >= 2) {
+        Window* drawable = drawableFinder(prefix);
+        if (drawable != nullptr) {
+            if (numTokens == 2) {
+                drawable->SetOpacity(wcstof(value, nullptr));
+            } else {
+                drawable->AnimateOpacity(wcstof(value, nullptr), _wtoi(durationstr),
+                    numTokens == 3 ? Easing::Type::Linear : Easing::EasingFromString(easingstr));
+            }
+        }
+    }
+}
+
+
 /// <summary>
 /// Changes the windows parent.
 /// </summary>
@@ -285,6 +347,32 @@ void WindowBangs::SetText(HWND, LPCTSTR args)
     }
 }
 
+/// <summary>
+/// Changes the text offsets of the window's states, optionally animating them.
+/// </summary>
+void WindowBangs::SetTextOffsets(HWND, LPCTSTR args) {
+    TCHAR prefix[MAX_RCCOMMAND], left[MAX_RCCOMMAND], top[MAX_RCCOMMAND], right[MAX_RCCOMMAND],
+        bottom[MAX_RCCOMMAND], durationstr[MAX_RCCOMMAND], easingstr[MAX_RCCOMMAND];
+    LPTSTR tokens [] = { prefix, left, top, right, bottom, durationstr, easingstr };
+
+    int numTokens = LiteStep::CommandTokenize(args, tokens, _countof(tokens), nullptr);
+
+    if (numTokens >= 5) {
+        Window* drawable = drawableFinder(prefix);
+        if (drawable != nullptr) {
+            if (numTokens == 5) {
+                drawable->SetTextOffsets(wcstof(left, nullptr), wcstof(top, nullptr),
+                    wcstof(right, nullptr), wcstof(bottom, nullptr));
+            } else {
+                drawable->AnimateTextOffsets(wcstof(left, nullptr), wcstof(top, nullptr),
+                    wcstof(right, nullptr), wcstof(bottom, nullptr), _wtoi(durationstr),
+                    numTokens == 6 ? Easing::Type::Linear : Easing::EasingFromString(easingstr));
+            }
+        }
+    }
+}
+
+
 /// <summary>
 /// Adds an event handler.
 /// </summary>
@@ -18,6 +18,9 @@ namespace WindowBangs
     void On(HWND, LPCTSTR);
     void Off(HWND, LPCTSTR);
 
+    // Runs the bang commands passed to it as a single update.
+    void Batch(HWND, LPCTSTR);
+
     //
     void Hide(HWND, LPCTSTR);
     void Show(HWND, LPCTSTR);
@@ -27,8 +30,11 @@ namespace WindowBangs
     void Position(HWND, LPCTSTR);
     void SetAlwaysOnTop(HWND, LPCTSTR);
     void SetClickThrough(HWND, LPCTSTR);
+    void SetCornerRadius(HWND, LPCTSTR);
+    void SetOpacity(HWND, LPCTSTR);
     void SetParent(HWND, LPCTSTR);
     void SetText(HWND, LPCTSTR);
+    void SetTextOffsets(HWND, LPCTSTR);
 
     struct BangItem
     {
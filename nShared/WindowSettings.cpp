@@ -8,6 +8,7 @@
 #include "../nShared/LiteStep.h"
 #include <strsafe.h>
 #include "WindowSettings.hpp"
+#include "../nCoreCom/Tracing.h"
 #include "../Utilities/StringUtils.h"
 #include "../Utilities/Unordered1To1Map.hpp"
 
@@ -64,6 +65,7 @@ WindowSettings::WindowSettings(void init(WindowSettings &))
 /// Loads settings from an RC file using the specified defaults.
 /// </summary>
 void WindowSettings::Load(const Settings *settings, const WindowSettings *defaults) {
+  TRACE_SPAN("WindowSettings::Load");
   WCHAR buf[MAX_LINE_LENGTH];
   if (!defaults) {
     defaults = this;
@@ -38,6 +38,8 @@ int initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path */)
     // Load settings
     LoadSettings();
 
+    gLSModule.StartupCompleted();
+
     return 0;
 }
 
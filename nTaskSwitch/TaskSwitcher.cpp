@@ -14,6 +14,7 @@
 
 #include "../Utilities/Common.h"
 
+#include <algorithm>
 #include <Shlwapi.h>
 
 
@@ -168,7 +169,17 @@ void TaskSwitcher::Show(int delta) {
 
   SetActiveWindow(mWindow->GetWindowHandle());
   SetForegroundWindow(mWindow->GetWindowHandle());
-  EnumDesktopWindows(nullptr, LoadWindowsCallback, (LPARAM)this);
+
+  // nCore already keeps track of the taskbar windows, most recently activated first.
+  std::vector<WindowStateTable::Entry> windows;
+  nCore::FetchWindowState().ReadAll(windows);
+  std::sort(windows.begin(), windows.end(), [] (const WindowStateTable::Entry &a,
+      const WindowStateTable::Entry &b) {
+    return a.record.activation > b.record.activation;
+  });
+  for (const WindowStateTable::Entry &window : windows) {
+    AddWindow(window.key);
+  }
 
   if (gDesktopWindow) {
     AddWindow(gDesktopWindow);
@@ -195,45 +206,6 @@ void TaskSwitcher::Show(int delta) {
 }
 
 
-/// <summary>
-/// Worker used by AddExisting.
-/// </summary>
-BOOL CALLBACK TaskSwitcher::LoadWindowsCallback(HWND window, LPARAM taskSwitcher) {
-  if (IsTaskbarWindow(window)) {
-    ((TaskSwitcher*)taskSwitcher)->AddWindow(window);
-  }
-  return TRUE;
-}
-
-
-/// <summary>
-/// Determines if a window should be shown on the taskbar.
-/// </summary>
-bool TaskSwitcher::IsTaskbarWindow(HWND hWnd) {
-  // Make sure it's actually a window.
-  if (!IsWindow(hWnd))
-    return false;
-
-  // And that it's visible
-  if (!IsWindowVisible(hWnd))
-    return false;
-
-  LONG_PTR exStyle = GetWindowLongPtrW(hWnd, GWL_EXSTYLE);
-
-  // Windows with the WS_EX_APPWINDOW style should always be shown
-  if ((exStyle & WS_EX_APPWINDOW) == WS_EX_APPWINDOW)
-    return true;
-  else if (GetParent(hWnd) != nullptr) // Windows with parents should not be shown
-    return false;
-  else if (::GetWindow(hWnd, GW_OWNER) != nullptr) // Windows with owners should not be shown
-    return false;
-  else if ((exStyle & WS_EX_TOOLWINDOW) == WS_EX_TOOLWINDOW) // Tool windows should not be shown on the taskbar
-    return false;
-
-  return true;
-}
-
-
 /// <summary>
 /// 
 /// </summary>
@@ -263,9 +235,8 @@ void TaskSwitcher::UpdateActiveWindow(int delta) {
   if (targetWindow == gDesktopWindow) {
     mWindow->SetText(L"Desktop");
   } else {
-    WCHAR text[MAX_PATH];
-    GetWindowTextW(targetWindow, text, MAX_PATH);
-    mWindow->SetText(text);
+    WCHAR title[MAX_LINE_LENGTH];
+    mWindow->SetText(nCore::FetchWindowTitle(targetWindow, title, _countof(title)) ? title : L"");
   }
   mWindow->Repaint();
 
@@ -44,9 +44,6 @@ public:
     LRESULT WINAPI HandleMessage(HWND, UINT, WPARAM, LPARAM, LPVOID);
 
 private:
-    static bool IsTaskbarWindow(HWND hWnd);
-    static BOOL CALLBACK LoadWindowsCallback(HWND window, LPARAM taskSwitcher);
-
     void LoadSettings();
     void UpdateActiveWindow(int delta);
 
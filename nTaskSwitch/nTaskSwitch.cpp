@@ -58,6 +58,8 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
 
   sTaskSwitcher = new TaskSwitcher();
 
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 
@@ -9,5 +9,8 @@
 #define TIMER_ADD_EXISTING 1
 #define TIMER_CHECKMONITOR 2
 #define TIMER_MAINTENANCE  3
+#define TIMER_CONSISTENCY  4
 
 #define WM_ADDED_EXISTING WM_USER
+#define WM_FLUSH_REDRAWS  (WM_USER + 1)
+#define WM_ICON_HASHED    (WM_USER + 2)
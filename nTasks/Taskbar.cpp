@@ -10,6 +10,7 @@
 #include "../nCoreCom/Core.h"
 #include "../nShared/LSModule.hpp"
 #include "Taskbar.hpp"
+#include "WindowManager.h"
 #include "../Utilities/Math.h"
 #include "../nShared/DWMColorVal.hpp"
 
@@ -19,7 +20,7 @@
 /// <summary>
 /// Constructor
 /// </summary>
-Taskbar::Taskbar(LPCTSTR name) : Drawable(name) {
+Taskbar::Taskbar(LPCTSTR name) : Drawable(name), mRemovedButtons(0) {
   mThumbnail = new WindowThumbnail(L"Thumbnail", mSettings);
 
   LoadSettings();
@@ -47,8 +48,11 @@ Taskbar::Taskbar(LPCTSTR name) : Drawable(name) {
 /// Destructor
 /// </summary>
 Taskbar::~Taskbar() {
+  WindowManager::TaskbarDestroyed(this);
+
   // Remove all buttons
   mButtonList.clear();
+  mButtons.Clear();
 
   SAFEDELETE(mThumbnail);
 }
@@ -76,22 +80,22 @@ void Taskbar::LoadSettings(bool /* isRefresh */) {
 /// <summary>
 /// Adds the specified task to this taskbar
 /// </summary>
-TaskButton *Taskbar::AddTask(HWND hWnd, UINT monitor, bool noLayout) {
+/// <param name="handle">Set to the handle of the new button, if one is created.</param>
+TaskButton *Taskbar::AddTask(HWND hWnd, UINT monitor, bool noLayout, ButtonHandle &handle) {
   if (monitor == mMonitor || mMonitor == 0xFFFFFFFF) {
-    ASSERT(mButtonMap.find(hWnd) == mButtonMap.end());
-
-    mButtonList.emplace_back(this, hWnd, mButtonSettings);
-    mButtonMap[hWnd] = --mButtonList.end();
+    handle = mButtons.Emplace(this, hWnd, mButtonSettings);
+    TaskButton *button = mButtons.Get(handle);
+    mButtonList.push_back(handle);
 
     if (hWnd == GetForegroundWindow()) {
-      mButtonList.back().Activate();
+      button->Activate();
     }
 
     if (!noLayout) {
       Relayout();
     }
 
-    return &mButtonList.back();
+    return button;
   }
 
   return nullptr;
@@ -99,20 +103,19 @@ TaskButton *Taskbar::AddTask(HWND hWnd, UINT monitor, bool noLayout) {
 
 
 /// <summary>
-/// Removes the specified task from this taskbar, if it is on it
+/// Returns the button the handle refers to, or nullptr if it is no longer on this taskbar.
 /// </summary>
-void Taskbar::RemoveTask(HWND hWnd) {
-  RemoveTask(mButtonMap.find(hWnd));
+TaskButton *Taskbar::GetButton(ButtonHandle handle) const {
+  return mButtons.Get(handle);
 }
 
 
 /// <summary>
-/// Removes the specified task from this taskbar, if it is on it
+/// Removes the specified button from this taskbar, if it is still on it
 /// </summary>
-void Taskbar::RemoveTask(ButtonMap::iterator iter) {
-  if (iter != mButtonMap.end()) {
-    mButtonList.erase(iter->second);
-    mButtonMap.erase(iter);
+void Taskbar::RemoveTask(ButtonHandle handle) {
+  if (mButtons.Erase(handle)) {
+    ++mRemovedButtons;
     Relayout();
     Repaint();
   }
@@ -120,26 +123,22 @@ void Taskbar::RemoveTask(ButtonMap::iterator iter) {
 
 
 /// <summary>
-/// Called when the specified taskbar has moved to a different monitor.
+/// Called when the specified task has moved to a different monitor.
 /// </summary>
-/// <param name="pOut">If a taskbutton was added or removed, the pointer to that button. Otherwise nullptr.</param>
-/// <returns>True if the task should be contained on this taskbar. False otherwise.</returns>
-bool Taskbar::MonitorChanged(HWND hWnd, UINT monitor, TaskButton **pOut) {
-  ButtonMap::iterator iter = mButtonMap.find(hWnd);
-  *pOut = nullptr;
+/// <param name="handle">The task's button on this taskbar, if it has one. Updated to refer to the
+/// new button if one is added.</param>
+/// <returns>The button, if one was added. Otherwise nullptr.</returns>
+TaskButton *Taskbar::MonitorChanged(HWND hWnd, UINT monitor, ButtonHandle &handle) {
+  bool contained = mButtons.Get(handle) != nullptr;
   // If we should contain the task
   if (monitor == mMonitor || mMonitor == 0xFFFFFFFF) {
-    if (iter == mButtonMap.end()) {
-      *pOut = AddTask(hWnd, monitor, false);
-    }
-    return true;
-  } else {
-    if (iter != mButtonMap.end()) {
-      *pOut = &*iter->second;
-      RemoveTask(iter);
+    if (!contained) {
+      return AddTask(hWnd, monitor, false, handle);
     }
-    return false;
+  } else if (contained) {
+    RemoveTask(handle);
   }
+  return nullptr;
 }
 
 
@@ -151,6 +150,19 @@ void Taskbar::Repaint() {
 }
 
 
+/// <summary>
+/// Drops the handles of removed buttons from the layout order.
+/// </summary>
+void Taskbar::CompactButtonList() {
+  if (mRemovedButtons != 0) {
+    mButtonList.erase(std::remove_if(mButtonList.begin(), mButtonList.end(), [this] (ButtonHandle handle) {
+      return mButtons.Get(handle) == nullptr;
+    }), mButtonList.end());
+    mRemovedButtons = 0;
+  }
+}
+
+
 /// <summary>
 /// Repositions/Resizes all buttons.
 /// </summary>
@@ -160,7 +172,9 @@ void Taskbar::Relayout() {
 
   float spacePerLine, lines, buttonSize, x0, y0, xdir, ydir;
 
-  if (mButtonMap.size() == 0) {
+  CompactButtonList();
+
+  if (mButtonList.empty()) {
     return;
   }
 
@@ -200,7 +214,7 @@ void Taskbar::Relayout() {
     spacePerLine = size->width - mLayoutSettings.mPadding.left - mLayoutSettings.mPadding.right;
     lines = floorf((size->height + mLayoutSettings.mRowSpacing - mLayoutSettings.mPadding.top - mLayoutSettings.mPadding.bottom) / (mLayoutSettings.mRowSpacing + buttonHeight));
     // We need to consider that buttons can't be split between multiple lines.
-    buttonSize = std::min(mButtonMaxWidth.Evaluate(size->width), std::min(spacePerLine * lines / (float)mButtonMap.size(), spacePerLine / ceil(mButtonMap.size() / lines)) - mLayoutSettings.mColumnSpacing);
+    buttonSize = std::min(mButtonMaxWidth.Evaluate(size->width), std::min(spacePerLine * lines / (float)mButtonList.size(), spacePerLine / ceil(mButtonList.size() / lines)) - mLayoutSettings.mColumnSpacing);
     if (ydir == -1) {
       y0 -= buttonHeight;
     }
@@ -209,20 +223,21 @@ void Taskbar::Relayout() {
     }
 
     float x = x0, y = y0;
-    for (TaskButton &button : mButtonList) {
-      button.Reposition(x, y, buttonSize, buttonHeight);
+    for (ButtonHandle handle : mButtonList) {
+      TaskButton *button = mButtons.Get(handle);
+      button->Reposition(x, y, buttonSize, buttonHeight);
       x += xdir*(buttonSize + mLayoutSettings.mColumnSpacing);
       if (x < mLayoutSettings.mPadding.left || x > size->width - mLayoutSettings.mPadding.right - buttonSize + 1.0f) {
         x = x0;
         y += ydir*(buttonHeight + mLayoutSettings.mRowSpacing);
       }
-      button.Show();
+      button->Show();
     }
   } else {
     float buttonWidth = mButtonHeight.Evaluate(size->width);
     spacePerLine = size->height - mLayoutSettings.mPadding.top - mLayoutSettings.mPadding.bottom;
     lines = floorf((size->width + mLayoutSettings.mColumnSpacing - mLayoutSettings.mPadding.left - mLayoutSettings.mPadding.right) / (mLayoutSettings.mColumnSpacing + buttonWidth));
-    buttonSize = std::min((float)mButtonMaxHeight.Evaluate(size->height), std::min(spacePerLine * lines / (float)mButtonMap.size(), spacePerLine / ceil(mButtonMap.size() / lines)) - mLayoutSettings.mRowSpacing);
+    buttonSize = std::min((float)mButtonMaxHeight.Evaluate(size->height), std::min(spacePerLine * lines / (float)mButtonList.size(), spacePerLine / ceil(mButtonList.size() / lines)) - mLayoutSettings.mRowSpacing);
     if (ydir == -1) {
       y0 -= buttonSize;
     }
@@ -231,14 +246,15 @@ void Taskbar::Relayout() {
     }
 
     float x = x0, y = y0;
-    for (TaskButton &button : mButtonList) {
-      button.Reposition(x, y, buttonWidth, buttonSize);
+    for (ButtonHandle handle : mButtonList) {
+      TaskButton *button = mButtons.Get(handle);
+      button->Reposition(x, y, buttonWidth, buttonSize);
       y += ydir*(buttonSize + mLayoutSettings.mRowSpacing);
       if (y < mLayoutSettings.mPadding.top || y > size->height - mLayoutSettings.mPadding.bottom - buttonSize + 1.0f) {
         y = y0;
         x += xdir*(buttonWidth + mLayoutSettings.mColumnSpacing);
       }
-      button.Show();
+      button->Show();
     }
   }
 
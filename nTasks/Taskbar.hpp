@@ -8,6 +8,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 #include "ButtonSettings.hpp"
 #include "TaskButton.hpp"
 #include "../nShared/Window.hpp"
@@ -15,6 +16,7 @@
 #include "../nShared/LayoutSettings.hpp"
 #include "../nShared/Drawable.hpp"
 #include "../nShared/WindowThumbnail.hpp"
+#include "../Utilities/SlotMap.hpp"
 
 class Taskbar: public Drawable
 {
@@ -29,10 +31,12 @@ public:
         Position
     };
 
+    // Refers to a button on this taskbar. Stops resolving once the button is removed.
+    typedef SlotMap<TaskButton>::Handle ButtonHandle;
+
     // Private Typedefs
 private:
-    typedef std::list<TaskButton> ButtonList;
-    typedef std::map<HWND, ButtonList::iterator> ButtonMap;
+    typedef std::vector<ButtonHandle> ButtonList;
 
     enum class States
     {
@@ -55,16 +59,16 @@ public:
     void HideThumbnail();
 
     void LoadSettings(bool = false);
-    TaskButton *AddTask(HWND, UINT, bool);
-    bool MonitorChanged(HWND hWnd, UINT monitor, TaskButton **out);
-    void RemoveTask(HWND);
+    TaskButton *AddTask(HWND, UINT, bool, ButtonHandle &);
+    TaskButton *MonitorChanged(HWND hWnd, UINT monitor, ButtonHandle &handle);
+    TaskButton *GetButton(ButtonHandle) const;
+    void RemoveTask(ButtonHandle);
     void Relayout();
     void Repaint();
 
     // Private methods
 private:
-    // Removes a task from this taskbar
-    void RemoveTask(ButtonMap::iterator iter);
+    void CompactButtonList();
 
     // 
 private:
@@ -73,9 +77,15 @@ private:
 
     // The taskbar buttons
     ButtonSettings mButtonSettings;
-    ButtonMap mButtonMap;
+    SlotMap<TaskButton> mButtons;
+
+    // The buttons, in the order they are laid out. Removed buttons are only dropped from this list
+    // by the next Relayout, which walks it anyway.
     ButtonList mButtonList;
 
+    // Number of handles in mButtonList which no longer resolve.
+    size_t mRemovedButtons;
+
     // The maximum width of a taskbar button
     Distance mButtonMaxWidth;
     Distance mButtonMaxHeight;
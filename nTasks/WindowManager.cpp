@@ -19,9 +19,13 @@
 #include <process.h>
 #include "Constants.h"
 #include <VersionHelpers.h>
+#include <strsafe.h>
 #include <thread>
 #include <algorithm>
+#include <unordered_map>
 #include "../nCoreCom/Core.h"
+#include "../Utilities/DeadlineQueue.hpp"
+#include "../Utilities/IconHash.h"
 
 
 using std::vector;
@@ -33,7 +37,10 @@ extern TaskbarMap gTaskbars;
 
 extern LSModule gLSModule;
 
-// The messages that the Window Manager wants from the core
+// The messages that the Window Manager wants from the core. Titles come from nCore's window
+// state. Which windows get buttons, and their activation and monitors, still come from the shell
+// hooks, since they go through nTasks' own IsTaskbarWindow and maintenance. LM_REDRAW also
+// carries the icon and flashing changes, which the window state doesn't hold.
 const UINT gWMMessages[] = {
     // Standard HSHELL
     LM_WINDOWCREATED, LM_WINDOWACTIVATED, LM_WINDOWDESTROYED, LM_LANGUAGE,
@@ -68,6 +75,95 @@ namespace WindowManager
 
     // True if we havent added existing windows yet.
     bool initializing = true;
+
+    // The kinds of work which can be pending for a window. Each kind has its own deadline, so that
+    // an early deadline for one doesn't pull the others forward.
+    enum class Work
+    {
+        Update,
+        CheckMinimized,
+        Validate
+    };
+
+    typedef std::pair<HWND, Work> PendingWork;
+
+    struct PendingWorkHash
+    {
+        size_t operator()(const PendingWork &work) const
+        {
+            return std::hash<HWND>()(work.first) * 3 + size_t(work.second);
+        }
+    };
+
+    // Work pending for windows, ordered by when it should be carried out.
+    DeadlineQueue<PendingWork, ULONGLONG, PendingWorkHash> pendingWork;
+
+    // Counters for the work done during maintenance.
+    MaintenanceStats maintenanceStats;
+
+    // LM_REDRAWs which have been received since the last flush, and their flags.
+    std::unordered_map<HWND, LPARAM> pendingRedraws;
+
+    // Counters for icon updates, across all windows.
+    IconStats iconStats;
+
+    // The version of nCore's window state which the buttons are up to date with.
+    UINT64 windowStateVersion = 0;
+
+    // The minimum time between two updates of the same window, in milliseconds.
+    const ULONGLONG minUpdateInterval = 100;
+
+    // How long to wait for the answers to a batch of WM_GETICON probes before giving up on them, in
+    // milliseconds. Hung applications never answer.
+    const ULONGLONG iconFetchTimeout = 5000;
+
+    // An icon being hashed on the thread pool.
+    struct IconHashRequest
+    {
+        HWND hWnd;
+        UINT generation;
+        HICON icon;
+        UINT64 hash;
+    };
+
+    // Icons are hashed through this environment, so that Stop can wait for them.
+    TP_CALLBACK_ENVIRON hashEnvironment;
+    PTP_CLEANUP_GROUP hashCleanupGroup = nullptr;
+
+    // How long to wait before checking the state of a window which is being minimized or
+    // restored, in milliseconds.
+    const ULONGLONG stateCheckDelay = 250;
+
+    // How often to sweep over all windows to catch anything the events missed, in milliseconds.
+    const UINT consistencyInterval = 30000;
+
+    /// <summary>
+    /// Calls function with each of the buttons which represent the specified window.
+    /// </summary>
+    template <class Function>
+    void ForEachButton(const WindowInformation &wndInfo, Function function)
+    {
+        for (const ButtonRef &ref : wndInfo.buttons)
+        {
+            TaskButton *button = ref.taskbar->GetButton(ref.handle);
+            if (button != nullptr)
+            {
+                function(button);
+            }
+        }
+    }
+
+    void QueueWork(HWND hWnd, Work work, ULONGLONG deadline);
+    void ScheduleMaintenance();
+    void ReportMaintenanceCounters(COUNTERSINK report, LPVOID sink);
+    void ReportIconCounters(COUNTERSINK report, LPVOID sink);
+    void CALLBACK HashIconCallback(PTP_CALLBACK_INSTANCE, PVOID context);
+    void IconHashed(IconHashRequest *request);
+    bool SyncMinimizedState(HWND hWnd, WindowInformation &wndInfo);
+    void ResolveIconProbes(HWND hWnd, WindowInformation &wndInfo);
+    void GetTitle(HWND hWnd, LPWSTR title, size_t cchTitle);
+    void UpdateTitle(HWND hWnd);
+    void ApplyWindowStateChanges();
 }
 
 
@@ -80,6 +176,9 @@ void WindowManager::Start()
     ASSERT(!isStarted);
     isStarted = true;
 
+    // Titles are kept up to date through nCore's window state from here on.
+    windowStateVersion = nCore::FetchWindowState().GetVersion();
+
     // Get the currently active window
     SetActive(GetForegroundWindow());
 
@@ -89,7 +188,17 @@ void WindowManager::Start()
     {
         SetTimer(gLSModule.GetMessageWindow(), TIMER_CHECKMONITOR, 250, nullptr);
     }
-    SetTimer(gLSModule.GetMessageWindow(), TIMER_MAINTENANCE, 250, nullptr);
+    SetTimer(gLSModule.GetMessageWindow(), TIMER_CONSISTENCY, consistencyInterval, nullptr);
+
+    InitializeThreadpoolEnvironment(&hashEnvironment);
+    hashCleanupGroup = CreateThreadpoolCleanupGroup();
+    if (hashCleanupGroup != nullptr)
+    {
+        SetThreadpoolCallbackCleanupGroup(&hashEnvironment, hashCleanupGroup, nullptr);
+    }
+
+    nCore::System::RegisterCounters(L"nTask.Maintenance", ReportMaintenanceCounters);
+    nCore::System::RegisterCounters(L"nTask.Icons", ReportIconCounters);
 
     SendMessage(LiteStep::GetLitestepWnd(), LM_REGISTERMESSAGE, (WPARAM)gLSModule.GetMessageWindow(), (LPARAM)gWMMessages);
 }
@@ -108,7 +217,28 @@ void WindowManager::Stop()
     SendMessage(LiteStep::GetLitestepWnd(), LM_UNREGISTERMESSAGE, (WPARAM)gLSModule.GetMessageWindow(), (LPARAM)gWMMessages);
     KillTimer(gLSModule.GetMessageWindow(), TIMER_CHECKMONITOR);
     KillTimer(gLSModule.GetMessageWindow(), TIMER_MAINTENANCE);
+    KillTimer(gLSModule.GetMessageWindow(), TIMER_CONSISTENCY);
+    nCore::System::UnRegisterCounters(L"nTask.Maintenance");
+    nCore::System::UnRegisterCounters(L"nTask.Icons");
+
+    // Wait for the icons which are being hashed, and drop their results.
+    if (hashCleanupGroup != nullptr)
+    {
+        CloseThreadpoolCleanupGroupMembers(hashCleanupGroup, FALSE, nullptr);
+        CloseThreadpoolCleanupGroup(hashCleanupGroup);
+        hashCleanupGroup = nullptr;
+    }
+    DestroyThreadpoolEnvironment(&hashEnvironment);
+    MSG msg;
+    while (PeekMessage(&msg, gLSModule.GetMessageWindow(), WM_ICON_HASHED, WM_ICON_HASHED, PM_REMOVE))
+    {
+        IconHashRequest *request = (IconHashRequest*)msg.lParam;
+        DestroyIcon(request->icon);
+        delete request;
+    }
     activeWindow = nullptr;
+    pendingWork.Clear();
+    pendingRedraws.clear();
     windowMap.clear();
     isStarted = false;
     initializing = true;
@@ -128,7 +258,7 @@ void WindowManager::AddWindow(HWND hWnd)
     {
         // Get the title here, we want to display it in the trace.
         WCHAR title[MAX_LINE_LENGTH];
-        GetWindowTextW(hWnd, title, _countof(title));
+        GetTitle(hWnd, title, _countof(title));
 
         // Make sure we don't already have this window in the map.
         if (windowMap.find(hWnd) != windowMap.end())
@@ -142,17 +272,20 @@ void WindowManager::AddWindow(HWND hWnd)
         wndInfo.uMonitor = nCore::FetchMonitorInfo().MonitorFromHWND(hWnd);
         wndInfo.lastUpdateTime = GetTickCount64();
         wndInfo.updateDuringMaintenance = false;
+        wndInfo.checkMinimized = false;
+        wndInfo.isMinimized = IsIconic(hWnd) != FALSE;
 
         // Add it to any taskbar that wants it
         for (TaskbarMap::value_type &taskbar : gTaskbars)
         {
-            TaskButton *taskButton = taskbar.second.AddTask(hWnd, wndInfo.uMonitor, initializing);
+            ButtonRef ref = { &taskbar.second };
+            TaskButton *taskButton = taskbar.second.AddTask(hWnd, wndInfo.uMonitor, initializing, ref.handle);
 
             // If the taskbar created a button for this window
             if (taskButton != nullptr)
             {
                 // Add it to our list of buttons
-                wndInfo.buttons.push_back(taskButton);
+                wndInfo.buttons.push_back(ref);
 
                 // Set the icon and text of the window.
                 taskButton->SetText(title);
@@ -163,6 +296,29 @@ void WindowManager::AddWindow(HWND hWnd)
 }
 
 
+/// <summary>
+/// Forgets the buttons a taskbar which is being destroyed had, so that no window refers to it.
+/// </summary>
+void WindowManager::TaskbarDestroyed(const Taskbar *taskbar)
+{
+    // Nothing refers to taskbars while we are stopped. This also keeps us away from windowMap
+    // during static destruction.
+    if (!isStarted)
+    {
+        return;
+    }
+
+    for (WindowMap::value_type &window : windowMap)
+    {
+        std::vector<ButtonRef> &buttons = window.second.buttons;
+        buttons.erase(std::remove_if(buttons.begin(), buttons.end(), [taskbar] (const ButtonRef &ref)
+        {
+            return ref.taskbar == taskbar;
+        }), buttons.end());
+    }
+}
+
+
 /// <summary>
 /// Removes/Adds the specified window to taskbars, based on the monitor change.
 /// </summary>
@@ -174,35 +330,39 @@ void WindowManager::MonitorChanged(HWND hWnd, UINT monitor)
     WindowMap::iterator iter = windowMap.find(hWnd);
     if (iter != windowMap.end())
     {
+        WindowInformation &wndInfo = iter->second;
         WCHAR title[MAX_LINE_LENGTH];
-        GetWindowTextW(hWnd, title, _countof(title));
-        iter->second.uMonitor = monitor;
+        GetTitle(hWnd, title, _countof(title));
+        wndInfo.uMonitor = monitor;
 
         for (TaskbarMap::value_type &taskbar : gTaskbars)
         {
-            TaskButton *out;
-            if (taskbar.second.MonitorChanged(hWnd, monitor, &out))
+            // Find the button this window has on the taskbar, if any.
+            Taskbar *target = &taskbar.second;
+            auto ref = std::find_if(wndInfo.buttons.begin(), wndInfo.buttons.end(), [target] (const ButtonRef &candidate)
             {
-                if (out != nullptr)
-                {
-                    iter->second.buttons.push_back(out);
-                    out->SetIcon(iter->second.hIcon);
-                    if (iter->second.hOverlayIcon != nullptr)
-                    {
-                        out->SetOverlayIcon(iter->second.hOverlayIcon);
-                    }
-                    out->SetText(title);
-                }
+                return candidate.taskbar == target;
+            });
+
+            if (ref == wndInfo.buttons.end())
+            {
+                ButtonRef empty = { target };
+                ref = wndInfo.buttons.insert(ref, empty);
             }
-            else
+
+            TaskButton *out = target->MonitorChanged(hWnd, monitor, ref->handle);
+            if (out != nullptr)
             {
-                if (out != nullptr)
+                out->SetIcon(wndInfo.hIcon);
+                if (wndInfo.hOverlayIcon != nullptr)
                 {
-                    iter->second.buttons.remove_if([out] (TaskButton *btn)
-                    {
-                        return btn == out;
-                    });
+                    out->SetOverlayIcon(wndInfo.hOverlayIcon);
                 }
+                out->SetText(title);
+            }
+            else if (target->GetButton(ref->handle) == nullptr)
+            {
+                wndInfo.buttons.erase(ref);
             }
         }
     }
@@ -225,10 +385,14 @@ void WindowManager::SetActive(HWND hWnd)
     WindowMap::iterator iter = windowMap.find(activeWindow);
     if (iter != windowMap.end())
     {
-        for (TaskButton* button : iter->second.buttons)
+        ForEachButton(iter->second, [] (TaskButton *button)
         {
             button->Deactivate();
-        }
+        });
+
+        // Windows are frequently deactivated because they are being minimized.
+        iter->second.checkMinimized = true;
+        QueueWork(activeWindow, Work::CheckMinimized, GetTickCount64() + stateCheckDelay);
     }
 
     // Swap the active window
@@ -238,10 +402,11 @@ void WindowManager::SetActive(HWND hWnd)
     iter = windowMap.find(activeWindow);
     if (iter != windowMap.end())
     {
-        for (TaskButton* button : iter->second.buttons)
+        ForEachButton(iter->second, [] (TaskButton *button)
         {
             button->Activate();
-        }
+        });
+        iter->second.isMinimized = false;
     }
     else if (IsTaskbarWindow(hWnd)) // Steam...
     {
@@ -255,13 +420,14 @@ void WindowManager::SetActive(HWND hWnd)
 /// </summary>
 void WindowManager::MarkAsMinimized(HWND hWnd)
 {
-    WindowMap::const_iterator iter = windowMap.find(hWnd);
+    WindowMap::iterator iter = windowMap.find(hWnd);
     if (iter != windowMap.end())
     {
-        for (TaskButton *button : iter->second.buttons)
+        ForEachButton(iter->second, [] (TaskButton *button)
         {
             button->ActivateState(TaskButton::State::Minimized);
-        }
+        });
+        iter->second.isMinimized = true;
     }
 }
 
@@ -278,9 +444,9 @@ void WindowManager::RemoveWindow(HWND hWnd)
     if (iter != windowMap.end())
     {
         // Remove all buttons
-        for (TaskbarMap::value_type &taskbar : gTaskbars)
+        for (const ButtonRef &ref : iter->second.buttons)
         {
-            taskbar.second.RemoveTask(hWnd);
+            ref.taskbar->RemoveTask(ref.handle);
         }
 
         if (iter->second.hOverlayIcon != nullptr)
@@ -288,6 +454,9 @@ void WindowManager::RemoveWindow(HWND hWnd)
             DestroyIcon(iter->second.hOverlayIcon);
         }
 
+        pendingWork.Cancel(PendingWork(hWnd, Work::Update));
+        pendingWork.Cancel(PendingWork(hWnd, Work::CheckMinimized));
+        pendingWork.Cancel(PendingWork(hWnd, Work::Validate));
         windowMap.erase(iter);
     }
     else
@@ -303,7 +472,7 @@ void WindowManager::RemoveWindow(HWND hWnd)
 
 
 /// <summary>
-/// Updates the text and icon of the specified window.
+/// Updates the icon of the specified window. The text follows nCore's window state.
 /// </summary>
 void WindowManager::UpdateWindow(HWND hWnd, LPARAM lParam)
 {
@@ -317,29 +486,22 @@ void WindowManager::UpdateWindow(HWND hWnd, LPARAM lParam)
         // installer). We can't render that fast, and end up locking up the shell with our backlog
         // of HSHELL_REDRAW messages. Therefore, if we get called too frequently, we just defer the
         // update until the next maintenance cycle.
-        if (GetTickCount64() - iter->second.lastUpdateTime < 100) {
+        if (GetTickCount64() - iter->second.lastUpdateTime < minUpdateInterval) {
             iter->second.updateDuringMaintenance = true;
+            QueueWork(hWnd, Work::Update, iter->second.lastUpdateTime + minUpdateInterval);
             return;
         }
 
-        // Update the text
-        WCHAR title[MAX_LINE_LENGTH];
-        GetWindowTextW(hWnd, title, _countof(title));
-        for (TaskButton *button : iter->second.buttons)
-        {
-            button->SetText(title);
-        }
-
         // Update the icon
         UpdateIcon(hWnd);
 
         // Check if we should be flashing
         if (lParam == HSHELL_HIGHBIT)
         {
-            for (TaskButton *button : iter->second.buttons)
+            ForEachButton(iter->second, [] (TaskButton *button)
             {
                 button->Flash();
-            }
+            });
         }
 
         iter->second.lastUpdateTime = GetTickCount64();
@@ -365,10 +527,17 @@ LRESULT WindowManager::GetMinRect(HWND hWnd, LPPOINTS lpPoints)
     ASSERT(isStarted);
 
     WindowMap::const_iterator iter = windowMap.find(hWnd);
-    if (iter != windowMap.end() && !iter->second.buttons.empty())
+    if (iter != windowMap.end())
     {
-        iter->second.buttons.front()->GetMinRect(lpPoints);
-        return 1;
+        for (const ButtonRef &ref : iter->second.buttons)
+        {
+            TaskButton *button = ref.taskbar->GetButton(ref.handle);
+            if (button != nullptr)
+            {
+                button->GetMinRect(lpPoints);
+                return 1;
+            }
+        }
     }
     return 0;
 }
@@ -426,6 +595,14 @@ LRESULT WindowManager::ShellMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
                 // The window is being minimized, might as well give the button a hint.
                 MarkAsMinimized((HWND)wParam);
             }
+
+            // Either way, check the real state once the animation is over.
+            WindowMap::iterator iter = windowMap.find((HWND)wParam);
+            if (iter != windowMap.end())
+            {
+                iter->second.checkMinimized = true;
+                QueueWork((HWND)wParam, Work::CheckMinimized, GetTickCount64() + stateCheckDelay);
+            }
         }
         return GetMinRect((HWND)wParam, (LPPOINTS)lParam);
 
@@ -438,7 +615,20 @@ LRESULT WindowManager::ShellMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
         // Text/Icon/Blinking change
     case LM_REDRAW:
         {
-            UpdateWindow((HWND)wParam, lParam);
+            QueueRedraw((HWND)wParam, lParam);
+        }
+        return 0;
+
+        // Carry out the LM_REDRAWs received since the last flush
+    case WM_FLUSH_REDRAWS:
+        {
+            FlushRedraws();
+        }
+        return 0;
+
+    case WM_ICON_HASHED:
+        {
+            IconHashed((IconHashRequest*)lParam);
         }
         return 0;
 
@@ -484,6 +674,13 @@ LRESULT WindowManager::ShellMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
         }
         return 0;
 
+        // nCore has looked at some windows again.
+    case NCORE_WINDOWSTATECHANGE:
+        {
+            ApplyWindowStateChanges();
+        }
+        return 0;
+
         // The display layout has changed.
     case NCORE_DISPLAYCHANGE:
         {
@@ -504,6 +701,12 @@ LRESULT WindowManager::ShellMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
                 return 0;
 
             case TIMER_MAINTENANCE:
+                {
+                    ProcessPendingWork();
+                }
+                return 0;
+
+            case TIMER_CONSISTENCY:
                 {
                     RunWindowMaintenance();
                 }
@@ -587,23 +790,44 @@ bool WindowManager::IsTaskbarWindow(HWND hWnd)
 
 
 /// <summary>
-/// Updates the icon of a particular HWND
+/// Updates the icon of a particular HWND. Takes ownership of hIcon, which must be a copy.
 /// </summary>
-void WindowManager::SetIcon(HWND hWnd, HICON hIcon)
+void WindowManager::SetIcon(HWND hWnd, HICON hIcon, UINT64 hash)
 {
     WindowMap::iterator window = windowMap.find(hWnd);
-    if (window != windowMap.end())
+    if (window == windowMap.end())
     {
-        for (TaskButton *button : window->second.buttons)
+        if (hIcon != nullptr)
         {
-            button->SetIcon(hIcon);
+            DestroyIcon(hIcon);
+        }
+    }
+    else
+    {
+        // Applications frequently re-send the icon they already have. Don't re-render the buttons
+        // when nothing changed.
+        if (hash != 0 && hash == window->second.iconHash && window->second.hIcon != nullptr)
+        {
+            ++window->second.iconStats.dedupeHits;
+            ++iconStats.dedupeHits;
+            if (hIcon != nullptr)
+            {
+                DestroyIcon(hIcon);
+            }
+            return;
         }
+        window->second.iconHash = hash;
+
+        ForEachButton(window->second, [hIcon] (TaskButton *button)
+        {
+            button->SetIcon(hIcon);
+        });
         if (window->second.hIcon != nullptr)
         {
             DestroyIcon(window->second.hIcon);
         }
 
-        window->second.hIcon = CopyIcon(hIcon);
+        window->second.hIcon = hIcon;
     }
 }
 
@@ -616,10 +840,10 @@ void WindowManager::SetOverlayIcon(HWND hWnd, HICON overlayIcon)
     WindowMap::iterator window = windowMap.find(hWnd);
     if (window != windowMap.end())
     {
-        for (TaskButton *button : window->second.buttons)
+        ForEachButton(window->second, [overlayIcon] (TaskButton *button)
         {
             button->SetOverlayIcon(overlayIcon);
-        }
+        });
         if (window->second.hOverlayIcon != nullptr)
         {
             DestroyIcon(window->second.hOverlayIcon);
@@ -638,10 +862,10 @@ void WindowManager::SetProgressState(HWND hWnd, TBPFLAG state)
     WindowMap::iterator window = windowMap.find(hWnd);
     if (window != windowMap.end())
     {
-        for (TaskButton *button : window->second.buttons)
+        ForEachButton(window->second, [state] (TaskButton *button)
         {
             button->SetProgressState(state);
-        }
+        });
         window->second.progressState = state;
     }
 }
@@ -655,64 +879,298 @@ void WindowManager::SetProgressValue(HWND hWnd, USHORT progress)
     WindowMap::iterator window = windowMap.find(hWnd);
     if (window != windowMap.end())
     {
-        for (TaskButton *button : window->second.buttons)
+        ForEachButton(window->second, [progress] (TaskButton *button)
         {
             button->SetProgressValue(progress);
-        }
+        });
         window->second.progress = progress;
     }
 }
 
 
 /// <summary>
-/// Updates the icon of a particular HWND
+/// Receives the answer to one of the WM_GETICON probes sent by UpdateIcon.
 /// </summary>
 void CALLBACK WindowManager::UpdateIconCallback(HWND hWnd, UINT uMsg, ULONG_PTR dwData, LRESULT lResult)
 {
     // We really only expect WM_GETICON messages.
-    if (uMsg == WM_GETICON)
+    if (uMsg != WM_GETICON)
     {
-        // If we got an icon back, use it.
-        if (lResult != 0)
+        return;
+    }
+
+    WindowMap::iterator iter = windowMap.find(hWnd);
+    if (iter == windowMap.end())
+    {
+        return;
+    }
+
+    // Ignore answers to probes from an earlier batch.
+    WindowInformation &wndInfo = iter->second;
+    UINT probe = UINT(dwData & 3);
+    if (!wndInfo.iconFetchInFlight || UINT(dwData >> 2) != (wndInfo.iconGeneration & (UINT_MAX >> 2)) || probe > 2)
+    {
+        return;
+    }
+
+    wndInfo.iconProbes[probe] = (HICON)lResult;
+    wndInfo.iconProbesAnswered |= 1 << probe;
+    ResolveIconProbes(hWnd, wndInfo);
+}
+
+
+/// <summary>
+/// Picks the icon once the best available probe answer is known. ICON_BIG is preferred over
+/// ICON_SMALL, which is preferred over ICON_SMALL2, which is preferred over the class icons.
+/// </summary>
+void WindowManager::ResolveIconProbes(HWND hWnd, WindowInformation &wndInfo)
+{
+    HICON hIcon = nullptr;
+    for (UINT i = 0; i < _countof(wndInfo.iconProbes); ++i)
+    {
+        if ((wndInfo.iconProbesAnswered & (1 << i)) == 0)
         {
-            SetIcon(hWnd, (HICON)lResult);
+            // A better answer may still arrive.
+            return;
         }
-        else switch (dwData)
+        if (wndInfo.iconProbes[i] != nullptr)
         {
-        case ICON_BIG:
-            {
-                SendMessageCallback(hWnd, WM_GETICON, ICON_SMALL, NULL, UpdateIconCallback, ICON_SMALL);
-            }
+            hIcon = wndInfo.iconProbes[i];
             break;
+        }
+    }
 
-        case ICON_SMALL:
-            {
-                SendMessageCallback(hWnd, WM_GETICON, ICON_SMALL2, NULL, UpdateIconCallback, ICON_SMALL2);
-            }
-            break;
+    if (hIcon == nullptr)
+    {
+        hIcon = (HICON)GetClassLongPtr(hWnd, GCLP_HICON);
+        if (hIcon == nullptr)
+        {
+            hIcon = (HICON)GetClassLongPtr(hWnd, GCLP_HICONSM);
+        }
+    }
 
-        case ICON_SMALL2:
-            {
-                HICON hIcon;
-                hIcon = (HICON)GetClassLongPtr(hWnd, GCLP_HICON);
-                if (hIcon == nullptr)
-                {
-                    hIcon = (HICON)GetClassLongPtr(hWnd, GCLP_HICONSM);
-                }
-                SetIcon(hWnd, hIcon);
-            }
-            break;
+    wndInfo.iconFetchInFlight = false;
+
+    // Hashing reads back the icon bitmaps, which is too slow for this thread. The copy belongs
+    // to the request until it is handed to SetIcon.
+    IconHashRequest *request = new IconHashRequest;
+    request->hWnd = hWnd;
+    request->generation = wndInfo.iconGeneration;
+    request->icon = hIcon != nullptr ? CopyIcon(hIcon) : nullptr;
+    request->hash = 0;
+    if (hashCleanupGroup == nullptr || !TrySubmitThreadpoolCallback(HashIconCallback, request, &hashEnvironment))
+    {
+        request->hash = Hashing::HashIcon(request->icon);
+        IconHashed(request);
+    }
+}
+
+
+/// <summary>
+/// Hashes an icon on the thread pool, and posts the result back to the message window.
+/// </summary>
+void CALLBACK WindowManager::HashIconCallback(PTP_CALLBACK_INSTANCE, PVOID context)
+{
+    IconHashRequest *request = (IconHashRequest*)context;
+    request->hash = Hashing::HashIcon(request->icon);
+    if (!PostMessage(gLSModule.GetMessageWindow(), WM_ICON_HASHED, 0, (LPARAM)request))
+    {
+        if (request->icon != nullptr)
+        {
+            DestroyIcon(request->icon);
         }
+        delete request;
     }
 }
 
 
 /// <summary>
-/// Updates the icon of a particular HWND
+/// Applies a hashed icon, unless a newer fetch has been started for the window since.
+/// </summary>
+void WindowManager::IconHashed(IconHashRequest *request)
+{
+    WindowMap::iterator iter = windowMap.find(request->hWnd);
+    if (iter == windowMap.end() || iter->second.iconGeneration != request->generation)
+    {
+        if (request->icon != nullptr)
+        {
+            DestroyIcon(request->icon);
+        }
+    }
+    else
+    {
+        SetIcon(request->hWnd, request->icon, request->hash);
+        if (iter->second.iconRefetch && !iter->second.iconFetchInFlight)
+        {
+            UpdateIcon(request->hWnd);
+        }
+    }
+    delete request;
+}
+
+
+/// <summary>
+/// Updates the icon of a particular HWND. All three WM_GETICON probes are sent at once, rather
+/// than one after the other. If a fetch is already in flight, another one is made once it's done.
 /// </summary>
 void WindowManager::UpdateIcon(HWND hWnd)
 {
-    SendMessageCallback(hWnd, WM_GETICON, ICON_BIG, NULL, UpdateIconCallback, ICON_BIG);
+    static const WPARAM probeTypes[] = { ICON_BIG, ICON_SMALL, ICON_SMALL2 };
+
+    WindowMap::iterator iter = windowMap.find(hWnd);
+    if (iter == windowMap.end())
+    {
+        return;
+    }
+
+    WindowInformation &wndInfo = iter->second;
+    ULONGLONG now = GetTickCount64();
+    if (wndInfo.iconFetchInFlight)
+    {
+        if (now - wndInfo.iconFetchTime < iconFetchTimeout)
+        {
+            wndInfo.iconRefetch = true;
+            ++wndInfo.iconStats.coalesced;
+            ++iconStats.coalesced;
+            return;
+        }
+
+        // The window never answered. Give up on those probes; answers to them are ignored once
+        // the generation moves on.
+        ++wndInfo.iconStats.timeouts;
+        ++iconStats.timeouts;
+    }
+
+    if (wndInfo.iconStats.fetches++ == 0)
+    {
+        wndInfo.iconStats.firstFetchTime = now;
+    }
+    if (iconStats.fetches++ == 0)
+    {
+        iconStats.firstFetchTime = now;
+    }
+
+    wndInfo.iconFetchInFlight = true;
+    wndInfo.iconFetchTime = now;
+    wndInfo.iconRefetch = false;
+    wndInfo.iconProbesAnswered = 0;
+    ++wndInfo.iconGeneration;
+
+    UINT failures = 0;
+    for (UINT i = 0; i < _countof(probeTypes); ++i)
+    {
+        wndInfo.iconProbes[i] = nullptr;
+        ULONG_PTR data = ULONG_PTR(wndInfo.iconGeneration & (UINT_MAX >> 2)) << 2 | i;
+        if (!SendMessageCallback(hWnd, WM_GETICON, probeTypes[i], NULL, UpdateIconCallback, data))
+        {
+            wndInfo.iconProbesAnswered |= 1 << i;
+            ++failures;
+        }
+    }
+
+    if (failures == _countof(probeTypes))
+    {
+        // The window has most likely been destroyed. Check up on it.
+        wndInfo.iconFetchInFlight = false;
+        QueueWork(hWnd, Work::Validate, now);
+    }
+}
+
+
+/// <summary>
+/// Records an LM_REDRAW. All LM_REDRAWs received for a window before the next flush are handled
+/// as one.
+/// </summary>
+void WindowManager::QueueRedraw(HWND hWnd, LPARAM lParam)
+{
+    ++iconStats.redraws;
+
+    WindowMap::iterator iter = windowMap.find(hWnd);
+    if (iter != windowMap.end())
+    {
+        ++iter->second.iconStats.redraws;
+    }
+
+    if (pendingRedraws.empty())
+    {
+        PostMessage(gLSModule.GetMessageWindow(), WM_FLUSH_REDRAWS, 0, 0);
+    }
+
+    auto inserted = pendingRedraws.emplace(hWnd, lParam);
+    if (!inserted.second)
+    {
+        inserted.first->second |= lParam;
+        ++iconStats.coalesced;
+        if (iter != windowMap.end())
+        {
+            ++iter->second.iconStats.coalesced;
+        }
+    }
+}
+
+
+/// <summary>
+/// Carries out all queued LM_REDRAWs, painting each taskbar at most once.
+/// </summary>
+void WindowManager::FlushRedraws()
+{
+    if (pendingRedraws.empty())
+    {
+        return;
+    }
+
+    std::unordered_map<HWND, LPARAM> redraws;
+    redraws.swap(pendingRedraws);
+
+    std::list<Window::UpdateLock> updateLocks;
+    for (auto &taskbar : gTaskbars)
+    {
+        updateLocks.emplace_back(taskbar.second.GetWindow());
+    }
+
+    for (auto &redraw : redraws)
+    {
+        UpdateWindow(redraw.first, redraw.second);
+    }
+}
+
+
+/// <summary>
+/// Returns the icon counters across all windows.
+/// </summary>
+const WindowManager::IconStats &WindowManager::GetIconStats()
+{
+    return iconStats;
+}
+
+
+/// <summary>
+/// Retrieves the icon counters for the specified window.
+/// </summary>
+/// <returns>False if the window is not known.</returns>
+bool WindowManager::GetIconStats(HWND hWnd, IconStats &stats)
+{
+    WindowMap::const_iterator iter = windowMap.find(hWnd);
+    if (iter == windowMap.end())
+    {
+        return false;
+    }
+    stats = iter->second.iconStats;
+    return true;
+}
+
+
+/// <summary>
+/// Returns the number of icon fetches per minute since the first fetch.
+/// </summary>
+double WindowManager::GetIconFetchRate(const IconStats &stats)
+{
+    if (stats.fetches == 0)
+    {
+        return 0.0;
+    }
+    ULONGLONG elapsed = GetTickCount64() - stats.firstFetchTime;
+    return stats.fetches * 60000.0 / std::max(elapsed, ULONGLONG(1000));
 }
 
 
@@ -721,6 +1179,8 @@ void WindowManager::UpdateIcon(HWND hWnd)
 /// </summary>
 void WindowManager::AddExisting()
 {
+    // Which windows get buttons is up to nTasks' own IsTaskbarWindow, so enumerate them here
+    // rather than going by nCore's window state.
     thread([] () -> void
     {
         EnumDesktopWindows(nullptr, (WNDENUMPROC)[] (HWND window, LPARAM) -> BOOL
@@ -738,7 +1198,214 @@ void WindowManager::AddExisting()
 
 
 /// <summary>
-/// Removes any invalid windows, and rechecks the minimized state of windows.
+/// Retrieves the title of a window from nCore's window state, or from the window itself if nCore
+/// hasn't seen it yet.
+/// </summary>
+void WindowManager::GetTitle(HWND hWnd, LPWSTR title, size_t cchTitle)
+{
+    if (!nCore::FetchWindowTitle(hWnd, title, UINT(cchTitle)))
+    {
+        GetWindowTextW(hWnd, title, int(cchTitle));
+    }
+}
+
+
+/// <summary>
+/// Sets the text of the buttons for the specified window to its title.
+/// </summary>
+void WindowManager::UpdateTitle(HWND hWnd)
+{
+    WindowMap::iterator iter = windowMap.find(hWnd);
+    WCHAR title[MAX_LINE_LENGTH];
+    if (iter != windowMap.end() && nCore::FetchWindowTitle(hWnd, title, _countof(title)))
+    {
+        ForEachButton(iter->second, [&title] (TaskButton *button)
+        {
+            button->SetText(title);
+        });
+    }
+}
+
+
+/// <summary>
+/// Updates the buttons of the windows whose titles changed since the last call.
+/// </summary>
+void WindowManager::ApplyWindowStateChanges()
+{
+    const WindowStateTable &windowState = nCore::FetchWindowState();
+
+    std::vector<WindowStateTable::Change> changes;
+    std::vector<HWND> retitled;
+    if (windowState.ReadChanges(windowStateVersion, changes))
+    {
+        for (const WindowStateTable::Change &change : changes)
+        {
+            if (change.type == WindowStateTable::ChangeType::Added ||
+                change.type == WindowStateTable::ChangeType::Modified && (change.fields & WindowState::TitleChanged) != 0)
+            {
+                retitled.push_back(change.key);
+            }
+        }
+        std::sort(retitled.begin(), retitled.end());
+        retitled.erase(std::unique(retitled.begin(), retitled.end()), retitled.end());
+    }
+    else
+    {
+        // We fell too far behind, go over every window.
+        for (WindowMap::value_type &window : windowMap)
+        {
+            retitled.push_back(window.first);
+        }
+    }
+
+    if (retitled.empty())
+    {
+        return;
+    }
+
+    std::list<Window::UpdateLock> updateLocks;
+    for (auto &taskbar : gTaskbars)
+    {
+        updateLocks.emplace_back(taskbar.second.GetWindow());
+    }
+
+    for (HWND hWnd : retitled)
+    {
+        UpdateTitle(hWnd);
+    }
+}
+
+
+/// <summary>
+/// Schedules a piece of work on the specified window during maintenance.
+/// </summary>
+void WindowManager::QueueWork(HWND hWnd, Work work, ULONGLONG deadline)
+{
+    pendingWork.Schedule(PendingWork(hWnd, work), deadline);
+    ScheduleMaintenance();
+}
+
+
+/// <summary>
+/// Sets the maintenance timer to fire when the earliest pending work is due, or kills it if there
+/// is nothing to do.
+/// </summary>
+void WindowManager::ScheduleMaintenance()
+{
+    ULONGLONG deadline;
+    if (!pendingWork.NextDeadline(deadline))
+    {
+        KillTimer(gLSModule.GetMessageWindow(), TIMER_MAINTENANCE);
+        return;
+    }
+
+    ULONGLONG now = GetTickCount64();
+    UINT delay = deadline > now ? UINT(std::min(deadline - now, ULONGLONG(consistencyInterval))) : 0;
+    SetTimer(gLSModule.GetMessageWindow(), TIMER_MAINTENANCE, std::max(delay, UINT(USER_TIMER_MINIMUM)), nullptr);
+}
+
+
+/// <summary>
+/// Brings the minimized state of the buttons for the specified window in line with the window.
+/// </summary>
+/// <returns>True if the state had to be changed.</returns>
+bool WindowManager::SyncMinimizedState(HWND hWnd, WindowInformation &wndInfo)
+{
+    bool minimized = IsIconic(hWnd) != FALSE;
+    ForEachButton(wndInfo, [minimized] (TaskButton *button)
+    {
+        if (minimized)
+        {
+            button->ActivateState(TaskButton::State::Minimized);
+        }
+        else
+        {
+            button->ClearState(TaskButton::State::Minimized);
+        }
+    });
+
+    bool changed = minimized != wndInfo.isMinimized;
+    wndInfo.isMinimized = minimized;
+    return changed;
+}
+
+
+/// <summary>
+/// Carries out all pending work which is due. Only windows with deferred updates, state checks,
+/// or which are suspected to have been destroyed are visited.
+/// </summary>
+void WindowManager::ProcessPendingWork()
+{
+    // Check that we are currently running
+    ASSERT(isStarted);
+
+    ULONGLONG now = GetTickCount64();
+    std::list<Window::UpdateLock> updateLocks;
+    vector<HWND> removals;
+    UINT visited = 0;
+
+    PendingWork work;
+    while (pendingWork.PopDue(now, work))
+    {
+        HWND hWnd = work.first;
+
+        // Prevent all taskbars from painting during the update.
+        if (updateLocks.empty())
+        {
+            for (auto &taskbar : gTaskbars)
+            {
+                updateLocks.emplace_back(taskbar.second.GetWindow());
+            }
+        }
+
+        ++visited;
+        WindowMap::iterator iter = windowMap.find(hWnd);
+        if (iter == windowMap.end())
+        {
+            continue;
+        }
+
+        if (!IsWindow(hWnd))
+        {
+            // The window may have had several kinds of work pending.
+            if (std::find(removals.begin(), removals.end(), hWnd) == removals.end())
+            {
+                removals.push_back(hWnd);
+            }
+            continue;
+        }
+
+        if (work.second == Work::Update && iter->second.updateDuringMaintenance)
+        {
+            ++maintenanceStats.updates;
+            UpdateWindow(hWnd, 0);
+        }
+
+        if (work.second == Work::CheckMinimized && iter->second.checkMinimized)
+        {
+            ++maintenanceStats.stateChecks;
+            iter->second.checkMinimized = false;
+            SyncMinimizedState(hWnd, iter->second);
+        }
+    }
+
+    for (HWND removal : removals)
+    {
+        RemoveWindow(removal);
+    }
+
+    ++maintenanceStats.passes;
+    maintenanceStats.lastVisited = visited;
+    maintenanceStats.visited += visited;
+    maintenanceStats.removals += removals.size();
+
+    ScheduleMaintenance();
+}
+
+
+/// <summary>
+/// Sweeps over every window, removing any invalid windows and rechecking the minimized state.
+/// This only catches what the shell events missed, so it runs rarely.
 /// </summary>
 void WindowManager::RunWindowMaintenance()
 {
@@ -746,14 +1413,14 @@ void WindowManager::RunWindowMaintenance()
     ASSERT(isStarted);
 
     // Prevent all taskbars from painting during the update.
-    std::vector<Window::UpdateLock*> updateLocks(gTaskbars.size());
-    int i = 0;
+    std::list<Window::UpdateLock> updateLocks;
     for (auto &taskbar : gTaskbars)
     {
-        updateLocks[i++] = new Window::UpdateLock(taskbar.second.GetWindow());
+        updateLocks.emplace_back(taskbar.second.GetWindow());
     }
 
     vector<HWND> removals;
+    UINT corrections = 0;
     for (WindowMap::iterator iter = windowMap.begin(); iter != windowMap.end(); iter++)
     {
         if (!IsWindow(iter->first))
@@ -766,16 +1433,9 @@ void WindowManager::RunWindowMaintenance()
             {
                 UpdateWindow(iter->first, 0);
             }
-            for (TaskButton *button : iter->second.buttons)
+            if (SyncMinimizedState(iter->first, iter->second))
             {
-                if (IsIconic(iter->first))
-                {
-                    button->ActivateState(TaskButton::State::Minimized);
-                }
-                else
-                {
-                    button->ClearState(TaskButton::State::Minimized);
-                }
+                ++corrections;
             }
         }
     }
@@ -784,9 +1444,70 @@ void WindowManager::RunWindowMaintenance()
         RemoveWindow(hwnd);
     }
 
-    // Clear update locks
-    for (Window::UpdateLock *updateLock : updateLocks)
+    ++maintenanceStats.sweeps;
+    maintenanceStats.lastVisited = UINT(windowMap.size() + removals.size());
+    maintenanceStats.visited += maintenanceStats.lastVisited;
+    maintenanceStats.removals += removals.size();
+    maintenanceStats.lastSweepCorrections = corrections + UINT(removals.size());
+
+    if (maintenanceStats.lastSweepCorrections != 0)
+    {
+        TRACE("Window maintenance sweep corrected %u windows", maintenanceStats.lastSweepCorrections);
+    }
+}
+
+
+/// <summary>
+/// Returns the counters for the work done during maintenance.
+/// </summary>
+const WindowManager::MaintenanceStats &WindowManager::GetMaintenanceStats()
+{
+    return maintenanceStats;
+}
+
+
+/// <summary>
+/// Reports the icon counters to nCore.
+/// </summary>
+void WindowManager::ReportIconCounters(COUNTERSINK report, LPVOID sink)
+{
+    const IconStats &stats = GetIconStats();
+    report(sink, L"redraws", double(stats.redraws));
+    report(sink, L"coalesced", double(stats.coalesced));
+    report(sink, L"fetches", double(stats.fetches));
+    report(sink, L"dedupeHits", double(stats.dedupeHits));
+    report(sink, L"timeouts", double(stats.timeouts));
+    report(sink, L"fetchRate", GetIconFetchRate(stats));
+
+    // The busiest windows are the interesting ones, so report per-window rates as well.
+    for (const WindowMap::value_type &window : windowMap)
     {
-        delete updateLock;
+        IconStats windowStats;
+        if (GetIconStats(window.first, windowStats) && windowStats.fetches != 0)
+        {
+            WCHAR name[64];
+            StringCchPrintfW(name, _countof(name), L"%p.fetchRate", window.first);
+            report(sink, name, GetIconFetchRate(windowStats));
+            StringCchPrintfW(name, _countof(name), L"%p.dedupeHits", window.first);
+            report(sink, name, double(windowStats.dedupeHits));
+        }
     }
 }
+
+
+/// <summary>
+/// Reports the maintenance counters to nCore.
+/// </summary>
+void WindowManager::ReportMaintenanceCounters(COUNTERSINK report, LPVOID sink)
+{
+    const MaintenanceStats &stats = GetMaintenanceStats();
+    report(sink, L"passes", double(stats.passes));
+    report(sink, L"sweeps", double(stats.sweeps));
+    report(sink, L"lastVisited", double(stats.lastVisited));
+    report(sink, L"visited", double(stats.visited));
+    report(sink, L"updates", double(stats.updates));
+    report(sink, L"stateChecks", double(stats.stateChecks));
+    report(sink, L"removals", double(stats.removals));
+    report(sink, L"lastSweepCorrections", double(stats.lastSweepCorrections));
+    report(sink, L"pending", double(pendingWork.Size()));
+}
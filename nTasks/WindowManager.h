@@ -8,18 +8,94 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <vector>
+#include "../Utilities/FlatMap.hpp"
 
 //
 typedef std::map<std::wstring, Taskbar> TaskbarMap;
 
 namespace WindowManager
 {
+    /// <summary>
+    /// Counters for icon updates.
+    /// </summary>
+    struct IconStats
+    {
+        // Number of LM_REDRAW messages received.
+        ULONGLONG redraws;
+
+        // Number of LM_REDRAW messages and icon requests folded into an already pending one.
+        ULONGLONG coalesced;
+
+        // Number of batches of WM_GETICON probes sent.
+        ULONGLONG fetches;
+
+        // Number of times a fetched icon was identical to the current one.
+        ULONGLONG dedupeHits;
+
+        // Number of batches of probes given up on, because the window didn't answer in time.
+        ULONGLONG timeouts;
+
+        // Tick count at the first fetch.
+        ULONGLONG firstFetchTime;
+    };
+
+    /// <summary>
+    /// A button on a particular taskbar.
+    /// </summary>
+    struct ButtonRef
+    {
+        Taskbar *taskbar;
+        Taskbar::ButtonHandle handle;
+    };
+
     /// <summary>
     /// Holds all information about a particular top level window.
     /// </summary>
     struct WindowInformation
     {
+        WindowInformation()
+            : uMonitor(0), hIcon(nullptr), hOverlayIcon(nullptr), progressState(TBPF_NOPROGRESS)
+            , progress(0), lastUpdateTime(0), updateDuringMaintenance(false), iconGeneration(0)
+            , iconProbesAnswered(0), iconFetchInFlight(false), iconFetchTime(0), iconRefetch(false)
+            , iconHash(0)
+            , checkMinimized(false), isMinimized(false)
+        {
+            ZeroMemory(iconProbes, sizeof(iconProbes));
+            ZeroMemory(&iconStats, sizeof(iconStats));
+        }
+
+        // WindowInformations are moved around within the WindowMap. The icons go with the
+        // information, so that they are destroyed exactly once.
+        WindowInformation(WindowInformation &&other)
+            : WindowInformation()
+        {
+            *this = std::move(other);
+        }
+
+        WindowInformation &operator=(WindowInformation &&other)
+        {
+            std::swap(hIcon, other.hIcon);
+            std::swap(hOverlayIcon, other.hOverlayIcon);
+            buttons.swap(other.buttons);
+            uMonitor = other.uMonitor;
+            progressState = other.progressState;
+            progress = other.progress;
+            lastUpdateTime = other.lastUpdateTime;
+            updateDuringMaintenance = other.updateDuringMaintenance;
+            iconGeneration = other.iconGeneration;
+            memcpy(iconProbes, other.iconProbes, sizeof(iconProbes));
+            iconProbesAnswered = other.iconProbesAnswered;
+            iconFetchInFlight = other.iconFetchInFlight;
+            iconFetchTime = other.iconFetchTime;
+            iconRefetch = other.iconRefetch;
+            iconHash = other.iconHash;
+            iconStats = other.iconStats;
+            checkMinimized = other.checkMinimized;
+            isMinimized = other.isMinimized;
+            return *this;
+        }
+
         ~WindowInformation()
         {
             if (hIcon != nullptr)
@@ -35,8 +111,8 @@ namespace WindowManager
         // The monitor this window is currently on
         UINT uMonitor;
 
-        // Pointers to the buttons that represent this window
-        std::list<TaskButton*> buttons;
+        // The buttons that represent this window, at most one per taskbar
+        std::vector<ButtonRef> buttons;
 
         // The main icon of the window
         HICON hIcon;
@@ -55,10 +131,70 @@ namespace WindowManager
 
         // True if this window should be updated during maintenance.
         bool updateDuringMaintenance;
+
+        // The generation of the current batch of WM_GETICON probes.
+        UINT iconGeneration;
+
+        // The answers to the ICON_BIG, ICON_SMALL, and ICON_SMALL2 probes.
+        HICON iconProbes[3];
+
+        // Bitmask of the probes which have been answered.
+        BYTE iconProbesAnswered;
+
+        // True while WM_GETICON probes are outstanding.
+        bool iconFetchInFlight;
+
+        // The tick count at which the outstanding probes were sent.
+        ULONGLONG iconFetchTime;
+
+        // True if the icon should be fetched again once the current probes are done.
+        bool iconRefetch;
+
+        // Hash of the pixels of hIcon.
+        UINT64 iconHash;
+
+        // Counters for this window's icon.
+        IconStats iconStats;
+
+        // True if the minimized state of this window should be rechecked during maintenance.
+        bool checkMinimized;
+
+        // The minimized state last applied to the buttons.
+        bool isMinimized;
+    };
+
+    /// <summary>
+    /// Counters describing the work done by window maintenance.
+    /// </summary>
+    struct MaintenanceStats
+    {
+        // Number of times pending work has been processed.
+        ULONGLONG passes;
+
+        // Number of full consistency sweeps over all windows.
+        ULONGLONG sweeps;
+
+        // Windows visited by the last pass or sweep.
+        UINT lastVisited;
+
+        // Total number of windows visited.
+        ULONGLONG visited;
+
+        // Deferred updates carried out.
+        ULONGLONG updates;
+
+        // Minimized state checks carried out.
+        ULONGLONG stateChecks;
+
+        // Windows removed because they no longer exist.
+        ULONGLONG removals;
+
+        // Windows whose state the last consistency sweep found to be out of date.
+        UINT lastSweepCorrections;
     };
 
     // Some helpful typedefs
-    typedef std::unordered_map<HWND, WindowInformation> WindowMap;
+    typedef FlatMap<HWND, WindowInformation> WindowMap;
 
     void Start();
     void Stop();
@@ -69,10 +205,13 @@ namespace WindowManager
     void AddWindow(HWND hWnd);
     void RemoveWindow(HWND hWnd);
     void MonitorChanged(HWND hWnd, UINT monitor);
+    void TaskbarDestroyed(const Taskbar *taskbar);
     LRESULT GetMinRect(HWND, LPPOINTS);
     void UpdateIcon(HWND hWnd);
     void CALLBACK UpdateIconCallback(HWND hWnd, UINT uMsg, ULONG_PTR dwData, LRESULT lResult);
-    void SetIcon(HWND, HICON);
+    void QueueRedraw(HWND hWnd, LPARAM lParam);
+    void FlushRedraws();
+    void SetIcon(HWND, HICON, UINT64 hash);
     void SetOverlayIcon(HWND hWnd, HICON hIcon);
     void SetProgressState(HWND hWnd, TBPFLAG state);
     void SetProgressValue(HWND hWnd, USHORT progress);
@@ -80,4 +219,9 @@ namespace WindowManager
     void UpdateWindowMonitors();
     void AddExisting();
     void RunWindowMaintenance();
+    void ProcessPendingWork();
+    const MaintenanceStats &GetMaintenanceStats();
+    const IconStats &GetIconStats();
+    bool GetIconStats(HWND hWnd, IconStats &stats);
+    double GetIconFetchRate(const IconStats &stats);
 }
@@ -25,7 +25,8 @@ LSModule gLSModule(TEXT(MODULE_NAME), TEXT(MODULE_AUTHOR), MakeVersion(MODULE_VE
 // The messages we want from the core
 const UINT gLSMessages[] = { LM_GETREVID, LM_REFRESH, LM_FULLSCREENACTIVATED,
     LM_FULLSCREENDEACTIVATED, 0 };
-const UINT sCoreMessages[] = { NCORE_DISPLAYCHANGE, NCORE_SETTINGCHANGE, 0 };
+const UINT sCoreMessages[] = { NCORE_DISPLAYCHANGE, NCORE_SETTINGCHANGE, NCORE_WINDOWSTATECHANGE,
+    0 };
 
 // All the taskbars we currently have loaded
 TaskbarMap gTaskbars;
@@ -65,6 +66,8 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
         TestWindow::Create();
     });
 
+    gLSModule.StartupCompleted();
+
     return 0;
 }
 
@@ -172,7 +175,10 @@ LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM
     case LM_WINDOWREPLACING:
     case LM_MONITORCHANGED:
     case NCORE_DISPLAYCHANGE:
+    case NCORE_WINDOWSTATECHANGE:
     case WM_ADDED_EXISTING:
+    case WM_FLUSH_REDRAWS:
+    case WM_ICON_HASHED:
     case LM_TASK_SETPROGRESSSTATE:
     case LM_TASK_SETPROGRESSVALUE:
     case LM_TASK_MARKASACTIVE:
@@ -0,0 +1,209 @@
+//-------------------------------------------------------------------------------------------------
+// /nTray/BalloonQueue.cpp
+// The nModules Project
+//
+// Decides which balloon notifications get shown, and in which order.
+//-------------------------------------------------------------------------------------------------
+#include "BalloonQueue.hpp"
+
+#include <algorithm>
+
+
+/// <summary>
+/// Constructor
+/// </summary>
+BalloonQueue::BalloonQueue(Clock clock)
+  : mClock(clock)
+  , mHasActive(false)
+  , mNextSequence(0)
+  , mMaxQueued(16)
+  , mRateLimit(0)
+  , mRateInterval(0)
+{
+  ZeroMemory(&mStats, sizeof(mStats));
+}
+
+
+void BalloonQueue::SetLimits(UINT maxQueued, UINT rateLimit, ULONGLONG rateInterval) {
+  mMaxQueued = std::max(maxQueued, 1u);
+  mRateLimit = rateLimit;
+  mRateInterval = rateInterval;
+  mHistory.clear();
+}
+
+
+BalloonQueue::Result BalloonQueue::Push(TrayIcon *icon, DWORD processId, LPCWSTR title,
+    LPCWSTR info, DWORD infoFlags, HICON balloonIcon) {
+  // Coalesce with the notification which is being shown.
+  if (mHasActive && mActive.icon == icon) {
+    Replace(mActive, title, info, infoFlags, balloonIcon);
+    ++mStats.merged;
+    return Result::MergedIntoActive;
+  }
+
+  // Coalesce with a notification which is waiting to be shown. It keeps its place in the queue,
+  // but is bumped up if the new one is more severe.
+  for (Entry &entry : mQueue) {
+    if (entry.notification.icon == icon) {
+      Replace(entry.notification, title, info, infoFlags, balloonIcon);
+      entry.severity = std::max(entry.severity, Severity(infoFlags));
+      ++mStats.merged;
+      return Result::Merged;
+    }
+  }
+
+  // Find room by evicting the least severe, most recently queued notification. If that is no less
+  // important than the new one, drop the new one instead.
+  int severity = Severity(infoFlags);
+  auto victim = mQueue.end();
+  if (mQueue.size() >= mMaxQueued) {
+    victim = std::min_element(mQueue.begin(), mQueue.end(), [] (const Entry &a, const Entry &b) {
+      return a.severity < b.severity || (a.severity == b.severity && a.sequence > b.sequence);
+    });
+    if (victim->severity >= severity) {
+      ++mStats.dropped;
+      return Result::Dropped;
+    }
+  }
+
+  // Only notifications which actually get queued count against the rate limit.
+  ULONGLONG now = mClock();
+  if (!WithinRate(processId, now)) {
+    ++mStats.rateLimited;
+    ++mStats.dropped;
+    return Result::Dropped;
+  }
+  ChargeRate(processId, now);
+
+  if (victim != mQueue.end()) {
+    ++mStats.dropped;
+    mQueue.erase(victim);
+  }
+
+  Entry entry;
+  entry.notification.icon = icon;
+  entry.notification.processId = processId;
+  entry.notification.queuedAt = now;
+  Replace(entry.notification, title, info, infoFlags, balloonIcon);
+  entry.severity = severity;
+  entry.sequence = mNextSequence++;
+  mQueue.push_back(std::move(entry));
+
+  ++mStats.queued;
+  return Result::Queued;
+}
+
+
+bool BalloonQueue::Next(bool quietTime) {
+  mHasActive = false;
+
+  while (!mQueue.empty()) {
+    auto best = std::min_element(mQueue.begin(), mQueue.end(), [] (const Entry &a, const Entry &b) {
+      return a.severity > b.severity || (a.severity == b.severity && a.sequence < b.sequence);
+    });
+
+    Entry entry = std::move(*best);
+    mQueue.erase(best);
+
+    if (quietTime && (entry.notification.infoFlags & NIIF_RESPECT_QUIET_TIME) == NIIF_RESPECT_QUIET_TIME) {
+      ++mStats.dropped;
+      continue;
+    }
+
+    mActive = std::move(entry.notification);
+    mHasActive = true;
+    ++mStats.shown;
+    return true;
+  }
+
+  return false;
+}
+
+
+const BalloonQueue::Notification *BalloonQueue::GetActive() const {
+  return mHasActive ? &mActive : nullptr;
+}
+
+
+TrayIcon *BalloonQueue::GetActiveIcon() const {
+  return mHasActive ? mActive.icon : nullptr;
+}
+
+
+void BalloonQueue::ClearActive() {
+  mHasActive = false;
+}
+
+
+void BalloonQueue::DropQueued(TrayIcon *icon) {
+  auto end = std::remove_if(mQueue.begin(), mQueue.end(), [icon] (const Entry &entry) {
+    return entry.notification.icon == icon;
+  });
+  mStats.dropped += mQueue.end() - end;
+  mQueue.erase(end, mQueue.end());
+}
+
+
+bool BalloonQueue::Empty() const {
+  return mQueue.empty();
+}
+
+
+const BalloonQueue::Stats &BalloonQueue::GetStats() const {
+  return mStats;
+}
+
+
+int BalloonQueue::Severity(DWORD infoFlags) {
+  switch (infoFlags & NIIF_ICON_MASK) {
+  case NIIF_ERROR:
+    return 3;
+  case NIIF_WARNING:
+    return 2;
+  case NIIF_INFO:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+
+bool BalloonQueue::WithinRate(DWORD processId, ULONGLONG now) {
+  if (mRateLimit == 0) {
+    return true;
+  }
+
+  // Forget about processes which have been quiet for a while.
+  for (auto iter = mHistory.begin(); iter != mHistory.end();) {
+    if (iter->first != processId && (iter->second.empty() || now - iter->second.back() >= mRateInterval)) {
+      iter = mHistory.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  auto history = mHistory.find(processId);
+  if (history == mHistory.end()) {
+    return true;
+  }
+  while (!history->second.empty() && now - history->second.front() >= mRateInterval) {
+    history->second.pop_front();
+  }
+  return history->second.size() < mRateLimit;
+}
+
+
+void BalloonQueue::ChargeRate(DWORD processId, ULONGLONG now) {
+  if (mRateLimit != 0) {
+    mHistory[processId].push_back(now);
+  }
+}
+
+
+void BalloonQueue::Replace(Notification &target, LPCWSTR title, LPCWSTR info, DWORD infoFlags,
+    HICON balloonIcon) {
+  target.title = title;
+  target.info = info;
+  target.infoFlags = infoFlags;
+  target.balloonIcon = balloonIcon;
+}
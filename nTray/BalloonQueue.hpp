@@ -0,0 +1,189 @@
+//-------------------------------------------------------------------------------------------------
+// /nTray/BalloonQueue.hpp
+// The nModules Project
+//
+// Decides which balloon notifications get shown, and in which order.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/Common.h"
+
+#include <shellapi.h>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TrayIcon;
+
+/// <summary>
+/// Queues balloon notifications for a tray. More severe notifications are shown first. A
+/// notification from an icon which already has one queued, or showing, replaces that one rather
+/// than being shown separately. Each process may only get a limited number of notifications
+/// through in a given interval; the rest are dropped.
+///
+/// The queue never touches the icons, and gets the time from the clock it is given, so the policy
+/// can be exercised on its own.
+/// </summary>
+class BalloonQueue {
+public:
+  // Returns the current time, in milliseconds.
+  typedef std::function<ULONGLONG ()> Clock;
+
+  /// <summary>
+  /// A balloon notification.
+  /// </summary>
+  struct Notification {
+    TrayIcon *icon;
+    DWORD processId;
+    std::wstring title;
+    std::wstring info;
+    DWORD infoFlags;
+    HICON balloonIcon;
+
+    // The time at which the notification was first queued.
+    ULONGLONG queuedAt;
+  };
+
+  /// <summary>
+  /// What happened to a pushed notification.
+  /// </summary>
+  enum class Result {
+    // Added to the queue.
+    Queued,
+
+    // Replaced a queued notification from the same icon.
+    Merged,
+
+    // Replaced the active notification, which should be redrawn.
+    MergedIntoActive,
+
+    // Discarded, due to rate limiting or a full queue.
+    Dropped
+  };
+
+  /// <summary>
+  /// Counters for the notifications which went through the queue.
+  /// </summary>
+  struct Stats {
+    // Notifications which were added to the queue.
+    ULONGLONG queued;
+
+    // Notifications which replaced a queued or active one.
+    ULONGLONG merged;
+
+    // Notifications which were made active.
+    ULONGLONG shown;
+
+    // Notifications which were discarded, for any reason.
+    ULONGLONG dropped;
+
+    // Notifications which were discarded because their process was over its limit.
+    ULONGLONG rateLimited;
+  };
+
+public:
+  explicit BalloonQueue(Clock clock);
+
+public:
+  /// <summary>
+  /// Sets the maximum number of queued notifications, and the maximum number of notifications a
+  /// single process may queue within rateInterval milliseconds. A rateLimit of 0 disables rate
+  /// limiting.
+  /// </summary>
+  void SetLimits(UINT maxQueued, UINT rateLimit, ULONGLONG rateInterval);
+
+  /// <summary>
+  /// Offers a notification to the queue.
+  /// </summary>
+  Result Push(TrayIcon *icon, DWORD processId, LPCWSTR title, LPCWSTR info, DWORD infoFlags,
+    HICON balloonIcon);
+
+  /// <summary>
+  /// Makes the most important queued notification the active one. If quietTime is true,
+  /// notifications which respect quiet time are discarded instead.
+  /// </summary>
+  /// <returns>False if there was nothing left to show.</returns>
+  bool Next(bool quietTime);
+
+  /// <summary>
+  /// Returns the active notification, or nullptr.
+  /// </summary>
+  const Notification *GetActive() const;
+
+  /// <summary>
+  /// Returns the icon of the active notification, or nullptr.
+  /// </summary>
+  TrayIcon *GetActiveIcon() const;
+
+  /// <summary>
+  /// Marks the active notification as done.
+  /// </summary>
+  void ClearActive();
+
+  /// <summary>
+  /// Discards all queued notifications from the specified icon. The active notification is left
+  /// alone.
+  /// </summary>
+  void DropQueued(TrayIcon *icon);
+
+  /// <summary>
+  /// Returns true if no notifications are queued.
+  /// </summary>
+  bool Empty() const;
+
+  /// <summary>
+  /// Returns the counters for this queue.
+  /// </summary>
+  const Stats &GetStats() const;
+
+  /// <summary>
+  /// Ranks notifications by their standard icon. Errors rank above warnings, which rank above
+  /// information, which ranks above everything else.
+  /// </summary>
+  static int Severity(DWORD infoFlags);
+
+private:
+  struct Entry {
+    Notification notification;
+    int severity;
+    ULONGLONG sequence;
+  };
+
+private:
+  /// <summary>
+  /// Checks whether the specified process may queue another notification.
+  /// </summary>
+  /// <returns>False if the process is over its limit.</returns>
+  bool WithinRate(DWORD processId, ULONGLONG now);
+
+  /// <summary>
+  /// Counts a queued notification against the limit of the specified process.
+  /// </summary>
+  void ChargeRate(DWORD processId, ULONGLONG now);
+
+  /// <summary>
+  /// Overwrites the contents of a notification with newer ones.
+  /// </summary>
+  static void Replace(Notification &target, LPCWSTR title, LPCWSTR info, DWORD infoFlags,
+    HICON balloonIcon);
+
+private:
+  Clock mClock;
+  Stats mStats;
+
+  std::vector<Entry> mQueue;
+  Notification mActive;
+  bool mHasActive;
+
+  // Used to keep notifications of the same severity in the order they were queued.
+  ULONGLONG mNextSequence;
+
+  // The times at which recent notifications from each process were queued.
+  std::unordered_map<DWORD, std::deque<ULONGLONG>> mHistory;
+
+  UINT mMaxQueued;
+  UINT mRateLimit;
+  ULONGLONG mRateInterval;
+};
@@ -39,10 +39,10 @@ static const StateRender<TrayIcon::States>::InitData sIconInitData([] (StateRend
 Tray::Tray(LPCTSTR name)
   : Drawable(name)
   , mBalloon(L"Balloon", mSettings, mWindow->RegisterUserMessage(this), this)
+  , mBalloonQueue(GetTickCount64)
   , mBalloonTimer(0)
   , mHideBalloons(false)
   , mNoTooltips(false)
-  , mActiveBalloonIcon(nullptr)
   , mTooltip(L"Tooltip", mSettings)
 {
   mOnResize[0] = L'\0';
@@ -92,6 +92,11 @@ void Tray::LoadSettings() {
   mNoTooltips = mSettings->GetBool(L"NoTooltips", false);
   mHideBalloons = mSettings->GetBool(L"HideBalloons", false);
   mBalloonTime = mSettings->GetInt(L"BalloonTime", 7000);
+  mMaxQueuedBalloons = mSettings->GetInt(L"MaxQueuedBalloons", 16);
+  mBalloonRateLimit = mSettings->GetInt(L"BalloonRateLimit", 4);
+  mBalloonRateInterval = mSettings->GetInt(L"BalloonRateInterval", 60000);
+  mBalloonQueue.SetLimits(UINT(std::max(mMaxQueuedBalloons, 1)), UINT(std::max(mBalloonRateLimit, 0)),
+    ULONGLONG(std::max(mBalloonRateInterval, 0)));
   mNoNotificationSounds = mSettings->GetBool(L"NoNotificationSounds", false);
   mSettings->GetString(L"NotificationSound", mNotificationSound, _countof(mNotificationSound),
     L"Notification.Default");
@@ -205,7 +210,8 @@ void Tray::RemoveIcon(TrayIcon *pIcon) {
   if (icon != mIcons.end()) {
     mIcons.erase(icon);
 
-    if (pIcon == mActiveBalloonIcon) {
+    mBalloonQueue.DropQueued(pIcon);
+    if (pIcon == mBalloonQueue.GetActiveIcon()) {
       DismissBalloon(NIN_BALLOONHIDE);
     }
     delete pIcon;
@@ -316,8 +322,9 @@ LRESULT WINAPI Tray::HandleMessage(HWND wnd, UINT message, WPARAM wParam, LPARAM
   default:
     if (message == mBalloon.GetClickedMessage()) {
       // wParam is 0 if the dialog was clicked. 1 if the x was clicked.
-      if (wParam == 0) {
-        mActiveBalloonIcon->SendCallback(NIN_BALLOONUSERCLICK, 0, 0);
+      TrayIcon *icon = mBalloonQueue.GetActiveIcon();
+      if (wParam == 0 && icon != nullptr) {
+        icon->SendCallback(NIN_BALLOONUSERCLICK, 0, 0);
       }
       DismissBalloon(NIN_BALLOONHIDE);
     }
@@ -359,8 +366,8 @@ void Tray::HideTip() {
 /// <summary>
 /// Enqueues a balloon.
 /// </summary>
-void Tray::EnqueueBalloon(TrayIcon *icon, LPCWSTR infoTitle, LPCWSTR info, DWORD infoFlags,
-  HICON balloonIcon, bool realTime)
+void Tray::EnqueueBalloon(TrayIcon *icon, DWORD processId, LPCWSTR infoTitle, LPCWSTR info,
+  DWORD infoFlags, HICON balloonIcon, bool realTime)
 {
   // Get the user notification state.
   QUERY_USER_NOTIFICATION_STATE state;
@@ -377,21 +384,30 @@ void Tray::EnqueueBalloon(TrayIcon *icon, LPCWSTR infoTitle, LPCWSTR info, DWORD
     return;
   }
 
-  BalloonData data;
-  data.icon = icon;
-  data.infoTitle = _wcsdup(infoTitle);
-  data.info = _wcsdup(info);
-  data.infoFlags = infoFlags;
-  data.balloonIcon = balloonIcon;
-
-  mQueuedBalloons.push_back(data);
+  switch (mBalloonQueue.Push(icon, processId, infoTitle, info, infoFlags, balloonIcon)) {
+  case BalloonQueue::Result::Queued:
+    if (mBalloonTimer == 0) {
+      ShowNextBalloon();
+    }
+    break;
 
-  if (mBalloonTimer == 0) {
-    ShowNextBalloon();
+  case BalloonQueue::Result::MergedIntoActive:
+    // Update the balloon in place. It keeps its original timeout, so that an app which keeps
+    // updating its balloon can't keep it up forever.
+    ShowActiveBalloon();
+    break;
   }
 }
 
 
+/// <summary>
+/// Returns the counters for the balloons which have gone through this tray.
+/// </summary>
+const BalloonQueue::Stats &Tray::GetBalloonStats() const {
+  return mBalloonQueue.GetStats();
+}
+
+
 /// <summary>
 /// Dismisses a balloon notification prematurely.
 /// </summary>
@@ -400,8 +416,14 @@ void Tray::DismissBalloon(UINT message) {
   SetTimer(mWindow->GetWindowHandle(), mBalloonTimer, mBalloonTime, nullptr);
 
   mBalloon.Hide();
-  mActiveBalloonIcon->SendCallback(message, 0, 0);
-  mActiveBalloonIcon = nullptr;
+
+  // The active balloon may already be gone, e.g. if its icon was removed while handling the
+  // click callback.
+  TrayIcon *icon = mBalloonQueue.GetActiveIcon();
+  if (icon != nullptr) {
+    icon->SendCallback(message, 0, 0);
+    mBalloonQueue.ClearActive();
+  }
 
   ShowNextBalloon();
 }
@@ -411,10 +433,9 @@ void Tray::DismissBalloon(UINT message) {
 /// Hides the current balloon and shows the next balloon in the queue.
 /// </summary>
 void Tray::ShowNextBalloon() {
-  if (mActiveBalloonIcon != nullptr) {
-    mBalloon.Hide();
-    mActiveBalloonIcon->SendCallback(NIN_BALLOONTIMEOUT, 0, 0);
-    mActiveBalloonIcon = nullptr;
+  if (mBalloonQueue.GetActiveIcon() != nullptr) {
+    mBalloonQueue.GetActiveIcon()->SendCallback(NIN_BALLOONTIMEOUT, 0, 0);
+    mBalloonQueue.ClearActive();
   }
 
   // Get the user notification state.
@@ -423,32 +444,45 @@ void Tray::ShowNextBalloon() {
 
   // If we are not accepting notifications at this time, we should wait.
   if (state != 0 && state != QUNS_ACCEPTS_NOTIFICATIONS && state != QUNS_QUIET_TIME) {
+    mBalloon.Hide();
     if (mBalloonTimer == 0) {
       mBalloonTimer = mWindow->SetCallbackTimer(mBalloonTime, this);
     }
     return;
   }
 
-  // Get the balloon to display.
-  BalloonData d;
-  // Discard balloons for icons which have gone away, or if we are in quiet mode.
-  do {
-    // If there are no more balloons
-    if (mQueuedBalloons.empty()) {
-      mWindow->ClearCallbackTimer(mBalloonTimer);
-      mBalloonTimer = 0;
-      return;
+  // Get the balloon to display, discarding those which respect quiet time if we are in it.
+  if (!mBalloonQueue.Next(state == QUNS_QUIET_TIME)) {
+    mBalloon.Hide();
+    mWindow->ClearCallbackTimer(mBalloonTimer);
+    mBalloonTimer = 0;
+    return;
+  }
+
+  if (mBalloonTimer == 0) {
+    mBalloonTimer = mWindow->SetCallbackTimer(mBalloonTime, this);
+    DWORD infoFlags = mBalloonQueue.GetActive()->infoFlags;
+    if ((infoFlags & NIIF_NOSOUND) != NIIF_NOSOUND && !mNoNotificationSounds) {
+      PlaySoundW(mNotificationSound, nullptr, SND_ALIAS | SND_ASYNC | SND_SYSTEM | SND_NODEFAULT);
     }
+  }
 
-    d = *mQueuedBalloons.begin();
-    mQueuedBalloons.pop_front();
+  // The balloon window is reused, rather than hidden and shown again.
+  ShowActiveBalloon();
+}
 
-    // TODO::Maybe we should permit balloons for icons which have gone away.
-  } while(FindIcon(d.icon) == mIcons.end() || state == QUNS_QUIET_TIME &&
-    (d.infoFlags & NIIF_RESPECT_QUIET_TIME) == NIIF_RESPECT_QUIET_TIME);
+
+/// <summary>
+/// Displays the contents of the active balloon.
+/// </summary>
+void Tray::ShowActiveBalloon() {
+  const BalloonQueue::Notification *d = mBalloonQueue.GetActive();
+  if (d == nullptr) {
+    return;
+  }
 
   SIZE iconSize;
-  if ((d.infoFlags & NIIF_LARGE_ICON) == NIIF_LARGE_ICON) {
+  if ((d->infoFlags & NIIF_LARGE_ICON) == NIIF_LARGE_ICON) {
     iconSize.cx = GetSystemMetrics(SM_CXICON);
     iconSize.cy = GetSystemMetrics(SM_CYICON);
   } else {
@@ -457,32 +491,19 @@ void Tray::ShowNextBalloon() {
   }
 
   HICON icon = nullptr;
-  if ((d.infoFlags & 0x3) == NIIF_INFO) {
+  if ((d->infoFlags & 0x3) == NIIF_INFO) {
     icon = mInfoIcon;
-  } else if ((d.infoFlags & 0x3) == NIIF_WARNING) {
+  } else if ((d->infoFlags & 0x3) == NIIF_WARNING) {
     icon = mWarningIcon;
-  } else if ((d.infoFlags & 0x3) == NIIF_ERROR) {
+  } else if ((d->infoFlags & 0x3) == NIIF_ERROR) {
     icon = mErrorIcon;
-  } else if ((d.infoFlags & NIIF_USER) == NIIF_USER && d.balloonIcon != nullptr) {
-    icon = d.balloonIcon;
-  }
-
-  if (mBalloonTimer == 0) {
-    mBalloonTimer = mWindow->SetCallbackTimer(mBalloonTime, this);
-    if ((d.infoFlags & NIIF_NOSOUND) != NIIF_NOSOUND && !mNoNotificationSounds) {
-      PlaySoundW(mNotificationSound, nullptr, SND_ALIAS | SND_ASYNC | SND_SYSTEM | SND_NODEFAULT);
-    }
+  } else if ((d->infoFlags & NIIF_USER) == NIIF_USER && d->balloonIcon != nullptr) {
+    icon = d->balloonIcon;
   }
 
   //
   RECT targetPosition;
-  d.icon->GetScreenRect(&targetPosition);
-
-  mActiveBalloonIcon = d.icon;
-
-  mBalloon.Show(d.infoTitle, d.info, icon, &iconSize, &targetPosition);
+  d->icon->GetScreenRect(&targetPosition);
 
-  // Free memory
-  free((LPVOID)d.infoTitle);
-  free((LPVOID)d.info);
+  mBalloon.Show(d->title.c_str(), d->info.c_str(), icon, &iconSize, &targetPosition);
 }
@@ -6,6 +6,7 @@
 //-------------------------------------------------------------------------------------------------
 #pragma once
 
+#include "BalloonQueue.hpp"
 #include "TrayIcon.hpp"
 #include "Types.h"
 
@@ -37,8 +38,9 @@ public:
   void InitCompleted();
   void ShowTip(LPCWSTR text, LPRECT position);
   void HideTip();
-  void EnqueueBalloon(TrayIcon*, LPCWSTR infoTitle, LPCWSTR info, DWORD infoFlags,
-    HICON balloonIcon, bool realTime);
+  void EnqueueBalloon(TrayIcon*, DWORD processId, LPCWSTR infoTitle, LPCWSTR info,
+    DWORD infoFlags, HICON balloonIcon, bool realTime);
+  const BalloonQueue::Stats &GetBalloonStats() const;
 
   // IMessageHandler
 public:
@@ -51,6 +53,9 @@ private:
   // Hides the current balloon, and possible shows the next balloon.
   void ShowNextBalloon();
 
+  // Displays the contents of the active balloon.
+  void ShowActiveBalloon();
+
   // Returns true if we should display the given icon.
   bool WantIcon(IconData&);
 
@@ -63,15 +68,6 @@ private:
     SizeDown
   };
 
-  // All data required to display a balloon.
-  struct BalloonData {
-    TrayIcon *icon;
-    LPCWSTR infoTitle;
-    LPCWSTR info;
-    DWORD infoFlags;
-    HICON balloonIcon;
-  };
-
   // All data required to determine whether to show or hide a particular icon.
   struct IconId {
     IconId(GUID guid) {
@@ -110,11 +106,9 @@ private:
   Tooltip mTooltip;
   vector<TrayIcon*> mIcons;
 
-  // Balloons queued up to be displayed.
-  std::list<BalloonData> mQueuedBalloons;
-
-  // The active balloon icon.
-  TrayIcon *mActiveBalloonIcon;
+  // Balloons queued up to be displayed, and the one being displayed. All balloons are shown
+  // through mBalloon.
+  BalloonQueue mBalloonQueue;
 
   // The size that the tray should be when it's not overflowing
   D2D1_SIZE_F mTargetSize;
@@ -142,6 +136,15 @@ private:
   // Number of milliseconds to show balloons.
   int mBalloonTime;
 
+  // The maximum number of balloons which may be waiting to be shown.
+  int mMaxQueuedBalloons;
+
+  // The maximum number of balloons a single process may queue within mBalloonRateInterval.
+  int mBalloonRateLimit;
+
+  // Number of milliseconds over which mBalloonRateLimit applies.
+  int mBalloonRateInterval;
+
   // If true, don't play any notification sounds.
   bool mNoNotificationSounds;
 
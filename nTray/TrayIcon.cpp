@@ -63,8 +63,8 @@ void TrayIcon::HandleModify(LiteStep::LPLSNOTIFYICONDATA pNID) {
   if ((pNID->uFlags & NIF_INFO) == NIF_INFO) {
     // uTimeout is only valid on 2000 and XP, so we can safely ignore it.
     if (*pNID->szInfo != L'\0' || *pNID->szInfoTitle != L'\0') {
-      ((Tray*)mParent)->EnqueueBalloon(this, pNID->szInfoTitle, pNID->szInfo, pNID->dwInfoFlags,
-        pNID->hBalloonIcon, (pNID->uFlags & NIF_REALTIME) == NIF_REALTIME);
+      ((Tray*)mParent)->EnqueueBalloon(this, mIconData.processId, pNID->szInfoTitle, pNID->szInfo,
+        pNID->dwInfoFlags, pNID->hBalloonIcon, (pNID->uFlags & NIF_REALTIME) == NIF_REALTIME);
     }
   }
 }
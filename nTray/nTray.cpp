@@ -12,7 +12,10 @@
 #include "../nShared/LiteStep.h"
 #include "../nShared/LSModule.hpp"
 
+#include "../nCoreCom/Core.h"
+
 #include <string>
+#include <strsafe.h>
 #include <unordered_map>
 
 #define WM_GOT_INITIAL_TRAY_ICONS WM_USER
@@ -47,6 +50,32 @@ static void LoadSettings() {
 }
 
 
+/// <summary>
+/// Reports the balloon counters of every tray to nCore.
+/// </summary>
+static void ReportBalloonCounters(COUNTERSINK report, LPVOID sink) {
+  static const struct {
+    LPCWSTR name;
+    ULONGLONG BalloonQueue::Stats::*counter;
+  } counters[] = {
+    { L"queued", &BalloonQueue::Stats::queued },
+    { L"merged", &BalloonQueue::Stats::merged },
+    { L"shown", &BalloonQueue::Stats::shown },
+    { L"dropped", &BalloonQueue::Stats::dropped },
+    { L"rateLimited", &BalloonQueue::Stats::rateLimited }
+  };
+
+  for (const TrayMap::value_type &tray : gTrays) {
+    const BalloonQueue::Stats &stats = tray.second.GetBalloonStats();
+    for (auto &counter : counters) {
+      WCHAR name[128];
+      StringCchPrintfW(name, _countof(name), L"%s.%s", tray.first.c_str(), counter.name);
+      report(sink, name, double(stats.*counter.counter));
+    }
+  }
+}
+
+
 /// <summary>
 /// Called by the LiteStep core when this module is loaded.
 /// </summary>
@@ -80,6 +109,10 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
     TrayManager::ListIconIDS();
   });
 
+  nCore::System::RegisterCounters(L"nTray.Balloons", ReportBalloonCounters);
+
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 
@@ -89,6 +122,7 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
 /// </summary>
 EXPORT_CDECL(void) quitModule(HINSTANCE /* instance */) {
   LiteStep::RemoveBangCommand(L"!nTrayListIconIDs");
+  nCore::System::UnRegisterCounters(L"nTray.Balloons");
   gTrays.clear();
   TrayManager::Stop();
   gLSModule.DeInitalize();
@@ -30,6 +30,8 @@ int initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path */) {
     return 1;
   }
 
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 
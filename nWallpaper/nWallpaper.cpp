@@ -31,6 +31,8 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
   }
   Bangs::_Register();
 
+  gLSModule.StartupCompleted();
+
   return 0;
 }
 